@@ -0,0 +1,174 @@
+#!/usr/bin/env bash
+
+# This script does decoding with a neural-net, composing the decoding graph
+# with a large language model on the fly (see nnet3-latgen-faster-biglm).  The
+# graph is built with a small LM (<old-lm-fst>, e.g. a pruned trigram), and the
+# difference between it and <new-lm> is applied at word ends.  Within a word the
+# pruning only sees the small LM (there is no look-ahead to <new-lm>).  This
+# avoids building HCLG with the large LM.  If <new-lm> ends in .carpa it is read
+# as a ConstArpaLm (as written by utils/build_const_arpa_lm.sh), otherwise as an
+# FST.
+#
+# To compare with decoding with a static HCLG built from the large LM, run
+# steps/nnet3/decode.sh with that graph on the same data.  The real-time factor
+# is printed at the end of this script (this can be done for any decoding
+# directory with --stage 3), and the WERs are in the usual scoring output.
+
+# Begin configuration section.
+stage=1
+nj=4 # number of decoding jobs.
+acwt=0.1  # Just a default value, used for adaptation and beam-pruning..
+post_decode_acwt=1.0  # can be used in 'chain' systems to scale acoustics by 10 so the
+                      # regular scoring script works.
+cmd=run.pl
+beam=15.0
+frames_per_chunk=50
+max_active=7000
+min_active=200
+lattice_beam=8.0 # Beam we use in lattice generation.
+iter=final
+mmap_lm=false   # If true, memory-map the ConstArpaLm so that the jobs on a
+                # machine share one copy; requires an LM built with
+                # arpa-to-const-arpa --page-align=true.
+lm_cache_size=0 # If >0, number of LM lookups to cache across utterances.
+scoring_opts=
+skip_scoring=false
+extra_left_context=0
+extra_right_context=0
+extra_left_context_initial=-1
+extra_right_context_final=-1
+online_ivector_dir=
+# End configuration section.
+
+echo "$0 $@"  # Print the command line for logging
+
+[ -f ./path.sh ] && . ./path.sh; # source the path.
+. utils/parse_options.sh || exit 1;
+
+if [ $# -ne 5 ]; then
+  echo "Usage: $0 [options] <graph-dir> <old-lm-fst> <new-lm> <data-dir> <decode-dir>"
+  echo "e.g.:   steps/nnet3/decode_biglm.sh --nj 8 \\"
+  echo "--online-ivector-dir exp/nnet3/ivectors_test_eval92 \\"
+  echo "    exp/chain/tdnn/graph_tgpr data/lang_test_tgpr/G.fst \\"
+  echo "    data/lang_test_fgconst/G.carpa data/test_eval92_hires \\"
+  echo "    exp/chain/tdnn/decode_biglm_fg_eval92"
+  echo "main options (for others, see top of script file)"
+  echo "  --config <config-file>                   # config containing options"
+  echo "  --nj <nj>                                # number of parallel jobs"
+  echo "  --cmd <cmd>                              # Command to run in parallel with"
+  echo "  --beam <beam>                            # Decoding beam; default 15.0"
+  echo "  --iter <iter>                            # Iteration of model to decode; default is final."
+  echo "  --mmap-lm <true|false>                   # Memory-map the ConstArpaLm; default false."
+  echo "  --scoring-opts <string>                  # options to local/score.sh"
+  exit 1;
+fi
+
+graphdir=$1
+oldlm_fst=$2
+newlm=$3
+data=$4
+dir=$5
+srcdir=`dirname $dir`; # Assume model directory one level up from decoding directory.
+model=$srcdir/$iter.mdl
+
+
+extra_files=
+if [ ! -z "$online_ivector_dir" ]; then
+  steps/nnet2/check_ivectors_compatible.sh $srcdir $online_ivector_dir || exit 1
+  extra_files="$online_ivector_dir/ivector_online.scp $online_ivector_dir/ivector_period"
+fi
+
+utils/lang/check_phones_compatible.sh {$srcdir,$graphdir}/phones.txt || exit 1
+
+for f in $graphdir/HCLG.fst $oldlm_fst $newlm $data/feats.scp $model $extra_files; do
+  [ ! -f $f ] && echo "$0: no such file $f" && exit 1;
+done
+
+[ -f `dirname $oldlm_fst`/words.txt ] && ! cmp `dirname $oldlm_fst`/words.txt $graphdir/words.txt && \
+  echo "$0: warning: old LM words.txt does not match with that in $graphdir .. probably will not work.";
+[ -f `dirname $newlm`/words.txt ] && ! cmp `dirname $newlm`/words.txt $graphdir/words.txt && \
+  echo "$0: warning: new LM words.txt does not match with that in $graphdir .. probably will not work.";
+
+sdata=$data/split$nj;
+if [ -f $srcdir/cmvn_opts ]; then
+    cmvn_opts=`cat $srcdir/cmvn_opts`
+else
+    cmvn_opts="--norm-means=false --norm-vars=false"
+fi
+
+mkdir -p $dir/log
+[[ -d $sdata && $data/feats.scp -ot $sdata ]] || split_data.sh $data $nj || exit 1;
+echo $nj > $dir/num_jobs
+
+## Set up features.
+if [ -f $srcdir/online_cmvn ]; then online_cmvn=true
+else online_cmvn=false; fi
+
+if ! $online_cmvn; then
+  echo "$0: feature type is raw"
+  feats="ark,s,cs:apply-cmvn $cmvn_opts --utt2spk=ark:$sdata/JOB/utt2spk scp:$sdata/JOB/cmvn.scp scp:$sdata/JOB/feats.scp ark:- |"
+else
+  echo "$0: feature type is raw (apply-cmvn-online)"
+  feats="ark,s,cs:apply-cmvn-online $cmvn_opts --spk2utt=ark:$sdata/JOB/spk2utt $srcdir/global_cmvn.stats scp:$sdata/JOB/feats.scp ark:- |"
+fi
+
+if [ ! -z "$online_ivector_dir" ]; then
+  ivector_period=$(cat $online_ivector_dir/ivector_period) || exit 1;
+  ivector_opts="--online-ivectors=scp:$online_ivector_dir/ivector_online.scp --online-ivector-period=$ivector_period"
+fi
+
+if [ "$post_decode_acwt" == 1.0 ]; then
+  lat_wspecifier="ark:|gzip -c >$dir/lat.JOB.gz"
+else
+  lat_wspecifier="ark:|lattice-scale --acoustic-scale=$post_decode_acwt ark:- ark:- | gzip -c >$dir/lat.JOB.gz"
+fi
+
+frame_subsampling_opt=
+if [ -f $srcdir/frame_subsampling_factor ]; then
+  # e.g. for 'chain' systems
+  frame_subsampling_opt="--frame-subsampling-factor=$(cat $srcdir/frame_subsampling_factor)"
+fi
+
+# fstproject replaces the disambiguation symbol #0, which only appears on the
+# input side, with the <eps> that appears in the corresponding arcs on the output side.
+oldlm_cmd="fstproject --project_output=true $oldlm_fst | fstarcsort --sort_type=ilabel |"
+case $newlm in
+  *.carpa)
+    newlm_opts="--use-const-arpa=true --mmap-lm=$mmap_lm --lm-cache-size=$lm_cache_size"
+    newlm_in=$newlm ;;
+  *)
+    newlm_opts="--use-const-arpa=false"
+    newlm_in="fstproject --project_output=true $newlm | fstarcsort --sort_type=ilabel |" ;;
+esac
+
+if [ $stage -le 1 ]; then
+  $cmd JOB=1:$nj $dir/log/decode.JOB.log \
+    nnet3-latgen-faster-biglm $ivector_opts $frame_subsampling_opt \
+     --frames-per-chunk=$frames_per_chunk \
+     --extra-left-context=$extra_left_context \
+     --extra-right-context=$extra_right_context \
+     --extra-left-context-initial=$extra_left_context_initial \
+     --extra-right-context-final=$extra_right_context_final \
+     --max-active=$max_active --min-active=$min_active --beam=$beam \
+     --lattice-beam=$lattice_beam --acoustic-scale=$acwt --allow-partial=true \
+     --word-symbol-table=$graphdir/words.txt $newlm_opts "$model" \
+     $graphdir/HCLG.fst "$oldlm_cmd" "$newlm_in" "$feats" "$lat_wspecifier" || exit 1;
+fi
+
+if [ $stage -le 2 ]; then
+  if ! $skip_scoring ; then
+    [ ! -x local/score.sh ] && \
+      echo "Not scoring because local/score.sh does not exist or not executable." && exit 1;
+    local/score.sh $scoring_opts --cmd "$cmd" $data $graphdir $dir
+  fi
+fi
+
+if [ $stage -le 3 ]; then
+  # Summarize the speed, for comparison with other decoding setups (e.g. a
+  # static HCLG decoded with steps/nnet3/decode.sh).
+  cat $dir/log/decode.*.log | \
+    awk '/real-time factor/ { rtf += $NF; n++; }
+         END { if (n > 0) printf("%s: average real-time factor is %.3f\n", dir, rtf / n); }' dir=$dir
+fi
+echo "Decoding done."
+exit 0;
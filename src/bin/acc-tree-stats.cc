@@ -20,11 +20,45 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "tree/context-dep.h"
 #include "tree/build-tree-utils.h"
 #include "hmm/transition-model.h"
 #include "hmm/tree-accu.h"
 
+namespace kaldi {
+
+typedef std::map<EventType, GaussClusterable*> TreeStatsMap;
+
+// Accumulates the tree stats for one utterance, into whichever accumulator
+// of the pool is free.
+class AccTreeStatsTask {
+ public:
+  AccTreeStatsTask(const TransitionModel &trans_model,
+                   const AccumulateTreeStatsInfo &info,
+                   const std::vector<int32> &alignment,
+                   const Matrix<BaseFloat> &features,
+                   AccumulatorPool<TreeStatsMap> *pool):
+      trans_model_(trans_model), info_(info), alignment_(alignment),
+      features_(features), pool_(pool) { }
+
+  void operator () () {
+    TreeStatsMap *tree_stats = pool_->Acquire();
+    AccumulateTreeStats(trans_model_, info_, alignment_, features_,
+                        tree_stats);
+    pool_->Release(tree_stats);
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+  const AccumulateTreeStatsInfo &info_;
+  std::vector<int32> alignment_;
+  Matrix<BaseFloat> features_;
+  AccumulatorPool<TreeStatsMap> *pool_;
+};
+
+}  // namespace kaldi
+
 /** @brief Accumulate tree statistics for decision tree training. The
 program reads in a feature archive, and the corresponding alignments,
 and generates the sufficient statistics for the decision tree
@@ -39,13 +73,17 @@ int main(int argc, char *argv[]) {
         "Accumulate statistics for phonetic-context tree building.\n"
         "Usage:  acc-tree-stats [options] <model-in> <features-rspecifier> <alignments-rspecifier> <tree-accs-out>\n"
         "e.g.: \n"
-        " acc-tree-stats 1.mdl scp:train.scp ark:1.ali 1.tacc\n";
+        " acc-tree-stats 1.mdl scp:train.scp ark:1.ali 1.tacc\n"
+        "With --num-threads=N, the utterances are processed by N threads,\n"
+        "each with its own stats, which are summed at the end.\n";
 
     bool binary = true;
     AccumulateTreeStatsOptions opts;
+    TaskSequencerConfig sequencer_config;
     ParseOptions po(usage);
     po.Register("binary", &binary, "Write output in binary mode");
     opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -73,35 +111,43 @@ int main(int argc, char *argv[]) {
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessInt32VectorReader alignment_reader(alignment_rspecifier);
 
-    std::map<EventType, GaussClusterable*> tree_stats;
+    AccumulatorPool<TreeStatsMap> pool(sequencer_config);
 
     int num_done = 0, num_no_alignment = 0, num_other_error = 0;
 
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!alignment_reader.HasKey(key)) {
-        num_no_alignment++;
-      } else {
-        const Matrix<BaseFloat> &mat = feature_reader.Value();
-        const std::vector<int32> &alignment = alignment_reader.Value(key);
-
-        if (alignment.size() != mat.NumRows()) {
-          KALDI_WARN << "Alignments has wrong size "<< (alignment.size())<<" vs. "<< (mat.NumRows());
-          num_other_error++;
-          continue;
+    {
+      TaskSequencer<AccTreeStatsTask> sequencer(sequencer_config);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!alignment_reader.HasKey(key)) {
+          num_no_alignment++;
+        } else {
+          const Matrix<BaseFloat> &mat = feature_reader.Value();
+          const std::vector<int32> &alignment = alignment_reader.Value(key);
+
+          if (alignment.size() != mat.NumRows()) {
+            KALDI_WARN << "Alignments has wrong size "<< (alignment.size())<<" vs. "<< (mat.NumRows());
+            num_other_error++;
+            continue;
+          }
+
+          sequencer.Run(new AccTreeStatsTask(trans_model,
+                                             acc_tree_stats_info,
+                                             alignment,
+                                             mat,
+                                             &pool));
+          num_done++;
+          if (num_done % 1000 == 0)
+            KALDI_LOG << "Processed " << num_done << " utterances.";
         }
-
-        AccumulateTreeStats(trans_model,
-                            acc_tree_stats_info,
-                            alignment,
-                            mat,
-                            &tree_stats);
-        num_done++;
-        if (num_done % 1000 == 0)
-          KALDI_LOG << "Processed " << num_done << " utterances.";
       }
     }
 
+    // Sum the stats of the different threads into the first one.
+    TreeStatsMap &tree_stats = pool.Accum(0);
+    for (int32 i = 1; i < pool.NumAccums(); i++)
+      MergeTreeStats(&(pool.Accum(i)), &tree_stats);
+
     BuildTreeStatsType stats;  // vectorized form.
 
     for (std::map<EventType, GaussClusterable*>::const_iterator iter = tree_stats.begin();
@@ -0,0 +1,113 @@
+// decoder/lattice-incremental-decoder-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-incremental-decoder.h"
+#include "hmm/hmm-test-utils.h"
+
+namespace kaldi {
+
+// Returns a one-state looped graph with an arc for each transition-id, some of
+// them with words on.
+fst::VectorFst<fst::StdArc> *GenRandLoopedGraph(
+    const TransitionModel &trans_model) {
+  fst::VectorFst<fst::StdArc> *fst = new fst::VectorFst<fst::StdArc>;
+  fst::StdArc::StateId s = fst->AddState();
+  fst->SetStart(s);
+  fst->SetFinal(s, fst::TropicalWeight::One());
+  for (int32 tid = 1; tid <= trans_model.NumTransitionIds(); tid++) {
+    int32 word = (RandInt(0, 2) == 0 ? RandInt(1, 10) : 0);
+    fst->AddArc(s, fst::StdArc(tid, word, RandUniform(), s));
+  }
+  return fst;
+}
+
+// Checks that states 0 .. num_states - 1 of "clat" have the same arcs and
+// final-probs as in "prev_clat".
+void CheckPrefixUnchanged(const CompactLattice &prev_clat,
+                          const CompactLattice &clat,
+                          int32 num_states) {
+  KALDI_ASSERT(num_states <= prev_clat.NumStates() &&
+               num_states <= clat.NumStates());
+  for (int32 s = 0; s < num_states; s++) {
+    KALDI_ASSERT(prev_clat.Final(s) == clat.Final(s) &&
+                 prev_clat.NumArcs(s) == clat.NumArcs(s));
+    fst::ArcIterator<CompactLattice> prev_aiter(prev_clat, s),
+        aiter(clat, s);
+    for (; !aiter.Done(); prev_aiter.Next(), aiter.Next()) {
+      const CompactLatticeArc &prev_arc = prev_aiter.Value(),
+          &arc = aiter.Value();
+      KALDI_ASSERT(prev_arc.ilabel == arc.ilabel &&
+                   prev_arc.olabel == arc.olabel &&
+                   prev_arc.weight == arc.weight &&
+                   prev_arc.nextstate == arc.nextstate);
+    }
+  }
+}
+
+// Decodes random likelihoods, getting the lattice after every few frames, and
+// checks that the states that NumFrozenLatticeStates() says are frozen stay
+// the same as later chunks are determinized.
+void TestNumFrozenLatticeStates() {
+  TransitionModel *trans_model = GenRandTransitionModel(NULL);
+  fst::VectorFst<fst::StdArc> *fst = GenRandLoopedGraph(*trans_model);
+
+  LatticeIncrementalDecoderConfig config;
+  config.beam = 8.0;
+  config.lattice_beam = 3.0;
+  config.max_active = 30;
+  config.min_active = 1;
+  config.determinize_max_delay = RandInt(6, 20);
+  config.determinize_min_chunk_size = RandInt(1, 5);
+
+  int32 num_frames = RandInt(20, 60);
+  Matrix<BaseFloat> loglikes(num_frames, trans_model->NumTransitionIds());
+  loglikes.SetRandn();
+  loglikes.Scale(3.0);
+  DecodableMatrixScaled decodable(loglikes, 1.0);
+
+  LatticeIncrementalDecoder decoder(*fst, *trans_model, config);
+  decoder.InitDecoding();
+  CompactLattice prev_clat;
+  int32 num_frozen_states = 0;
+  while (decoder.NumFramesDecoded() < num_frames) {
+    decoder.AdvanceDecoding(&decodable, RandInt(1, 5));
+    const CompactLattice &clat =
+        decoder.GetLattice(decoder.NumFramesDecoded(), false);
+    CheckPrefixUnchanged(prev_clat, clat, num_frozen_states);
+    int32 new_num_frozen_states = decoder.NumFrozenLatticeStates();
+    KALDI_ASSERT(new_num_frozen_states >= num_frozen_states &&
+                 new_num_frozen_states <= clat.NumStates());
+    num_frozen_states = new_num_frozen_states;
+    prev_clat = clat;
+  }
+  decoder.FinalizeDecoding();
+  const CompactLattice &clat =
+      decoder.GetLattice(decoder.NumFramesDecoded(), true);
+  CheckPrefixUnchanged(prev_clat, clat, num_frozen_states);
+
+  delete fst;
+  delete trans_model;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 10; i++)
+    kaldi::TestNumFrozenLatticeStates();
+  KALDI_LOG << "Success.";
+}
@@ -1220,6 +1220,33 @@ void LatticeIncrementalDeterminizer::GetNonFinalRedetStates() {
 }
 
 
+CompactLattice::StateId LatticeIncrementalDeterminizer::NumFrozenStates() const {
+  using StateId = CompactLattice::StateId;
+  StateId ans = clat_.NumStates();
+  for (StateId redet_state: non_final_redet_states_) {
+    ans = std::min(ans, redet_state);
+    // The arcs entering redeterminized-states get their weights (and possibly
+    // destination-states) changed by ProcessArcsFromChunkStartState().
+    for (const auto &p: arcs_in_[redet_state]) {
+      StateId src_state = p.first;
+      int32 arc_pos = p.second;
+      if (src_state >= ans || arc_pos >= (int32)clat_.NumArcs(src_state))
+        continue;
+      fst::ArcIterator<CompactLattice> aiter(clat_, src_state);
+      aiter.Seek(arc_pos);
+      if (aiter.Value().nextstate == redet_state)  // else it's out of date.
+        ans = src_state;
+    }
+  }
+  // SetFinalCosts() sets final-probs on the sources of final_arcs_ (stored in
+  // .nextstate), which are not in non_final_redet_states_ if they are not
+  // accessible.
+  for (const CompactLatticeArc &arc: final_arcs_)
+    ans = std::min(ans, arc.nextstate);
+  return ans;
+}
+
+
 void LatticeIncrementalDeterminizer::InitializeRawLatticeChunk(
     Lattice *olat,
     unordered_map<Label, LatticeArc::StateId> *token_label2state) {
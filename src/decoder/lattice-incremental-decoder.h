@@ -283,6 +283,16 @@ class LatticeIncrementalDeterminizer {
 
   const CompactLattice &GetLattice() { return clat_; }
 
+  /**
+     Returns a number n such that states 0 .. n-1 of clat_ will not change
+     when further chunks are accepted: neither their arcs (including the
+     weights and destination-states of the arcs) nor their final-probs.  These
+     are the states that are not redeterminized-states and have no arcs into
+     redeterminized-states.  This is for code that processes the lattice
+     incrementally, such as IncrementalWordAligner.
+  */
+  CompactLattice::StateId NumFrozenStates() const;
+
   // kStateLabelOffset is what we add to state-ids in clat_ to produce labels
   // to identify them in the raw lattice chunk
   // kTokenLabelOffset is where we start allocating labels corresponding to Tokens
@@ -568,6 +578,16 @@ class LatticeIncrementalDecoderTpl {
    */
   int NumFramesInLattice() const { return num_frames_in_lattice_; }
 
+  /**
+    Returns the number of leading states of the lattice returned by
+    GetLattice() that will not change as decoding continues (see
+    LatticeIncrementalDeterminizer::NumFrozenStates()); e.g. to give to
+    IncrementalWordAligner::AdvanceAlignment().
+   */
+  int32 NumFrozenLatticeStates() const {
+    return determinizer_.NumFrozenStates();
+  }
+
   /**
      InitDecoding initializes the decoding, and should only be used if you
      intend to call AdvanceDecoding().  If you call Decode(), you don't need to
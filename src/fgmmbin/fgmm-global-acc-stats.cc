@@ -114,6 +114,9 @@ int main(int argc, char *argv[]) {
           continue;
         }
         
+        // The posteriors of the whole file are accumulated at once; this is
+        // much faster than accumulating frame by frame.
+        Matrix<BaseFloat> posts(file_frames, fgmm.NumGauss());
         for (int32 i = 0; i < file_frames; i++) {
           BaseFloat weight = (weights.Dim() != 0) ? weights(i) : 1.0;
           if (weight == 0.0) continue;
@@ -127,15 +130,25 @@ int main(int argc, char *argv[]) {
           file_like += weight * loglikes.ApplySoftMax();
           loglikes.Scale(weight);
           for (int32 j = 0; j < loglikes.Dim(); j++)
-            fgmm_accs.AccumulateForComponent(data, this_gselect[j], loglikes(j));
+            posts(i, this_gselect[j]) += loglikes(j);
         }
+        fgmm_accs.AccumulateFromPosteriors(mat, posts);
       } else { // no gselect...
-        for (int32 i = 0; i < file_frames; i++) {
-          BaseFloat weight = (weights.Dim() != 0) ? weights(i) : 1.0;
-          if (weight == 0.0) continue;
-          file_weight += weight;
-          file_like += weight *
-              fgmm_accs.AccumulateFromFull(fgmm, mat.Row(i), weight);
+        if (file_frames != 0) {
+          Matrix<BaseFloat> posts;
+          fgmm.LogLikelihoods(mat, &posts);
+          for (int32 i = 0; i < file_frames; i++) {
+            SubVector<BaseFloat> post(posts, i);
+            BaseFloat weight = (weights.Dim() != 0) ? weights(i) : 1.0;
+            if (weight == 0.0) {
+              post.SetZero();
+              continue;
+            }
+            file_weight += weight;
+            file_like += weight * post.ApplySoftMax();
+            post.Scale(weight);
+          }
+          fgmm_accs.AccumulateFromPosteriors(mat, posts);
         }
       }
       KALDI_VLOG(2) << "File '" << key << "': Average likelihood = "
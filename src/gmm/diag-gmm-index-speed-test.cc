@@ -0,0 +1,105 @@
+// gmm/diag-gmm-index-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "base/timer.h"
+#include "gmm/diag-gmm-index.h"
+
+namespace kaldi {
+
+// Initializes a GMM whose means are grouped around a smaller number of
+// centers, which is more like a real UBM than independent random means.
+void InitRandomGmm(int32 num_gauss, int32 dim, DiagGmm *gmm) {
+  gmm->Resize(num_gauss, dim);
+  int32 num_centers = 1 + num_gauss / 16;
+  Matrix<BaseFloat> centers(num_centers, dim);
+  centers.SetRandn();
+  centers.Scale(3.0);
+  Matrix<BaseFloat> inv_vars(num_gauss, dim),
+      means(num_gauss, dim);
+  Vector<BaseFloat> weights(num_gauss);
+  for (int32 i = 0; i < num_gauss; i++) {
+    int32 c = RandInt(0, num_centers - 1);
+    for (int32 j = 0; j < dim; j++) {
+      inv_vars(i, j) = Exp(RandGauss() * 0.5);
+      means(i, j) = centers(c, j) + RandGauss();
+    }
+    weights(i) = Exp(RandGauss());
+  }
+  weights.Scale(1.0 / weights.Sum());
+  gmm->SetWeights(weights);
+  gmm->SetInvVarsAndMeans(inv_vars, means);
+  gmm->ComputeGconsts();
+}
+
+// Compares the recall and speed of the index with exhaustive Gaussian
+// selection, on data generated from the GMM.
+void UnitTestDiagGmmIndexRecall(int32 num_gauss, int32 dim,
+                                int32 num_gselect) {
+  DiagGmm gmm;
+  InitRandomGmm(num_gauss, dim, &gmm);
+  DiagGmmIndexOptions opts;
+  DiagGmmIndex index(gmm, num_gselect, opts);
+
+  int32 num_frames = 500;
+  Matrix<BaseFloat> feats(num_frames, dim);
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> frame(feats, t);
+    gmm.Generate(&frame);
+  }
+  std::vector<std::vector<int32> > gselect_ref, gselect;
+  Timer timer;
+  gmm.GaussianSelection(feats, num_gselect, &gselect_ref);
+  double time_ref = timer.Elapsed();
+  timer.Reset();
+  int64 num_evaluated = 0;
+  index.GaussianSelection(gmm, feats, num_gselect, &gselect, &num_evaluated);
+  double time = timer.Elapsed();
+
+  int32 num_found = 0, num_best_found = 0;
+  for (int32 t = 0; t < num_frames; t++) {
+    std::vector<int32> ref(gselect_ref[t]);
+    std::sort(ref.begin(), ref.end());
+    for (size_t j = 0; j < gselect[t].size(); j++)
+      if (std::binary_search(ref.begin(), ref.end(), gselect[t][j]))
+        num_found++;
+    if (gselect[t][0] == gselect_ref[t][0])
+      num_best_found++;
+  }
+  BaseFloat recall = num_found / static_cast<BaseFloat>(num_frames *
+                                                        num_gselect),
+      best_recall = num_best_found / static_cast<BaseFloat>(num_frames);
+  KALDI_LOG << "For " << num_gauss << " Gaussians of dimension " << dim
+            << ", " << index.NumClusters() << " clusters, top " << num_gselect
+            << ": recall is " << recall << " (of the best Gaussian, "
+            << best_recall << "), evaluating "
+            << (num_evaluated / static_cast<BaseFloat>(num_frames))
+            << " Gaussians per frame; time was " << time << " vs. "
+            << time_ref << " for exhaustive selection.";
+  KALDI_ASSERT(recall > 0.8 && best_recall > 0.9);
+  KALDI_ASSERT(num_evaluated < static_cast<int64>(num_frames) * num_gauss);
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestDiagGmmIndexRecall(256, 20, 10);
+  UnitTestDiagGmmIndexRecall(2048, 40, 20);
+  std::cout << "Test OK.\n";
+}
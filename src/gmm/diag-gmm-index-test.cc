@@ -0,0 +1,125 @@
+// gmm/diag-gmm-index-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "gmm/diag-gmm-index.h"
+
+namespace kaldi {
+
+// Initializes a GMM whose means are grouped around a smaller number of
+// centers, which is more like a real UBM than independent random means.
+void InitRandomGmm(int32 num_gauss, int32 dim, DiagGmm *gmm) {
+  gmm->Resize(num_gauss, dim);
+  int32 num_centers = 1 + num_gauss / 16;
+  Matrix<BaseFloat> centers(num_centers, dim);
+  centers.SetRandn();
+  centers.Scale(3.0);
+  Matrix<BaseFloat> inv_vars(num_gauss, dim),
+      means(num_gauss, dim);
+  Vector<BaseFloat> weights(num_gauss);
+  for (int32 i = 0; i < num_gauss; i++) {
+    int32 c = RandInt(0, num_centers - 1);
+    for (int32 j = 0; j < dim; j++) {
+      inv_vars(i, j) = Exp(RandGauss() * 0.5);
+      means(i, j) = centers(c, j) + RandGauss();
+    }
+    weights(i) = Exp(RandGauss());
+  }
+  weights.Scale(1.0 / weights.Sum());
+  gmm->SetWeights(weights);
+  gmm->SetInvVarsAndMeans(inv_vars, means);
+  gmm->ComputeGconsts();
+}
+
+// Checks that "gselect" and "gselect_ref" are both a best "num_gselect"
+// Gaussians for "data", allowing Gaussians whose log-likelihoods are the same
+// up to roundoff to be swapped.  (The index and DiagGmm may compute the
+// log-likelihoods in different ways.)
+void CheckGselectEquivalent(const DiagGmm &gmm,
+                            const VectorBase<BaseFloat> &data,
+                            const std::vector<int32> &gselect,
+                            const std::vector<int32> &gselect_ref) {
+  KALDI_ASSERT(gselect.size() == gselect_ref.size());
+  Vector<BaseFloat> loglikes;
+  gmm.LogLikelihoods(data, &loglikes);
+  std::vector<BaseFloat> selected, selected_ref;
+  for (size_t i = 0; i < gselect.size(); i++) {
+    selected.push_back(loglikes(gselect[i]));
+    selected_ref.push_back(loglikes(gselect_ref[i]));
+  }
+  std::vector<int32> sorted_gselect(gselect);
+  std::sort(sorted_gselect.begin(), sorted_gselect.end());
+  KALDI_ASSERT(std::adjacent_find(sorted_gselect.begin(),
+                                  sorted_gselect.end()) ==
+               sorted_gselect.end());  // no duplicates.
+  std::sort(selected.begin(), selected.end());
+  std::sort(selected_ref.begin(), selected_ref.end());
+  for (size_t i = 0; i < selected.size(); i++)
+    KALDI_ASSERT(std::abs(selected[i] - selected_ref[i]) <
+                 1.0e-04 * std::max<BaseFloat>(1.0, std::abs(selected[i])));
+}
+
+// With an infinite beam and all the clusters searched, the selection should be
+// the same as the exhaustive one, except for near-ties.
+void UnitTestDiagGmmIndexExhaustive() {
+  DiagGmm gmm;
+  InitRandomGmm(RandInt(1, 100), RandInt(1, 10), &gmm);
+  DiagGmmIndexOptions opts;
+  opts.num_clusters = RandInt(0, 12);
+  opts.max_clusters = gmm.NumGauss();
+  opts.beam = 1.0e+10;
+  int32 num_frames = RandInt(1, 20), num_gselect = RandInt(1, 10);
+  DiagGmmIndex index(gmm, num_gselect, opts);
+  KALDI_ASSERT(index.NumClusters() > 0);
+  std::vector<bool> seen(gmm.NumGauss(), false);
+  for (int32 c = 0; c < index.NumClusters(); c++)
+    for (size_t i = 0; i < index.Shortlist(c).size(); i++)
+      seen[index.Shortlist(c)[i]] = true;
+  KALDI_ASSERT(std::count(seen.begin(), seen.end(), false) == 0);
+
+  Matrix<BaseFloat> feats(num_frames, gmm.Dim());
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> frame(feats, t);
+    gmm.Generate(&frame);
+  }
+  std::vector<std::vector<int32> > gselect_ref, gselect;
+  BaseFloat like_ref = gmm.GaussianSelection(feats, num_gselect, &gselect_ref);
+  int64 num_evaluated = 0;
+  BaseFloat like = index.GaussianSelection(gmm, feats, num_gselect, &gselect,
+                                           &num_evaluated);
+  KALDI_ASSERT(gselect.size() == gselect_ref.size());
+  for (int32 t = 0; t < num_frames; t++)
+    CheckGselectEquivalent(gmm, feats.Row(t), gselect[t], gselect_ref[t]);
+  KALDI_ASSERT(ApproxEqual(like, like_ref));
+  KALDI_ASSERT(num_evaluated == static_cast<int64>(num_frames) *
+               (index.NumClusters() + gmm.NumGauss()));
+  for (int32 t = 0; t < num_frames; t++) {
+    std::vector<int32> this_gselect;
+    index.GaussianSelection(gmm, feats.Row(t), num_gselect, &this_gselect);
+    CheckGselectEquivalent(gmm, feats.Row(t), this_gselect, gselect_ref[t]);
+  }
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestDiagGmmIndexExhaustive();
+  std::cout << "Test OK.\n";
+}
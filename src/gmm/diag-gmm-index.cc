@@ -0,0 +1,224 @@
+// gmm/diag-gmm-index.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "gmm/diag-gmm-index.h"
+#include "tree/cluster-utils.h"
+#include "tree/clusterable-classes.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+void DiagGmmIndex::Init(const DiagGmm &gmm, int32 num_gselect,
+                        const DiagGmmIndexOptions &opts) {
+  opts_ = opts;
+  num_gauss_ = gmm.NumGauss();
+  int32 dim = gmm.Dim(), num_clusters = opts.num_clusters;
+  if (num_clusters <= 0)
+    num_clusters = static_cast<int32>(std::sqrt(
+        static_cast<double>(num_gauss_)) + 0.5);
+  num_clusters = std::max(1, std::min(num_clusters, num_gauss_));
+  KALDI_ASSERT(num_gselect > 0 && opts.max_clusters > 0 && opts.beam > 0.0 &&
+               opts.samples_per_gauss >= 0);
+
+  // The Gaussians are clustered with unit counts, so that the clusters do not
+  // depend on the weights (which are accounted for in the cluster Gaussians).
+  Matrix<BaseFloat> means(num_gauss_, dim), vars(num_gauss_, dim);
+  gmm.GetMeans(&means);
+  gmm.GetVars(&vars);
+  double min_var = 1.0e-10;
+  std::vector<Clusterable*> clusterable_vec(num_gauss_);
+  for (int32 g = 0; g < num_gauss_; g++) {
+    Vector<BaseFloat> x_stats(means.Row(g)), x2_stats(vars.Row(g));
+    x2_stats.AddVec2(1.0, x_stats);  // x2_stats is now var + mean^2.
+    clusterable_vec[g] = new GaussClusterable(x_stats, x2_stats, min_var, 1.0);
+  }
+  std::vector<int32> assignments;
+  ClusterKMeansOptions cfg;
+  cfg.verbose = false;
+  ClusterKMeans(clusterable_vec, num_clusters, NULL, &assignments, cfg);
+  DeletePointers(&clusterable_vec);
+
+  std::vector<std::vector<int32> > members(num_clusters);
+  for (int32 g = 0; g < num_gauss_; g++)
+    members[assignments[g]].push_back(g);
+  shortlists_.clear();
+  for (int32 c = 0; c < num_clusters; c++)
+    if (!members[c].empty())
+      shortlists_.push_back(members[c]);
+  num_clusters = shortlists_.size();
+
+  // Each cluster Gaussian has the first and second moments of its members,
+  // and the total weight of its members.
+  Vector<BaseFloat> weights(num_clusters);
+  Matrix<BaseFloat> cluster_means(num_clusters, dim),
+      cluster_vars(num_clusters, dim);
+  const Vector<BaseFloat> &gmm_weights = gmm.weights();
+  for (int32 c = 0; c < num_clusters; c++) {
+    SubVector<BaseFloat> mean(cluster_means, c), var(cluster_vars, c);
+    const std::vector<int32> &this_members = shortlists_[c];
+    for (size_t i = 0; i < this_members.size(); i++) {
+      int32 g = this_members[i];
+      weights(c) += gmm_weights(g);
+      mean.AddVec(1.0, means.Row(g));
+      var.AddVec(1.0, vars.Row(g));
+      var.AddVec2(1.0, means.Row(g));
+    }
+    mean.Scale(1.0 / this_members.size());
+    var.Scale(1.0 / this_members.size());  // var is now E[x^2].
+    var.AddVec2(-1.0, mean);
+    var.ApplyFloor(min_var);
+    weights(c) = std::max(weights(c), std::numeric_limits<BaseFloat>::min());
+  }
+  cluster_gmm_.Resize(num_clusters, dim);
+  cluster_gmm_.SetWeights(weights);
+  cluster_vars.InvertElements();
+  cluster_gmm_.SetInvVarsAndMeans(cluster_vars, cluster_means);
+  cluster_gmm_.ComputeGconsts();
+
+  // Add to the shortlist of each cluster the best Gaussians for the points,
+  // sampled from each of the Gaussians, for which that cluster is the best.
+  int32 num_samples = num_gauss_ * opts.samples_per_gauss;
+  if (num_samples > 0) {
+    Matrix<BaseFloat> samples(num_samples, dim, kUndefined),
+        std_devs(vars);
+    std_devs.ApplyPow(0.5);
+    samples.SetRandn();
+    for (int32 i = 0; i < num_samples; i++) {
+      int32 g = i % num_gauss_;
+      SubVector<BaseFloat> sample(samples, i);
+      sample.MulElements(std_devs.Row(g));
+      sample.AddVec(1.0, means.Row(g));
+    }
+    std::vector<std::vector<int32> > gselect;
+    gmm.GaussianSelection(samples, std::min(num_gselect, num_gauss_),
+                          &gselect);
+    Matrix<BaseFloat> cluster_loglikes;
+    cluster_gmm_.LogLikelihoods(samples, &cluster_loglikes);
+    for (int32 i = 0; i < num_samples; i++) {
+      MatrixIndexT best_cluster;
+      cluster_loglikes.Row(i).Max(&best_cluster);
+      std::vector<int32> &shortlist = shortlists_[best_cluster];
+      shortlist.insert(shortlist.end(), gselect[i].begin(), gselect[i].end());
+    }
+  }
+  size_t tot_size = 0;
+  for (int32 c = 0; c < num_clusters; c++) {
+    SortAndUniq(&(shortlists_[c]));
+    tot_size += shortlists_[c].size();
+  }
+  KALDI_VLOG(2) << "Built index with " << num_clusters << " clusters over "
+                << num_gauss_ << " Gaussians; average shortlist size is "
+                << (tot_size / static_cast<BaseFloat>(num_clusters));
+}
+
+BaseFloat DiagGmmIndex::SelectGivenClusterLoglikes(
+    const DiagGmm &gmm,
+    const VectorBase<BaseFloat> &data,
+    const VectorBase<BaseFloat> &cluster_loglikes,
+    int32 num_gselect,
+    std::vector<int32> *output,
+    int64 *num_evaluated) const {
+  int32 num_clusters = NumClusters();
+  std::vector<std::pair<BaseFloat, int32> > cluster_pairs(num_clusters);
+  for (int32 c = 0; c < num_clusters; c++)
+    cluster_pairs[c] = std::make_pair(cluster_loglikes(c), c);
+  std::sort(cluster_pairs.begin(), cluster_pairs.end(),
+            std::greater<std::pair<BaseFloat, int32> >());
+
+  // Search the clusters from best to worst, within the beam and up to
+  // max_clusters of them, but always until we have num_gselect Gaussians.
+  // The shortlists overlap, so we need to remove duplicates.
+  BaseFloat thresh = cluster_pairs[0].first - opts_.beam;
+  std::vector<int32> preselect;
+  for (int32 i = 0; i < num_clusters; i++) {
+    if (static_cast<int32>(preselect.size()) >= num_gselect &&
+        (i >= opts_.max_clusters || cluster_pairs[i].first < thresh))
+      break;
+    const std::vector<int32> &shortlist = shortlists_[cluster_pairs[i].second];
+    preselect.insert(preselect.end(), shortlist.begin(), shortlist.end());
+    if (i == 0) continue;  // the first shortlist has no duplicates.
+    SortAndUniq(&preselect);
+  }
+  int32 preselect_sz = preselect.size();
+  if (num_evaluated != NULL)
+    *num_evaluated += preselect_sz;
+
+  Vector<BaseFloat> loglikes(preselect_sz, kUndefined);
+  gmm.LogLikelihoodsPreselect(data, preselect, &loglikes);
+  std::vector<std::pair<BaseFloat, int32> > pairs(preselect_sz);
+  for (int32 p = 0; p < preselect_sz; p++)
+    pairs[p] = std::make_pair(loglikes(p), preselect[p]);
+  int32 this_num_gselect = std::min(num_gselect, preselect_sz);
+  std::partial_sort(pairs.begin(), pairs.begin() + this_num_gselect,
+                    pairs.end(),
+                    std::greater<std::pair<BaseFloat, int32> >());
+  output->resize(this_num_gselect);
+  BaseFloat tot_loglike = -std::numeric_limits<BaseFloat>::infinity();
+  for (int32 j = 0; j < this_num_gselect; j++) {
+    (*output)[j] = pairs[j].second;
+    tot_loglike = LogAdd(tot_loglike, pairs[j].first);
+  }
+  KALDI_ASSERT(!output->empty());
+  return tot_loglike;
+}
+
+BaseFloat DiagGmmIndex::GaussianSelection(const DiagGmm &gmm,
+                                          const VectorBase<BaseFloat> &data,
+                                          int32 num_gselect,
+                                          std::vector<int32> *output,
+                                          int64 *num_evaluated) const {
+  KALDI_ASSERT(gmm.NumGauss() == num_gauss_ && NumClusters() > 0 &&
+               num_gselect > 0);
+  Vector<BaseFloat> cluster_loglikes;
+  cluster_gmm_.LogLikelihoods(data, &cluster_loglikes);
+  if (num_evaluated != NULL)
+    *num_evaluated += NumClusters();
+  return SelectGivenClusterLoglikes(gmm, data, cluster_loglikes, num_gselect,
+                                    output, num_evaluated);
+}
+
+BaseFloat DiagGmmIndex::GaussianSelection(
+    const DiagGmm &gmm,
+    const MatrixBase<BaseFloat> &data,
+    int32 num_gselect,
+    std::vector<std::vector<int32> > *output,
+    int64 *num_evaluated) const {
+  KALDI_ASSERT(gmm.NumGauss() == num_gauss_ && NumClusters() > 0 &&
+               num_gselect > 0);
+  int32 num_frames = data.NumRows();
+  output->clear();
+  output->resize(num_frames);
+  if (num_frames == 0) return 0.0;
+  Matrix<BaseFloat> cluster_loglikes;
+  cluster_gmm_.LogLikelihoods(data, &cluster_loglikes);
+  if (num_evaluated != NULL)
+    *num_evaluated += static_cast<int64>(num_frames) * NumClusters();
+  double ans = 0.0;
+  for (int32 t = 0; t < num_frames; t++)
+    ans += SelectGivenClusterLoglikes(gmm, data.Row(t),
+                                      cluster_loglikes.Row(t), num_gselect,
+                                      &((*output)[t]), num_evaluated);
+  return ans;
+}
+
+}  // End namespace kaldi
@@ -0,0 +1,142 @@
+// gmm/diag-gmm-index.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_GMM_DIAG_GMM_INDEX_H_
+#define KALDI_GMM_DIAG_GMM_INDEX_H_ 1
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "gmm/diag-gmm.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+/** \struct DiagGmmIndexOptions
+ *  Configuration variables for DiagGmmIndex.
+ */
+struct DiagGmmIndexOptions {
+  /// Number of clusters of Gaussians; if <= 0, the square root of the number
+  /// of Gaussians is used.
+  int32 num_clusters;
+  /// Maximum number of clusters whose shortlists are evaluated on each frame.
+  int32 max_clusters;
+  /// Only clusters whose log-likelihood is within this beam of the best
+  /// cluster are evaluated.
+  BaseFloat beam;
+  /// Number of points sampled from each Gaussian to build the shortlists.
+  int32 samples_per_gauss;
+
+  DiagGmmIndexOptions(): num_clusters(0), max_clusters(2), beam(10.0),
+                         samples_per_gauss(5) { }
+
+  void Register(OptionsItf *opts) {
+    std::string module = "DiagGmmIndexOptions: ";
+    opts->Register("num-clusters", &num_clusters, module+"Number of clusters "
+                   "of Gaussians in the index (if <= 0, the square root of "
+                   "the number of Gaussians).");
+    opts->Register("max-clusters", &max_clusters, module+"Maximum number of "
+                   "clusters whose shortlists are evaluated on each frame.");
+    opts->Register("beam", &beam, module+"Log-likelihood beam for the "
+                   "clusters whose shortlists are evaluated on each frame.");
+    opts->Register("samples-per-gauss", &samples_per_gauss, module+"Number "
+                   "of points sampled from each Gaussian to build the "
+                   "shortlists.");
+  }
+};
+
+
+/** \class DiagGmmIndex
+ *  A two-level index over the Gaussians of a DiagGmm, for approximate
+ *  Gaussian selection without evaluating all the Gaussians on each frame
+ *  (this is the "Gaussian shortlist" method of Bocchieri).
+ *
+ *  The Gaussians are clustered by k-means (as in DiagGmm::MergeKmeans()), and
+ *  each cluster is represented by the Gaussian with the same first and second
+ *  moments as its members.  Each cluster has a shortlist: its members, plus
+ *  the Gaussians that were among the best num_gselect for some point, sampled
+ *  from the GMM, for which that cluster was the best.  For each frame the
+ *  cluster Gaussians are evaluated first, and then only the Gaussians in the
+ *  shortlists of the best clusters (searched with a beam); the selected
+ *  Gaussians are the best of those.  More clusters are searched if needed to
+ *  get num_gselect Gaussians.
+ *
+ *  With max_clusters >= NumClusters() and an infinite beam, the output is the
+ *  same as DiagGmm::GaussianSelection().
+ */
+class DiagGmmIndex {
+ public:
+  DiagGmmIndex(): num_gauss_(0) { }
+
+  /// Builds the index for "gmm", with shortlists for selecting the best
+  /// "num_gselect" Gaussians.  The index must only be used with this GMM.
+  DiagGmmIndex(const DiagGmm &gmm, int32 num_gselect,
+               const DiagGmmIndexOptions &opts) {
+    Init(gmm, num_gselect, opts);
+  }
+
+  void Init(const DiagGmm &gmm, int32 num_gselect,
+            const DiagGmmIndexOptions &opts);
+
+  int32 NumClusters() const { return shortlists_.size(); }
+
+  /// The indexes of the Gaussians in the shortlist of cluster c (sorted).
+  const std::vector<int32> &Shortlist(int32 c) const { return shortlists_[c]; }
+
+  /// Gets Gaussian selection information for one frame, as
+  /// DiagGmm::GaussianSelection(): outputs the best "num_gselect" indexes
+  /// of the Gaussians that were evaluated, sorted from best to worst, and
+  /// returns the total log-likelihood of those.  If num_evaluated is
+  /// non-NULL, the number of Gaussians evaluated (including the cluster
+  /// Gaussians) is added to it.
+  BaseFloat GaussianSelection(const DiagGmm &gmm,
+                              const VectorBase<BaseFloat> &data,
+                              int32 num_gselect,
+                              std::vector<int32> *output,
+                              int64 *num_evaluated = NULL) const;
+
+  /// This version of GaussianSelection() does a sequence of frames; the
+  /// cluster Gaussians are evaluated for all the frames at once.
+  BaseFloat GaussianSelection(const DiagGmm &gmm,
+                              const MatrixBase<BaseFloat> &data,
+                              int32 num_gselect,
+                              std::vector<std::vector<int32> > *output,
+                              int64 *num_evaluated = NULL) const;
+
+ private:
+  // Evaluates the Gaussians in the shortlists of the clusters selected given
+  // the cluster log-likelihoods "cluster_loglikes", and outputs the best ones.
+  BaseFloat SelectGivenClusterLoglikes(
+      const DiagGmm &gmm,
+      const VectorBase<BaseFloat> &data,
+      const VectorBase<BaseFloat> &cluster_loglikes,
+      int32 num_gselect,
+      std::vector<int32> *output,
+      int64 *num_evaluated) const;
+
+  DiagGmmIndexOptions opts_;
+  DiagGmm cluster_gmm_;  // one Gaussian per cluster.
+  std::vector<std::vector<int32> > shortlists_;
+  int32 num_gauss_;  // of the GMM the index was built for (for checking).
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DiagGmmIndex);
+};
+
+}  // End namespace kaldi
+
+#endif  // KALDI_GMM_DIAG_GMM_INDEX_H_
@@ -179,6 +179,21 @@ UnitTestFullGmm() {
 
   KALDI_ASSERT(fabs(1.0 - posterior1.Sum()) < 0.001);
 
+  {  // Test the version of LogLikelihoods() that takes a matrix of frames.
+    int32 num_frames = RandInt(1, 300);
+    Matrix<BaseFloat> feats(num_frames, dim);
+    feats.SetRandn();
+    Matrix<BaseFloat> loglikes_mat;
+    gmm->LogLikelihoods(feats, &loglikes_mat);
+    KALDI_ASSERT(loglikes_mat.NumRows() == num_frames &&
+                 loglikes_mat.NumCols() == static_cast<int32>(nMix));
+    for (int32 t = 0; t < num_frames; t++) {
+      Vector<BaseFloat> loglikes_vec, loglikes_row(loglikes_mat.Row(t));
+      gmm->LogLikelihoods(feats.Row(t), &loglikes_vec);
+      AssertEqual(loglikes_vec, loglikes_row, 0.001);
+    }
+  }
+
   {  // Test various accessors / mutators
     Vector<BaseFloat> weights_bak(nMix);
     Matrix<BaseFloat> means_bak(nMix, dim);
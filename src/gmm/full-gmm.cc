@@ -610,6 +610,53 @@ void FullGmm::LogLikelihoods(const VectorBase<BaseFloat> &data,
   }
 }
 
+void FullGmm::LogLikelihoods(const MatrixBase<BaseFloat> &data,
+                             Matrix<BaseFloat> *loglikes) const {
+  int32 dim = Dim(), num_frames = data.NumRows(), num_comp = NumGauss();
+  KALDI_ASSERT(num_frames != 0);
+  if (data.NumCols() != dim) {
+    KALDI_ERR << "FullGmm::LogLikelihoods, dimension "
+              << "mismatch " << data.NumCols() << " vs. "<< dim;
+  }
+  loglikes->Resize(num_frames, num_comp, kUndefined);
+  loglikes->CopyRowsFromVec(gconsts_);
+  // loglikes +=  means * inv(covars) * data.
+  loglikes->AddMatMat(1.0, data, kNoTrans, means_invcovars_, kTrans, 1.0);
+
+  // The quadratic term 0.5 * data' * inv(covar) * data is computed as in the
+  // vector version, as a dot product of the packed lower triangles of
+  // inv(covar) and of data * data' with its diagonal scaled by 0.5; here the
+  // dot products for all frames and components are one matrix multiplication.
+  int32 packed_dim = (dim * (dim + 1)) / 2;
+  Matrix<BaseFloat> inv_covars_packed(num_comp, packed_dim, kUndefined);
+  for (int32 mix = 0; mix < num_comp; mix++)
+    inv_covars_packed.Row(mix).CopyFromPacked(inv_covars_[mix]);
+
+  // Process the frames in blocks, to limit the memory used for the packed
+  // squared data.
+  int32 block_size = 256;
+  Matrix<BaseFloat> data_sq_packed(std::min(block_size, num_frames),
+                                   packed_dim, kUndefined);
+  for (int32 start = 0; start < num_frames; start += block_size) {
+    int32 this_block_size = std::min(block_size, num_frames - start);
+    SubMatrix<BaseFloat> data_sq_block(data_sq_packed, 0, this_block_size,
+                                       0, packed_dim);
+    for (int32 t = 0; t < this_block_size; t++) {
+      const BaseFloat *x = data.RowData(start + t);
+      BaseFloat *x_sq = data_sq_block.RowData(t);
+      for (int32 i = 0; i < dim; i++) {
+        for (int32 j = 0; j < i; j++)
+          *(x_sq++) = x[i] * x[j];
+        *(x_sq++) = 0.5 * x[i] * x[i];
+      }
+    }
+    SubMatrix<BaseFloat> loglikes_block(*loglikes, start, this_block_size,
+                                        0, num_comp);
+    loglikes_block.AddMatMat(-1.0, data_sq_block, kNoTrans,
+                             inv_covars_packed, kTrans, 1.0);
+  }
+}
+
 void FullGmm::LogLikelihoodsPreselect(const VectorBase<BaseFloat> &data,
                                       const vector<int32> &indices,
                                       Vector<BaseFloat> *loglikes) const {
@@ -72,6 +72,15 @@ class FullGmm {
   void LogLikelihoods(const VectorBase<BaseFloat> &data,
                       Vector<BaseFloat> *loglikes) const;
 
+  /// This version of the LogLikelihoods function operates on a sequence of
+  /// frames simultaneously; the row index of both "data" and "loglikes" is
+  /// the frame index.  The quadratic terms for a block of frames are
+  /// computed with one matrix multiplication against the packed inverse
+  /// covariances, so this is much faster than calling the vector version
+  /// for each frame.
+  void LogLikelihoods(const MatrixBase<BaseFloat> &data,
+                      Matrix<BaseFloat> *loglikes) const;
+
   /// Outputs the per-component log-likelihoods of a subset of mixture
   /// components. Note: indices.size() will equal loglikes->Dim() at output.
   /// loglikes[i] will correspond to the log-likelihood of the Gaussian
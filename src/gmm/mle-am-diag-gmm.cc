@@ -21,6 +21,7 @@
 #include "gmm/am-diag-gmm.h"
 #include "gmm/mle-am-diag-gmm.h"
 #include "util/stl-utils.h"
+#include "util/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -184,12 +185,69 @@ void ResizeModel (int32 dim, AmDiagGmm *am_gmm) {
   }
 }
 
+// Updates the pdfs thread_id_, thread_id_ + num_threads_, and so on; the
+// totals are added to the shared ones in the destructor.
+class MleAmDiagGmmUpdateClass: public MultiThreadable {
+ public:
+  MleAmDiagGmmUpdateClass(const MleDiagGmmOptions &config,
+                          const AccumAmDiagGmm &am_diag_gmm_acc,
+                          GmmFlagsType flags, AmDiagGmm *am_gmm,
+                          BaseFloat *tot_obj_change, BaseFloat *tot_count,
+                          int32 *tot_elems_floored, int32 *tot_gauss_floored,
+                          int32 *tot_gauss_removed):
+      config_(config), am_diag_gmm_acc_(am_diag_gmm_acc), flags_(flags),
+      am_gmm_(am_gmm), tot_obj_change_ptr_(tot_obj_change),
+      tot_count_ptr_(tot_count), tot_elems_floored_ptr_(tot_elems_floored),
+      tot_gauss_floored_ptr_(tot_gauss_floored),
+      tot_gauss_removed_ptr_(tot_gauss_removed), tot_obj_change_(0.0),
+      tot_count_(0.0), tot_elems_floored_(0), tot_gauss_floored_(0),
+      tot_gauss_removed_(0) { }
+
+  void operator () () {
+    for (int32 i = thread_id_; i < am_diag_gmm_acc_.NumAccs();
+         i += num_threads_) {
+      BaseFloat obj_change, count;
+      int32 elems_floored, gauss_floored, gauss_removed;
+
+      MleDiagGmmUpdate(config_, am_diag_gmm_acc_.GetAcc(i), flags_,
+                       &(am_gmm_->GetPdf(i)),
+                       &obj_change, &count, &elems_floored,
+                       &gauss_floored, &gauss_removed);
+      tot_obj_change_ += obj_change;
+      tot_count_ += count;
+      tot_elems_floored_ += elems_floored;
+      tot_gauss_floored_ += gauss_floored;
+      tot_gauss_removed_ += gauss_removed;
+    }
+  }
+
+  ~MleAmDiagGmmUpdateClass() {
+    *tot_obj_change_ptr_ += tot_obj_change_;
+    *tot_count_ptr_ += tot_count_;
+    *tot_elems_floored_ptr_ += tot_elems_floored_;
+    *tot_gauss_floored_ptr_ += tot_gauss_floored_;
+    *tot_gauss_removed_ptr_ += tot_gauss_removed_;
+  }
+
+ private:
+  const MleDiagGmmOptions &config_;
+  const AccumAmDiagGmm &am_diag_gmm_acc_;
+  GmmFlagsType flags_;
+  AmDiagGmm *am_gmm_;
+  BaseFloat *tot_obj_change_ptr_, *tot_count_ptr_;
+  int32 *tot_elems_floored_ptr_, *tot_gauss_floored_ptr_,
+      *tot_gauss_removed_ptr_;
+  BaseFloat tot_obj_change_, tot_count_;
+  int32 tot_elems_floored_, tot_gauss_floored_, tot_gauss_removed_;
+};
+
 void MleAmDiagGmmUpdate (const MleDiagGmmOptions &config,
                          const AccumAmDiagGmm &am_diag_gmm_acc,
                          GmmFlagsType flags,
                          AmDiagGmm *am_gmm,
                          BaseFloat *obj_change_out,
-                         BaseFloat *count_out) {
+                         BaseFloat *count_out,
+                         int32 num_threads) {
   if (am_diag_gmm_acc.Dim() != am_gmm->Dim()) {
     KALDI_ASSERT(am_diag_gmm_acc.Dim() != 0);
     KALDI_WARN << "Dimensions of accumulator " << am_diag_gmm_acc.Dim()
@@ -206,19 +264,13 @@ void MleAmDiagGmmUpdate (const MleDiagGmmOptions &config,
   BaseFloat tot_obj_change = 0.0, tot_count = 0.0;
   int32 tot_elems_floored = 0, tot_gauss_floored = 0,
       tot_gauss_removed = 0;
-  for (int32 i = 0; i < am_diag_gmm_acc.NumAccs(); i++) {
-    BaseFloat obj_change, count;
-    int32 elems_floored, gauss_floored, gauss_removed;
-    
-    MleDiagGmmUpdate(config, am_diag_gmm_acc.GetAcc(i), flags,
-                     &(am_gmm->GetPdf(i)),
-                     &obj_change, &count, &elems_floored,
-                     &gauss_floored, &gauss_removed);
-    tot_obj_change += obj_change;
-    tot_count += count;
-    tot_elems_floored += elems_floored;
-    tot_gauss_floored += gauss_floored;
-    tot_gauss_removed += gauss_removed;
+  {
+    MleAmDiagGmmUpdateClass c(config, am_diag_gmm_acc, flags, am_gmm,
+                              &tot_obj_change, &tot_count, &tot_elems_floored,
+                              &tot_gauss_floored, &tot_gauss_removed);
+    // With num_threads == 0, MultiThreader runs the update in this thread.
+    MultiThreader<MleAmDiagGmmUpdateClass> m(num_threads > 1 ? num_threads : 0,
+                                             c);
   }
   if (obj_change_out != NULL) *obj_change_out = tot_obj_change;
   if (count_out != NULL) *count_out = tot_count;
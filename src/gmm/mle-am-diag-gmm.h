@@ -109,12 +109,15 @@ class AccumAmDiagGmm {
 
 /// for computing the maximum-likelihood estimates of the parameters of
 /// an acoustic model that uses diagonal Gaussian mixture models as emission densities.
+/// If num_threads > 1, the pdfs are updated in parallel by that many threads
+/// (the updated model is the same).
 void MleAmDiagGmmUpdate(const MleDiagGmmOptions &config,
                         const AccumAmDiagGmm &amdiaggmm_acc,
                         GmmFlagsType flags,
                         AmDiagGmm *am_gmm,
                         BaseFloat *obj_change_out,
-                        BaseFloat *count_out);
+                        BaseFloat *count_out,
+                        int32 num_threads = 1);
 
 /// Maximum A Posteriori update.
 void MapAmDiagGmmUpdate(const MapDiagGmmOptions &config,
@@ -87,6 +87,37 @@ void TestComponentAcc(const FullGmm &gmm, const Matrix<BaseFloat> &feats) {
   }
 }
 
+// Checks that accumulating a whole matrix of frames at once gives the same
+// stats as accumulating frame by frame.  Some posteriors are zeroed or negated
+// to cover the sparse and the signed cases.
+void TestBatchAcc(const FullGmm &gmm, const Matrix<BaseFloat> &feats) {
+  AccumFullGmm est_frames, est_batch;
+  est_frames.Resize(gmm.NumGauss(), gmm.Dim(), kGmmAll);
+  est_frames.SetZero(kGmmAll);
+  est_batch.Resize(gmm.NumGauss(), gmm.Dim(), kGmmAll);
+  est_batch.SetZero(kGmmAll);
+
+  Matrix<BaseFloat> posts(feats.NumRows(), gmm.NumGauss());
+  for (int32 i = 0; i < feats.NumRows(); i++) {
+    SubVector<BaseFloat> post(posts, i);
+    gmm.ComponentPosteriors(feats.Row(i), &post);
+    for (int32 m = 0; m < gmm.NumGauss(); m++) {
+      if (RandInt(0, 3) == 0) post(m) = 0.0;
+      else if (RandInt(0, 9) == 0) post(m) *= -1.0;
+    }
+    est_frames.AccumulateFromPosteriors(feats.Row(i), post);
+  }
+  est_batch.AccumulateFromPosteriors(feats, posts);
+
+  KALDI_ASSERT(est_frames.occupancy().ApproxEqual(est_batch.occupancy(),
+                                                  1.0e-05));
+  KALDI_ASSERT(est_frames.mean_accumulator().ApproxEqual(
+      est_batch.mean_accumulator(), 1.0e-05));
+  for (int32 m = 0; m < gmm.NumGauss(); m++)
+    KALDI_ASSERT(est_frames.covariance_accumulator()[m].ApproxEqual(
+        est_batch.covariance_accumulator()[m], 1.0e-05));
+}
+
 void rand_posdef_spmatrix(size_t dim, SpMatrix<BaseFloat> *matrix,
                           TpMatrix<BaseFloat> *matrix_sqrt = NULL,
                           BaseFloat *logdet = NULL) {
@@ -452,6 +483,8 @@ UnitTestEstimateFullGmm() {
       test_flags_driven_update(*gmm, feats, kGmmWeights | kGmmMeans);
       std::cout << "Testing component-wise accumulation" << '\n';
       TestComponentAcc(*gmm, feats);
+      std::cout << "Testing batch accumulation" << '\n';
+      TestBatchAcc(*gmm, feats);
     }
 
     iteration++;
@@ -20,6 +20,7 @@
 // limitations under the License.
 
 #include <string>
+#include <vector>
 
 #include "gmm/full-gmm.h"
 #include "gmm/diag-gmm.h"
@@ -140,6 +141,54 @@ void AccumFullGmm::AccumulateFromPosteriors(
   }
 }
 
+void AccumFullGmm::AccumulateFromPosteriors(
+    const MatrixBase<BaseFloat> &data,
+    const MatrixBase<BaseFloat> &gauss_posteriors) {
+  int32 num_frames = data.NumRows(), num_comp = NumGauss(), dim = Dim();
+  KALDI_ASSERT(gauss_posteriors.NumRows() == num_frames &&
+               gauss_posteriors.NumCols() == num_comp &&
+               data.NumCols() == dim);
+  // For each component, the frames on which it has nonzero posterior.
+  std::vector<std::vector<int32> > comp_frames(num_comp);
+  for (int32 t = 0; t < num_frames; t++) {
+    const BaseFloat *post = gauss_posteriors.RowData(t);
+    for (int32 mix = 0; mix < num_comp; mix++)
+      if (post[mix] != 0.0)
+        comp_frames[mix].push_back(t);
+  }
+  Matrix<double> data_d(data);
+  for (int32 mix = 0; mix < num_comp; mix++) {
+    const std::vector<int32> &frames = comp_frames[mix];
+    int32 num_this_frames = frames.size();
+    if (num_this_frames == 0) continue;
+    Vector<double> post_d(num_this_frames, kUndefined);
+    Matrix<double> data_this(num_this_frames, dim, kUndefined);
+    bool all_positive = true;
+    for (int32 i = 0; i < num_this_frames; i++) {
+      post_d(i) = gauss_posteriors(frames[i], mix);
+      if (post_d(i) < 0.0) all_positive = false;
+      data_this.Row(i).CopyFromVec(data_d.Row(frames[i]));
+    }
+    occupancy_(mix) += post_d.Sum();
+    if (flags_ & (kGmmMeans|kGmmVariances)) {  // mean stats.
+      mean_accumulator_.Row(mix).AddMatVec(1.0, data_this, kTrans, post_d, 1.0);
+      if (flags_ & kGmmVariances) {
+        // A rank-k update (syrk) needs the rows scaled by the square roots of
+        // the posteriors, and it has some fixed overhead, so we only use it if
+        // there are enough frames.
+        if (all_positive && num_this_frames >= 8) {
+          post_d.ApplyPow(0.5);
+          data_this.MulRowsVec(post_d);
+          covariance_accumulator_[mix].AddMat2(1.0, data_this, kTrans, 1.0);
+        } else {
+          covariance_accumulator_[mix].AddMat2Vec(1.0, data_this, kTrans,
+                                                  post_d, 1.0);
+        }
+      }
+    }
+  }
+}
+
 BaseFloat AccumFullGmm::AccumulateFromFull(const FullGmm &gmm,
     const VectorBase<BaseFloat> &data, BaseFloat frame_posterior) {
   KALDI_ASSERT(gmm.NumGauss() == NumGauss());
@@ -110,6 +110,14 @@ class AccumFullGmm {
   void AccumulateFromPosteriors(const VectorBase<BaseFloat> &data,
                                 const VectorBase<BaseFloat> &gauss_posteriors);
 
+  /// Accumulate for all components, given the posteriors for a sequence of
+  /// frames; the row index of both "data" and "gauss_posteriors" is the frame
+  /// index.  This is equivalent to calling the vector version for each frame,
+  /// but the variance stats of each component are accumulated with one rank-k
+  /// update over the frames for which it has nonzero posterior.
+  void AccumulateFromPosteriors(const MatrixBase<BaseFloat> &data,
+                                const MatrixBase<BaseFloat> &gauss_posteriors);
+
   /// Accumulate for all components given a full-covariance GMM.
   /// Computes posteriors and returns log-likelihood
   BaseFloat AccumulateFromFull(const FullGmm &gmm,
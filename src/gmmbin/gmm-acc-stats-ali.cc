@@ -20,11 +20,73 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "gmm/mle-am-diag-gmm.h"
 
+namespace kaldi {
+
+// The stats accumulated by one thread.
+struct GmmAccStatsAliAccs {
+  Vector<double> transition_accs;
+  AccumAmDiagGmm gmm_accs;
+  double tot_like;
+  int64 tot_t;
+  GmmAccStatsAliAccs(): tot_like(0.0), tot_t(0) { }
+};
+
+// Accumulates the stats for one utterance, into whichever accumulator of
+// the pool is free.
+class GmmAccStatsAliTask {
+ public:
+  GmmAccStatsAliTask(const TransitionModel &trans_model,
+                     const AmDiagGmm &am_gmm,
+                     const std::string &key,
+                     const Matrix<BaseFloat> &features,
+                     const std::vector<int32> &alignment,
+                     AccumulatorPool<GmmAccStatsAliAccs> *pool,
+                     int32 *num_done):
+      trans_model_(trans_model), am_gmm_(am_gmm), key_(key),
+      features_(features), alignment_(alignment), pool_(pool),
+      num_done_(num_done), tot_like_this_file_(0.0) { }
+
+  void operator () () {
+    GmmAccStatsAliAccs *accs = pool_->Acquire();
+    for (size_t i = 0; i < alignment_.size(); i++) {
+      int32 tid = alignment_[i],  // transition identifier.
+          pdf_id = trans_model_.TransitionIdToPdf(tid);
+      trans_model_.Accumulate(1.0, tid, &(accs->transition_accs));
+      tot_like_this_file_ += accs->gmm_accs.AccumulateForGmm(
+          am_gmm_, features_.Row(i), pdf_id, 1.0);
+    }
+    accs->tot_like += tot_like_this_file_;
+    accs->tot_t += alignment_.size();
+    pool_->Release(accs);
+  }
+
+  ~GmmAccStatsAliTask() {
+    (*num_done_)++;
+    if (*num_done_ % 50 == 0) {
+      KALDI_LOG << "Processed " << *num_done_ << " utterances; for utterance "
+                << key_ << " avg. like is "
+                << (tot_like_this_file_ / alignment_.size())
+                << " over " << alignment_.size() <<" frames.";
+    }
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+  const AmDiagGmm &am_gmm_;
+  std::string key_;
+  Matrix<BaseFloat> features_;
+  std::vector<int32> alignment_;
+  AccumulatorPool<GmmAccStatsAliAccs> *pool_;
+  int32 *num_done_;
+  BaseFloat tot_like_this_file_;
+};
 
+}  // namespace kaldi
 
 
 int main(int argc, char *argv[]) {
@@ -35,11 +97,17 @@ int main(int argc, char *argv[]) {
         "Accumulate stats for GMM training.\n"
         "Usage:  gmm-acc-stats-ali [options] <model-in> <feature-rspecifier> "
         "<alignments-rspecifier> <stats-out>\n"
-        "e.g.:\n gmm-acc-stats-ali 1.mdl scp:train.scp ark:1.ali 1.acc\n";
+        "e.g.:\n gmm-acc-stats-ali 1.mdl scp:train.scp ark:1.ali 1.acc\n"
+        "With --num-threads=N, the utterances are processed by N threads,\n"
+        "each with its own accumulators, which are summed at the end; this\n"
+        "can replace N separate jobs.  (Use e.g. scp,bg:train.scp to also\n"
+        "read the features in a background thread).\n";
 
     ParseOptions po(usage);
     bool binary = true;
+    TaskSequencerConfig sequencer_config;
     po.Register("binary", &binary, "Write output in binary mode");
+    sequencer_config.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -61,54 +129,50 @@ int main(int argc, char *argv[]) {
       am_gmm.Read(ki.Stream(), binary);
     }
 
-    Vector<double> transition_accs;
-    trans_model.InitStats(&transition_accs);
-    AccumAmDiagGmm gmm_accs;
-    gmm_accs.Init(am_gmm, kGmmAll);
-
-    double tot_like = 0.0;
-    kaldi::int64 tot_t = 0;
+    AccumulatorPool<GmmAccStatsAliAccs> pool(sequencer_config);
+    for (int32 i = 0; i < pool.NumAccums(); i++) {
+      trans_model.InitStats(&(pool.Accum(i).transition_accs));
+      pool.Accum(i).gmm_accs.Init(am_gmm, kGmmAll);
+    }
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
 
     int32 num_done = 0, num_err = 0;
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!alignments_reader.HasKey(key)) {
-        KALDI_WARN << "No alignment for utterance " << key;
-        num_err++;
-      } else {
-        const Matrix<BaseFloat> &mat = feature_reader.Value();
-        const std::vector<int32> &alignment = alignments_reader.Value(key);
-
-        if (alignment.size() != mat.NumRows()) {
-          KALDI_WARN << "Alignments has wrong size " << (alignment.size())
-                     << " vs. " << (mat.NumRows());
+    {
+      TaskSequencer<GmmAccStatsAliTask> sequencer(sequencer_config);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!alignments_reader.HasKey(key)) {
+          KALDI_WARN << "No alignment for utterance " << key;
           num_err++;
-          continue;
-        }
-
-        num_done++;
-        BaseFloat tot_like_this_file = 0.0;
-
-        for (size_t i = 0; i < alignment.size(); i++) {
-          int32 tid = alignment[i],  // transition identifier.
-              pdf_id = trans_model.TransitionIdToPdf(tid);
-          trans_model.Accumulate(1.0, tid, &transition_accs);
-          tot_like_this_file += gmm_accs.AccumulateForGmm(am_gmm, mat.Row(i),
-                                                          pdf_id, 1.0);
-        }
-        tot_like += tot_like_this_file;
-        tot_t += alignment.size();
-        if (num_done % 50 == 0) {
-          KALDI_LOG << "Processed " << num_done << " utterances; for utterance "
-                    << key << " avg. like is "
-                    << (tot_like_this_file/alignment.size())
-                    << " over " << alignment.size() <<" frames.";
+        } else {
+          const Matrix<BaseFloat> &mat = feature_reader.Value();
+          const std::vector<int32> &alignment = alignments_reader.Value(key);
+
+          if (alignment.size() != mat.NumRows()) {
+            KALDI_WARN << "Alignments has wrong size " << (alignment.size())
+                       << " vs. " << (mat.NumRows());
+            num_err++;
+            continue;
+          }
+          sequencer.Run(new GmmAccStatsAliTask(trans_model, am_gmm, key, mat,
+                                               alignment, &pool, &num_done));
         }
       }
     }
+
+    // Sum the accumulators of the different threads into the first one.
+    GmmAccStatsAliAccs &accs = pool.Accum(0);
+    for (int32 i = 1; i < pool.NumAccums(); i++) {
+      accs.transition_accs.AddVec(1.0, pool.Accum(i).transition_accs);
+      accs.gmm_accs.Add(1.0, pool.Accum(i).gmm_accs);
+      accs.tot_like += pool.Accum(i).tot_like;
+      accs.tot_t += pool.Accum(i).tot_t;
+    }
+    double tot_like = accs.tot_like;
+    int64 tot_t = accs.tot_t;
+
     KALDI_LOG << "Done " << num_done << " files, " << num_err
               << " with errors.";
 
@@ -117,8 +181,8 @@ int main(int argc, char *argv[]) {
 
     {
       Output ko(accs_wxfilename, binary);
-      transition_accs.Write(ko.Stream(), binary);
-      gmm_accs.Write(ko.Stream(), binary);
+      accs.transition_accs.Write(ko.Stream(), binary);
+      accs.gmm_accs.Write(ko.Stream(), binary);
     }
     KALDI_LOG << "Written accs.";
     if (num_done != 0)
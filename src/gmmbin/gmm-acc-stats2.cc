@@ -20,11 +20,70 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "gmm/mle-am-diag-gmm.h"
 #include "hmm/posterior.h"
 
+namespace kaldi {
+
+// The num and den stats accumulated by one thread.
+struct GmmAccStats2Accs {
+  Vector<double> num_trans_accs, den_trans_accs;
+  AccumAmDiagGmm num_gmm_accs, den_gmm_accs;
+  double tot_like, tot_weight;
+  int64 tot_frames;
+  GmmAccStats2Accs(): tot_like(0.0), tot_weight(0.0), tot_frames(0) { }
+};
+
+// Accumulates the stats for one utterance, into whichever accumulator of
+// the pool is free.
+class GmmAccStats2Task {
+ public:
+  GmmAccStats2Task(const TransitionModel &trans_model,
+                   const AmDiagGmm &am_gmm,
+                   const Matrix<BaseFloat> &features,
+                   const Posterior &posterior,
+                   AccumulatorPool<GmmAccStats2Accs> *pool):
+      trans_model_(trans_model), am_gmm_(am_gmm), features_(features),
+      posterior_(posterior), pool_(pool) { }
+
+  void operator () () {
+    GmmAccStats2Accs *accs = pool_->Acquire();
+    BaseFloat tot_like_this_file = 0.0, tot_weight_this_file = 0.0;
+    for (size_t i = 0; i < posterior_.size(); i++) {
+      for (size_t j = 0; j < posterior_[i].size(); j++) {
+        int32 tid = posterior_[i][j].first,
+            pdf_id = trans_model_.TransitionIdToPdf(tid);
+        BaseFloat weight = posterior_[i][j].second;
+        trans_model_.Accumulate(fabs(weight), tid,
+                                (weight > 0.0 ?
+                                 &(accs->num_trans_accs) :
+                                 &(accs->den_trans_accs)));
+        tot_like_this_file +=
+            (weight > 0.0 ? &(accs->num_gmm_accs) : &(accs->den_gmm_accs)) ->
+            AccumulateForGmm(am_gmm_, features_.Row(i), pdf_id, fabs(weight)) *
+            weight;
+        tot_weight_this_file += weight;
+      }
+    }
+    accs->tot_like += tot_like_this_file;
+    accs->tot_weight += tot_weight_this_file;
+    accs->tot_frames += static_cast<int32>(posterior_.size());
+    pool_->Release(accs);
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+  const AmDiagGmm &am_gmm_;
+  Matrix<BaseFloat> features_;
+  Posterior posterior_;
+  AccumulatorPool<GmmAccStats2Accs> *pool_;
+};
+
+}  // namespace kaldi
+
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -38,7 +97,9 @@ int main(int argc, char *argv[]) {
         "Usage:  gmm-acc-stats2 [options] <model> <feature-rspecifier>"
         "<posteriors-rspecifier> <num-stats-out> <den-stats-out>\n"
         "e.g.:\n"
-        "gmm-acc-stats 1.mdl \"$feats\" ark:1.post 1.num_acc 1.den_acc\n";
+        "gmm-acc-stats 1.mdl \"$feats\" ark:1.post 1.num_acc 1.den_acc\n"
+        "With --num-threads=N, the utterances are processed by N threads,\n"
+        "each with its own accumulators, which are summed at the end.\n";
 
     ParseOptions po(usage);
     bool binary = true;
@@ -47,6 +108,8 @@ int main(int argc, char *argv[]) {
     po.Register("binary", &binary, "Write stats in binary mode");
     po.Register("update-flags", &update_flags_str, "Which GMM parameters to "
                 "update: subset of mvwt.");
+    TaskSequencerConfig sequencer_config;
+    sequencer_config.Register(&po);
     po.Read(argc, argv);
     
     if (po.NumArgs() != 5) {
@@ -70,63 +133,61 @@ int main(int argc, char *argv[]) {
       am_gmm.Read(ki.Stream(), binary);
     }
     
-    Vector<double> num_trans_accs, den_trans_accs;
-    trans_model.InitStats(&num_trans_accs);
-    trans_model.InitStats(&den_trans_accs);
-    AccumAmDiagGmm num_gmm_accs, den_gmm_accs;
-    num_gmm_accs.Init(am_gmm, StringToGmmFlags(update_flags_str));
-    den_gmm_accs.Init(am_gmm, StringToGmmFlags(update_flags_str));
+    AccumulatorPool<GmmAccStats2Accs> pool(sequencer_config);
+    for (int32 i = 0; i < pool.NumAccums(); i++) {
+      GmmAccStats2Accs &accs = pool.Accum(i);
+      trans_model.InitStats(&accs.num_trans_accs);
+      trans_model.InitStats(&accs.den_trans_accs);
+      accs.num_gmm_accs.Init(am_gmm, StringToGmmFlags(update_flags_str));
+      accs.den_gmm_accs.Init(am_gmm, StringToGmmFlags(update_flags_str));
+    }
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessPosteriorReader posteriors_reader(posteriors_rspecifier);
 
-
-    BaseFloat tot_like = 0.0, tot_weight = 0.0;
-    // tot_like is total weighted likelihood (note: weighted
-    // by both +ve and -ve numbers)
-    // tot_t is total weight in posteriors (will often be about zero).
-    int64 tot_frames = 0.0; 
-    
     int32 num_done = 0, num_err = 0;
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!posteriors_reader.HasKey(key)) {
-        num_err++;
-      } else {
-        const Matrix<BaseFloat> &mat = feature_reader.Value();
-        const Posterior &posterior = posteriors_reader.Value(key);
-
-        if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
-          KALDI_WARN << "Posterior vector has wrong size " 
-                     << (posterior.size()) << " vs. "
-                     << (mat.NumRows());
+    {
+      TaskSequencer<GmmAccStats2Task> sequencer(sequencer_config);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!posteriors_reader.HasKey(key)) {
           num_err++;
-          continue;
-        }
-
-        BaseFloat tot_like_this_file = 0.0, tot_weight_this_file = 0.0;
-
-        num_done++;
-        for (size_t i = 0; i < posterior.size(); i++) {
-          for (size_t j = 0; j < posterior[i].size(); j++) {
-            int32 tid = posterior[i][j].first,
-                pdf_id = trans_model.TransitionIdToPdf(tid);
-            BaseFloat weight = posterior[i][j].second;
-            trans_model.Accumulate(fabs(weight), tid,
-                                   (weight > 0.0 ?
-                                    &num_trans_accs : &den_trans_accs));
-            tot_like_this_file +=
-                (weight > 0.0 ? &num_gmm_accs : &den_gmm_accs) ->
-                AccumulateForGmm(am_gmm, mat.Row(i), pdf_id, fabs(weight)) * weight;
-            tot_weight_this_file += weight;
+        } else {
+          const Matrix<BaseFloat> &mat = feature_reader.Value();
+          const Posterior &posterior = posteriors_reader.Value(key);
+
+          if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
+            KALDI_WARN << "Posterior vector has wrong size "
+                       << (posterior.size()) << " vs. "
+                       << (mat.NumRows());
+            num_err++;
+            continue;
           }
+          num_done++;
+          sequencer.Run(new GmmAccStats2Task(trans_model, am_gmm, mat,
+                                             posterior, &pool));
         }
-        tot_like += tot_like_this_file;
-        tot_weight += tot_weight_this_file;
-        tot_frames += static_cast<int32>(posterior.size());
       }
     }
 
+    // Sum the accumulators of the different threads into the first one.
+    GmmAccStats2Accs &accs = pool.Accum(0);
+    for (int32 i = 1; i < pool.NumAccums(); i++) {
+      const GmmAccStats2Accs &other = pool.Accum(i);
+      accs.num_trans_accs.AddVec(1.0, other.num_trans_accs);
+      accs.den_trans_accs.AddVec(1.0, other.den_trans_accs);
+      accs.num_gmm_accs.Add(1.0, other.num_gmm_accs);
+      accs.den_gmm_accs.Add(1.0, other.den_gmm_accs);
+      accs.tot_like += other.tot_like;
+      accs.tot_weight += other.tot_weight;
+      accs.tot_frames += other.tot_frames;
+    }
+    // tot_like is total weighted likelihood (note: weighted
+    // by both +ve and -ve numbers)
+    // tot_weight is total weight in posteriors (will often be about zero).
+    BaseFloat tot_like = accs.tot_like, tot_weight = accs.tot_weight;
+    int64 tot_frames = accs.tot_frames;
+
     KALDI_LOG << "Done " << num_done << " files, " << num_err
               << " had errors.";
     
@@ -136,13 +197,13 @@ int main(int argc, char *argv[]) {
 
     {
       Output ko(num_accs_wxfilename, binary);
-      num_trans_accs.Write(ko.Stream(), binary);
-      num_gmm_accs.Write(ko.Stream(), binary);
+      accs.num_trans_accs.Write(ko.Stream(), binary);
+      accs.num_gmm_accs.Write(ko.Stream(), binary);
     }
     {
       Output ko(den_accs_wxfilename, binary);
-      den_trans_accs.Write(ko.Stream(), binary);
-      den_gmm_accs.Write(ko.Stream(), binary);
+      accs.den_trans_accs.Write(ko.Stream(), binary);
+      accs.den_gmm_accs.Write(ko.Stream(), binary);
     }
     KALDI_LOG << "Written accs.";
     return (num_done != 0 ? 0 : 1);
@@ -25,6 +25,7 @@ using std::vector;
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "transform/fmllr-diag-gmm.h"
@@ -39,16 +40,79 @@ void AccumulateForUtterance(const Matrix<BaseFloat> &feats,
                             FmllrDiagGmmAccs *spk_stats) {
   Posterior pdf_post;
   ConvertPosteriorToPdfs(trans_model, post, &pdf_post);
-  for (size_t i = 0; i < post.size(); i++) {
-    for (size_t j = 0; j < pdf_post[i].size(); j++) {
-      int32 pdf_id = pdf_post[i][j].first;
-      spk_stats->AccumulateForGmm(am_gmm.GetPdf(pdf_id),
-                                  feats.Row(i),
-                                  pdf_post[i][j].second);
-    }
-  }
+  spk_stats->AccumulateForFrames(am_gmm, feats, pdf_post);
 }
 
+// Accumulates the stats for one speaker (or utterance) and estimates its
+// transform; the transform and weights are written out in the destructor, so
+// the output is in the same order as the input.
+class BasisFmllrEstimateTask {
+ public:
+  BasisFmllrEstimateTask(const TransitionModel &trans_model,
+                         const AmDiagGmm &am_gmm,
+                         const BasisFmllrEstimate &basis_est,
+                         const BasisFmllrOptions &basis_fmllr_opts,
+                         const std::string &key,
+                         bool is_speaker,
+                         BaseFloatMatrixWriter *transform_writer,
+                         BaseFloatVectorWriter *weights_writer,
+                         double *tot_impr,
+                         double *tot_t):
+      trans_model_(trans_model), am_gmm_(am_gmm), basis_est_(basis_est),
+      basis_fmllr_opts_(basis_fmllr_opts), key_(key), is_speaker_(is_speaker),
+      transform_writer_(transform_writer), weights_writer_(weights_writer),
+      tot_impr_(tot_impr), tot_t_(tot_t), impr_(0.0), spk_tot_t_(0.0) { }
+
+  void AddUtterance(const Matrix<BaseFloat> &feats, const Posterior &post) {
+    feats_.push_back(feats);
+    posts_.push_back(post);
+  }
+
+  void operator () () {
+    FmllrDiagGmmAccs spk_stats(am_gmm_.Dim());
+    for (size_t i = 0; i < feats_.size(); i++)
+      AccumulateForUtterance(feats_[i], posts_[i], trans_model_, am_gmm_,
+                             &spk_stats);
+    feats_.clear();
+    posts_.clear();
+    transform_.Resize(am_gmm_.Dim(), am_gmm_.Dim() + 1);
+    transform_.SetUnit();
+    impr_ = basis_est_.ComputeTransform(spk_stats, &transform_, &weights_,
+                                        basis_fmllr_opts_);
+    spk_tot_t_ = spk_stats.beta_;
+  }
+
+  ~BasisFmllrEstimateTask() {
+    transform_writer_->Write(key_, transform_);
+    // Optionally write out the base weights
+    if (weights_writer_->IsOpen() && weights_.Dim() > 0)
+      weights_writer_->Write(key_, weights_);
+    KALDI_LOG << "For " << (is_speaker_ ? "speaker " : "utterance ") << key_
+              << ", auxf-impr from Basis fMLLR is " << (impr_ / spk_tot_t_)
+              << ", over " << spk_tot_t_ << " frames, "
+              << "the top " << weights_.Dim()
+              << " basis elements have been used";
+    *tot_impr_ += impr_;
+    *tot_t_ += spk_tot_t_;
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+  const AmDiagGmm &am_gmm_;
+  const BasisFmllrEstimate &basis_est_;
+  const BasisFmllrOptions &basis_fmllr_opts_;
+  std::string key_;
+  bool is_speaker_;
+  BaseFloatMatrixWriter *transform_writer_;
+  BaseFloatVectorWriter *weights_writer_;
+  double *tot_impr_;
+  double *tot_t_;
+  std::vector<Matrix<BaseFloat> > feats_;
+  std::vector<Posterior> posts_;
+  Matrix<BaseFloat> transform_;
+  Vector<BaseFloat> weights_;
+  double impr_, spk_tot_t_;
+};
 
 }
 
@@ -60,12 +124,14 @@ int main(int argc, char *argv[]) {
         "Perform basis fMLLR adaptation in testing stage, either per utterance or\n"
         "for the supplied set of speakers (spk2utt option). Reads posterior to\n"
         "accumulate fMLLR stats for each speaker/utterance. Writes to a table of\n"
-        "matrices.\n"
+        "matrices.  With --num-threads=N, N speakers (or utterances) are processed\n"
+        "in parallel.\n"
         "Usage: gmm-est-basis-fmllr [options] <model-in> <basis-rspecifier> <feature-rspecifier> "
         "<post-rspecifier> <transform-wspecifier>\n";
 
     ParseOptions po(usage);
     BasisFmllrOptions basis_fmllr_opts;
+    TaskSequencerConfig sequencer_config;
     string spk2utt_rspecifier;
     string weights_out_filename;
 
@@ -75,6 +141,7 @@ int main(int argc, char *argv[]) {
                     "weights to.");
 
     basis_fmllr_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
     if (po.NumArgs() != 5) {
@@ -115,10 +182,13 @@ int main(int argc, char *argv[]) {
     if (spk2utt_rspecifier != "") {  // per-speaker adaptation
       SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
       RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      TaskSequencer<BasisFmllrEstimateTask> sequencer(sequencer_config);
 
       for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
-        FmllrDiagGmmAccs spk_stats(am_gmm.Dim());
         string spk = spk2utt_reader.Key();
+        BasisFmllrEstimateTask *task = new BasisFmllrEstimateTask(
+            trans_model, am_gmm, basis_est, basis_fmllr_opts, spk, true,
+            &transform_writer, &weights_writer, &tot_impr, &tot_t);
         const vector<string> &uttlist = spk2utt_reader.Value();
         for (size_t i = 0; i < uttlist.size(); i++) {
           std::string utt = uttlist[i];
@@ -141,33 +211,16 @@ int main(int argc, char *argv[]) {
             continue;
           }
 
-          AccumulateForUtterance(feats, post, trans_model, am_gmm, &spk_stats);
+          task->AddUtterance(feats, post);
+
           num_done++;
         }  // end looping over all utterances of the current speaker
 
-        double impr, spk_tot_t; int32 wgt_size;
-        {
-          // Compute the transform and write it out.
-          Matrix<BaseFloat> transform(am_gmm.Dim(), am_gmm.Dim() + 1);
-          transform.SetUnit();
-          Vector<BaseFloat> weights;  // size will be adjusted
-          impr = basis_est.ComputeTransform(spk_stats, &transform,
-                                            &weights, basis_fmllr_opts);
-          spk_tot_t = spk_stats.beta_;
-          wgt_size = weights.Dim();
-          transform_writer.Write(spk, transform);
-          // Optionally write out the base weights
-          if (!weights_out_filename.empty() && weights.Dim() > 0)
-              weights_writer.Write(spk, weights);
-        }
-        KALDI_LOG << "For speaker " << spk << ", auxf-impr from Basis fMLLR is "
-                  << (impr / spk_tot_t) << ", over " << spk_tot_t << " frames, "
-                  << "the top " << wgt_size << " basis elements have been used";
-        tot_impr += impr;
-        tot_t += spk_tot_t;
+        sequencer.Run(task);  // computes the transform and writes it out.
       }  // end looping over speakers
     } else {  // per-utterance adaptation
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      TaskSequencer<BasisFmllrEstimateTask> sequencer(sequencer_config);
       for (; !feature_reader.Done(); feature_reader.Next()) {
         string utt = feature_reader.Key();
         if (!post_reader.HasKey(utt)) {
@@ -185,29 +238,12 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        FmllrDiagGmmAccs spk_stats(am_gmm.Dim());
-        AccumulateForUtterance(feats, post, trans_model, am_gmm, &spk_stats);
+        BasisFmllrEstimateTask *task = new BasisFmllrEstimateTask(
+            trans_model, am_gmm, basis_est, basis_fmllr_opts, utt, false,
+            &transform_writer, &weights_writer, &tot_impr, &tot_t);
+        task->AddUtterance(feats, post);
         num_done++;
-
-        BaseFloat impr, utt_tot_t; int32 wgt_size;
-        {  // Compute the transform and write it out.
-          Matrix<BaseFloat> transform(am_gmm.Dim(), am_gmm.Dim()+1);
-          transform.SetUnit();
-          Vector<BaseFloat> weights(am_gmm.Dim() * (am_gmm.Dim() + 1)); // size will be adjusted
-          impr = basis_est.ComputeTransform(spk_stats, &transform,
-                                            &weights, basis_fmllr_opts);
-          utt_tot_t = spk_stats.beta_;
-          wgt_size = weights.Dim();
-          transform_writer.Write(utt, transform);
-          // Optionally write out the base weights
-          if (!weights_out_filename.empty() && weights.Dim() > 0)
-            weights_writer.Write(utt, weights);
-        }
-        KALDI_LOG << "For utterance " << utt << ", auxf-impr from Basis fMLLR is "
-                  << (impr / utt_tot_t) << ", over " << utt_tot_t << " frames, "
-                  << "the top " << wgt_size << " basis elements have been used";
-        tot_impr += impr;
-        tot_t += utt_tot_t;
+        sequencer.Run(task);  // computes the transform and writes it out.
       }  // end looping over all the utterances
     }
 
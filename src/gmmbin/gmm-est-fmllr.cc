@@ -26,6 +26,7 @@ using std::vector;
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "transform/fmllr-diag-gmm.h"
@@ -39,16 +40,66 @@ void AccumulateForUtterance(const Matrix<BaseFloat> &feats,
                             FmllrDiagGmmAccs *spk_stats) {
   Posterior pdf_post;
   ConvertPosteriorToPdfs(trans_model, post, &pdf_post);
-  for (size_t i = 0; i < post.size(); i++) {
-    for (size_t j = 0; j < pdf_post[i].size(); j++) {
-      int32 pdf_id = pdf_post[i][j].first;
-      spk_stats->AccumulateForGmm(am_gmm.GetPdf(pdf_id),
-                                  feats.Row(i),
-                                  pdf_post[i][j].second);
-    }
-  }
+  spk_stats->AccumulateForFrames(am_gmm, feats, pdf_post);
 }
 
+// Accumulates the stats for one speaker (or utterance) and estimates its
+// transform; the transform is written out in the destructor, so the output
+// is in the same order as the input.
+class FmllrEstimateTask {
+ public:
+  FmllrEstimateTask(const TransitionModel &trans_model,
+                    const AmDiagGmm &am_gmm,
+                    const FmllrOptions &fmllr_opts,
+                    const std::string &key,
+                    bool is_speaker,
+                    BaseFloatMatrixWriter *transform_writer,
+                    double *tot_impr,
+                    double *tot_t):
+      trans_model_(trans_model), am_gmm_(am_gmm), fmllr_opts_(fmllr_opts),
+      key_(key), is_speaker_(is_speaker), transform_writer_(transform_writer),
+      tot_impr_(tot_impr), tot_t_(tot_t), impr_(0.0), spk_tot_t_(0.0) { }
+
+  void AddUtterance(const Matrix<BaseFloat> &feats, const Posterior &post) {
+    feats_.push_back(feats);
+    posts_.push_back(post);
+  }
+
+  void operator () () {
+    FmllrDiagGmmAccs spk_stats(am_gmm_.Dim(), fmllr_opts_);
+    for (size_t i = 0; i < feats_.size(); i++)
+      AccumulateForUtterance(feats_[i], posts_[i], trans_model_, am_gmm_,
+                             &spk_stats);
+    feats_.clear();
+    posts_.clear();
+    transform_.Resize(am_gmm_.Dim(), am_gmm_.Dim() + 1);
+    transform_.SetUnit();
+    spk_stats.Update(fmllr_opts_, &transform_, &impr_, &spk_tot_t_);
+  }
+
+  ~FmllrEstimateTask() {
+    transform_writer_->Write(key_, transform_);
+    KALDI_LOG << "For " << (is_speaker_ ? "speaker " : "utterance ") << key_
+              << ", auxf-impr from fMLLR is " << (impr_ / spk_tot_t_)
+              << ", over " << spk_tot_t_ << " frames.";
+    *tot_impr_ += impr_;
+    *tot_t_ += spk_tot_t_;
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+  const AmDiagGmm &am_gmm_;
+  const FmllrOptions &fmllr_opts_;
+  std::string key_;
+  bool is_speaker_;
+  BaseFloatMatrixWriter *transform_writer_;
+  double *tot_impr_;
+  double *tot_t_;
+  std::vector<Matrix<BaseFloat> > feats_;
+  std::vector<Posterior> posts_;
+  Matrix<BaseFloat> transform_;
+  BaseFloat impr_, spk_tot_t_;
+};
 
 }
 
@@ -59,16 +110,19 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Estimate global fMLLR transforms, either per utterance or for the supplied\n"
         "set of speakers (spk2utt option).  Reads posteriors (on transition-ids).  Writes\n"
-        "to a table of matrices.\n"
+        "to a table of matrices.  With --num-threads=N, N speakers (or utterances)\n"
+        "are processed in parallel.\n"
         "Usage: gmm-est-fmllr [options] <model-in> "
         "<feature-rspecifier> <post-rspecifier> <transform-wspecifier>\n";
 
     ParseOptions po(usage);
     FmllrOptions fmllr_opts;
+    TaskSequencerConfig sequencer_config;
     string spk2utt_rspecifier;
     po.Register("spk2utt", &spk2utt_rspecifier, "rspecifier for speaker to "
                 "utterance-list map");
     fmllr_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -102,10 +156,13 @@ int main(int argc, char *argv[]) {
     if (spk2utt_rspecifier != "") {  // per-speaker adaptation
       SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
       RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      TaskSequencer<FmllrEstimateTask> sequencer(sequencer_config);
 
       for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
-        FmllrDiagGmmAccs spk_stats(am_gmm.Dim(), fmllr_opts);
         string spk = spk2utt_reader.Key();
+        FmllrEstimateTask *task = new FmllrEstimateTask(
+            trans_model, am_gmm, fmllr_opts, spk, true, &transform_writer,
+            &tot_impr, &tot_t);
         const vector<string> &uttlist = spk2utt_reader.Value();
         for (size_t i = 0; i < uttlist.size(); i++) {
           std::string utt = uttlist[i];
@@ -128,25 +185,16 @@ int main(int argc, char *argv[]) {
             continue;
           }
 
-          AccumulateForUtterance(feats, post, trans_model, am_gmm, &spk_stats);
+          task->AddUtterance(feats, post);
 
           num_done++;
         }  // end looping over all utterances of the current speaker
 
-        BaseFloat impr, spk_tot_t;
-        {  // Compute the transform and write it out.
-          Matrix<BaseFloat> transform(am_gmm.Dim(), am_gmm.Dim()+1);
-          transform.SetUnit();
-          spk_stats.Update(fmllr_opts, &transform, &impr, &spk_tot_t);
-          transform_writer.Write(spk, transform);
-        }
-        KALDI_LOG << "For speaker " << spk << ", auxf-impr from fMLLR is "
-                  << (impr/spk_tot_t) << ", over " << spk_tot_t << " frames.";
-        tot_impr += impr;
-        tot_t += spk_tot_t;
+        sequencer.Run(task);  // computes the transform and writes it out.
       }  // end looping over speakers
     } else {  // per-utterance adaptation
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      TaskSequencer<FmllrEstimateTask> sequencer(sequencer_config);
       for (; !feature_reader.Done(); feature_reader.Next()) {
         string utt = feature_reader.Key();
         if (!post_reader.HasKey(utt)) {
@@ -166,22 +214,11 @@ int main(int argc, char *argv[]) {
         }
         num_done++;
 
-        FmllrDiagGmmAccs spk_stats(am_gmm.Dim(), fmllr_opts);
-
-        AccumulateForUtterance(feats, post, trans_model, am_gmm,
-                               &spk_stats);
-
-        BaseFloat impr, utt_tot_t;
-        {  // Compute the transform and write it out.
-          Matrix<BaseFloat> transform(am_gmm.Dim(), am_gmm.Dim()+1);
-          transform.SetUnit();
-          spk_stats.Update(fmllr_opts, &transform, &impr, &utt_tot_t);
-          transform_writer.Write(utt, transform);
-        }
-        KALDI_LOG << "For utterance " << utt << ", auxf-impr from fMLLR is "
-                  << (impr/utt_tot_t) << ", over " << utt_tot_t << " frames.";
-        tot_impr += impr;
-        tot_t += utt_tot_t;
+        FmllrEstimateTask *task = new FmllrEstimateTask(
+            trans_model, am_gmm, fmllr_opts, utt, false, &transform_writer,
+            &tot_impr, &tot_t);
+        task->AddUtterance(feats, post);
+        sequencer.Run(task);  // computes the transform and writes it out.
       }
     }
 
@@ -195,4 +232,3 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 }
-
@@ -44,6 +44,7 @@ int main(int argc, char *argv[]) {
     BaseFloat min_count = 20.0;
     std::string update_flags_str = "mvwt";
     std::string occs_out_filename;
+    int32 num_threads = 1;
 
     ParseOptions po(usage);
     po.Register("binary", &binary_write, "Write output in binary mode");
@@ -61,6 +62,8 @@ int main(int argc, char *argv[]) {
                 "means by standard deviation times this factor.");
     po.Register("write-occs", &occs_out_filename, "File to write pdf "
                 "occupation counts to.");
+    po.Register("num-threads", &num_threads, "Number of threads used to update "
+                "the GMMs of the different pdfs.");
     tcfg.Register(&po);
     gmm_opts.Register(&po);
 
@@ -109,7 +112,7 @@ int main(int argc, char *argv[]) {
       BaseFloat tot_like = gmm_accs.TotLogLike(),
           tot_t = gmm_accs.TotCount();
       MleAmDiagGmmUpdate(gmm_opts, gmm_accs, update_flags, &am_gmm,
-                         &objf_impr, &count);
+                         &objf_impr, &count, num_threads);
       KALDI_LOG << "GMM update: Overall " << (objf_impr/count)
                 << " objective function improvement per frame over "
                 <<  count <<  " frames";
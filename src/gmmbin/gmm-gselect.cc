@@ -22,6 +22,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "gmm/diag-gmm.h"
+#include "gmm/diag-gmm-index.h"
 #include "hmm/transition-model.h"
 
 int main(int argc, char *argv[]) {
@@ -39,17 +40,27 @@ int main(int argc, char *argv[]) {
         "Usage: gmm-gselect [options] <model-in> <feature-rspecifier> <gselect-wspecifier>\n"
         "The --gselect option (which takes an rspecifier) limits selection to a subset\n"
         "of indices:\n"
-        "e.g.: gmm-gselect \"--gselect=ark:gunzip -c bigger.gselect.gz|\" --n=20 1.gmm \"ark:feature-command |\" \"ark,t:|gzip -c >gselect.1.gz\"\n";
+        "e.g.: gmm-gselect \"--gselect=ark:gunzip -c bigger.gselect.gz|\" --n=20 1.gmm \"ark:feature-command |\" \"ark,t:|gzip -c >gselect.1.gz\"\n"
+        "With --use-index=true, the selection is approximate: only the Gaussians\n"
+        "in the shortlists of the best clusters of Gaussians are evaluated (see\n"
+        "the --index.* options).\n";
     
     ParseOptions po(usage);
     int32 num_gselect = 50;
+    bool use_index = false;
     std::string gselect_rspecifier;
     std::string likelihood_wspecifier;
+    DiagGmmIndexOptions index_opts;
     po.Register("n", &num_gselect, "Number of Gaussians to keep per frame\n");
+    po.Register("use-index", &use_index, "If true, use an index over the "
+                "Gaussians for approximate selection, which evaluates fewer "
+                "Gaussians per frame (not used with --gselect).");
     po.Register("write-likes", &likelihood_wspecifier, "rspecifier for likelihoods per "
                 "utterance");
     po.Register("gselect", &gselect_rspecifier, "rspecifier for gselect objects "
                 "to limit the search to");
+    ParseOptions po_index("index", &po);
+    index_opts.Register(&po_index);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 3) {
@@ -71,9 +82,12 @@ int main(int argc, char *argv[]) {
                  << "Note: this means the Gaussian selection is pointless.";
       num_gselect = num_gauss;
     }
+    DiagGmmIndex index;
+    if (use_index && gselect_rspecifier == "")
+      index.Init(gmm, num_gselect, index_opts);
     
     double tot_like = 0.0;
-    kaldi::int64 tot_t = 0;
+    kaldi::int64 tot_t = 0, tot_evaluated = 0;
     
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     Int32VectorVectorWriter gselect_writer(gselect_wspecifier);
@@ -104,6 +118,9 @@ int main(int argc, char *argv[]) {
           tot_like_this_file +=
               gmm.GaussianSelectionPreselect(mat.Row(i), preselect[i],
                                              num_gselect, &(gselect[i]));
+      } else if (use_index) {
+        tot_like_this_file = index.GaussianSelection(gmm, mat, num_gselect,
+                                                     &gselect, &tot_evaluated);
       } else { // No "preselect" [i.e. no existing gselect]: simple case.
         tot_like_this_file =
             gmm.GaussianSelection(mat, num_gselect, &gselect);
@@ -125,6 +142,9 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Done " << num_done << " files, " << num_err
               << " with errors, average UBM log-likelihood is "
               << (tot_like/tot_t) << " over " << tot_t << " frames.";
+    if (use_index && gselect_rspecifier == "" && tot_t != 0)
+      KALDI_LOG << "Evaluated " << (tot_evaluated / static_cast<double>(tot_t))
+                << " Gaussians per frame (out of " << num_gauss << ").";
     
     if (num_done != 0) return 0;
     else return 1;
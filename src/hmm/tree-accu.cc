@@ -103,6 +103,23 @@ void AccumulateTreeStats(const TransitionModel &trans_model,
 }
 
 
+void MergeTreeStats(std::map<EventType, GaussClusterable*> *src,
+                    std::map<EventType, GaussClusterable*> *dest) {
+  std::map<EventType, GaussClusterable*>::iterator iter = src->begin(),
+      end = src->end();
+  for (; iter != end; ++iter) {
+    std::map<EventType, GaussClusterable*>::iterator dest_iter =
+        dest->find(iter->first);
+    if (dest_iter == dest->end()) {
+      dest->insert(*iter);
+    } else {
+      dest_iter->second->Add(*(iter->second));
+      delete iter->second;
+    }
+  }
+  src->clear();
+}
+
 void ReadPhoneMap(std::string phone_map_rxfilename,
                   std::vector<int32> *phone_map) {
   phone_map->clear();
@@ -80,6 +80,12 @@ void AccumulateTreeStats(const TransitionModel &trans_model,
                          const Matrix<BaseFloat> &features,
                          std::map<EventType, GaussClusterable*> *stats);
 
+/// Adds the stats in "src" to "dest" and leaves "src" empty; this is for
+/// merging the stats that different threads accumulated with
+/// AccumulateTreeStats().  Pointers for events not already in "dest" are moved
+/// rather than copied, and the others are deleted after being added.
+void MergeTreeStats(std::map<EventType, GaussClusterable*> *src,
+                    std::map<EventType, GaussClusterable*> *dest);
 
 
 /*** Read a mapping from one phone set to another.  The phone map file has lines
@@ -0,0 +1,79 @@
+// ivector/agglomerative-clustering-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ivector/agglomerative-clustering.h"
+
+
+namespace kaldi {
+
+// Returns true if the two label sequences define the same partition of the
+// points.
+static bool SamePartition(const std::vector<int32> &labels1,
+                          const std::vector<int32> &labels2) {
+  if (labels1.size() != labels2.size())
+    return false;
+  std::unordered_map<int32, int32> map12, map21;
+  for (size_t i = 0; i < labels1.size(); i++) {
+    if (map12.count(labels1[i]) == 0) map12[labels1[i]] = labels2[i];
+    if (map21.count(labels2[i]) == 0) map21[labels2[i]] = labels1[i];
+    if (map12[labels1[i]] != labels2[i] || map21[labels2[i]] != labels1[i])
+      return false;
+  }
+  return true;
+}
+
+// Compares AgglomerativeClusterNnChain() with AgglomerativeCluster() on random
+// symmetric costs, stopping either at a threshold or at a number of clusters.
+void UnitTestAgglomerativeClusterNnChain() {
+  int32 num_points = 1 + Rand() % 60;
+  Matrix<BaseFloat> costs(num_points, num_points);
+  for (int32 i = 0; i < num_points; i++)
+    for (int32 j = 0; j < i; j++)
+      costs(i, j) = costs(j, i) = RandUniform();
+
+  BaseFloat threshold;
+  int32 min_clusters;
+  if (Rand() % 2 == 0) {
+    threshold = 0.2 + 0.4 * RandUniform();
+    min_clusters = 1;
+  } else {
+    threshold = std::numeric_limits<BaseFloat>::max();
+    min_clusters = 1 + Rand() % num_points;
+  }
+
+  std::vector<int32> ref_labels, labels;
+  AgglomerativeCluster(costs, threshold, min_clusters,
+                       std::numeric_limits<int16>::max(), 1.0, &ref_labels);
+  std::vector<BaseFloat> condensed_costs;
+  GetCondensedCosts(costs, &condensed_costs);
+  KALDI_ASSERT(condensed_costs.size() == num_points * (num_points - 1) / 2);
+  AgglomerativeClusterNnChain(num_points, threshold, min_clusters,
+                              &condensed_costs, &labels);
+  KALDI_ASSERT(SamePartition(ref_labels, labels));
+  KALDI_ASSERT(labels.empty() || labels[0] == 1);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  SetVerboseLevel(4);
+  for (int32 i = 0; i < 200; i++)
+    UnitTestAgglomerativeClusterNnChain();
+  std::cout << "Test OK.\n";
+  return 0;
+}
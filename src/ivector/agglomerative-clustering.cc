@@ -20,6 +20,7 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <limits>
 #include "ivector/agglomerative-clustering.h"
 
 namespace kaldi {
@@ -235,4 +236,148 @@ void AgglomerativeCluster(
   ac.Cluster();
 }
 
+// Returns the index of the pair of points (i, j), with i < j, in the condensed
+// storage of the costs between num_points points.
+static inline size_t CondensedIndex(size_t num_points, size_t i, size_t j) {
+  return i * (2 * num_points - i - 1) / 2 + (j - i - 1);
+}
+
+void GetCondensedCosts(const MatrixBase<BaseFloat> &costs,
+                       std::vector<BaseFloat> *condensed_costs) {
+  KALDI_ASSERT(costs.NumRows() == costs.NumCols());
+  size_t num_points = costs.NumRows();
+  condensed_costs->resize(num_points * (num_points - 1) / 2);
+  if (num_points == 0) return;
+  BaseFloat *out = condensed_costs->empty() ? NULL : &((*condensed_costs)[0]);
+  for (size_t i = 0; i + 1 < num_points; i++) {
+    const BaseFloat *row = costs.RowData(i);
+    std::copy(row + i + 1, row + num_points, out);
+    out += num_points - i - 1;
+  }
+}
+
+namespace {
+// A merge found by the nearest-neighbor chain: clusters (represented by the
+// points) "kept" and "removed", which were merged at cost "cost".
+struct NnChainMerge {
+  BaseFloat cost;
+  int32 kept, removed;
+  bool operator < (const NnChainMerge &other) const {
+    return cost < other.cost;
+  }
+};
+
+int32 FindRoot(std::vector<int32> *parent, int32 i) {
+  while ((*parent)[i] != i) {
+    (*parent)[i] = (*parent)[(*parent)[i]];
+    i = (*parent)[i];
+  }
+  return i;
+}
+}  // namespace
+
+void AgglomerativeClusterNnChain(
+    int32 num_points,
+    BaseFloat threshold,
+    int32 min_clusters,
+    std::vector<BaseFloat> *condensed_costs,
+    std::vector<int32> *assignments_out) {
+  KALDI_ASSERT(num_points >= 0 && min_clusters >= 0);
+  KALDI_ASSERT(condensed_costs->size() ==
+               static_cast<size_t>(num_points) * (num_points - 1) / 2);
+  std::vector<BaseFloat> &costs = *condensed_costs;
+  size_t n = num_points;
+
+  // A cluster is identified by the lowest-numbered point it contains, which
+  // is also where the average costs to it are stored.  "active" contains the
+  // clusters not yet merged into another cluster, and "active_pos" their
+  // positions in "active".
+  std::vector<int32> active(num_points), active_pos(num_points),
+      size(num_points, 1), chain;
+  for (int32 i = 0; i < num_points; i++)
+    active[i] = active_pos[i] = i;
+  std::vector<NnChainMerge> merges;
+  merges.reserve(num_points);
+
+  while (active.size() > 1) {
+    if (chain.empty())
+      chain.push_back(active[0]);
+    int32 a = chain.back(),
+        prev = (chain.size() > 1 ? chain[chain.size() - 2] : -1), b = prev;
+    // On ties, we prefer the previous element of the chain, which guarantees
+    // that the chain ends in a reciprocal pair rather than a cycle.
+    BaseFloat best_cost = (prev >= 0 ?
+                           costs[CondensedIndex(n, std::min(a, prev),
+                                                std::max(a, prev))] :
+                           std::numeric_limits<BaseFloat>::infinity());
+    for (size_t p = 0; p < active.size(); p++) {
+      int32 k = active[p];
+      if (k == a) continue;
+      BaseFloat cost = (k < a ? costs[CondensedIndex(n, k, a)] :
+                        costs[CondensedIndex(n, a, k)]);
+      if (cost < best_cost || b < 0) {
+        best_cost = cost;
+        b = k;
+      }
+    }
+    if (b != prev) {
+      chain.push_back(b);
+      continue;
+    }
+    chain.resize(chain.size() - 2);
+    int32 kept = std::min(a, b), removed = std::max(a, b);
+    NnChainMerge merge;
+    merge.cost = best_cost;
+    merge.kept = kept;
+    merge.removed = removed;
+    merges.push_back(merge);
+
+    // Update the average costs to the merged cluster (the Lance-Williams
+    // update for average linkage) and remove "removed" from the active set.
+    BaseFloat kept_weight = size[kept] /
+        static_cast<BaseFloat>(size[kept] + size[removed]),
+        removed_weight = 1.0 - kept_weight;
+    for (size_t p = 0; p < active.size(); p++) {
+      int32 k = active[p];
+      if (k == kept || k == removed) continue;
+      BaseFloat &kept_cost = (k < kept ? costs[CondensedIndex(n, k, kept)] :
+                              costs[CondensedIndex(n, kept, k)]);
+      BaseFloat removed_cost = (k < removed ?
+                                costs[CondensedIndex(n, k, removed)] :
+                                costs[CondensedIndex(n, removed, k)]);
+      kept_cost = kept_weight * kept_cost + removed_weight * removed_cost;
+    }
+    size[kept] += size[removed];
+    int32 pos = active_pos[removed];
+    active[pos] = active.back();
+    active_pos[active[pos]] = pos;
+    active.pop_back();
+  }
+  std::vector<BaseFloat>().swap(costs);  // free the memory.
+
+  // Average linkage has no inversions, so the merges in order of increasing
+  // cost are the merges that the greedy algorithm does.
+  std::stable_sort(merges.begin(), merges.end());
+  int32 max_merges = std::max(num_points - min_clusters, 0);
+  std::vector<int32> parent(num_points);
+  for (int32 i = 0; i < num_points; i++)
+    parent[i] = i;
+  for (int32 m = 0; m < static_cast<int32>(merges.size()) && m < max_merges &&
+           merges[m].cost <= threshold; m++) {
+    int32 root1 = FindRoot(&parent, merges[m].kept),
+        root2 = FindRoot(&parent, merges[m].removed);
+    parent[std::max(root1, root2)] = std::min(root1, root2);
+  }
+
+  assignments_out->resize(num_points);
+  std::vector<int32> root_label(num_points, 0);
+  int32 num_labels = 0;
+  for (int32 i = 0; i < num_points; i++) {
+    int32 root = FindRoot(&parent, i);
+    if (root_label[root] == 0)
+      root_label[root] = ++num_labels;
+    (*assignments_out)[i] = root_label[root];
+  }
+}
+
 }  // end namespace kaldi.
@@ -185,6 +185,40 @@ void AgglomerativeCluster(
     BaseFloat max_cluster_fraction,
     std::vector<int32> *assignments_out);
 
+/// Copies the upper triangle (i < j) of the square cost matrix "costs" into
+/// "condensed_costs" in row-major order, i.e. (0,1), (0,2) ... (0,N-1), (1,2)
+/// ..., which is the storage that AgglomerativeClusterNnChain() expects.  This
+/// needs N(N-1)/2 floats, and the full matrix may be freed afterwards.
+void GetCondensedCosts(const MatrixBase<BaseFloat> &costs,
+                       std::vector<BaseFloat> *condensed_costs);
+
+/** This does the same clustering as AgglomerativeCluster() with
+ *  max_cluster_fraction = 1.0 (average-linkage, stopping when the smallest
+ *  merge cost exceeds "threshold" or when "min_clusters" clusters remain), but
+ *  scales to recordings with many more points.  It uses the
+ *  nearest-neighbor-chain algorithm: a chain of clusters, each the nearest
+ *  neighbor of the previous one, is followed until it reaches a pair of
+ *  reciprocal nearest neighbors, which are merged.  Because average linkage
+ *  never decreases the cost between clusters when merging, this finds the same
+ *  merges as always merging the globally closest pair, in O(N^2) time, with no
+ *  queue or hash maps; the average costs are updated in place in
+ *  "condensed_costs" (see GetCondensedCosts()), which is used as workspace and
+ *  destroyed.  The merges are then sorted by cost and applied until one of the
+ *  stopping criteria is reached.
+ *
+ *  The clusters are the same as those of AgglomerativeCluster() except when
+ *  there are ties among the merge costs; the integer labels in
+ *  "assignments_out" are numbered from 1 in order of the first point of each
+ *  cluster.  The two-pass mode and the cluster size limit of
+ *  AgglomerativeCluster() are not supported.
+ */
+void AgglomerativeClusterNnChain(
+    int32 num_points,
+    BaseFloat threshold,
+    int32 min_clusters,
+    std::vector<BaseFloat> *condensed_costs,
+    std::vector<int32> *assignments_out);
+
 }  // end namespace kaldi.
 
 #endif  // KALDI_IVECTOR_AGGLOMERATIVE_CLUSTERING_H_
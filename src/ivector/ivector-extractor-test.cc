@@ -141,6 +141,39 @@ void TestIvectorExtraction(const IvectorExtractor &extractor,
   KALDI_ASSERT(ivector1.ApproxEqual(ivector2));
 }
 
+// Checks that GetIvectorMeansBatch() gives the same iVectors as
+// GetIvectorDistribution() on each utterance.
+void TestIvectorMeansBatch(const IvectorExtractor &extractor,
+                           const std::vector<Matrix<BaseFloat> > &all_feats,
+                           const FullGmm &fgmm) {
+  int32 num_utts = all_feats.size(),
+      ivector_dim = extractor.IvectorDim();
+  std::vector<IvectorExtractorUtteranceStats*> utt_stats(num_utts);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    const Matrix<BaseFloat> &feats = all_feats[utt];
+    Posterior post(feats.NumRows());
+    for (int32 t = 0; t < feats.NumRows(); t++) {
+      Vector<BaseFloat> posterior(fgmm.NumGauss(), kUndefined);
+      fgmm.ComponentPosteriors(feats.Row(t), &posterior);
+      for (int32 i = 0; i < posterior.Dim(); i++)
+        post[t].push_back(std::make_pair(i, posterior(i)));
+    }
+    utt_stats[utt] = new IvectorExtractorUtteranceStats(
+        extractor.NumGauss(), extractor.FeatDim(), false);
+    utt_stats[utt]->AccStats(feats, post);
+  }
+  std::vector<const IvectorExtractorUtteranceStats*> utt_stats_const(
+      utt_stats.begin(), utt_stats.end());
+  Matrix<double> ivectors(num_utts, ivector_dim);
+  extractor.GetIvectorMeansBatch(utt_stats_const, &ivectors);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    Vector<double> ivector(ivector_dim);
+    extractor.GetIvectorDistribution(*(utt_stats[utt]), &ivector, NULL);
+    KALDI_ASSERT(ivector.ApproxEqual(ivectors.Row(utt), 1.0e-05));
+  }
+  DeletePointers(&utt_stats);
+}
+
 
 void UnitTestIvectorExtractor() {
   FullGmm fgmm;
@@ -184,6 +217,7 @@ void UnitTestIvectorExtractor() {
       stats.AccStatsForUtterance(extractor, feats, fgmm);
       TestIvectorExtraction(extractor, feats, fgmm);
     }
+    TestIvectorMeansBatch(extractor, all_feats, fgmm);
     TestIvectorExtractorStatsIO(stats);
     
     IvectorExtractorEstimationOptions estimation_opts;
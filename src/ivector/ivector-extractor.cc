@@ -254,6 +254,57 @@ void IvectorExtractor::GetIvectorDistWeight(
   quadratic->AddMat2Vec(1.0, w_, kTrans, quadratic_coeff, 1.0);
 }
 
+void IvectorExtractor::GetIvectorMeansBatch(
+    const std::vector<const IvectorExtractorUtteranceStats*> &utt_stats,
+    MatrixBase<double> *means) const {
+  int32 num_utts = utt_stats.size(), I = NumGauss(), S = IvectorDim(),
+      D = FeatDim();
+  KALDI_ASSERT(means->NumRows() == num_utts && means->NumCols() == S);
+  if (num_utts == 0)
+    return;
+  if (IvectorDependentWeights()) {
+    for (int32 n = 0; n < num_utts; n++) {
+      SubVector<double> mean(*means, n);
+      GetIvectorDistribution(*(utt_stats[n]), &mean, NULL);
+    }
+    return;
+  }
+  // Row n of "gamma" is the zeroth-order stats of utterance n; the rows of
+  // "quadratic" are the packed quadratic terms, as in GetIvectorDistMean().
+  Matrix<double> gamma(num_utts, I, kUndefined);
+  for (int32 n = 0; n < num_utts; n++)
+    gamma.Row(n).CopyFromVec(utt_stats[n]->gamma_);
+  Matrix<double> quadratic(num_utts, S * (S + 1) / 2);
+  quadratic.AddMatMat(1.0, gamma, kNoTrans, U_, kNoTrans, 0.0);
+
+  // linear(n) = \sum_i \M_i^T \Sigma_i^{-1} x_i(n); we do one matrix multiply
+  // for each Gaussian, with the first-order stats of all the utterances.
+  Matrix<double> linear(num_utts, S);
+  Matrix<double> x(num_utts, D, kUndefined);
+  for (int32 i = 0; i < I; i++) {
+    for (int32 n = 0; n < num_utts; n++)
+      x.Row(n).CopyFromVec(utt_stats[n]->X_.Row(i));
+    linear.AddMatMat(1.0, x, kNoTrans, Sigma_inv_M_[i], kNoTrans, 1.0);
+  }
+
+  SpMatrix<double> this_quadratic(S, kUndefined);
+  TpMatrix<double> cholesky(S, kUndefined);
+  for (int32 n = 0; n < num_utts; n++) {
+    SubVector<double> q_vec(this_quadratic.Data(), S * (S + 1) / 2);
+    q_vec.CopyFromVec(quadratic.Row(n));
+    // The prior terms, as in GetIvectorDistPrior().
+    this_quadratic.AddToDiag(1.0);
+    linear(n, 0) += prior_offset_;
+    // mean = quadratic^{-1} linear; quadratic is positive definite, as its
+    // eigenvalues are >= 1 due to the prior term.
+    cholesky.Cholesky(this_quadratic);
+    SubVector<double> mean(*means, n);
+    mean.CopyFromVec(linear.Row(n));
+    mean.Solve(cholesky, kNoTrans);
+    mean.Solve(cholesky, kTrans);
+  }
+}
+
 void IvectorExtractor::GetIvectorDistMean(
     const IvectorExtractorUtteranceStats &utt_stats,
     VectorBase<double> *linear,
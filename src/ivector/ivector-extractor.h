@@ -153,6 +153,19 @@ class IvectorExtractor {
       VectorBase<double> *mean,
       SpMatrix<double> *var) const;
 
+  /// Gets the means of the distributions over ivectors for a batch of
+  /// utterances: row n of "means" is set to what GetIvectorDistribution()
+  /// would output as the "mean" for utt_stats[n] (up to roundoff).  This is
+  /// faster than doing the utterances one by one, because the quadratic and
+  /// linear terms for all the utterances are computed with matrix-matrix
+  /// multiplies, and the systems are solved by Cholesky decomposition rather
+  /// than by inverting.  If IvectorDependentWeights(), it just calls
+  /// GetIvectorDistribution() for each utterance.  "means" must have
+  /// utt_stats.size() rows and IvectorDim() columns.
+  void GetIvectorMeansBatch(
+      const std::vector<const IvectorExtractorUtteranceStats*> &utt_stats,
+      MatrixBase<double> *means) const;
+
   /// The distribution over iVectors, in our formulation, is not centered at
   /// zero; its first dimension has a nonzero offset.  This function returns
   /// that offset.
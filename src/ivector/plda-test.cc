@@ -22,6 +22,37 @@
 
 namespace kaldi {
 
+// Checks PldaBatchScorer against Plda::LogLikelihoodRatio() on random
+// iVectors, with varying numbers of enrollment utterances.
+void UnitTestPldaBatchScorer(const Plda &plda) {
+  int32 dim = plda.Dim(), num_enroll = 1 + Rand() % 10,
+      num_test = 1 + Rand() % 10;
+  Matrix<double> enroll_ivectors(num_enroll, dim),
+      test_ivectors(num_test, dim);
+  enroll_ivectors.SetRandn();
+  test_ivectors.SetRandn();
+  std::vector<int32> num_enroll_utts(num_enroll);
+  for (int32 i = 0; i < num_enroll; i++)
+    num_enroll_utts[i] = 1 + Rand() % 3;
+
+  PldaBatchScorer scorer(plda, enroll_ivectors, num_enroll_utts,
+                         test_ivectors);
+  int32 enroll_begin = Rand() % num_enroll;
+  Matrix<BaseFloat> scores(num_enroll - enroll_begin, num_test);
+  scorer.LogLikelihoodRatios(enroll_begin, &scores);
+  for (int32 i = 0; i < num_enroll; i++) {
+    for (int32 j = 0; j < num_test; j++) {
+      double ref_score = plda.LogLikelihoodRatio(enroll_ivectors.Row(i),
+                                                 num_enroll_utts[i],
+                                                 test_ivectors.Row(j)),
+          score = scorer.LogLikelihoodRatio(i, j);
+      AssertEqual(ref_score, score, 1.0e-06);
+      if (i >= enroll_begin)
+        AssertEqual(ref_score, scores(i - enroll_begin, j), 1.0e-04);
+    }
+  }
+}
+
 void UnitTestPldaEstimation(int32 dim) {
   int32 num_classes = 1000 + Rand() % 10;
   Matrix<double> between_proj(dim, dim);
@@ -69,6 +100,8 @@ void UnitTestPldaEstimation(int32 dim) {
   PldaEstimationConfig config;
   estimator.Estimate(config, &plda);
 
+  UnitTestPldaBatchScorer(plda);
+
   KALDI_LOG << "Trace of true within-var is " << within_var.Trace();
   KALDI_LOG << "Trace of true between-var is " << between_var.Trace();
 
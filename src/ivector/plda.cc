@@ -192,6 +192,107 @@ double Plda::LogLikelihoodRatio(
 }
 
 
+/*
+   Expanding the expression for LogLikelihoodRatio() above, with u^g the
+   enrollment iVector averaged over n utterances and u^p the test iVector, and
+   writing a = n \Psi / (n \Psi + I), v = I + \Psi / (n \Psi + I) and
+   w = I + \Psi (all diagonal), the log-likelihood ratio is
+     -0.5 logdet(v) + 0.5 logdet(w) - 0.5 (a^2 / v) . (u^g)^2
+     - 0.5 (1/v - 1/w) . (u^p)^2  +  (a / v) u^g . u^p
+   where "." is a dot product and the squares are elementwise.
+ */
+PldaBatchScorer::PldaBatchScorer(
+    const Plda &plda,
+    const MatrixBase<double> &transformed_enroll_ivectors,
+    const std::vector<int32> &num_enroll_utts,
+    const MatrixBase<double> &transformed_test_ivectors):
+    scaled_enroll_ivectors_(transformed_enroll_ivectors),
+    enroll_offsets_(transformed_enroll_ivectors.NumRows()),
+    enroll_test_term_index_(transformed_enroll_ivectors.NumRows()),
+    test_ivectors_(transformed_test_ivectors) {
+  int32 dim = plda.Dim(),
+      num_enroll = transformed_enroll_ivectors.NumRows(),
+      num_test = transformed_test_ivectors.NumRows();
+  KALDI_ASSERT(transformed_enroll_ivectors.NumCols() == dim &&
+               transformed_test_ivectors.NumCols() == dim &&
+               num_enroll_utts.size() == static_cast<size_t>(num_enroll));
+  const Vector<double> &psi = plda.psi_;
+
+  std::vector<int32> distinct_num_utts(num_enroll_utts);
+  SortAndUniq(&distinct_num_utts);
+  int32 num_distinct = distinct_num_utts.size();
+  // Row k of these contains the diagonal coefficients for
+  // n = distinct_num_utts[k]: the enrollment scale a / v, the coefficient
+  // -0.5 a^2 / v of (u^g)^2, and the coefficient -0.5 (1/v - 1/w) of (u^p)^2.
+  Matrix<double> enroll_scale(num_distinct, dim),
+      enroll_sq_coeff(num_distinct, dim),
+      test_sq_coeff(num_distinct, dim);
+  Vector<double> logdet_term(num_distinct);
+  for (int32 k = 0; k < num_distinct; k++) {
+    int32 n = distinct_num_utts[k];
+    KALDI_ASSERT(n > 0);
+    for (int32 d = 0; d < dim; d++) {
+      double a = n * psi(d) / (n * psi(d) + 1.0),
+          v = 1.0 + psi(d) / (n * psi(d) + 1.0),
+          w = 1.0 + psi(d);
+      enroll_scale(k, d) = a / v;
+      enroll_sq_coeff(k, d) = -0.5 * a * a / v;
+      test_sq_coeff(k, d) = -0.5 * (1.0 / v - 1.0 / w);
+      logdet_term(k) += -0.5 * (Log(v) - Log(w));
+    }
+  }
+
+  for (int32 i = 0; i < num_enroll; i++) {
+    int32 k = std::lower_bound(distinct_num_utts.begin(),
+                               distinct_num_utts.end(), num_enroll_utts[i]) -
+        distinct_num_utts.begin();
+    enroll_test_term_index_[i] = k;
+    SubVector<double> enroll_ivector(scaled_enroll_ivectors_, i);
+    Vector<double> enroll_ivector_sq(enroll_ivector);
+    enroll_ivector_sq.ApplyPow(2.0);
+    enroll_offsets_(i) = logdet_term(k) +
+        VecVec(enroll_sq_coeff.Row(k), enroll_ivector_sq);
+    enroll_ivector.MulElements(enroll_scale.Row(k));
+  }
+
+  Matrix<double> test_ivectors_sq(test_ivectors_);
+  test_ivectors_sq.ApplyPow(2.0);
+  test_terms_.Resize(num_distinct, num_test);
+  test_terms_.AddMatMat(1.0, test_sq_coeff, kNoTrans,
+                        test_ivectors_sq, kTrans, 0.0);
+}
+
+double PldaBatchScorer::LogLikelihoodRatio(int32 enroll_index,
+                                           int32 test_index) const {
+  KALDI_ASSERT(enroll_index >= 0 && enroll_index < NumEnroll() &&
+               test_index >= 0 && test_index < NumTest());
+  return enroll_offsets_(enroll_index) +
+      test_terms_(enroll_test_term_index_[enroll_index], test_index) +
+      VecVec(scaled_enroll_ivectors_.Row(enroll_index),
+             test_ivectors_.Row(test_index));
+}
+
+void PldaBatchScorer::LogLikelihoodRatios(
+    int32 enroll_begin, MatrixBase<BaseFloat> *scores) const {
+  int32 num_rows = scores->NumRows();
+  KALDI_ASSERT(enroll_begin >= 0 && enroll_begin + num_rows <= NumEnroll() &&
+               scores->NumCols() == NumTest());
+  if (num_rows == 0)
+    return;
+  Matrix<double> scores_dbl(num_rows, NumTest(), kUndefined);
+  scores_dbl.AddMatMat(1.0, scaled_enroll_ivectors_.RowRange(enroll_begin,
+                                                             num_rows),
+                       kNoTrans, test_ivectors_, kTrans, 0.0);
+  for (int32 i = 0; i < num_rows; i++) {
+    SubVector<double> row(scores_dbl, i);
+    row.AddVec(1.0, test_terms_.Row(
+        enroll_test_term_index_[enroll_begin + i]));
+    row.Add(enroll_offsets_(enroll_begin + i));
+  }
+  scores->CopyFromMat(scores_dbl);
+}
+
+
 void Plda::SmoothWithinClassCovariance(double smoothing_factor) {
   KALDI_ASSERT(smoothing_factor >= 0.0 && smoothing_factor <= 1.0);
   // smoothing_factor > 1.0 is possible but wouldn't really make sense.
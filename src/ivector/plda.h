@@ -144,6 +144,7 @@ class Plda {
   void ComputeDerivedVars(); // computes offset_.
   friend class PldaEstimator;
   friend class PldaUnsupervisedAdaptor;
+  friend class PldaBatchScorer;
 
   Vector<double> mean_;  // mean of samples in original space.
   Matrix<double> transform_; // of dimension Dim() by Dim();
@@ -169,6 +170,57 @@ class Plda {
 };
 
 
+/**
+   PldaBatchScorer computes Plda::LogLikelihoodRatio() for many pairs of
+   enrollment and test iVectors.  The log-likelihood ratio is a quadratic
+   function of the two iVectors with diagonal coefficients that depend only on
+   the number of enrollment utterances, so it can be written as
+      offset(enroll) + test_term(num_enroll_utts, test) + scaled_enroll . test
+   The constructor computes the offsets and the scaled enrollment iVectors,
+   and the test terms for each distinct number of enrollment utterances; after
+   that a single score is one dot product, and a block of the score matrix is
+   one matrix multiplication.  The results are the same as those of
+   LogLikelihoodRatio() up to roundoff.
+*/
+class PldaBatchScorer {
+ public:
+  /// The iVectors are assumed to have been transformed by
+  /// Plda::TransformIvector(); num_enroll_utts[i] is the number of
+  /// utterances that row i of transformed_enroll_ivectors was averaged over.
+  PldaBatchScorer(const Plda &plda,
+                  const MatrixBase<double> &transformed_enroll_ivectors,
+                  const std::vector<int32> &num_enroll_utts,
+                  const MatrixBase<double> &transformed_test_ivectors);
+
+  int32 NumEnroll() const { return scaled_enroll_ivectors_.NumRows(); }
+  int32 NumTest() const { return test_ivectors_.NumRows(); }
+
+  /// Returns the log-likelihood ratio for enrollment iVector "enroll_index"
+  /// and test iVector "test_index".
+  double LogLikelihoodRatio(int32 enroll_index, int32 test_index) const;
+
+  /// Sets (*scores)(i, j) to the log-likelihood ratio for enrollment iVector
+  /// enroll_begin + i and test iVector j, for all rows i of "scores", which
+  /// must have NumTest() columns.  Different blocks of rows may be computed
+  /// in parallel.
+  void LogLikelihoodRatios(int32 enroll_begin,
+                           MatrixBase<BaseFloat> *scores) const;
+
+ private:
+  // The enrollment iVectors times n Psi / (n Psi + I), divided by the
+  // variance I + Psi / (n Psi + I) (these are diagonal).
+  Matrix<double> scaled_enroll_ivectors_;
+  // The terms that depend only on the enrollment iVector.
+  Vector<double> enroll_offsets_;
+  // For each enrollment iVector, its row in test_terms_.
+  std::vector<int32> enroll_test_term_index_;
+  // Row k contains, for each test iVector, the term that depends only on the
+  // test iVector, for the k'th distinct number of enrollment utterances.
+  Matrix<double> test_terms_;
+  Matrix<double> test_ivectors_;
+};
+
+
 class PldaStats {
  public:
   PldaStats(): dim_(0) { } /// The dimension is set up the first time you add samples.
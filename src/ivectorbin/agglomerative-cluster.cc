@@ -49,7 +49,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     std::string reco2num_spk_rspecifier;
     BaseFloat threshold = 0.0, max_spk_fraction = 1.0;
-    bool read_costs = false;
+    bool read_costs = false, nn_chain = false;
     int32 first_pass_max_utterances = std::numeric_limits<int16>::max();
 
     po.Register("reco2num-spk-rspecifier", &reco2num_spk_rspecifier,
@@ -70,6 +70,12 @@ int main(int argc, char *argv[]) {
       " total fraction of utterances in them is less than this threshold."
       " This is active only when reco2num-spk-rspecifier is supplied and"
       " 1.0 / num-spk <= max-spk-fraction <= 1.0.");
+    po.Register("nn-chain", &nn_chain, "If true, use the nearest-neighbor-chain"
+      " algorithm, which stores only the upper triangle of the costs and"
+      " needs much less time and memory for recordings with many utterances."
+      " It gives the same clusters as the default algorithm (up to ties) in a"
+      " single pass, so --first-pass-max-utterances is ignored; it does not"
+      " support --max-spk-fraction < 1.0.");
 
     po.Read(argc, argv);
 
@@ -77,6 +83,9 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (nn_chain && !reco2num_spk_rspecifier.empty() && max_spk_fraction < 1.0)
+      KALDI_ERR << "--nn-chain=true is not compatible with "
+                << "--max-spk-fraction < 1.0";
 
     std::string scores_rspecifier = po.GetArg(1),
       reco2utt_rspecifier = po.GetArg(2),
@@ -100,7 +109,19 @@ int main(int argc, char *argv[]) {
         costs.Scale(-1);
       std::vector<std::string> uttlist = reco2utt_reader.Value(reco);
       std::vector<int32> spk_ids;
-      if (reco2num_spk_rspecifier.size()) {
+      if (nn_chain) {
+        int32 num_speakers = (reco2num_spk_rspecifier.size() ?
+                              reco2num_spk_reader.Value(reco) : 1);
+        BaseFloat this_threshold = (reco2num_spk_rspecifier.size() ?
+                                    std::numeric_limits<BaseFloat>::max() :
+                                    threshold);
+        int32 num_points = costs.NumRows();
+        std::vector<BaseFloat> condensed_costs;
+        GetCondensedCosts(costs, &condensed_costs);
+        costs.Resize(0, 0);  // free the memory.
+        AgglomerativeClusterNnChain(num_points, this_threshold, num_speakers,
+                                    &condensed_costs, &spk_ids);
+      } else if (reco2num_spk_rspecifier.size()) {
         int32 num_speakers = reco2num_spk_reader.Value(reco);
         if (1.0 / num_speakers <= max_spk_fraction && max_spk_fraction <= 1.0)
           AgglomerativeCluster(costs, std::numeric_limits<BaseFloat>::max(),
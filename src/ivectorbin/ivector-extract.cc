@@ -27,66 +27,89 @@
 namespace kaldi {
 
 // This class will be used to parallelize over multiple threads the job
-// that this program does.  The work happens in the operator (), the
-// output happens in the destructor.
+// that this program does.  Each task handles a batch of utterances, whose
+// iVectors are computed together by GetIvectorMeansBatch().  The work happens
+// in the operator (), the output happens in the destructor.
 class IvectorExtractTask {
  public:
   IvectorExtractTask(const IvectorExtractor &extractor,
-                     std::string utt,
-                     const Matrix<BaseFloat> &feats,
-                     const Posterior &posterior,
                      BaseFloatVectorWriter *writer,
                      double *tot_auxf_change):
-      extractor_(extractor), utt_(utt), feats_(feats), posterior_(posterior),
-      writer_(writer), tot_auxf_change_(tot_auxf_change) { }
+      extractor_(extractor), writer_(writer),
+      tot_auxf_change_(tot_auxf_change) { }
+
+  // Adds an utterance to the batch.
+  void AddUtterance(const std::string &utt,
+                    const Matrix<BaseFloat> &feats,
+                    const Posterior &posterior) {
+    utts_.push_back(utt);
+    feats_.push_back(feats);
+    posteriors_.push_back(posterior);
+  }
+
+  int32 NumUtterances() const { return utts_.size(); }
 
   void operator () () {
     bool need_2nd_order_stats = false;
+    int32 num_utts = utts_.size();
 
-    IvectorExtractorUtteranceStats utt_stats(extractor_.NumGauss(),
-                                             extractor_.FeatDim(),
-                                             need_2nd_order_stats);
-
-    utt_stats.AccStats(feats_, posterior_);
-
-    ivector_.Resize(extractor_.IvectorDim());
-    ivector_(0) = extractor_.PriorOffset();
+    std::vector<IvectorExtractorUtteranceStats*> utt_stats(num_utts);
+    for (int32 n = 0; n < num_utts; n++) {
+      utt_stats[n] = new IvectorExtractorUtteranceStats(
+          extractor_.NumGauss(), extractor_.FeatDim(), need_2nd_order_stats);
+      utt_stats[n]->AccStats(feats_[n], posteriors_[n]);
+    }
+    // We don't need the features any more.
+    feats_.clear();
 
+    Vector<double> default_ivector(extractor_.IvectorDim());
+    default_ivector(0) = extractor_.PriorOffset();
     if (tot_auxf_change_ != NULL) {
-      double old_auxf = extractor_.GetAuxf(utt_stats, ivector_);
-      extractor_.GetIvectorDistribution(utt_stats, &ivector_, NULL);
-      double new_auxf = extractor_.GetAuxf(utt_stats, ivector_);
-      auxf_change_ = new_auxf - old_auxf;
-    } else {
-      extractor_.GetIvectorDistribution(utt_stats, &ivector_, NULL);
+      auxf_change_.resize(num_utts);
+      for (int32 n = 0; n < num_utts; n++)
+        auxf_change_[n] = -extractor_.GetAuxf(*(utt_stats[n]),
+                                              default_ivector);
     }
+    ivectors_.Resize(num_utts, extractor_.IvectorDim());
+    std::vector<const IvectorExtractorUtteranceStats*> utt_stats_const(
+        utt_stats.begin(), utt_stats.end());
+    extractor_.GetIvectorMeansBatch(utt_stats_const, &ivectors_);
+    if (tot_auxf_change_ != NULL) {
+      for (int32 n = 0; n < num_utts; n++)
+        auxf_change_[n] += extractor_.GetAuxf(*(utt_stats[n]),
+                                              ivectors_.Row(n));
+    }
+    DeletePointers(&utt_stats);
   }
   ~IvectorExtractTask() {
-    if (tot_auxf_change_ != NULL) {
-      double T = TotalPosterior(posterior_);
-      *tot_auxf_change_ += auxf_change_;
-      KALDI_VLOG(2) << "Auxf change for utterance " << utt_ << " was "
-                    << (auxf_change_ / T) << " per frame over " << T
-                    << " frames (weighted)";
+    for (int32 n = 0; n < NumUtterances(); n++) {
+      if (tot_auxf_change_ != NULL) {
+        double T = TotalPosterior(posteriors_[n]);
+        *tot_auxf_change_ += auxf_change_[n];
+        KALDI_VLOG(2) << "Auxf change for utterance " << utts_[n] << " was "
+                      << (auxf_change_[n] / T) << " per frame over " << T
+                      << " frames (weighted)";
+      }
+      // We actually write out the offset of the iVectors from the mean of the
+      // prior distribution; this is the form we'll need it in for scoring.
+      // (most formulations of iVectors have zero-mean priors so this is not
+      // normally an issue).
+      SubVector<double> ivector(ivectors_, n);
+      ivector(0) -= extractor_.PriorOffset();
+      KALDI_VLOG(2) << "Ivector norm for utterance " << utts_[n]
+                    << " was " << ivector.Norm(2.0);
+      writer_->Write(utts_[n], Vector<BaseFloat>(ivector));
     }
-    // We actually write out the offset of the iVectors from the mean of the
-    // prior distribution; this is the form we'll need it in for scoring.  (most
-    // formulations of iVectors have zero-mean priors so this is not normally an
-    // issue).
-    ivector_(0) -= extractor_.PriorOffset();
-    KALDI_VLOG(2) << "Ivector norm for utterance " << utt_
-                  << " was " << ivector_.Norm(2.0);
-    writer_->Write(utt_, Vector<BaseFloat>(ivector_));
   }
  private:
   const IvectorExtractor &extractor_;
-  std::string utt_;
-  Matrix<BaseFloat> feats_;
-  Posterior posterior_;
+  std::vector<std::string> utts_;
+  std::vector<Matrix<BaseFloat> > feats_;
+  std::vector<Posterior> posteriors_;
   BaseFloatVectorWriter *writer_;
   double *tot_auxf_change_; // if non-NULL we need the auxf change.
-  Vector<double> ivector_;
-  double auxf_change_;
+  Matrix<double> ivectors_;
+  std::vector<double> auxf_change_;
 };
 
 int32 RunPerSpeaker(const std::string &ivector_extractor_rxfilename,
@@ -226,6 +249,7 @@ int main(int argc, char *argv[]) {
     IvectorEstimationOptions opts;
     std::string spk2utt_rspecifier;
     TaskSequencerConfig sequencer_config;
+    int32 batch_size = 1;
     po.Register("compute-objf-change", &compute_objf_change,
                 "If true, compute the change in objective function from using "
                 "nonzero iVector (a potentially useful diagnostic).  Combine "
@@ -236,13 +260,17 @@ int main(int argc, char *argv[]) {
                 "is not the normal way iVectors are obtained for speaker-id. "
                 "This option will cause the program to ignore the --num-threads "
                 "option.");
+    po.Register("batch-size", &batch_size, "Number of utterances whose "
+                "iVectors are computed together (this is faster, as it uses "
+                "matrix-matrix multiplies).  Each thread works on one batch "
+                "at a time.  Ignored with --spk2utt.");
 
     opts.Register(&po);
     sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
-    if (po.NumArgs() != 4) {
+    if (po.NumArgs() != 4 || batch_size <= 0) {
       po.PrintUsage();
       exit(1);
     }
@@ -268,7 +296,9 @@ int main(int argc, char *argv[]) {
       BaseFloatVectorWriter ivector_writer(ivectors_wspecifier);
 
       {
+        double *auxf_ptr = (compute_objf_change ? &tot_auxf_change : NULL );
         TaskSequencer<IvectorExtractTask> sequencer(sequencer_config);
+        IvectorExtractTask *task = NULL;
         for (; !feature_reader.Done(); feature_reader.Next()) {
           std::string utt = feature_reader.Key();
           if (!posterior_reader.HasKey(utt)) {
@@ -287,8 +317,6 @@ int main(int argc, char *argv[]) {
             continue;
           }
 
-          double *auxf_ptr = (compute_objf_change ? &tot_auxf_change : NULL );
-
           double this_t = opts.acoustic_weight * TotalPosterior(posterior),
               max_count_scale = 1.0;
           if (opts.max_count > 0 && this_t > opts.max_count) {
@@ -302,12 +330,19 @@ int main(int argc, char *argv[]) {
                          &posterior);
           // note: now, this_t == sum of posteriors.
 
-          sequencer.Run(new IvectorExtractTask(extractor, utt, mat, posterior,
-                                               &ivector_writer, auxf_ptr));
+          if (task == NULL)
+            task = new IvectorExtractTask(extractor, &ivector_writer, auxf_ptr);
+          task->AddUtterance(utt, mat, posterior);
+          if (task->NumUtterances() == batch_size) {
+            sequencer.Run(task);
+            task = NULL;
+          }
 
           tot_t += this_t;
           num_done++;
         }
+        if (task != NULL)
+          sequencer.Run(task);
         // Destructor of "sequencer" will wait for any remaining tasks.
       }
 
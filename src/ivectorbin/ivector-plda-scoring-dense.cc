@@ -22,6 +22,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "util/stl-utils.h"
+#include "util/kaldi-thread.h"
 #include "ivector/plda.h"
 
 namespace kaldi {
@@ -109,6 +110,26 @@ void ApplyPca(const Matrix<BaseFloat> &ivectors_in,
     pca_mat, kTrans, 0.0);
 }
 
+// Computes the score matrix for all pairs of transformed i-vectors in blocks
+// of rows; thread t does blocks t, t + num_threads_, and so on.
+class PldaScoringClass: public MultiThreadable {
+ public:
+  PldaScoringClass(const PldaBatchScorer &scorer, Matrix<BaseFloat> *scores):
+      scorer_(scorer), scores_(scores) { }
+  void operator () () {
+    int32 num_rows = scores_->NumRows(), block_size = 256;
+    for (int32 begin = thread_id_ * block_size; begin < num_rows;
+         begin += num_threads_ * block_size) {
+      SubMatrix<BaseFloat> block(scores_->RowRange(
+          begin, std::min(block_size, num_rows - begin)));
+      scorer_.LogLikelihoodRatios(begin, &block);
+    }
+  }
+ private:
+  const PldaBatchScorer &scorer_;
+  Matrix<BaseFloat> *scores_;
+};
+
 } // namespace kaldi
 
 int main(int argc, char *argv[]) {
@@ -131,6 +152,7 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     BaseFloat target_energy = 0.5;
+    int32 num_threads = 1;
     PldaConfig plda_config;
     plda_config.Register(&po);
 
@@ -138,6 +160,8 @@ int main(int argc, char *argv[]) {
       "Reduce dimensionality of i-vectors using a recording-dependent"
       " PCA such that this fraction of the total energy remains.");
     KALDI_ASSERT(target_energy <= 1.0);
+    po.Register("num-threads", &num_threads, "Number of threads used to score"
+      " the pairs of i-vectors of each recording.");
 
     po.Read(argc, argv);
 
@@ -205,12 +229,14 @@ int main(int argc, char *argv[]) {
           TransformIvectors(ivector_mat, plda_config, this_plda,
           &ivector_mat_plda);
         }
-        for (int32 i = 0; i < ivector_mat_plda.NumRows(); i++) {
-          for (int32 j = 0; j < ivector_mat_plda.NumRows(); j++) {
-            scores(i, j) = this_plda.LogLikelihoodRatio(Vector<double>(
-              ivector_mat_plda.Row(i)), 1.0,
-              Vector<double>(ivector_mat_plda.Row(j)));
-          }
+        Matrix<double> ivector_mat_plda_dbl(ivector_mat_plda);
+        std::vector<int32> num_enroll_utts(ivector_mat_plda.NumRows(), 1);
+        PldaBatchScorer scorer(this_plda, ivector_mat_plda_dbl,
+                               num_enroll_utts, ivector_mat_plda_dbl);
+        {
+          // The destructor of the MultiThreader waits for the threads.
+          PldaScoringClass scoring(scorer, &scores);
+          MultiThreader<PldaScoringClass> m(num_threads, scoring);
         }
         scores_writer.Write(reco, scores);
         num_reco_done++;
@@ -150,6 +150,34 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Average renormalization scale on test iVectors was "
               << (tot_test_renorm_scale / num_test_ivectors);
 
+    // Put the iVectors into matrices so that PldaBatchScorer can precompute
+    // everything except one dot product per trial; the hashes now map to the
+    // row indexes.
+    unordered_map<string, int32, StringHasher> train_index, test_index;
+    Matrix<double> train_ivector_mat(num_train_ivectors, dim),
+        test_ivector_mat(num_test_ivectors, dim);
+    std::vector<int32> num_train_examples(num_train_ivectors, 1);
+    for (HashType::iterator iter = train_ivectors.begin();
+         iter != train_ivectors.end(); ++iter) {
+      int32 i = train_index.size();
+      train_index[iter->first] = i;
+      train_ivector_mat.Row(i).CopyFromVec(*(iter->second));
+      if (!num_utts_rspecifier.empty())
+        num_train_examples[i] = num_utts_reader.Value(iter->first);
+      delete iter->second;
+    }
+    for (HashType::iterator iter = test_ivectors.begin();
+         iter != test_ivectors.end(); ++iter) {
+      int32 j = test_index.size();
+      test_index[iter->first] = j;
+      test_ivector_mat.Row(j).CopyFromVec(*(iter->second));
+      delete iter->second;
+    }
+    train_ivectors.clear();
+    test_ivectors.clear();
+    PldaBatchScorer scorer(plda, train_ivector_mat, num_train_examples,
+                           test_ivector_mat);
+
 
     Input ki(trials_rxfilename);
     bool binary = false;
@@ -166,47 +194,24 @@ int main(int argc, char *argv[]) {
                   << "in input (expected two fields: key1 key2): " << line;
       }
       std::string key1 = fields[0], key2 = fields[1];
-      if (train_ivectors.count(key1) == 0) {
+      if (train_index.count(key1) == 0) {
         KALDI_WARN << "Key " << key1 << " not present in training iVectors.";
         num_trials_err++;
         continue;
       }
-      if (test_ivectors.count(key2) == 0) {
+      if (test_index.count(key2) == 0) {
         KALDI_WARN << "Key " << key2 << " not present in test iVectors.";
         num_trials_err++;
         continue;
       }
-      const Vector<BaseFloat> *train_ivector = train_ivectors[key1],
-          *test_ivector = test_ivectors[key2];
-
-      Vector<double> train_ivector_dbl(*train_ivector),
-          test_ivector_dbl(*test_ivector);
-
-      int32 num_train_examples;
-      if (!num_utts_rspecifier.empty()) {
-        // we already checked that it has this key.
-        num_train_examples = num_utts_reader.Value(key1);
-      } else {
-        num_train_examples = 1;
-      }
-
-
-      BaseFloat score = plda.LogLikelihoodRatio(train_ivector_dbl,
-                                                num_train_examples,
-                                                test_ivector_dbl);
+      BaseFloat score = scorer.LogLikelihoodRatio(train_index[key1],
+                                                  test_index[key2]);
       sum += score;
       sumsq += score * score;
       num_trials_done++;
       ko.Stream() << key1 << ' ' << key2 << ' ' << score << std::endl;
     }
 
-    for (HashType::iterator iter = train_ivectors.begin();
-         iter != train_ivectors.end(); ++iter)
-      delete iter->second;
-    for (HashType::iterator iter = test_ivectors.begin();
-         iter != test_ivectors.end(); ++iter)
-      delete iter->second;
-
 
     if (num_trials_done != 0) {
       BaseFloat mean = sum / num_trials_done, scatter = sumsq / num_trials_done,
@@ -0,0 +1,53 @@
+// lat/compact-lattice-task.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/compact-lattice-task.h"
+
+namespace kaldi {
+
+CompactLatticeTask::CompactLatticeTask(const std::string &key,
+                                       CompactLattice *clat,
+                                       CompactLatticeWriter *clat_writer,
+                                       int32 *num_done, int32 *num_fail):
+    key_(key), clat_(clat), clat_writer_(clat_writer), num_done_(num_done),
+    num_fail_(num_fail), ok_(false) {
+  KALDI_ASSERT(clat != NULL);
+}
+
+void CompactLatticeTask::operator () () {
+  ok_ = Process(clat_, &clat_out_);
+  delete clat_;
+  clat_ = NULL;
+}
+
+CompactLatticeTask::~CompactLatticeTask() {
+  if (clat_writer_ != NULL) {
+    bool nonempty = (clat_out_.Start() != fst::kNoStateId);
+    if (nonempty)
+      clat_writer_->Write(key_, clat_out_);
+    if (ok_ && nonempty) {
+      if (num_done_ != NULL)
+        (*num_done_)++;
+    } else {
+      if (num_fail_ != NULL)
+        (*num_fail_)++;
+    }
+  }
+  delete clat_;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,78 @@
+// lat/compact-lattice-task.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_COMPACT_LATTICE_TASK_H_
+#define KALDI_LAT_COMPACT_LATTICE_TASK_H_
+
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+/**
+   CompactLatticeTask is a base class for the tasks of programs that process
+   a table of compact lattices in parallel with TaskSequencer (see
+   util/kaldi-thread.h).  The task owns one input lattice.  operator () calls
+   Process() on a worker thread and then frees the input lattice.  The
+   destructor, which TaskSequencer calls in the order in which the tasks were
+   given to it, writes the output lattice, if there is a writer.
+
+   If the writer is NULL, e.g. if the output is not a lattice, the derived
+   class writes its own output from its destructor (which runs before this
+   one).
+ */
+class CompactLatticeTask {
+ public:
+  /// Takes ownership of "clat".  "clat_writer", "num_done" and "num_fail" may
+  /// be NULL.
+  CompactLatticeTask(const std::string &key, CompactLattice *clat,
+                     CompactLatticeWriter *clat_writer,
+                     int32 *num_done, int32 *num_fail);
+
+  void operator () ();
+
+  /// If there is a writer: writes the output lattice if it is nonempty, and
+  /// counts the lattice as done if Process() returned true and the output is
+  /// nonempty, or as failed otherwise.
+  virtual ~CompactLatticeTask();
+
+ protected:
+  /// Called on a worker thread to process the lattice "clat", which it may
+  /// modify.  It should put the result, if any, in "clat_out".  It returns
+  /// false (after printing a warning if appropriate) if the processing
+  /// failed; a nonempty "clat_out" is still written in that case, so it
+  /// should be cleared if partial output is not wanted.
+  virtual bool Process(CompactLattice *clat, CompactLattice *clat_out) = 0;
+
+  const std::string &Key() const { return key_; }
+
+ private:
+  std::string key_;
+  CompactLattice *clat_;  // The input lattice; owned here.
+  CompactLattice clat_out_;  // The output lattice.
+  CompactLatticeWriter *clat_writer_;
+  int32 *num_done_;
+  int32 *num_fail_;
+  bool ok_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CompactLatticeTask);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_COMPACT_LATTICE_TASK_H_
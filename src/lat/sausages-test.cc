@@ -0,0 +1,152 @@
+// lat/sausages-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/sausages.h"
+#include "fstext/fstext-lib.h"
+
+namespace kaldi {
+
+// Returns a random acyclic word lattice, in which every state is on a path
+// from the start state to a final state.
+CompactLattice *RandAcyclicCompactLattice() {
+  CompactLattice *clat = new CompactLattice;
+  int32 num_states = RandInt(2, 8), num_words = RandInt(1, 5);
+  for (int32 s = 0; s < num_states; s++)
+    clat->AddState();
+  clat->SetStart(0);
+  for (int32 s = 0; s + 1 < num_states; s++) {
+    // There is always an arc to the next state, and maybe arcs to later ones.
+    int32 num_arcs = RandInt(1, 3);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 nextstate = (i == 0 ? s + 1 : RandInt(s + 1, num_states - 1)),
+          word = RandInt(0, num_words);  // zero is epsilon.
+      std::vector<int32> alignment(RandInt(1, 3), 1);
+      CompactLatticeWeight weight(
+          LatticeWeight(5.0 * RandUniform(), 5.0 * RandUniform()), alignment);
+      clat->AddArc(s, CompactLatticeArc(word, word, weight, nextstate));
+    }
+  }
+  clat->SetFinal(num_states - 1, CompactLatticeWeight::One());
+  if (num_states > 2 && RandInt(0, 1) == 0)
+    clat->SetFinal(RandInt(1, num_states - 2),
+                   CompactLatticeWeight(LatticeWeight(RandUniform(), 0.0),
+                                        std::vector<int32>()));
+  return clat;
+}
+
+// Returns the Bayes risk (approximate expected edit distance, as in Figure 4
+// of the paper) of "words" given the lattice, computed the way
+// MinimumBayesRisk::EditDistance() originally did it: the alphas are
+// recomputed on each call, and the arc posteriors for each (arc, q).
+double ReferenceBayesRisk(const CompactLattice &clat_in,
+                          const std::vector<int32> &words) {
+  const double delta = 1.0e-05;  // As MinimumBayesRisk::delta().
+  CompactLattice clat(clat_in);
+  fst::CreateSuperFinal(&clat);
+  if (!(clat.Properties(fst::kTopSorted, true) & fst::kTopSorted))
+    KALDI_ASSERT(fst::TopSort(&clat));
+
+  // The hypothesis with epsilons between the words, as in NormalizeEps().
+  std::vector<int32> r(1, 0);
+  for (size_t i = 0; i < words.size(); i++) {
+    r.push_back(words[i]);
+    r.push_back(0);
+  }
+  int32 N = clat.NumStates(), Q = r.size();
+
+  // Arcs entering each node; nodes are numbered from 1.
+  struct RefArc { int32 word, start_node; double loglike; };
+  std::vector<std::vector<RefArc> > pre(N + 1);
+  for (int32 n = 1; n <= N; n++) {
+    for (fst::ArcIterator<CompactLattice> aiter(clat, n - 1); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &carc = aiter.Value();
+      RefArc arc = { carc.ilabel, n, -(carc.weight.Weight().Value1() +
+                                       carc.weight.Weight().Value2()) };
+      pre[carc.nextstate + 1].push_back(arc);
+    }
+  }
+
+  Vector<double> alpha(N + 1), alpha_dash_arc(Q + 1);
+  Matrix<double> alpha_dash(N + 1, Q + 1);
+  alpha(1) = 0.0;
+  for (int32 q = 1; q <= Q; q++)
+    alpha_dash(1, q) = alpha_dash(1, q - 1) + (r[q - 1] == 0 ? 0.0 : 1.0);
+  for (int32 n = 2; n <= N; n++) {
+    double alpha_n = kLogZeroDouble;
+    for (size_t i = 0; i < pre[n].size(); i++)
+      alpha_n = LogAdd(alpha_n, alpha(pre[n][i].start_node) +
+                       pre[n][i].loglike);
+    alpha(n) = alpha_n;
+    for (size_t i = 0; i < pre[n].size(); i++) {
+      const RefArc &arc = pre[n][i];
+      int32 s_a = arc.start_node, w_a = arc.word;
+      double del_cost = (w_a == 0 ? 0.0 : 1.0 + delta);
+      for (int32 q = 0; q <= Q; q++) {
+        if (q == 0) {
+          alpha_dash_arc(q) = alpha_dash(s_a, q) + del_cost;
+        } else {
+          int32 r_q = r[q - 1];
+          double a1 = alpha_dash(s_a, q - 1) + (w_a == r_q ? 0.0 : 1.0),
+              a2 = alpha_dash(s_a, q) + del_cost,
+              a3 = alpha_dash_arc(q - 1) + (r_q == 0 ? 0.0 : 1.0);
+          alpha_dash_arc(q) = std::min(a1, std::min(a2, a3));
+        }
+        alpha_dash(n, q) += Exp(alpha(s_a) + arc.loglike - alpha(n)) *
+            alpha_dash_arc(q);
+      }
+    }
+  }
+  return alpha_dash(N, Q);
+}
+
+// Checks the MBR output of random lattices: that the Bayes risk is the one
+// that the original algorithm gives for the output, that the output consists
+// of the most likely word of each sausage bin, and that starting from the
+// output gives the same output.
+void TestMinimumBayesRisk() {
+  CompactLattice *clat = RandAcyclicCompactLattice();
+  MinimumBayesRiskOptions opts;
+  MinimumBayesRisk mbr(*clat, opts);
+  const std::vector<int32> &one_best = mbr.GetOneBest();
+
+  double ref_risk = ReferenceBayesRisk(*clat, one_best);
+  KALDI_ASSERT(std::abs(mbr.GetBayesRisk() - ref_risk) < 1.0e-04);
+
+  const std::vector<std::vector<std::pair<int32, BaseFloat> > > &sausages =
+      mbr.GetSausageStats();
+  std::vector<int32> sausage_best;
+  for (size_t q = 0; q < sausages.size(); q++) {
+    KALDI_ASSERT(!sausages[q].empty());
+    if (sausages[q][0].first != 0)
+      sausage_best.push_back(sausages[q][0].first);
+  }
+  KALDI_ASSERT(sausage_best == one_best);
+
+  MinimumBayesRisk mbr2(*clat, one_best, opts);
+  KALDI_ASSERT(mbr2.GetOneBest() == one_best);
+  KALDI_ASSERT(std::abs(mbr2.GetBayesRisk() - mbr.GetBayesRisk()) < 1.0e-04);
+  delete clat;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 200; i++)
+    kaldi::TestMinimumBayesRisk();
+  KALDI_LOG << "Success.";
+}
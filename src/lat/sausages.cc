@@ -128,25 +128,18 @@ void MinimumBayesRisk::NormalizeEps(std::vector<int32> *vec) {
 }
 
 double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
-                                      Vector<double> &alpha,
                                       Matrix<double> &alpha_dash,
                                       Vector<double> &alpha_dash_arc) {
-  alpha(1) = 0.0; // = log(1).  Line 5.
   alpha_dash(1, 0) = 0.0; // Line 5.
   for (int32 q = 1; q <= Q; q++)
     alpha_dash(1, q) = alpha_dash(1, q-1) + l(0, r(q)); // Line 7.
   for (int32 n = 2; n <= N; n++) {
-    double alpha_n = kLogZeroDouble;
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
-      alpha_n = LogAdd(alpha_n, alpha(arc.start_node) + arc.loglike);
-    }
-    alpha(n) = alpha_n; // Line 10.
+    // Line 10 (the alphas) was done in PrepareLatticeAndInitStats().
     // Line 11 omitted: matrix was initialized to zero.
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
+    for (int32 i = pre_[n]; i < pre_[n+1]; i++) {
+      const Arc &arc = arcs_[i];
       int32 s_a = arc.start_node, w_a = arc.word;
-      BaseFloat p_a = arc.loglike;
+      double prob = arc.prob;
       for (int32 q = 0; q <= Q; q++) {
         if (q == 0) {
           alpha_dash_arc(q) = // line 15.
@@ -159,7 +152,7 @@ double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
           alpha_dash_arc(q) = std::min(a1, std::min(a2, a3));
         }
         // line 19:
-        alpha_dash(n, q) += Exp(alpha(s_a) + p_a - alpha(n)) * alpha_dash_arc(q);
+        alpha_dash(n, q) += prob * alpha_dash_arc(q);
       }
     }
   }
@@ -170,10 +163,9 @@ double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
 void MinimumBayesRisk::AccStats() {
   using std::map;
 
-  int32 N = static_cast<int32>(pre_.size()) - 1,
+  int32 N = static_cast<int32>(pre_.size()) - 2,
       Q = static_cast<int32>(R_.size());
 
-  Vector<double> alpha(N+1); // index (1...N)
   Matrix<double> alpha_dash(N+1, Q+1); // index (1...N, 0...Q)
   Vector<double> alpha_dash_arc(Q+1); // index 0...Q
   Matrix<double> beta_dash(N+1, Q+1); // index (1...N, 0...Q)
@@ -188,7 +180,7 @@ void MinimumBayesRisk::AccStats() {
   // the sausage bins and the 1-best output.
   std::vector<map<int32, double> > tau_b(Q+1), tau_e(Q+1);
 
-  double Ltmp = EditDistance(N, Q, alpha, alpha_dash, alpha_dash_arc);
+  double Ltmp = EditDistance(N, Q, alpha_dash, alpha_dash_arc);
   if (L_ != 0 && Ltmp > L_) { // L_ != 0 is to rule out 1st iter.
     KALDI_WARN << "Edit distance increased: " << Ltmp << " > "
                << L_;
@@ -198,10 +190,10 @@ void MinimumBayesRisk::AccStats() {
   // omit line 10: zero when initialized.
   beta_dash(N, Q) = 1.0; // Line 11.
   for (int32 n = N; n >= 2; n--) {
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
+    for (int32 i = pre_[n]; i < pre_[n+1]; i++) {
+      const Arc &arc = arcs_[i];
       int32 s_a = arc.start_node, w_a = arc.word;
-      BaseFloat p_a = arc.loglike;
+      double prob = arc.prob;
       alpha_dash_arc(0) = alpha_dash(s_a, 0) + l(w_a, 0, true); // line 14.
       for (int32 q = 1; q <= Q; q++) { // this loop == lines 15-18.
         int32 r_q = r(q);
@@ -219,7 +211,7 @@ void MinimumBayesRisk::AccStats() {
       beta_dash_arc.SetZero(); // line 19.
       for (int32 q = Q; q >= 1; q--) {
         // line 21:
-        beta_dash_arc(q) += Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, q);
+        beta_dash_arc(q) += prob * beta_dash(n, q);
         switch (static_cast<int>(b_arc[q])) { // lines 22 and 23:
           case 1:
             beta_dash(s_a, q-1) += beta_dash_arc(q);
@@ -247,7 +239,7 @@ void MinimumBayesRisk::AccStats() {
             KALDI_ERR << "Invalid b_arc value"; // error in code.
         }
       }
-      beta_dash_arc(0) += Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, 0);
+      beta_dash_arc(0) += prob * beta_dash(n, 0);
       beta_dash(s_a, 0) += beta_dash_arc(0); // line 26.
     }
   }
@@ -337,12 +329,12 @@ void MinimumBayesRisk::PrepareLatticeAndInitStats(CompactLattice *clat) {
     state_times_[i] = state_times_[i-1];
 
   // Now we convert the information in "clat" into a special internal
-  // format (pre_, post_ and arcs_) which allows us to access the
-  // arcs preceding any given state.
+  // format (pre_ and arcs_) which allows us to access the arcs preceding any
+  // given state.
   // Note: in our internal format the states will be numbered from 1,
   // which involves adding 1 to the OpenFst states.
   int32 N = clat->NumStates();
-  pre_.resize(N+1);
+  std::vector<Arc> arcs;
 
   // Careful: "Arc" is a class-member struct, not an OpenFst type of arc as one
   // would normally assume.
@@ -359,11 +351,38 @@ void MinimumBayesRisk::PrepareLatticeAndInitStats(CompactLattice *clat) {
                        carc.weight.Weight().Value2());
       // loglike: sum graph/LM and acoustic cost, and negate to
       // convert to loglikes.  We assume acoustic scaling is already done.
-
-      pre_[arc.end_node].push_back(arcs_.size()); // record index of this arc.
-      arcs_.push_back(arc);
+      arc.prob = 0.0;  // set below.
+      arcs.push_back(arc);
     }
   }
+
+  // Sort the arcs on their end node, keeping the order of the arcs entering
+  // each node (a counting sort).
+  pre_.clear();
+  pre_.resize(N + 2, 0);
+  for (size_t i = 0; i < arcs.size(); i++)
+    pre_[arcs[i].end_node + 1]++;
+  for (int32 n = 1; n <= N; n++)
+    pre_[n + 1] += pre_[n];
+  std::vector<int32> next_arc(pre_.begin(), pre_.end() - 1);
+  arcs_.resize(arcs.size());
+  for (size_t i = 0; i < arcs.size(); i++)
+    arcs_[next_arc[arcs[i].end_node]++] = arcs[i];
+
+  // Work out the alphas (line 10 of Figure 4 of the paper), which do not
+  // depend on the hypothesis, and from them the probabilities of the arcs.
+  std::vector<double> alpha(N + 1, kLogZeroDouble); // index (1...N)
+  if (N > 0)
+    alpha[1] = 0.0;
+  for (int32 n = 2; n <= N; n++) {
+    double alpha_n = kLogZeroDouble;
+    for (int32 i = pre_[n]; i < pre_[n+1]; i++)
+      alpha_n = LogAdd(alpha_n, alpha[arcs_[i].start_node] + arcs_[i].loglike);
+    alpha[n] = alpha_n;
+    for (int32 i = pre_[n]; i < pre_[n+1]; i++)
+      arcs_[i].prob = Exp(alpha[arcs_[i].start_node] + arcs_[i].loglike -
+                          alpha_n);
+  }
 }
 
 MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in,
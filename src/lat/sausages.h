@@ -163,9 +163,10 @@ class MinimumBayesRisk {
   inline int32 r(int32 q) { return R_[q-1]; }
 
 
-  /// Figure 4 of the paper; called from AccStats (Fig. 5)
+  /// Figure 4 of the paper; called from AccStats (Fig. 5).  The alphas (line
+  /// 10) are not computed here: they do not depend on R_, so the arc
+  /// probabilities computed from them are in arcs_.
   double EditDistance(int32 N, int32 Q,
-                      Vector<double> &alpha,
                       Matrix<double> &alpha_dash,
                       Vector<double> &alpha_dash_arc);
 
@@ -202,6 +203,10 @@ class MinimumBayesRisk {
     int32 start_node;
     int32 end_node;
     BaseFloat loglike;
+    // The probability of the arc given that we are in its end node, i.e.
+    // Exp(alpha(start_node) + loglike - alpha(end_node)).  The alphas do not
+    // depend on the hypothesis, so this is worked out once.
+    double prob;
   };
 
   MinimumBayesRiskOptions opts_;
@@ -209,12 +214,14 @@ class MinimumBayesRisk {
 
   /// Arcs in the topologically sorted acceptor form of the word-level lattice,
   /// with one final-state.  Contains (word-symbol, log-likelihood on arc ==
-  /// negated cost).  Indexed from zero.
+  /// negated cost).  Indexed from zero, and sorted on the end node (and then
+  /// on the start node), so that the arcs entering each node are contiguous.
   std::vector<Arc> arcs_;
 
-  /// For each node in the lattice, a list of arcs entering that node. Indexed
-  /// from 1 (first node == 1).
-  std::vector<std::vector<int32> > pre_;
+  /// For each node n in the lattice, the arcs entering it are arcs_[pre_[n]]
+  /// ... arcs_[pre_[n+1] - 1].  Indexed from 1 (first node == 1), with
+  /// pre_[N+1] == arcs_.size().
+  std::vector<int32> pre_;
 
   std::vector<int32> state_times_; // time of each state in the word lattice,
   // indexed from 1 (same index as into pre_)
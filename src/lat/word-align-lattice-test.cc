@@ -0,0 +1,246 @@
+// lat/word-align-lattice-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <set>
+#include <sstream>
+
+#include "fstext/fstext-lib.h"
+#include "hmm/hmm-test-utils.h"
+#include "hmm/hmm-utils.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/word-align-lattice.h"
+
+namespace kaldi {
+
+// Sets up word-boundary information in which phones[0] is a non-word
+// (silence) phone and the other phones are in turn singleton, word-begin,
+// word-end and word-internal phones.  Outputs the phones of each type, indexed
+// by WordBoundaryInfo::PhoneType.
+void GenerateWordBoundaryInfo(const std::vector<int32> &phones,
+                              WordBoundaryInfo *info,
+                              std::vector<std::vector<int32> > *phones_of_type) {
+  KALDI_ASSERT(phones.size() >= 5);
+  const char *type_names[] = { "singleton", "begin", "end", "internal" };
+  WordBoundaryInfo::PhoneType types[] = {
+    WordBoundaryInfo::kWordBeginAndEndPhone, WordBoundaryInfo::kWordBeginPhone,
+    WordBoundaryInfo::kWordEndPhone, WordBoundaryInfo::kWordInternalPhone };
+  phones_of_type->clear();
+  phones_of_type->resize(WordBoundaryInfo::kNonWordPhone + 1);
+  std::ostringstream os;
+  os << phones[0] << " nonword\n";
+  (*phones_of_type)[WordBoundaryInfo::kNonWordPhone].push_back(phones[0]);
+  for (size_t i = 1; i < phones.size(); i++) {
+    os << phones[i] << ' ' << type_names[(i - 1) % 4] << '\n';
+    (*phones_of_type)[types[(i - 1) % 4]].push_back(phones[i]);
+  }
+  std::istringstream is(os.str());
+  info->Init(is);
+}
+
+// Generates a random word sequence with optional silences, and the
+// corresponding phone sequence; (*word_of_phone)[i] is the word whose first
+// phone is phone i, or zero.
+void GenerateWordsAndPhones(
+    const std::vector<std::vector<int32> > &phones_of_type,
+    std::vector<int32> *phone_seq,
+    std::vector<int32> *word_of_phone) {
+  phone_seq->clear();
+  word_of_phone->clear();
+  int32 num_words = RandInt(1, 4);
+  for (int32 i = 0; i <= num_words; i++) {
+    if (RandInt(0, 2) == 0) {  // optional silence.
+      const std::vector<int32> &sil =
+          phones_of_type[WordBoundaryInfo::kNonWordPhone];
+      phone_seq->push_back(sil[RandInt(0, sil.size() - 1)]);
+      word_of_phone->push_back(0);
+    }
+    if (i == num_words)
+      break;
+    std::vector<int32> pron;
+    if (RandInt(0, 1) == 0) {
+      pron.push_back(WordBoundaryInfo::kWordBeginAndEndPhone);
+    } else {
+      pron.push_back(WordBoundaryInfo::kWordBeginPhone);
+      int32 num_internal = RandInt(0, 2);
+      for (int32 j = 0; j < num_internal; j++)
+        pron.push_back(WordBoundaryInfo::kWordInternalPhone);
+      pron.push_back(WordBoundaryInfo::kWordEndPhone);
+    }
+    for (size_t j = 0; j < pron.size(); j++) {
+      const std::vector<int32> &p = phones_of_type[pron[j]];
+      phone_seq->push_back(p[RandInt(0, p.size() - 1)]);
+      word_of_phone->push_back(j == 0 ? RandInt(1, 100) : 0);
+    }
+  }
+}
+
+// Generates a lattice whose paths go from the start state to a shared final
+// state, each with the alignment of a random word sequence.  Each word label
+// is on the arc that has the first phone of the word; the arcs are cut at
+// phone boundaries, and some unlabeled arcs are merged with the previous arc.
+void GenerateWordLattice(
+    const ContextDependency &ctx_dep,
+    const TransitionModel &trans_model, bool reorder,
+    const std::vector<std::vector<int32> > &phones_of_type,
+    CompactLattice *clat) {
+  clat->DeleteStates();
+  clat->SetStart(clat->AddState());
+  std::vector<std::vector<CompactLatticeArc> > paths;
+  int32 num_paths = RandInt(1, 4);
+  for (int32 n = 0; n < num_paths; n++) {
+    std::vector<int32> phone_seq, word_of_phone, alignment;
+    GenerateWordsAndPhones(phones_of_type, &phone_seq, &word_of_phone);
+    GenerateRandomAlignment(ctx_dep, trans_model, reorder, phone_seq,
+                            &alignment);
+    std::vector<std::vector<int32> > split;
+    KALDI_ASSERT(SplitToPhones(trans_model, alignment, &split) &&
+                 split.size() == phone_seq.size());
+    std::vector<CompactLatticeArc> path;
+    for (size_t i = 0; i < split.size(); i++) {
+      if (word_of_phone[i] == 0 && !path.empty() && RandInt(0, 1) == 0) {
+        std::vector<int32> tids(path.back().weight.String());
+        tids.insert(tids.end(), split[i].begin(), split[i].end());
+        path.back().weight.SetString(tids);
+      } else {
+        LatticeWeight weight(RandUniform(), RandUniform());
+        path.push_back(CompactLatticeArc(word_of_phone[i], word_of_phone[i],
+                                         CompactLatticeWeight(weight, split[i]),
+                                         0));
+      }
+    }
+    paths.push_back(path);
+  }
+  // Add the states of each path (except the final state), then the final
+  // state, so the lattice is topologically sorted.
+  std::vector<int32> first_state(num_paths);
+  for (int32 n = 0; n < num_paths; n++) {
+    first_state[n] = clat->NumStates();
+    for (size_t i = 1; i < paths[n].size(); i++)
+      clat->AddState();
+  }
+  int32 final_state = clat->AddState();
+  clat->SetFinal(final_state, CompactLatticeWeight::One());
+  for (int32 n = 0; n < num_paths; n++) {
+    int32 cur_state = clat->Start();
+    for (size_t i = 0; i < paths[n].size(); i++) {
+      CompactLatticeArc arc(paths[n][i]);
+      arc.nextstate = (i + 1 == paths[n].size() ? final_state :
+                       first_state[n] + i);
+      clat->AddArc(cur_state, arc);
+      cur_state = arc.nextstate;
+    }
+  }
+}
+
+// Returns a copy of "clat" in which only states 0 .. num_frozen_states - 1
+// have arcs and final-probs, as if the rest were still to be decoded.
+void GetLatticePrefix(const CompactLattice &clat, int32 num_frozen_states,
+                      CompactLattice *prefix) {
+  *prefix = clat;
+  for (int32 s = num_frozen_states; s < prefix->NumStates(); s++) {
+    prefix->DeleteArcs(s);
+    prefix->SetFinal(s, CompactLatticeWeight::Zero());
+  }
+}
+
+typedef std::set<std::pair<int32, std::vector<int32> > > WordArcSet;
+
+void AddWordArcs(const std::vector<IncrementalWordAligner::WordArc> &arcs,
+                 WordArcSet *arc_set) {
+  for (size_t i = 0; i < arcs.size(); i++)
+    arc_set->insert(std::make_pair(arcs[i].arc.ilabel,
+                                   arcs[i].arc.weight.String()));
+}
+
+// Feeds a lattice to IncrementalWordAligner in growing frozen-state prefixes,
+// and checks that the word arcs it outputs and its aligned lattice agree with
+// WordAlignLattice().
+void TestIncrementalWordAligner() {
+  ContextDependency *ctx_dep;
+  TransitionModel *trans_model = GenRandTransitionModel(&ctx_dep);
+  while (trans_model->GetPhones().size() < 5) {
+    delete ctx_dep;
+    delete trans_model;
+    trans_model = GenRandTransitionModel(&ctx_dep);
+  }
+  bool reorder = (RandInt(0, 1) == 0);
+  WordBoundaryInfoNewOpts opts;
+  opts.reorder = reorder;
+  opts.silence_label = (RandInt(0, 1) == 0 ? 0 : 1000);
+  opts.partial_word_label = (RandInt(0, 1) == 0 ? 0 : 1001);
+  WordBoundaryInfo info(opts);
+  std::vector<std::vector<int32> > phones_of_type;
+  GenerateWordBoundaryInfo(trans_model->GetPhones(), &info, &phones_of_type);
+
+  CompactLattice clat;
+  GenerateWordLattice(*ctx_dep, *trans_model, reorder, phones_of_type, &clat);
+
+  CompactLattice ref_aligned_clat;
+  KALDI_ASSERT(WordAlignLattice(clat, *trans_model, info, 0,
+                                &ref_aligned_clat));
+  TestWordAlignedLattice(clat, *trans_model, info, ref_aligned_clat);
+  WordArcSet ref_arcs;
+  for (int32 s = 0; s < ref_aligned_clat.NumStates(); s++) {
+    for (fst::ArcIterator<CompactLattice> aiter(ref_aligned_clat, s);
+         !aiter.Done(); aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      ref_arcs.insert(std::make_pair(arc.ilabel, arc.weight.String()));
+    }
+  }
+
+  IncrementalWordAligner aligner(*trans_model, info);
+  aligner.Init();
+  WordArcSet arcs;
+  int32 num_frozen_states = 0;
+  while (num_frozen_states < clat.NumStates()) {
+    CompactLattice prefix;
+    GetLatticePrefix(clat, num_frozen_states, &prefix);
+    aligner.AdvanceAlignment(prefix, num_frozen_states);
+    AddWordArcs(aligner.NewWordArcs(), &arcs);
+    CompactLattice partial_aligned_clat;
+    KALDI_ASSERT(aligner.GetAlignedLattice(&partial_aligned_clat));
+    num_frozen_states += RandInt(1, 3);
+  }
+  KALDI_ASSERT(aligner.FinalizeAlignment(clat));
+  AddWordArcs(aligner.NewWordArcs(), &arcs);
+  KALDI_ASSERT(arcs == ref_arcs);
+
+  CompactLattice aligned_clat;
+  KALDI_ASSERT(aligner.GetAlignedLattice(&aligned_clat));
+  KALDI_ASSERT(fst::RandEquivalent(aligned_clat, ref_aligned_clat, 5, 0.001,
+                                   Rand(), 10));
+
+  // The aligner can be reused for another lattice after Init().
+  aligner.Init();
+  aligner.AdvanceAlignment(clat, clat.NumStates());
+  KALDI_ASSERT(aligner.FinalizeAlignment(clat));
+  CompactLattice aligned_clat2;
+  KALDI_ASSERT(aligner.GetAlignedLattice(&aligned_clat2));
+  KALDI_ASSERT(fst::RandEquivalent(aligned_clat2, ref_aligned_clat, 5, 0.001,
+                                   Rand(), 10));
+
+  delete ctx_dep;
+  delete trans_model;
+}
+
+} // end namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 10; i++)
+    kaldi::TestIncrementalWordAligner();
+  std::cout << "Tests succeeded\n";
+}
@@ -730,6 +730,240 @@ bool WordAlignLattice(const CompactLattice &lat,
 }
 
 
+// This class does the work of IncrementalWordAligner.  It does the same
+// computation as LatticeWordAligner, but it does not own the input lattice,
+// which grows between calls.  Instead of the super-final state that
+// LatticeWordAligner creates with CreateSuperFinal(), tuples whose input state
+// is kSuperFinal represent the paths that have taken a final-prob.
+class IncrementalWordAlignerImpl {
+ public:
+  typedef CompactLatticeArc::StateId StateId;
+  typedef LatticeWordAligner::ComputationState ComputationState;
+  typedef LatticeWordAligner::Tuple Tuple;
+  typedef LatticeWordAligner::MapType MapType;
+  typedef IncrementalWordAligner::WordArc WordArc;
+
+  // kTempSilenceLabel and kTempPartialWordLabel are used instead of
+  // zero silence and partial-word labels, for the same reason as in
+  // LatticeWordAligner; we can't use HighestNumberedOutputSymbol() as we don't
+  // see the whole lattice in advance, so we use labels far above any word
+  // label.
+  enum { kSuperFinal = -2, kTempSilenceLabel = 2000000000,
+         kTempPartialWordLabel = 2000000001 };
+
+  IncrementalWordAlignerImpl(const TransitionModel &tmodel,
+                             const WordBoundaryInfo &info):
+      tmodel_(tmodel), info_in_(info), info_(info) {
+    if (info_.silence_label == 0)
+      info_.silence_label = kTempSilenceLabel;
+    if (info_.partial_word_label == 0)
+      info_.partial_word_label = kTempPartialWordLabel;
+    Init();
+  }
+
+  void Init() {
+    lat_out_.DeleteStates();
+    state_times_.clear();
+    map_.clear();
+    queue_.clear();
+    pending_.clear();
+    new_arcs_.clear();
+    num_frozen_states_ = 0;
+    error_ = false;
+  }
+
+  void AdvanceAlignment(const CompactLattice &lat, int32 num_frozen_states) {
+    new_arcs_.clear();
+    if (lat.Start() == fst::kNoStateId)
+      return;  // Nothing has been decoded yet.
+    KALDI_ASSERT(num_frozen_states >= num_frozen_states_ &&
+                 num_frozen_states <= lat.NumStates());
+    num_frozen_states_ = num_frozen_states;
+    if (lat_out_.Start() == fst::kNoStateId) {
+      Tuple initial_tuple(lat.Start(), ComputationState());
+      lat_out_.SetStart(GetStateForTuple(initial_tuple, 0));
+    } else {
+      // Move the tuples whose input state has become frozen to the queue.
+      std::vector<std::pair<Tuple, StateId> > pending;
+      pending.swap(pending_);
+      for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i].first.input_state < num_frozen_states_)
+          queue_.push_back(pending[i]);
+        else
+          pending_.push_back(pending[i]);
+      }
+    }
+    while (!queue_.empty())
+      ProcessQueueElement(lat);
+  }
+
+  bool FinalizeAlignment(const CompactLattice &lat) {
+    if (lat.Start() == fst::kNoStateId) {
+      KALDI_WARN << "Trying to word-align empty lattice.";
+      new_arcs_.clear();
+      return false;
+    }
+    AdvanceAlignment(lat, lat.NumStates());
+    KALDI_ASSERT(pending_.empty());
+    return !error_;
+  }
+
+  const std::vector<WordArc> &NewWordArcs() const { return new_arcs_; }
+
+  bool GetAlignedLattice(CompactLattice *lat_out) const {
+    *lat_out = lat_out_;
+    // Let the paths end where the alignment has got to; after
+    // FinalizeAlignment() there will be no such states.
+    for (size_t i = 0; i < pending_.size(); i++)
+      lat_out->SetFinal(pending_[i].second, CompactLatticeWeight::One());
+    // This is as LatticeWordAligner::RemoveEpsilonsFromLattice().
+    RmEpsilon(lat_out, true);  // true = connect.
+    std::vector<int32> syms_to_remove;
+    if (info_in_.partial_word_label == 0)
+      syms_to_remove.push_back(info_.partial_word_label);
+    if (info_in_.silence_label == 0)
+      syms_to_remove.push_back(info_.silence_label);
+    if (!syms_to_remove.empty()) {
+      RemoveSomeInputSymbols(syms_to_remove, lat_out);
+      Project(lat_out, fst::PROJECT_INPUT);
+    }
+    return !error_;
+  }
+
+ private:
+  // "time" is the number of frames of the word arcs on the way to this state.
+  StateId GetStateForTuple(const Tuple &tuple, int32 time) {
+    MapType::iterator iter = map_.find(tuple);
+    if (iter != map_.end())
+      return iter->second;
+    StateId output_state = lat_out_.AddState();
+    map_[tuple] = output_state;
+    state_times_.push_back(time);
+    // Tuples whose input state may still change have to wait.
+    if (tuple.input_state == kSuperFinal ||
+        tuple.input_state < num_frozen_states_)
+      queue_.push_back(std::make_pair(tuple, output_state));
+    else
+      pending_.push_back(std::make_pair(tuple, output_state));
+    return output_state;
+  }
+
+  void AddWordArc(StateId output_state, const CompactLatticeArc &arc) {
+    KALDI_ASSERT(output_state != arc.nextstate);
+    lat_out_.AddArc(output_state, arc);
+    WordArc word_arc;
+    word_arc.src_state = output_state;
+    word_arc.begin_frame = state_times_[output_state];
+    word_arc.arc = arc;
+    if ((info_in_.silence_label == 0 && arc.ilabel == info_.silence_label) ||
+        (info_in_.partial_word_label == 0 &&
+         arc.ilabel == info_.partial_word_label))
+      word_arc.arc.ilabel = word_arc.arc.olabel = 0;
+    new_arcs_.push_back(word_arc);
+  }
+
+  // Adds the epsilon arc that follows input arc "arc" from the tuple.
+  void AdvanceTuple(const Tuple &tuple, StateId output_state,
+                    const CompactLatticeArc &arc) {
+    Tuple next_tuple(tuple);
+    LatticeWeight weight;
+    next_tuple.comp_state.Advance(arc, &weight);
+    next_tuple.input_state = arc.nextstate;
+    StateId next_output_state = GetStateForTuple(next_tuple,
+                                                 state_times_[output_state]);
+    KALDI_ASSERT(next_output_state != output_state);
+    lat_out_.AddArc(output_state,
+                    CompactLatticeArc(0, 0,
+                        CompactLatticeWeight(weight, std::vector<int32>()),
+                        next_output_state));
+  }
+
+  // This is as LatticeWordAligner::ProcessQueueElement(), with the
+  // final-probs of the input lattice treated as arcs to kSuperFinal.
+  void ProcessQueueElement(const CompactLattice &lat) {
+    KALDI_ASSERT(!queue_.empty());
+    Tuple tuple = queue_.back().first;
+    StateId output_state = queue_.back().second;
+    queue_.pop_back();
+    int32 time = state_times_[output_state];
+
+    CompactLatticeArc lat_arc;
+    if (tuple.comp_state.OutputArc(info_, tmodel_, &lat_arc, &error_)) {
+      // note: this function changes the tuple (when it returns true).
+      lat_arc.nextstate = GetStateForTuple(
+          tuple, time + lat_arc.weight.String().size());
+      AddWordArc(output_state, lat_arc);
+    } else if (tuple.input_state == kSuperFinal) {
+      // This is as LatticeWordAligner::ProcessFinal().
+      if (tuple.comp_state.IsEmpty()) {
+        std::vector<int32> empty_vec;
+        CompactLatticeWeight cw(tuple.comp_state.FinalWeight(), empty_vec);
+        lat_out_.SetFinal(output_state,
+                          Plus(lat_out_.Final(output_state), cw));
+      } else {
+        tuple.comp_state.OutputArcForce(info_, tmodel_, &lat_arc, &error_);
+        lat_arc.nextstate = GetStateForTuple(
+            tuple, time + lat_arc.weight.String().size());
+        AddWordArc(output_state, lat_arc);
+      }
+    } else {
+      for (fst::ArcIterator<CompactLattice> aiter(lat, tuple.input_state);
+           !aiter.Done(); aiter.Next())
+        AdvanceTuple(tuple, output_state, aiter.Value());
+      const CompactLatticeWeight &final_weight = lat.Final(tuple.input_state);
+      if (final_weight != CompactLatticeWeight::Zero())
+        AdvanceTuple(tuple, output_state,
+                     CompactLatticeArc(0, 0, final_weight, kSuperFinal));
+    }
+  }
+
+  const TransitionModel &tmodel_;
+  const WordBoundaryInfo &info_in_;
+  WordBoundaryInfo info_;
+
+  // The output lattice so far, with epsilon arcs (as in LatticeWordAligner).
+  CompactLattice lat_out_;
+  // The frame at which each state of lat_out_ is reached.
+  std::vector<int32> state_times_;
+  MapType map_;  // map from tuples to StateId.
+  // The tuples to be processed.
+  std::vector<std::pair<Tuple, StateId> > queue_;
+  // The tuples that are waiting for their input states to become frozen.
+  std::vector<std::pair<Tuple, StateId> > pending_;
+  // The word arcs output by the most recent call.
+  std::vector<WordArc> new_arcs_;
+  int32 num_frozen_states_;
+  bool error_;
+};
+
+
+IncrementalWordAligner::IncrementalWordAligner(const TransitionModel &tmodel,
+                                               const WordBoundaryInfo &info):
+    impl_(new IncrementalWordAlignerImpl(tmodel, info)) { }
+
+void IncrementalWordAligner::Init() { impl_->Init(); }
+
+void IncrementalWordAligner::AdvanceAlignment(const CompactLattice &lat,
+                                              int32 num_frozen_states) {
+  impl_->AdvanceAlignment(lat, num_frozen_states);
+}
+
+bool IncrementalWordAligner::FinalizeAlignment(const CompactLattice &lat) {
+  return impl_->FinalizeAlignment(lat);
+}
+
+const std::vector<IncrementalWordAligner::WordArc>&
+IncrementalWordAligner::NewWordArcs() const {
+  return impl_->NewWordArcs();
+}
+
+bool IncrementalWordAligner::GetAlignedLattice(CompactLattice *lat_out) const {
+  return impl_->GetAlignedLattice(lat_out);
+}
+
+IncrementalWordAligner::~IncrementalWordAligner() { delete impl_; }
+
+
 
 class WordAlignedLatticeTester {
  public:
@@ -195,6 +195,87 @@ bool WordAlignLattice(const CompactLattice &lat,
                       CompactLattice *lat_out);
 
 
+class IncrementalWordAlignerImpl;  // Forward decl; defined in a .cc file
+
+/**
+   IncrementalWordAligner does the same computation as WordAlignLattice(), but
+   for a lattice that grows as decoding proceeds, such as the one produced by
+   LatticeIncrementalDecoder (see LatticeIncrementalDeterminizer).  It keeps the
+   state of the alignment between calls, so the work done by each call is
+   proportional to the part of the lattice that is new since the last call,
+   rather than to the length of the utterance.
+
+   The caller says how much of the lattice is "frozen": a number n such that
+   states 0 .. n-1 of the lattice (their arcs, including the arcs' weights and
+   destination-states, and their final-probs) will not change any more.  For
+   LatticeIncrementalDecoder this is NumFrozenLatticeStates().  Only the part of
+   the lattice reachable through frozen states is aligned; words that extend
+   past it are aligned on a later call.
+
+   Typical usage, for each utterance:
+     aligner.Init();
+     while (decoding) {
+        ... decoder.GetLattice(...)
+        aligner.AdvanceAlignment(decoder.GetLattice(...),
+                                 decoder.NumFrozenLatticeStates());
+        ... use aligner.NewWordArcs()
+     }
+     aligner.FinalizeAlignment(decoder.GetLattice(num_frames, true));
+     aligner.GetAlignedLattice(&aligned_clat);
+*/
+class IncrementalWordAligner {
+ public:
+  /// An arc of the word-aligned lattice: a word, or silence (info.silence_label)
+  /// or a partial word (info.partial_word_label), with its transition-ids.
+  struct WordArc {
+    CompactLatticeArc::StateId src_state;  // the source state; this and
+                                           // arc.nextstate are states of the
+                                           // (not yet epsilon-removed) aligned
+                                           // lattice, and are only useful to
+                                           // link arcs together.
+    int32 begin_frame;  // The frame at which the word begins.
+    CompactLatticeArc arc;  // arc.ilabel == arc.olabel is the word label;
+                            // arc.weight.String() are its transition-ids.
+  };
+
+  /// Note: the objects must remain in existence while this object does.
+  IncrementalWordAligner(const TransitionModel &tmodel,
+                         const WordBoundaryInfo &info);
+
+  /// Resets the object for a new utterance.  Must also be called if the
+  /// lattice was reset, e.g. because LatticeIncrementalDeterminizer failed.
+  void Init();
+
+  /// Aligns the part of "lat" that has become available since the last call:
+  /// states 0 .. num_frozen_states - 1 must not change after this call (and
+  /// num_frozen_states must not be less than on the previous call).  After
+  /// this, NewWordArcs() returns the arcs that were output.
+  void AdvanceAlignment(const CompactLattice &lat, int32 num_frozen_states);
+
+  /// To be called when the lattice is complete, e.g. with the output of
+  /// LatticeIncrementalDecoder::GetLattice() with use_final_probs = true at
+  /// the end of the utterance.  Aligns the rest of the lattice.  Returns false
+  /// if an error was detected (see WordAlignLattice()).
+  bool FinalizeAlignment(const CompactLattice &lat);
+
+  /// Returns the word arcs output by the most recent call to
+  /// AdvanceAlignment() or FinalizeAlignment().
+  const std::vector<WordArc> &NewWordArcs() const;
+
+  /// Outputs the word-aligned lattice of the part of the lattice aligned so
+  /// far; after FinalizeAlignment() this is the same as the output of
+  /// WordAlignLattice() on the complete lattice (before that, the paths end
+  /// where the alignment has got to, and words still in progress are not
+  /// included).  Note: this takes time proportional to the whole lattice.
+  /// Returns false if an error was detected.
+  bool GetAlignedLattice(CompactLattice *lat_out) const;
+
+  ~IncrementalWordAligner();
+ private:
+  IncrementalWordAlignerImpl *impl_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(IncrementalWordAligner);
+};
+
 
 /// This function is designed to crash if something went wrong with the
 /// word-alignment of the lattice.  It verifies
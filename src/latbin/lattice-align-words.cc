@@ -20,9 +20,72 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "lat/compact-lattice-task.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/word-align-lattice.h"
 #include "lat/lattice-functions.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// Word-aligns one lattice; the lattices are aligned in parallel by
+// TaskSequencer, and written, in order, from the destructor.
+class AlignWordsTask: public CompactLatticeTask {
+ public:
+  // Takes ownership of "clat".
+  AlignWordsTask(const TransitionModel &tmodel, const WordBoundaryInfo &info,
+                 BaseFloat max_expand, bool output_if_error, bool do_test,
+                 const std::string &key, CompactLattice *clat,
+                 CompactLatticeWriter *clat_writer,
+                 int32 *num_done, int32 *num_err):
+      CompactLatticeTask(key, clat, clat_writer, num_done, num_err),
+      tmodel_(tmodel), info_(info), max_expand_(max_expand),
+      output_if_error_(output_if_error), do_test_(do_test) { }
+
+ protected:
+  virtual bool Process(CompactLattice *clat, CompactLattice *clat_out) {
+    int32 max_states;
+    if (max_expand_ > 0) max_states = 1000 + max_expand_ * clat->NumStates();
+    else max_states = 0;
+
+    bool ok = WordAlignLattice(*clat, tmodel_, info_, max_states, clat_out);
+
+    if (do_test_ && ok)
+      TestWordAlignedLattice(*clat, tmodel_, info_, *clat_out);
+
+    if (clat_out->Start() != fst::kNoStateId)
+      TopSortCompactLatticeIfNeeded(clat_out);
+
+    if (!ok) {
+      if (!output_if_error_) {
+        KALDI_WARN << "Lattice for " << Key()
+                   << " did not align correctly, producing no output.";
+        clat_out->DeleteStates();
+      } else if (clat_out->Start() != fst::kNoStateId) {
+        KALDI_WARN << "Outputting partial lattice for " << Key();
+      } else {
+        KALDI_WARN << "Empty aligned lattice for " << Key()
+                   << ", producing no output.";
+      }
+      return false;
+    }
+    if (clat_out->Start() == fst::kNoStateId) {
+      KALDI_WARN << "Lattice was empty for key " << Key();
+      return false;
+    }
+    KALDI_VLOG(2) << "Aligned lattice for " << Key();
+    return true;
+  }
+
+ private:
+  const TransitionModel &tmodel_;
+  const WordBoundaryInfo &info_;
+  BaseFloat max_expand_;
+  bool output_if_error_;
+  bool do_test_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -46,6 +109,7 @@ int main(int argc, char *argv[]) {
     BaseFloat max_expand = 0.0;
     bool output_if_error = true;
     bool do_test = false;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     
     po.Register("output-error-lats", &output_if_error, "Output lattices that aligned "
                 "with errors (e.g. due to force-out");
@@ -57,6 +121,7 @@ int main(int argc, char *argv[]) {
     
     WordBoundaryInfoNewOpts opts;
     opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -81,46 +146,18 @@ int main(int argc, char *argv[]) {
     
     int32 num_done = 0, num_err = 0;
     
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      const CompactLattice &clat = clat_reader.Value();
-
-      CompactLattice aligned_clat;
-      int32 max_states;
-      if (max_expand > 0) max_states = 1000 + max_expand * clat.NumStates();
-      else max_states = 0;
-      
-      bool ok = WordAlignLattice(clat, tmodel, info, max_states, &aligned_clat);
-      
-      if (do_test && ok)
-        TestWordAlignedLattice(clat, tmodel, info, aligned_clat);
-
-      if (!ok) {
-        num_err++;
-        if (!output_if_error)
-          KALDI_WARN << "Lattice for " << key
-                     << " did not align correctly, producing no output.";
-        else {
-          if (aligned_clat.Start() != fst::kNoStateId) {
-            KALDI_WARN << "Outputting partial lattice for " << key;
-            TopSortCompactLatticeIfNeeded(&aligned_clat);
-            clat_writer.Write(key, aligned_clat);
-          } else {
-            KALDI_WARN << "Empty aligned lattice for " << key
-                       << ", producing no output.";
-          }
-        }
-      } else {
-        if (aligned_clat.Start() == fst::kNoStateId) {
-          num_err++;
-          KALDI_WARN << "Lattice was empty for key " << key;
-        } else {
-          num_done++;
-          KALDI_VLOG(2) << "Aligned lattice for " << key;
-          TopSortCompactLatticeIfNeeded(&aligned_clat);
-          clat_writer.Write(key, aligned_clat);
-        }
+    {
+      TaskSequencer<AlignWordsTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        // Will give ownership to the task.
+        CompactLattice *clat = clat_reader.Value().Copy();
+        clat_reader.FreeCurrent();
+        sequencer.Run(new AlignWordsTask(tmodel, info, max_expand,
+                                         output_if_error, do_test, key, clat,
+                                         &clat_writer, &num_done, &num_err));
       }
+      sequencer.Wait();
     }
     KALDI_LOG << "Successfully aligned " << num_done << " lattices; "
               << num_err << " had errors.";
@@ -20,10 +20,76 @@
 
 #include "base/kaldi-common.h"
 #include "fstext/fstext-lib.h"
+#include "lat/compact-lattice-task.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "lm/const-arpa-lm.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// Rescores one lattice; the lattices are rescored in parallel by
+// TaskSequencer, and written, in order, from the destructor.
+class LmRescoreConstArpaTask: public CompactLatticeTask {
+ public:
+  // Takes ownership of "clat".  "lm_cache" may be NULL.
+  LmRescoreConstArpaTask(const ConstArpaLm &const_arpa,
+                         ConstArpaLmCache *lm_cache,
+                         BaseFloat lm_scale,
+                         const std::string &key,
+                         CompactLattice *clat,
+                         CompactLatticeWriter *clat_writer,
+                         int32 *num_done, int32 *num_fail):
+      CompactLatticeTask(key, clat, clat_writer, num_done, num_fail),
+      const_arpa_(const_arpa), lm_cache_(lm_cache), lm_scale_(lm_scale) { }
+
+ protected:
+  virtual bool Process(CompactLattice *clat, CompactLattice *clat_out) {
+    if (lm_scale_ == 0.0) {
+      // Zero scale so nothing to do.
+      *clat_out = *clat;
+      return true;
+    }
+    // Before composing with the LM FST, we scale the lattice weights
+    // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
+    // We do it this way so we can determinize and it will give the
+    // right effect (taking the "best path" through the LM) regardless
+    // of the sign of lm_scale.
+    fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale_), clat);
+    ArcSort(clat, fst::OLabelCompare<CompactLatticeArc>());
+
+    // Wraps the ConstArpaLm format language model into FST. We re-create it
+    // for each lattice to prevent memory usage increasing with time; the
+    // cache, if any, is what carries over between lattices.
+    ConstArpaLmDeterministicFst const_arpa_fst(const_arpa_, lm_cache_);
+
+    // Composes lattice with language model.
+    CompactLattice composed_clat;
+    ComposeCompactLatticeDeterministic(*clat,
+                                       &const_arpa_fst, &composed_clat);
+
+    // Determinizes the composed lattice.
+    Lattice composed_lat;
+    ConvertLattice(composed_clat, &composed_lat);
+    Invert(&composed_lat);
+    DeterminizeLattice(composed_lat, clat_out);
+    fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_), clat_out);
+    if (clat_out->Start() == fst::kNoStateId) {
+      KALDI_WARN << "Empty lattice for utterance " << Key()
+                 << " (incompatible LM?)";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  const ConstArpaLm &const_arpa_;
+  ConstArpaLmCache *lm_cache_;
+  BaseFloat lm_scale_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -45,9 +111,20 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     BaseFloat lm_scale = 1.0;
+    bool mmap_lm = false;
+    int32 lm_cache_size = 0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
+    po.Register("mmap-lm", &mmap_lm, "If true, map the language model into "
+                "memory instead of reading it, so that processes using the "
+                "same LM share one copy.  Requires an LM written by "
+                "arpa-to-const-arpa --page-align=true, in a file.");
+    po.Register("lm-cache-size", &lm_cache_size, "If positive, the number of "
+                "LM lookups (history, word) to cache across lattices; only "
+                "useful if LM lookups are slow, e.g. for a memory-mapped LM.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -62,58 +139,39 @@ int main(int argc, char *argv[]) {
 
     // Reads the language model in ConstArpaLm format.
     ConstArpaLm const_arpa;
-    ReadKaldiObject(lm_rxfilename, &const_arpa);
+    if (mmap_lm)
+      const_arpa.ReadMapped(lm_rxfilename);
+    else
+      ReadKaldiObject(lm_rxfilename, &const_arpa);
+    ConstArpaLmCache *lm_cache = NULL;
+    if (lm_cache_size > 0)
+      lm_cache = new ConstArpaLmCache(lm_cache_size);
 
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
     int32 n_done = 0, n_fail = 0;
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-
-      if (lm_scale != 0.0) {
-        // Before composing with the LM FST, we scale the lattice weights
-        // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
-        // We do it this way so we can determinize and it will give the
-        // right effect (taking the "best path" through the LM) regardless
-        // of the sign of lm_scale.
-        fst::ScaleLattice(fst::GraphLatticeScale(1.0/lm_scale), &clat);
-        ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
-
-        // Wraps the ConstArpaLm format language model into FST. We re-create it
-        // for each lattice to prevent memory usage increasing with time.
-        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
-
-        // Composes lattice with language model.
-        CompactLattice composed_clat;
-        ComposeCompactLatticeDeterministic(clat,
-                                           &const_arpa_fst, &composed_clat);
-
-        // Determinizes the composed lattice.
-        Lattice composed_lat;
-        ConvertLattice(composed_clat, &composed_lat);
-        Invert(&composed_lat);
-        CompactLattice determinized_clat;
-        DeterminizeLattice(composed_lat, &determinized_clat);
-        fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), &determinized_clat);
-        if (determinized_clat.Start() == fst::kNoStateId) {
-          KALDI_WARN << "Empty lattice for utterance " << key
-              << " (incompatible LM?)";
-          n_fail++;
-        } else {
-          compact_lattice_writer.Write(key, determinized_clat);
-          n_done++;
-        }
-      } else {
-        // Zero scale so nothing to do.
-        n_done++;
-        compact_lattice_writer.Write(key, clat);
+    {
+      // The tasks share the (read-only) LM and the cache, which is
+      // thread-safe.
+      TaskSequencer<LmRescoreConstArpaTask> sequencer(sequencer_config);
+      for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+        std::string key = compact_lattice_reader.Key();
+        // Will give ownership to the task.
+        CompactLattice *clat = compact_lattice_reader.Value().Copy();
+        compact_lattice_reader.FreeCurrent();
+        sequencer.Run(new LmRescoreConstArpaTask(
+            const_arpa, lm_cache, lm_scale, key, clat, &compact_lattice_writer,
+            &n_done, &n_fail));
       }
+      sequencer.Wait();
     }
 
+    if (lm_cache != NULL) {
+      lm_cache->PrintStats();
+      delete lm_cache;
+    }
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
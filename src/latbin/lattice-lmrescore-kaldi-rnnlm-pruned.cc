@@ -25,9 +25,110 @@
 #include "lm/const-arpa-lm.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-utils.h"
+#include "lat/compact-lattice-task.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "lat/compose-lattice-pruned.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// Rescores one lattice; the lattices are rescored in parallel by
+// TaskSequencer, and written, in order, from the destructor.  Each task
+// creates its own on-demand LM FSTs, since those are not thread-safe; the
+// old LM and the RNNLM themselves are shared.
+class RnnlmRescorePrunedTask: public CompactLatticeTask {
+ public:
+  // Takes ownership of "clat".  Exactly one of "const_arpa" and
+  // "lm_to_subtract_fst" is non-NULL; "lm_cache" may be NULL.
+  RnnlmRescorePrunedTask(const ComposeLatticePrunedOptions &compose_opts,
+                         BaseFloat lm_scale, BaseFloat acoustic_scale,
+                         int32 max_ngram_order, int32 max_rnnlm_states,
+                         const rnnlm::RnnlmComputeStateInfo &info,
+                         const fst::StdVectorFst *lm_to_subtract_fst,
+                         const ConstArpaLm *const_arpa,
+                         ConstArpaLmCache *lm_cache,
+                         const std::string &key, CompactLattice *clat,
+                         CompactLatticeWriter *clat_writer,
+                         int32 *num_done, int32 *num_err,
+                         int64 *num_states_computed,
+                         int64 *num_states_recomputed):
+      CompactLatticeTask(key, clat, clat_writer, num_done, num_err),
+      compose_opts_(compose_opts), lm_scale_(lm_scale),
+      acoustic_scale_(acoustic_scale), max_ngram_order_(max_ngram_order),
+      max_rnnlm_states_(max_rnnlm_states), info_(info),
+      lm_to_subtract_fst_(lm_to_subtract_fst), const_arpa_(const_arpa),
+      lm_cache_(lm_cache), num_states_computed_(num_states_computed),
+      num_states_recomputed_(num_states_recomputed),
+      states_computed_(0), states_recomputed_(0) { }
+
+  ~RnnlmRescorePrunedTask() {
+    *num_states_computed_ += states_computed_;
+    *num_states_recomputed_ += states_recomputed_;
+  }
+
+ protected:
+  virtual bool Process(CompactLattice *clat, CompactLattice *clat_out) {
+    using fst::StdArc;
+    if (acoustic_scale_ != 1.0) {
+      fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale_), clat);
+    }
+    TopSortCompactLatticeIfNeeded(clat);
+
+    fst::DeterministicOnDemandFst<StdArc> *lm_to_subtract_orig;
+    if (const_arpa_ != NULL)
+      lm_to_subtract_orig = new ConstArpaLmDeterministicFst(*const_arpa_,
+                                                            lm_cache_);
+    else
+      lm_to_subtract_orig = new fst::BackoffDeterministicOnDemandFst<StdArc>(
+          *lm_to_subtract_fst_);
+    fst::ScaleDeterministicOnDemandFst lm_to_subtract(-lm_scale_,
+                                                      lm_to_subtract_orig);
+
+    rnnlm::KaldiRnnlmDeterministicFst lm_to_add_orig(max_ngram_order_, info_,
+                                                     max_rnnlm_states_);
+    fst::ScaleDeterministicOnDemandFst lm_to_add(lm_scale_, &lm_to_add_orig);
+
+    fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
+        &lm_to_subtract, &lm_to_add);
+
+    // Composes lattice with language model.
+    ComposeCompactLatticePruned(compose_opts_, *clat,
+                                &combined_lms, clat_out);
+    states_computed_ = lm_to_add_orig.NumStatesComputed();
+    states_recomputed_ = lm_to_add_orig.NumStatesRecomputed();
+    delete lm_to_subtract_orig;
+
+    if (clat_out->NumStates() == 0) {
+      // Something went wrong.  A warning will already have been printed.
+      return false;
+    }
+    if (acoustic_scale_ != 1.0) {
+      if (acoustic_scale_ == 0.0)
+        KALDI_ERR << "Acoustic scale cannot be zero.";
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                        clat_out);
+    }
+    return true;
+  }
+
+ private:
+  const ComposeLatticePrunedOptions &compose_opts_;
+  BaseFloat lm_scale_;
+  BaseFloat acoustic_scale_;
+  int32 max_ngram_order_;
+  int32 max_rnnlm_states_;
+  const rnnlm::RnnlmComputeStateInfo &info_;
+  const fst::StdVectorFst *lm_to_subtract_fst_;
+  const ConstArpaLm *const_arpa_;
+  ConstArpaLmCache *lm_cache_;
+  int64 *num_states_computed_;
+  int64 *num_states_recomputed_;
+  int64 states_computed_;
+  int64 states_recomputed_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -65,6 +166,9 @@ int main(int argc, char *argv[]) {
     BaseFloat lm_scale = 0.5;
     BaseFloat acoustic_scale = 0.1;
     bool use_carpa = false;
+    int32 max_rnnlm_states = 0;
+    int32 lm_cache_size = 0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for <lm-to-add>; its negative "
                 "will be applied to <lm-to-subtract>.");
@@ -77,9 +181,18 @@ int main(int argc, char *argv[]) {
         "saves time and reduces output lattice size).");
     po.Register("use-const-arpa", &use_carpa, "If true, read the old-LM file "
                 "as a const-arpa file as opposed to an FST file");
+    po.Register("max-rnnlm-states", &max_rnnlm_states, "If positive, the "
+                "maximum number of RNNLM states to keep in memory per lattice; "
+                "states that are needed again after being freed are recomputed, "
+                "so this limits memory use without changing the output.");
+    po.Register("lm-cache-size", &lm_cache_size, "If positive (and "
+                "--use-const-arpa=true), the number of lookups of the old LM "
+                "to cache across lattices (only useful if LM lookups are "
+                "slow).");
 
     opts.Register(&po);
     compose_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -101,31 +214,20 @@ int main(int argc, char *argv[]) {
     lats_rspecifier = po.GetArg(4);
     lats_wspecifier = po.GetArg(5);
 
-    // for G.fst
-    fst::ScaleDeterministicOnDemandFst *lm_to_subtract_det_scale = NULL;
-    fst::BackoffDeterministicOnDemandFst<StdArc> *lm_to_subtract_det_backoff = NULL;
+    // Exactly one of these is used, depending on --use-const-arpa.
     VectorFst<StdArc> *lm_to_subtract_fst = NULL;
-
-    // for G.carpa
-    ConstArpaLm* const_arpa = NULL;
-    fst::DeterministicOnDemandFst<StdArc> *carpa_lm_to_subtract_fst = NULL;
+    ConstArpaLm *const_arpa = NULL;
+    ConstArpaLmCache *lm_cache = NULL;
 
     KALDI_LOG << "Reading old LMs...";
     if (use_carpa) {
       const_arpa = new ConstArpaLm();
       ReadKaldiObject(lm_to_subtract_rxfilename, const_arpa);
-      carpa_lm_to_subtract_fst = new ConstArpaLmDeterministicFst(*const_arpa);
-      lm_to_subtract_det_scale
-        = new fst::ScaleDeterministicOnDemandFst(-lm_scale,
-                                                 carpa_lm_to_subtract_fst);
+      if (lm_cache_size > 0)
+        lm_cache = new ConstArpaLmCache(lm_cache_size);
     } else {
       lm_to_subtract_fst = fst::ReadAndPrepareLmFst(
           lm_to_subtract_rxfilename);
-      lm_to_subtract_det_backoff =
-        new fst::BackoffDeterministicOnDemandFst<StdArc>(*lm_to_subtract_fst);
-      lm_to_subtract_det_scale =
-           new fst::ScaleDeterministicOnDemandFst(-lm_scale,
-                                                  lm_to_subtract_det_backoff);
     }
 
     kaldi::nnet3::Nnet rnnlm;
@@ -143,61 +245,32 @@ int main(int argc, char *argv[]) {
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
     int32 num_done = 0, num_err = 0;
-
-    rnnlm::KaldiRnnlmDeterministicFst* lm_to_add_orig = 
-         new rnnlm::KaldiRnnlmDeterministicFst(max_ngram_order, info);
-
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      fst::DeterministicOnDemandFst<StdArc> *lm_to_add =
-         new fst::ScaleDeterministicOnDemandFst(lm_scale, lm_to_add_orig);
-
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-
-      // Before composing with the LM FST, we scale the lattice weights
-      // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
-      // We do it this way so we can determinize and it will give the
-      // right effect (taking the "best path" through the LM) regardless
-      // of the sign of lm_scale.
-      if (acoustic_scale != 1.0) {
-        fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
-      }
-      TopSortCompactLatticeIfNeeded(&clat);
-
-      fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
-          lm_to_subtract_det_scale, lm_to_add);
-
-      // Composes lattice with language model.
-      CompactLattice composed_clat;
-      ComposeCompactLatticePruned(compose_opts, clat,
-                                  &combined_lms, &composed_clat);
-
-      lm_to_add_orig->Clear();
-
-      if (composed_clat.NumStates() == 0) {
-        // Something went wrong.  A warning will already have been printed.
-        num_err++;
-      } else {
-        if (acoustic_scale != 1.0) {
-          if (acoustic_scale == 0.0)
-            KALDI_ERR << "Acoustic scale cannot be zero.";
-          fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale),
-                            &composed_clat);
-        }
-        compact_lattice_writer.Write(key, composed_clat);
-        num_done++;
+    int64 num_states_computed = 0, num_states_recomputed = 0;
+    {
+      TaskSequencer<RnnlmRescorePrunedTask> sequencer(sequencer_config);
+      for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+        std::string key = compact_lattice_reader.Key();
+        // Will give ownership to the task.
+        CompactLattice *clat = compact_lattice_reader.Value().Copy();
+        compact_lattice_reader.FreeCurrent();
+        sequencer.Run(new RnnlmRescorePrunedTask(
+            compose_opts, lm_scale, acoustic_scale, max_ngram_order,
+            max_rnnlm_states, info, lm_to_subtract_fst, const_arpa, lm_cache,
+            key, clat, &compact_lattice_writer, &num_done, &num_err,
+            &num_states_computed, &num_states_recomputed));
       }
-      delete lm_to_add;
+      sequencer.Wait();
     }
 
-    delete lm_to_subtract_fst;
-    delete lm_to_add_orig;
-    delete lm_to_subtract_det_backoff;
-    delete lm_to_subtract_det_scale;
+    KALDI_LOG << "Computed " << num_states_computed << " RNNLM states, and "
+              << "recomputed " << num_states_recomputed << " that had been "
+              << "deleted (max-rnnlm-states=" << max_rnnlm_states << ").";
+    if (lm_cache != NULL)
+      lm_cache->PrintStats();
 
+    delete lm_to_subtract_fst;
     delete const_arpa;
-    delete carpa_lm_to_subtract_fst;
+    delete lm_cache;
 
     KALDI_LOG << "Overall, succeeded for " << num_done
               << " lattices, failed for " << num_err;
@@ -22,11 +22,93 @@
 
 #include "base/kaldi-common.h"
 #include "fstext/fstext-lib.h"
+#include "lat/compact-lattice-task.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "rnnlm/rnnlm-lattice-rescoring.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-utils.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// Rescores one lattice; the lattices are rescored in parallel by
+// TaskSequencer, and written, in order, from the destructor.  Each task
+// creates its own RNNLM FST, since it is not thread-safe; the RNNLM itself is
+// shared.
+class RnnlmRescoreTask: public CompactLatticeTask {
+ public:
+  // Takes ownership of "clat".
+  RnnlmRescoreTask(const rnnlm::RnnlmComputeStateInfo &info,
+                   int32 max_ngram_order, int32 max_rnnlm_states,
+                   BaseFloat lm_scale, const std::string &key,
+                   CompactLattice *clat, CompactLatticeWriter *clat_writer,
+                   int32 *num_done, int32 *num_fail,
+                   int64 *num_states_computed, int64 *num_states_recomputed):
+      CompactLatticeTask(key, clat, clat_writer, num_done, num_fail),
+      info_(info), max_ngram_order_(max_ngram_order),
+      max_rnnlm_states_(max_rnnlm_states), lm_scale_(lm_scale),
+      num_states_computed_(num_states_computed),
+      num_states_recomputed_(num_states_recomputed), states_computed_(0),
+      states_recomputed_(0) { }
+
+  ~RnnlmRescoreTask() {
+    *num_states_computed_ += states_computed_;
+    *num_states_recomputed_ += states_recomputed_;
+  }
+
+ protected:
+  virtual bool Process(CompactLattice *clat, CompactLattice *clat_out) {
+    if (lm_scale_ == 0.0) {
+      // Zero scale so nothing to do.
+      *clat_out = *clat;
+      return true;
+    }
+    // Before composing with the LM FST, we scale the lattice weights
+    // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
+    // We do it this way so we can determinize and it will give the
+    // right effect (taking the "best path" through the LM) regardless
+    // of the sign of lm_scale.
+    fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale_), clat);
+    ArcSort(clat, fst::OLabelCompare<CompactLatticeArc>());
+
+    // Wraps the rnnlm into FST. We re-create it for each lattice to prevent
+    // memory usage increasing with time.
+    rnnlm::KaldiRnnlmDeterministicFst rnnlm_fst(max_ngram_order_, info_,
+                                                max_rnnlm_states_);
+
+    // Composes lattice with language model.
+    CompactLattice composed_clat;
+    ComposeCompactLatticeDeterministic(*clat, &rnnlm_fst, &composed_clat);
+    states_computed_ = rnnlm_fst.NumStatesComputed();
+    states_recomputed_ = rnnlm_fst.NumStatesRecomputed();
+
+    // Determinizes the composed lattice.
+    Lattice composed_lat;
+    ConvertLattice(composed_clat, &composed_lat);
+    Invert(&composed_lat);
+    DeterminizeLattice(composed_lat, clat_out);
+    fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_), clat_out);
+    if (clat_out->Start() == fst::kNoStateId) {
+      KALDI_WARN << "Empty lattice for utterance " << Key()
+                 << " (incompatible LM?)";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  const rnnlm::RnnlmComputeStateInfo &info_;
+  int32 max_ngram_order_;
+  int32 max_rnnlm_states_;
+  BaseFloat lm_scale_;
+  int64 *num_states_computed_;
+  int64 *num_states_recomputed_;
+  int64 states_computed_;
+  int64 states_recomputed_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -52,6 +134,8 @@ int main(int argc, char *argv[]) {
 
     int32 max_ngram_order = 3;
     BaseFloat lm_scale = 1.0;
+    int32 max_rnnlm_states = 0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs");
@@ -59,7 +143,12 @@ int main(int argc, char *argv[]) {
         "If positive, allow RNNLM histories longer than this to be identified "
         "with each other for rescoring purposes (an approximation that "
         "saves time and reduces output lattice size).");
+    po.Register("max-rnnlm-states", &max_rnnlm_states, "If positive, the "
+                "maximum number of RNNLM states to keep in memory per lattice; "
+                "states that are needed again after being freed are recomputed, "
+                "so this limits memory use without changing the output.");
     opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -92,52 +181,25 @@ int main(int argc, char *argv[]) {
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
     int32 n_done = 0, n_fail = 0;
-
-    rnnlm::KaldiRnnlmDeterministicFst rnnlm_fst(max_ngram_order, info);
-
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice &clat = compact_lattice_reader.Value();
-
-      if (lm_scale != 0.0) {
-        // Before composing with the LM FST, we scale the lattice weights
-        // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
-        // We do it this way so we can determinize and it will give the
-        // right effect (taking the "best path" through the LM) regardless
-        // of the sign of lm_scale.
-        fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale), &clat);
-        ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
-
-        // Wraps the rnnlm into FST. We re-create it for each lattice to prevent
-        // memory usage increasing with time.
-
-        // Composes lattice with language model.
-        CompactLattice composed_clat;
-        ComposeCompactLatticeDeterministic(clat, &rnnlm_fst, &composed_clat);
-
-        // Determinizes the composed lattice.
-        Lattice composed_lat;
-        ConvertLattice(composed_clat, &composed_lat);
-        Invert(&composed_lat);
-        CompactLattice determinized_clat;
-        DeterminizeLattice(composed_lat, &determinized_clat);
-        fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), &determinized_clat);
-        if (determinized_clat.Start() == fst::kNoStateId) {
-          KALDI_WARN << "Empty lattice for utterance " << key
-              << " (incompatible LM?)";
-          n_fail++;
-        } else {
-          compact_lattice_writer.Write(key, determinized_clat);
-          n_done++;
-        }
-      } else {
-        // Zero scale so nothing to do.
-        n_done++;
-        compact_lattice_writer.Write(key, clat);
+    int64 num_states_computed = 0, num_states_recomputed = 0;
+    {
+      TaskSequencer<RnnlmRescoreTask> sequencer(sequencer_config);
+      for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+        std::string key = compact_lattice_reader.Key();
+        // Will give ownership to the task.
+        CompactLattice *clat = compact_lattice_reader.Value().Copy();
+        compact_lattice_reader.FreeCurrent();
+        sequencer.Run(new RnnlmRescoreTask(
+            info, max_ngram_order, max_rnnlm_states, lm_scale, key, clat,
+            &compact_lattice_writer, &n_done, &n_fail,
+            &num_states_computed, &num_states_recomputed));
       }
-      rnnlm_fst.Clear();
+      sequencer.Wait();
     }
 
+    KALDI_LOG << "Computed " << num_states_computed << " RNNLM states, and "
+              << "recomputed " << num_states_recomputed << " that had been "
+              << "deleted (max-rnnlm-states=" << max_rnnlm_states << ").";
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
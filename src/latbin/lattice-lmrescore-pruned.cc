@@ -23,9 +23,101 @@
 #include "fstext/fstext-lib.h"
 #include "fstext/kaldi-fst-io.h"
 #include "lm/const-arpa-lm.h"
+#include "lat/compact-lattice-task.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "lat/compose-lattice-pruned.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// Rescores one lattice; the lattices are rescored in parallel by
+// TaskSequencer, and written, in order, from the destructor.  Each task
+// creates its own on-demand LM FSTs, since those are not thread-safe; the
+// LMs themselves are shared.
+class LmRescorePrunedTask: public CompactLatticeTask {
+ public:
+  // Takes ownership of "clat".  Exactly one of "const_arpa" and "lm_to_add_fst"
+  // is non-NULL; "lm_cache" may be NULL.
+  LmRescorePrunedTask(const ComposeLatticePrunedOptions &compose_opts,
+                      BaseFloat lm_scale, BaseFloat acoustic_scale,
+                      const fst::StdVectorFst &lm_to_subtract_fst,
+                      const ConstArpaLm *const_arpa,
+                      ConstArpaLmCache *lm_cache,
+                      const fst::StdVectorFst *lm_to_add_fst,
+                      const std::string &key, CompactLattice *clat,
+                      CompactLatticeWriter *clat_writer,
+                      int32 *num_done, int32 *num_err):
+      CompactLatticeTask(key, clat, clat_writer, num_done, num_err),
+      compose_opts_(compose_opts), lm_scale_(lm_scale),
+      acoustic_scale_(acoustic_scale), lm_to_subtract_fst_(lm_to_subtract_fst),
+      const_arpa_(const_arpa), lm_cache_(lm_cache),
+      lm_to_add_fst_(lm_to_add_fst) { }
+
+ protected:
+  virtual bool Process(CompactLattice *clat, CompactLattice *clat_out) {
+    using fst::StdArc;
+    if (acoustic_scale_ != 1.0) {
+      fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale_), clat);
+    }
+    TopSortCompactLatticeIfNeeded(clat);
+
+    fst::BackoffDeterministicOnDemandFst<StdArc> lm_to_subtract_det_backoff(
+        lm_to_subtract_fst_);
+    fst::ScaleDeterministicOnDemandFst lm_to_subtract_det_scale(
+        -lm_scale_, &lm_to_subtract_det_backoff);
+
+    fst::DeterministicOnDemandFst<StdArc> *lm_to_add_orig = NULL,
+        *lm_to_add = NULL;
+    if (const_arpa_ != NULL) {
+      lm_to_add = new ConstArpaLmDeterministicFst(*const_arpa_, lm_cache_);
+    } else {
+      lm_to_add = new fst::BackoffDeterministicOnDemandFst<StdArc>(
+          *lm_to_add_fst_);
+    }
+    if (lm_scale_ != 1.0) {
+      lm_to_add_orig = lm_to_add;
+      lm_to_add = new fst::ScaleDeterministicOnDemandFst(lm_scale_,
+                                                         lm_to_add_orig);
+    }
+
+    // To avoid memory gradually increasing with time, we reconstruct the
+    // composed-LM FST for each lattice we process.
+    //   It shouldn't make a difference in which order we provide the
+    // arguments to the composition; either way should work.  They are both
+    // acceptors so the result is the same either way.
+    fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
+        &lm_to_subtract_det_scale, lm_to_add);
+
+    ComposeCompactLatticePruned(compose_opts_, *clat,
+                                &combined_lms, clat_out);
+    delete lm_to_add_orig;
+    delete lm_to_add;
+
+    if (clat_out->NumStates() == 0) {
+      // Something went wrong.  A warning will already have been printed.
+      return false;
+    }
+    if (acoustic_scale_ != 1.0) {
+      if (acoustic_scale_ == 0.0)
+        KALDI_ERR << "Acoustic scale cannot be zero.";
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                        clat_out);
+    }
+    return true;
+  }
+
+ private:
+  const ComposeLatticePrunedOptions &compose_opts_;
+  BaseFloat lm_scale_;
+  BaseFloat acoustic_scale_;
+  const fst::StdVectorFst &lm_to_subtract_fst_;
+  const ConstArpaLm *const_arpa_;
+  ConstArpaLmCache *lm_cache_;
+  const fst::StdVectorFst *lm_to_add_fst_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -60,6 +152,9 @@ int main(int argc, char *argv[]) {
     BaseFloat lm_scale = 1.0;
     BaseFloat acoustic_scale = 1.0;
     bool add_const_arpa = false;
+    bool mmap_lm = false;
+    int32 lm_cache_size = 0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for <lm-to-add>; its negative "
                 "will be applied to <lm-to-subtract>.");
@@ -69,7 +164,16 @@ int main(int argc, char *argv[]) {
     po.Register("add-const-arpa", &add_const_arpa, "If true, <lm-to-add> is expected "
                 "to be in const-arpa format; if false it's expected to be in FST"
                 "format.");
-
+    po.Register("mmap-lm", &mmap_lm, "If true (and --add-const-arpa=true), "
+                "map <lm-to-add> into memory instead of reading it, so that "
+                "processes using the same LM share one copy.  Requires an LM "
+                "written by arpa-to-const-arpa --page-align=true, in a file.");
+    po.Register("lm-cache-size", &lm_cache_size, "If positive (and "
+                "--add-const-arpa=true), the number of lookups of <lm-to-add> "
+                "to cache across lattices (only useful if LM lookups are "
+                "slow).");
+    compose_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -89,29 +193,16 @@ int main(int argc, char *argv[]) {
     VectorFst<StdArc> *lm_to_add_fst = NULL;
     ConstArpaLm const_arpa;
     if (add_const_arpa) {
-      ReadKaldiObject(lm_to_add_rxfilename, &const_arpa);
+      if (mmap_lm)
+        const_arpa.ReadMapped(lm_to_add_rxfilename);
+      else
+        ReadKaldiObject(lm_to_add_rxfilename, &const_arpa);
     } else {
       lm_to_add_fst = fst::ReadAndPrepareLmFst(lm_to_add_rxfilename);
     }
-    fst::BackoffDeterministicOnDemandFst<StdArc> lm_to_subtract_det_backoff(
-        *lm_to_subtract_fst);
-    fst::ScaleDeterministicOnDemandFst lm_to_subtract_det_scale(
-        -lm_scale, &lm_to_subtract_det_backoff);
-
-
-    fst::DeterministicOnDemandFst<StdArc> *lm_to_add_orig = NULL,
-        *lm_to_add = NULL;
-    if (add_const_arpa) {
-      lm_to_add = new ConstArpaLmDeterministicFst(const_arpa);
-    } else {
-      lm_to_add = new fst::BackoffDeterministicOnDemandFst<StdArc>(
-          *lm_to_add_fst);
-    }
-    if (lm_scale != 1.0) {
-      lm_to_add_orig = lm_to_add;
-      lm_to_add = new fst::ScaleDeterministicOnDemandFst(lm_scale,
-                                                         lm_to_add_orig);
-    }
+    ConstArpaLmCache *lm_cache = NULL;
+    if (add_const_arpa && lm_cache_size > 0)
+      lm_cache = new ConstArpaLmCache(lm_cache_size);
 
     KALDI_LOG << "Done.";
 
@@ -122,48 +213,26 @@ int main(int argc, char *argv[]) {
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
     int32 num_done = 0, num_err = 0;
-
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice &clat = clat_reader.Value();
-
-      if (acoustic_scale != 1.0) {
-        fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
-      }
-      TopSortCompactLatticeIfNeeded(&clat);
-
-      // To avoid memory gradually increasing with time, we reconstruct the
-      // composed-LM FST for each lattice we process.
-      //   It shouldn't make a difference in which order we provide the
-      // arguments to the composition; either way should work.  They are both
-      // acceptors so the result is the same either way.
-      fst::ComposeDeterministicOnDemandFst<StdArc> combined_lms(
-          &lm_to_subtract_det_scale, lm_to_add);
-
-      CompactLattice composed_clat;
-      ComposeCompactLatticePruned(compose_opts,
-                                  clat,
-                                  &combined_lms,
-                                  &composed_clat);
-
-      if (composed_clat.NumStates() == 0) {
-        // Something went wrong.  A warning will already have been printed.
-        num_err++;
-      } else {
-        if (acoustic_scale != 1.0) {
-          if (acoustic_scale == 0.0)
-            KALDI_ERR << "Acoustic scale cannot be zero.";
-          fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale),
-                            &composed_clat);
-        }
-        compact_lattice_writer.Write(key, composed_clat);
-        num_done++;
+    {
+      TaskSequencer<LmRescorePrunedTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        // Will give ownership to the task.
+        CompactLattice *clat = clat_reader.Value().Copy();
+        clat_reader.FreeCurrent();
+        sequencer.Run(new LmRescorePrunedTask(
+            compose_opts, lm_scale, acoustic_scale, *lm_to_subtract_fst,
+            (add_const_arpa ? &const_arpa : NULL), lm_cache, lm_to_add_fst,
+            key, clat, &compact_lattice_writer, &num_done, &num_err));
       }
+      sequencer.Wait();
     }
     delete lm_to_subtract_fst;
     delete lm_to_add_fst;
-    delete lm_to_add_orig;
-    delete lm_to_add;
+    if (lm_cache != NULL) {
+      lm_cache->PrintStats();
+      delete lm_cache;
+    }
 
     KALDI_LOG << "Overall, succeeded for " << num_done
               << " lattices, failed for " << num_err;
@@ -21,8 +21,90 @@
 #include "util/common-utils.h"
 #include "util/kaldi-table.h"
 #include "lat/sausages.h"
+#include "lat/compact-lattice-task.h"
+#include "util/kaldi-thread.h"
 #include <numeric>
 
+namespace kaldi {
+
+// Does the MBR computation for one lattice; the lattices are processed in
+// parallel by TaskSequencer, and the ctm lines are written, in order, from the
+// destructor.
+class LatticeToCtmConfTask: public CompactLatticeTask {
+ public:
+  // Takes ownership of "clat".  "one_best" and "times" may be NULL (meaning
+  // the lattice best path is the starting point); they are copied.
+  LatticeToCtmConfTask(const MinimumBayesRiskOptions &mbr_opts,
+                       BaseFloat lm_scale, BaseFloat acoustic_scale,
+                       BaseFloat frame_shift, const std::string &key,
+                       CompactLattice *clat,
+                       const std::vector<int32> *one_best,
+                       const std::vector<std::pair<BaseFloat,BaseFloat> > *times,
+                       std::ostream *os, int32 *n_done, int32 *n_words,
+                       BaseFloat *tot_bayes_risk):
+      CompactLatticeTask(key, clat, NULL, NULL, NULL),
+      mbr_opts_(mbr_opts), lm_scale_(lm_scale), acoustic_scale_(acoustic_scale),
+      frame_shift_(frame_shift),
+      one_best_(one_best != NULL ? new std::vector<int32>(*one_best) : NULL),
+      times_(times != NULL ?
+             new std::vector<std::pair<BaseFloat,BaseFloat> >(*times) : NULL),
+      os_(os), n_done_(n_done), n_words_(n_words),
+      tot_bayes_risk_(tot_bayes_risk), mbr_(NULL) { }
+
+  ~LatticeToCtmConfTask() {
+    const std::string &key = Key();
+    const std::vector<BaseFloat> &conf = mbr_->GetOneBestConfidences();
+    const std::vector<int32> &words = mbr_->GetOneBest();
+    const std::vector<std::pair<BaseFloat, BaseFloat> > &times =
+        mbr_->GetOneBestTimes();
+    KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
+    for (size_t i = 0; i < words.size(); i++) {
+      KALDI_ASSERT(words[i] != 0 || mbr_opts_.print_silence); // Should not have epsilons.
+      *os_ << key << " 1 " << (frame_shift_ * times[i].first) << ' '
+           << (frame_shift_ * (times[i].second-times[i].first)) << ' '
+           << words[i] << ' ' << conf[i] << '\n';
+    }
+    KALDI_LOG << "For utterance " << key << ", Bayes Risk "
+              << mbr_->GetBayesRisk() << ", avg. confidence per-word "
+              << std::accumulate(conf.begin(),conf.end(),0.0) / words.size();
+    (*n_done_)++;
+    *n_words_ += mbr_->GetOneBest().size();
+    *tot_bayes_risk_ += mbr_->GetBayesRisk();
+    delete mbr_;
+    delete one_best_;
+    delete times_;
+  }
+
+ protected:
+  virtual bool Process(CompactLattice *clat, CompactLattice *clat_out) {
+    fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), clat);
+    if (one_best_ == NULL) {
+      mbr_ = new MinimumBayesRisk(*clat, mbr_opts_);
+    } else if (times_ == NULL) {
+      mbr_ = new MinimumBayesRisk(*clat, *one_best_, mbr_opts_); // no 'times',
+    } else {
+      // with initial 'times' of the bins,
+      mbr_ = new MinimumBayesRisk(*clat, *one_best_, *times_, mbr_opts_);
+    }
+    return true;
+  }
+
+ private:
+  const MinimumBayesRiskOptions &mbr_opts_;
+  BaseFloat lm_scale_;
+  BaseFloat acoustic_scale_;
+  BaseFloat frame_shift_;
+  std::vector<int32> *one_best_;  // owned here; may be NULL.
+  std::vector<std::pair<BaseFloat,BaseFloat> > *times_;  // owned here; may be NULL.
+  std::ostream *os_;
+  int32 *n_done_;
+  int32 *n_words_;
+  BaseFloat *tot_bayes_risk_;
+  MinimumBayesRisk *mbr_;
+};
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -61,6 +143,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0, inv_acoustic_scale = 1.0, lm_scale = 1.0;
     BaseFloat frame_shift = 0.01;
     int32 confidence_digits = 2;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
 
     std::string word_syms_filename;
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
@@ -75,6 +158,7 @@ int main(int argc, char *argv[]) {
 
     MinimumBayesRiskOptions mbr_opts;
     mbr_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -129,56 +213,35 @@ int main(int argc, char *argv[]) {
     int32 n_done = 0, n_words = 0;
     BaseFloat tot_bayes_risk = 0.0;
 
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
-
-      MinimumBayesRisk *mbr = NULL;
-
-      if (one_best_rspecifier == "") {
-        mbr = new MinimumBayesRisk(clat, mbr_opts);
-      } else {
-        // check,
-        if (!one_best_reader.HasKey(key)) {
-          KALDI_WARN << "No 1-best present for utterance " << key;
-          continue;
-        }
-        if (times_rspecifier != "" && !times_reader.HasKey(key)) {
-          KALDI_WARN << "No 'times' present for utterance " << key;
-          continue;
+    {
+      TaskSequencer<LatticeToCtmConfTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        const std::vector<int32> *one_best = NULL;
+        const std::vector<std::pair<BaseFloat,BaseFloat> > *times = NULL;
+        if (one_best_rspecifier != "") {
+          // check,
+          if (!one_best_reader.HasKey(key)) {
+            KALDI_WARN << "No 1-best present for utterance " << key;
+            continue;
+          }
+          if (times_rspecifier != "" && !times_reader.HasKey(key)) {
+            KALDI_WARN << "No 'times' present for utterance " << key;
+            continue;
+          }
+          one_best = &(one_best_reader.Value(key));
+          if (times_rspecifier != "")
+            times = &(times_reader.Value(key));
         }
-        // get the 'mbr' decoding object,
-        if (times_rspecifier == "") {
-          const std::vector<int32> &one_best = one_best_reader.Value(key);
-          mbr = new MinimumBayesRisk(clat, one_best, mbr_opts); // no 'times',
-        } else {
-          // with initial 'times' of the bins,
-          const std::vector<int32> &one_best = one_best_reader.Value(key);
-          const std::vector<std::pair<BaseFloat,BaseFloat> > &times = times_reader.Value(key);
-          mbr = new MinimumBayesRisk(clat, one_best, times, mbr_opts);
-        }
-      }
-
-      const std::vector<BaseFloat> &conf = mbr->GetOneBestConfidences();
-      const std::vector<int32> &words = mbr->GetOneBest();
-      const std::vector<std::pair<BaseFloat, BaseFloat> > &times =
-          mbr->GetOneBestTimes();
-      KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
-      for (size_t i = 0; i < words.size(); i++) {
-        KALDI_ASSERT(words[i] != 0 || mbr_opts.print_silence); // Should not have epsilons.
-        ko.Stream() << key << " 1 " << (frame_shift * times[i].first) << ' '
-                    << (frame_shift * (times[i].second-times[i].first)) << ' '
-                    << words[i] << ' ' << conf[i] << '\n';
+        // Will give ownership to the task.
+        CompactLattice *clat = clat_reader.Value().Copy();
+        clat_reader.FreeCurrent();
+        sequencer.Run(new LatticeToCtmConfTask(
+            mbr_opts, lm_scale, acoustic_scale, frame_shift, key, clat,
+            one_best, times, &(ko.Stream()), &n_done, &n_words,
+            &tot_bayes_risk));
       }
-      KALDI_LOG << "For utterance " << key << ", Bayes Risk "
-                << mbr->GetBayesRisk() << ", avg. confidence per-word "
-                << std::accumulate(conf.begin(),conf.end(),0.0) / words.size();
-      n_done++;
-      n_words += mbr->GetOneBest().size();
-      tot_bayes_risk += mbr->GetBayesRisk();
-      delete mbr;
+      sequencer.Wait();
     }
 
     KALDI_LOG << "Done " << n_done << " lattices.";
@@ -155,6 +155,11 @@ void TestableArpaFileParser::Validate(
                           expect_ngrams.array, CompareNgrams));
 }
 
+// The number of threads with which the tests parse the LMs, and the number of
+// lines per thread in each batch; the results must not depend on them.
+int32 num_threads = 1;
+int32 lines_per_thread = 20000;
+
 // Read integer LM (no symbols) with log base conversion.
 void ReadIntegerLmLogconvExpectSuccess() {
   KALDI_LOG << "ReadIntegerLmLogconvExpectSuccess()";
@@ -197,6 +202,8 @@ ngram 3=2\n\
   ArpaParseOptions options;
   options.bos_symbol = 1;
   options.eos_symbol = 2;
+  options.num_threads = num_threads;
+  options.lines_per_thread = lines_per_thread;
 
   TestableArpaFileParser parser(options, NULL);
   std::istringstream stm(integer_lm, std::ios_base::in);
@@ -270,6 +277,8 @@ void ReadSymbolicLmNoOovImpl(ArpaParseOptions::OovHandling oov) {
   ArpaParseOptions options;
   options.bos_symbol = 1;
   options.eos_symbol = 2;
+  options.num_threads = num_threads;
+  options.lines_per_thread = lines_per_thread;
   options.unk_symbol = 3;
   options.oov_handling = oov;
   TestableArpaFileParser parser(options, &symbols);
@@ -300,6 +309,8 @@ void ReadSymbolicLmWithOovImpl(
   ArpaParseOptions options;
   options.bos_symbol = 1;
   options.eos_symbol = 2;
+  options.num_threads = num_threads;
+  options.lines_per_thread = lines_per_thread;
   options.unk_symbol = 3;
   options.oov_handling = oov;
   TestableArpaFileParser parser(options, symbols);
@@ -367,7 +378,16 @@ void ReadSymbolicLmWithOovTests() {
 }  // namespace kaldi
 
 int main(int argc, char *argv[]) {
-  kaldi::ReadIntegerLmLogconvExpectSuccess();
-  kaldi::ReadSymbolicLmNoOovTests();
-  kaldi::ReadSymbolicLmWithOovTests();
+  // With 1 or 2 lines per thread, each section is split into many batches,
+  // and some threads get no lines.
+  int32 lines_per_thread_values[] = { 1, 2, 20000 };
+  for (kaldi::num_threads = 1; kaldi::num_threads <= 3;
+       kaldi::num_threads++) {
+    for (int32 i = 0; i < 3; i++) {
+      kaldi::lines_per_thread = lines_per_thread_values[i];
+      kaldi::ReadIntegerLmLogconvExpectSuccess();
+      kaldi::ReadSymbolicLmNoOovTests();
+      kaldi::ReadSymbolicLmWithOovTests();
+    }
+  }
 }
@@ -20,11 +20,14 @@
 
 #include <fst/fstlib.h>
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
 
 #include "base/kaldi-error.h"
 #include "base/kaldi-math.h"
 #include "lm/arpa-file-parser.h"
+#include "util/kaldi-thread.h"
 #include "util/text-utils.h"
 
 namespace kaldi {
@@ -38,6 +41,49 @@ ArpaFileParser::ArpaFileParser(const ArpaParseOptions& options,
 ArpaFileParser::~ArpaFileParser() {
 }
 
+// An n-gram line as parsed by ArpaNGramParser.
+struct ArpaParsedNGram {
+  NGram ngram;
+  std::string error;
+  std::vector<std::pair<int32, std::string> > oovs;
+};
+
+// A batch of n-gram lines of one order, as read by ArpaFileParser::Read() when
+// options.num_threads > 1.  Only lines[0 .. num_lines - 1] are in use; the
+// vectors keep their size so that their memory is reused between batches.
+struct ArpaNGramBatch {
+  std::vector<std::string> lines;
+  std::vector<int32> line_numbers;
+  std::vector<ArpaParsedNGram> parsed;
+  int32 num_lines;
+  int32 order;
+  ArpaNGramBatch(): num_lines(0), order(0) { }
+};
+
+// Parses a contiguous range of the lines of a batch into batch->parsed, on
+// one thread.
+class ArpaNGramParser: public MultiThreadable {
+ public:
+  ArpaNGramParser(const ArpaFileParser &parser, ArpaNGramBatch *batch):
+      parser_(&parser), batch_(batch) { }
+
+  void operator() () {
+    int32 num_lines = batch_->num_lines,
+        block_size = (num_lines + num_threads_ - 1) / num_threads_,
+        begin = std::min(num_lines, thread_id_ * block_size),
+        end = std::min(num_lines, begin + block_size);
+    for (int32 i = begin; i < end; i++) {
+      ArpaParsedNGram &parsed = batch_->parsed[i];
+      parsed.error = parser_->ParseNGram(batch_->lines[i], batch_->order,
+                                         &parsed.ngram, &parsed.oovs);
+    }
+  }
+
+ private:
+  const ArpaFileParser *parser_;
+  ArpaNGramBatch *batch_;
+};
+
 void TrimTrailingWhitespace(std::string *str) {
   str->erase(str->find_last_not_of(" \n\r\t") + 1);
 }
@@ -131,6 +177,28 @@ void ArpaFileParser::Read(std::istream &is) {
 
   NGram ngram;
   ngram.words.reserve(ngram_counts_.size());
+  std::vector<std::pair<int32, std::string> > oovs;
+
+  // If we parse on several threads, the n-gram lines are read into one of two
+  // batches while the lines of the other batch, if any, are being parsed by
+  // 'threader'.  A parsed batch is consumed before the next one is started,
+  // since consuming it may add words to the symbol table.  'threader' is
+  // declared after 'batches' so that, if we throw, its destructor waits for
+  // the threads before the batches are freed.
+  bool parallel = (options_.num_threads > 1);
+  ArpaNGramBatch batches[2];
+  ArpaNGramBatch *batch = &batches[0],  // the batch being read.
+      *parsing_batch = &batches[1];  // the batch being parsed, if 'threader'.
+  std::unique_ptr<MultiThreader<ArpaNGramParser> > threader;
+  if (parallel) {
+    KALDI_ASSERT(options_.lines_per_thread > 0);
+    for (int32 i = 0; i < 2; i++) {
+      batches[i].lines.resize(options_.num_threads *
+                              options_.lines_per_thread);
+      batches[i].line_numbers.resize(batches[i].lines.size());
+      batches[i].parsed.resize(batches[i].lines.size());
+    }
+  }
 
   // Processes "\N-grams:" section.
   for (int32 cur_order = 1; cur_order <= ngram_counts_.size(); ++cur_order) {
@@ -149,18 +217,26 @@ void ArpaFileParser::Read(std::istream &is) {
     KALDI_LOG << "Reading " << current_line_ << " section.";
 
     int32 ngram_count = 0;
-    while (++line_number_, getline(is, current_line_) && !is.eof()) {
-      if (current_line_.find_first_not_of(" \n\t\r") == std::string::npos) {
+    batch->order = cur_order;
+    while (true) {
+      std::string &line = (parallel ? batch->lines[batch->num_lines] :
+                           current_line_);
+      if (!(++line_number_, getline(is, line) && !is.eof())) {
+        // The last line (e.g. "\end\" without a newline) is checked below.
+        if (parallel)
+          current_line_ = line;
+        break;
+      }
+      if (line.find_first_not_of(" \n\t\r") == std::string::npos) {
         continue;
       }
-      if (current_line_[0] == '\\') {
-        TrimTrailingWhitespace(&current_line_);
+      if (line[0] == '\\') {
+        TrimTrailingWhitespace(&line);
         std::ostringstream next_keyword;
         next_keyword << "\\" << cur_order + 1 << "-grams:";
-        if ((current_line_ != next_keyword.str()) &&
-            (current_line_ != "\\end\\")) {
+        if ((line != next_keyword.str()) && (line != "\\end\\")) {
           if (ShouldWarn()) {
-            KALDI_WARN << "ignoring possible directive '" << current_line_
+            KALDI_WARN << "ignoring possible directive '" << line
                        << "' expecting '" << next_keyword.str() << "'";
 
             if (warning_count_ > 0 &&
@@ -172,77 +248,50 @@ void ArpaFileParser::Read(std::istream &is) {
             }
           }
         } else {
+          if (parallel)
+            current_line_ = line;
           break;
         }
       }
 
-      std::vector<std::string> col;
-      SplitStringToVector(current_line_, " \t", true, &col);
-
-      if (col.size() < 1 + cur_order ||
-          col.size() > 2 + cur_order ||
-          (cur_order == ngram_counts_.size() && col.size() != 1 + cur_order)) {
-        PARSE_ERR << "Invalid n-gram data line";
-      }
       ++ngram_count;
-
-      // Parse out n-gram logprob and, if present, backoff weight.
-      if (!ConvertStringToReal(col[0], &ngram.logprob)) {
-        PARSE_ERR << "invalid n-gram logprob '" << col[0] << "'";
-      }
-      ngram.backoff = 0.0;
-      if (col.size() > cur_order + 1) {
-        if (!ConvertStringToReal(col[cur_order + 1], &ngram.backoff))
-          PARSE_ERR << "invalid backoff weight '" << col[cur_order + 1] << "'";
-      }
-      // Convert to natural log.
-      ngram.logprob *= M_LN10;
-      ngram.backoff *= M_LN10;
-
-      ngram.words.resize(cur_order);
-      bool skip_ngram = false;
-      for (int32 index = 0; !skip_ngram && index < cur_order; ++index) {
-        int32 word;
-        if (symbols_) {
-          // Symbol table provided, so symbol labels are expected.
-          if (options_.oov_handling == ArpaParseOptions::kAddToSymbols) {
-            word = symbols_->AddSymbol(col[1 + index]);
-          } else {
-            word = symbols_->Find(col[1 + index]);
-            if (word == -1) { // fst::kNoSymbol
-              switch (options_.oov_handling) {
-                case ArpaParseOptions::kReplaceWithUnk:
-                  word = options_.unk_symbol;
-                  break;
-                case ArpaParseOptions::kSkipNGram:
-                  if (ShouldWarn())
-                    KALDI_WARN << LineReference() << " skipped: word '"
-                               << col[1 + index] << "' not in symbol table";
-                  skip_ngram = true;
-                  break;
-                default:
-                  PARSE_ERR << "word '"  << col[1 + index]
-                            << "' not in symbol table";
-              }
-            }
-          }
-        } else {
-          // Symbols not provided, LM file should contain integers.
-          if (!ConvertStringToInteger(col[1 + index], &word) || word < 0) {
-            PARSE_ERR << "invalid symbol '" << col[1 + index] << "'";
+      if (parallel) {
+        batch->line_numbers[batch->num_lines++] = line_number_;
+        if (batch->num_lines == static_cast<int32>(batch->lines.size())) {
+          // Wait for the previous batch and consume it, then start parsing
+          // this one and read the next one while it is being parsed.
+          if (threader) {
+            threader.reset();  // The destructor waits for the threads.
+            ConsumeBatch(parsing_batch);
           }
+          std::swap(batch, parsing_batch);
+          threader.reset(new MultiThreader<ArpaNGramParser>(
+              options_.num_threads, ArpaNGramParser(*this, parsing_batch)));
+          batch->order = cur_order;
         }
-        // Whichever way we got it, an epsilon is invalid.
-        if (word == 0) {
-          PARSE_ERR << "epsilon symbol '" << col[1 + index]
-                    << "' is illegal in ARPA LM";
-        }
-        ngram.words[index] = word;
+        continue;
       }
-      if (!skip_ngram) {
+
+      std::string error = ParseNGram(current_line_, cur_order, &ngram, &oovs);
+      if (!error.empty()) {
+        PARSE_ERR << error;
+      }
+      if (MapOovWords(oovs, &ngram)) {
         ConsumeNGram(ngram);
       }
     }
+    if (parallel) {
+      // Consume the rest of the section before going on to the next order.
+      if (threader) {
+        threader.reset();
+        ConsumeBatch(parsing_batch);
+      }
+      if (batch->num_lines > 0) {
+        MultiThreader<ArpaNGramParser> last_threader(
+            options_.num_threads, ArpaNGramParser(*this, batch));
+      }
+      ConsumeBatch(batch);
+    }
     if (ngram_count > ngram_counts_[cur_order - 1]) {
       PARSE_ERR << "header said there would be " << ngram_counts_[cur_order - 1]
                 << " n-grams of order " << cur_order
@@ -267,6 +316,112 @@ void ArpaFileParser::Read(std::istream &is) {
 #undef PARSE_ERR
 }
 
+std::string ArpaFileParser::ParseNGram(
+    const std::string &line, int32 order, NGram *ngram,
+    std::vector<std::pair<int32, std::string> > *oovs) const {
+  oovs->clear();
+  std::vector<std::string> col;
+  SplitStringToVector(line, " \t", true, &col);
+
+  if (col.size() < 1 + order ||
+      col.size() > 2 + order ||
+      (order == ngram_counts_.size() && col.size() != 1 + order)) {
+    return "Invalid n-gram data line";
+  }
+
+  // Parse out n-gram logprob and, if present, backoff weight.
+  if (!ConvertStringToReal(col[0], &ngram->logprob)) {
+    return "invalid n-gram logprob '" + col[0] + "'";
+  }
+  ngram->backoff = 0.0;
+  if (col.size() > order + 1) {
+    if (!ConvertStringToReal(col[order + 1], &ngram->backoff))
+      return "invalid backoff weight '" + col[order + 1] + "'";
+  }
+  // Convert to natural log.
+  ngram->logprob *= M_LN10;
+  ngram->backoff *= M_LN10;
+
+  ngram->words.resize(order);
+  for (int32 index = 0; index < order; ++index) {
+    const std::string &word_str = col[1 + index];
+    int32 word;
+    if (symbols_) {
+      // Symbol table provided, so symbol labels are expected.
+      word = symbols_->Find(word_str);
+      if (word == -1) { // fst::kNoSymbol
+        switch (options_.oov_handling) {
+          case ArpaParseOptions::kAddToSymbols:
+            oovs->push_back(std::make_pair(index, word_str));
+            break;
+          case ArpaParseOptions::kReplaceWithUnk:
+            word = options_.unk_symbol;
+            break;
+          case ArpaParseOptions::kSkipNGram:
+            // The caller will skip the n-gram.
+            oovs->push_back(std::make_pair(index, word_str));
+            return "";
+          default:
+            return "word '" + word_str + "' not in symbol table";
+        }
+      }
+    } else {
+      // Symbols not provided, LM file should contain integers.
+      if (!ConvertStringToInteger(word_str, &word) || word < 0) {
+        return "invalid symbol '" + word_str + "'";
+      }
+    }
+    // Whichever way we got it, an epsilon is invalid.
+    if (word == 0) {
+      return "epsilon symbol '" + word_str + "' is illegal in ARPA LM";
+    }
+    ngram->words[index] = word;
+  }
+  return "";
+}
+
+bool ArpaFileParser::MapOovWords(
+    const std::vector<std::pair<int32, std::string> > &oovs, NGram *ngram) {
+  for (size_t i = 0; i < oovs.size(); i++) {
+    if (options_.oov_handling == ArpaParseOptions::kSkipNGram) {
+      if (ShouldWarn())
+        KALDI_WARN << LineReference() << " skipped: word '"
+                   << oovs[i].second << "' not in symbol table";
+      return false;
+    }
+    KALDI_ASSERT(options_.oov_handling == ArpaParseOptions::kAddToSymbols);
+    int32 word = symbols_->AddSymbol(oovs[i].second);
+    if (word == 0) {
+      KALDI_ERR << LineReference() << ": epsilon symbol '" << oovs[i].second
+                << "' is illegal in ARPA LM";
+    }
+    ngram->words[oovs[i].first] = word;
+  }
+  return true;
+}
+
+void ArpaFileParser::ConsumeBatch(ArpaNGramBatch *batch) {
+  // line_number_ and current_line_ are set to each line in turn, for the
+  // diagnostics of the derived class.
+  int32 line_number = line_number_;
+  std::string current_line;
+  current_line.swap(current_line_);
+  for (int32 i = 0; i < batch->num_lines; i++) {
+    ArpaParsedNGram &parsed = batch->parsed[i];
+    line_number_ = batch->line_numbers[i];
+    current_line_ = batch->lines[i];
+    if (!parsed.error.empty()) {
+      KALDI_ERR << LineReference() << ": " << parsed.error;
+    }
+    if (MapOovWords(parsed.oovs, &parsed.ngram)) {
+      ConsumeNGram(parsed.ngram);
+    }
+  }
+  line_number_ = line_number;
+  current_line_.swap(current_line);
+  batch->num_lines = 0;
+}
+
 std::string ArpaFileParser::LineReference() const {
   std::ostringstream ss;
   ss << "line " << line_number_ << " [" << current_line_ << "]";
@@ -24,6 +24,7 @@
 #include <fst/fst-decl.h>
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/kaldi-types.h"
@@ -31,6 +32,8 @@
 
 namespace kaldi {
 
+struct ArpaNGramBatch;
+
 /**
   Options that control ArpaFileParser
 */
@@ -44,7 +47,8 @@ struct ArpaParseOptions {
 
   ArpaParseOptions():
       bos_symbol(-1), eos_symbol(-1), unk_symbol(-1),
-      oov_handling(kRaiseError), max_warnings(30) { }
+      oov_handling(kRaiseError), max_warnings(30), num_threads(1),
+      lines_per_thread(20000) { }
 
   void Register(OptionsItf *opts) {
     // Registering only the max_warnings count, since other options are
@@ -53,6 +57,9 @@ struct ArpaParseOptions {
     opts->Register("max-arpa-warnings", &max_warnings,
                    "Maximum warnings to report on ARPA parsing, "
                    "0 to disable, -1 to show all");
+    opts->Register("num-threads", &num_threads,
+                   "Number of threads used to parse the n-grams of the ARPA "
+                   "file");
   }
 
   int32 bos_symbol;  ///< Symbol for <s>, Required non-epsilon.
@@ -60,6 +67,10 @@ struct ArpaParseOptions {
   int32 unk_symbol;  ///< Symbol for <unk>, Required for kReplaceWithUnk.
   OovHandling oov_handling;  ///< How to handle OOV words in the file.
   int32 max_warnings;  ///< Maximum warnings to report, <0 unlimited.
+  int32 num_threads;  ///< Number of threads used to parse the n-grams.
+  /// If num_threads > 1, the number of n-gram lines per thread in each batch
+  /// that is parsed in parallel.  Not registered; tests make it small.
+  int32 lines_per_thread;
 };
 
 /**
@@ -92,7 +103,10 @@ class ArpaFileParser {
   ArpaFileParser(const ArpaParseOptions& options, fst::SymbolTable* symbols);
   virtual ~ArpaFileParser();
 
-  /// Read ARPA LM file from a stream.
+  /// Read ARPA LM file from a stream.  If options.num_threads > 1, the
+  /// n-gram lines are read in batches, and the lines of each batch are parsed
+  /// on several threads while the next batch is being read; ConsumeNGram() is
+  /// still called from the calling thread, in the file order.
   void Read(std::istream &is);
 
   /// Parser options.
@@ -133,6 +147,29 @@ class ArpaFileParser {
   const std::vector<int32>& NgramCounts() const { return ngram_counts_; }
 
  private:
+  friend class ArpaNGramParser;
+
+  // Parses 'line', which is an n-gram line of order 'order', into *ngram.
+  // Does not modify the parser or the symbol table, so it may be called from
+  // several threads.  Words that are not in the symbol table, if they need
+  // to be added to it (kAddToSymbols) or the n-gram skipped (kSkipNGram), are
+  // set to -1 and their positions and text are output to 'oovs'.  Returns an
+  // empty string on success, else the error message.
+  std::string ParseNGram(const std::string &line, int32 order, NGram *ngram,
+                         std::vector<std::pair<int32, std::string> > *oovs)
+      const;
+
+  // Maps the words in 'oovs' (as output by ParseNGram()) in 'ngram', adding
+  // them to the symbol table if the options say so.  Returns false if the
+  // n-gram is to be skipped.
+  bool MapOovWords(const std::vector<std::pair<int32, std::string> > &oovs,
+                   NGram *ngram);
+
+  // Consumes the n-grams of 'batch', which must have been parsed, in the file
+  // order.  Called from Read() only when no batch is being parsed, as it may
+  // add words to the symbol table.
+  void ConsumeBatch(ArpaNGramBatch *batch);
+
   ArpaParseOptions options_;
   fst::SymbolTable* symbols_;  // the pointer is not owned here.
   int32 line_number_;
@@ -0,0 +1,583 @@
+// lm/compact-arpa-lm.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include "lm/compact-arpa-lm.h"
+#include "lm/const-arpa-lm.h"
+
+namespace kaldi {
+
+// Returns the number of bits needed to represent the numbers 0 .. max_value.
+static int32 NumBitsFor(uint64 max_value) {
+  int32 num_bits = 0;
+  while (max_value != 0) {
+    num_bits++;
+    max_value >>= 1;
+  }
+  return num_bits;
+}
+
+// Reads the field of 'num_bits' bits (at most 57) starting at bit
+// 'bit_offset' of 'data'.  Like the rest of the ConstArpaLm format, this
+// assumes that the file is read on a machine of the same endianness as the
+// one that wrote it.
+static inline uint64 ReadBits(const char *data, int64 bit_offset,
+                              int32 num_bits) {
+  uint64 value;
+  memcpy(&value, data + (bit_offset >> 3), sizeof(value));
+  return (value >> (bit_offset & 7)) &
+      ((static_cast<uint64>(1) << num_bits) - 1);
+}
+
+// Writes a field that was zero before; see ReadBits().
+static void WriteBits(char *data, int64 bit_offset, int32 num_bits,
+                      uint64 value) {
+  KALDI_ASSERT(num_bits <= 57 && (value >> num_bits) == 0);
+  uint64 bits;
+  memcpy(&bits, data + (bit_offset >> 3), sizeof(bits));
+  bits |= value << (bit_offset & 7);
+  memcpy(data + (bit_offset >> 3), &bits, sizeof(bits));
+}
+
+void CompactArpaLm::Level::Allocate() {
+  KALDI_ASSERT(word_bits <= 31 && logprob_bits <= 16 && backoff_bits <= 16 &&
+               child_bits <= 57);
+  int64 num_bytes = (num_entries * EntryBits() + 7) / 8;
+  // The padding makes sure we can read 8 bytes at the last field.
+  data.assign(num_bytes + sizeof(uint64), 0);
+}
+
+inline int32 CompactArpaLm::Level::Word(int64 i) const {
+  return ReadBits(&(data[0]), i * EntryBits(), word_bits);
+}
+
+inline float CompactArpaLm::Level::Logprob(int64 i) const {
+  return logprob_codebook[ReadBits(&(data[0]), i * EntryBits() + word_bits,
+                                   logprob_bits)];
+}
+
+inline float CompactArpaLm::Level::Backoff(int64 i) const {
+  if (backoff_codebook.empty())  // The highest order.
+    return 0.0;
+  return backoff_codebook[ReadBits(&(data[0]),
+                                   i * EntryBits() + word_bits + logprob_bits,
+                                   backoff_bits)];
+}
+
+inline int64 CompactArpaLm::Level::ChildEnd(int64 i) const {
+  return ReadBits(&(data[0]),
+                  i * EntryBits() + word_bits + logprob_bits + backoff_bits,
+                  child_bits);
+}
+
+void CompactArpaLm::Level::SetEntry(int64 i, int32 word, int32 logprob_code,
+                                    int32 backoff_code, int64 child_end) {
+  KALDI_ASSERT(i >= 0 && i < num_entries);
+  char *ptr = &(data[0]);
+  int64 offset = i * EntryBits();
+  WriteBits(ptr, offset, word_bits, word);
+  offset += word_bits;
+  WriteBits(ptr, offset, logprob_bits, logprob_code);
+  offset += logprob_bits;
+  WriteBits(ptr, offset, backoff_bits, backoff_code);
+  offset += backoff_bits;
+  WriteBits(ptr, offset, child_bits, child_end);
+}
+
+inline float CompactArpaLm::Backoff(int32 order, int64 index) const {
+  if (order == 1)
+    return unigram_backoffs_[index];
+  else
+    return levels_[order - 2].Backoff(index);
+}
+
+inline void CompactArpaLm::GetChildRange(int32 order, int64 index,
+                                         int64 *begin, int64 *end) const {
+  if (order == 1) {
+    *end = unigram_child_ends_[index];
+    *begin = (index == 0 ? 0 : unigram_child_ends_[index - 1]);
+  } else {
+    const Level &level = levels_[order - 2];
+    *end = level.ChildEnd(index);
+    *begin = (index == 0 ? 0 : level.ChildEnd(index - 1));
+  }
+}
+
+bool CompactArpaLm::FindChild(int32 order, int64 index, int32 word,
+                              int64 *child_index) const {
+  if (order >= NgramOrder())
+    return false;
+  int64 begin, end;
+  GetChildRange(order, index, &begin, &end);
+  const Level &level = levels_[order - 1];
+  // A binary search in [begin, end).
+  while (begin < end) {
+    int64 mid = begin + (end - begin) / 2;
+    int32 mid_word = level.Word(mid);
+    if (mid_word == word) {
+      *child_index = mid;
+      return true;
+    } else if (mid_word < word) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return false;
+}
+
+bool CompactArpaLm::FindNgram(const int32 *words, int32 length,
+                              int64 *index) const {
+  KALDI_ASSERT(length > 0);
+  if (!WordExists(words[0]))
+    return false;
+  *index = words[0];
+  for (int32 i = 1; i < length; i++)
+    if (!FindChild(i, *index, words[i], index))
+      return false;
+  return true;
+}
+
+float CompactArpaLm::GetNgramLogprob(int32 word,
+                                     const std::vector<int32> &hist) const {
+  int32 hist_size = hist.size();
+  KALDI_ASSERT(hist_size < NgramOrder());
+  // We try the histories hist[start ...] from the longest to the shortest,
+  // adding the backoffs of those that exist but do not have 'word' as a
+  // child.  This is the same as ConstArpaLm::GetNgramLogprobRecurse().
+  float backoff_logprob = 0.0;
+  for (int32 start = 0; start < hist_size; start++) {
+    int32 context_order = hist_size - start;
+    int64 context_index, index;
+    if (!FindNgram(&(hist[start]), context_order, &context_index))
+      continue;
+    if (FindChild(context_order, context_index, word, &index))
+      return backoff_logprob + levels_[context_order - 1].Logprob(index);
+    backoff_logprob += Backoff(context_order, context_index);
+  }
+  if (!WordExists(word))
+    return -std::numeric_limits<float>::infinity();
+  return backoff_logprob + unigram_logprobs_[word];
+}
+
+bool CompactArpaLm::HistoryStateExists(const std::vector<int32> &hist) const {
+  if (hist.empty())
+    return true;
+  int32 order = hist.size();
+  int64 index, begin, end;
+  if (order >= NgramOrder() || !FindNgram(&(hist[0]), order, &index))
+    return false;
+  GetChildRange(order, index, &begin, &end);
+  return end > begin;
+}
+
+void CompactArpaLm::GetNgramsRecurse(int32 order, int64 index,
+                                     std::vector<int32> *words,
+                                     std::vector<NGram> *ngrams) const {
+  NGram ngram;
+  ngram.words = *words;
+  ngram.logprob = (order == 1 ? unigram_logprobs_[index] :
+                   levels_[order - 2].Logprob(index));
+  ngram.backoff = Backoff(order, index);
+  ngrams->push_back(ngram);
+  if (order == NgramOrder())
+    return;
+  int64 begin, end;
+  GetChildRange(order, index, &begin, &end);
+  for (int64 c = begin; c < end; c++) {
+    words->push_back(levels_[order - 1].Word(c));
+    GetNgramsRecurse(order + 1, c, words, ngrams);
+    words->pop_back();
+  }
+}
+
+void CompactArpaLm::GetNgrams(std::vector<NGram> *ngrams) const {
+  ngrams->clear();
+  std::vector<int32> words(1);
+  for (int32 w = 0; w < num_words_; w++) {
+    if (unigram_exists_[w]) {
+      words[0] = w;
+      GetNgramsRecurse(1, w, &words, ngrams);
+    }
+  }
+}
+
+int64 CompactArpaLm::MemorySize() const {
+  int64 ans = unigram_exists_.size() * sizeof(uint8) +
+      (unigram_logprobs_.size() + unigram_backoffs_.size()) * sizeof(float) +
+      unigram_child_ends_.size() * sizeof(int64);
+  for (size_t i = 0; i < levels_.size(); i++)
+    ans += levels_[i].data.size() +
+        (levels_[i].logprob_codebook.size() +
+         levels_[i].backoff_codebook.size()) * sizeof(float);
+  return ans;
+}
+
+// Writes a vector of a plain-old-data type as its size (int64) and its raw
+// contents; ReadArray() reads it.  We do not use WriteIntegerVector() because
+// its size is an int32.
+template<class T>
+static void WriteArray(std::ostream &os, const std::vector<T> &v) {
+  int64 size = v.size();
+  WriteBasicType(os, true, size);
+  if (size != 0)
+    os.write(reinterpret_cast<const char*>(&(v[0])), sizeof(T) * size);
+}
+
+template<class T>
+static void ReadArray(std::istream &is, std::vector<T> *v) {
+  int64 size;
+  ReadBasicType(is, true, &size);
+  if (size < 0)
+    KALDI_ERR << "Bad array size " << size << " in CompactArpaLm.";
+  v->resize(size);
+  if (size != 0)
+    is.read(reinterpret_cast<char*>(&((*v)[0])), sizeof(T) * size);
+}
+
+void CompactArpaLm::Write(std::ostream &os, bool binary) const {
+  if (!binary) {
+    KALDI_ERR << "text-mode writing is not implemented for CompactArpaLm.";
+  }
+  WriteToken(os, binary, "<NumWords>");
+  WriteBasicType(os, binary, num_words_);
+  WriteToken(os, binary, "<NumLevels>");
+  WriteBasicType(os, binary, static_cast<int32>(levels_.size()));
+  WriteToken(os, binary, "<Unigrams>");
+  WriteArray(os, unigram_exists_);
+  WriteArray(os, unigram_logprobs_);
+  WriteArray(os, unigram_backoffs_);
+  WriteArray(os, unigram_child_ends_);
+  for (size_t i = 0; i < levels_.size(); i++) {
+    const Level &level = levels_[i];
+    WriteToken(os, binary, "<Level>");
+    WriteBasicType(os, binary, level.num_entries);
+    WriteBasicType(os, binary, level.word_bits);
+    WriteBasicType(os, binary, level.logprob_bits);
+    WriteBasicType(os, binary, level.backoff_bits);
+    WriteBasicType(os, binary, level.child_bits);
+    WriteArray(os, level.logprob_codebook);
+    WriteArray(os, level.backoff_codebook);
+    WriteArray(os, level.data);
+  }
+  if (!os.good()) {
+    KALDI_ERR << "CompactArpaLm writing failed.";
+  }
+}
+
+void CompactArpaLm::Read(std::istream &is, bool binary) {
+  if (!binary) {
+    KALDI_ERR << "text-mode reading is not implemented for CompactArpaLm.";
+  }
+  int32 num_levels;
+  ExpectToken(is, binary, "<NumWords>");
+  ReadBasicType(is, binary, &num_words_);
+  ExpectToken(is, binary, "<NumLevels>");
+  ReadBasicType(is, binary, &num_levels);
+  ExpectToken(is, binary, "<Unigrams>");
+  ReadArray(is, &unigram_exists_);
+  ReadArray(is, &unigram_logprobs_);
+  ReadArray(is, &unigram_backoffs_);
+  ReadArray(is, &unigram_child_ends_);
+  if (num_words_ <= 0 || num_levels < 0 ||
+      unigram_exists_.size() != num_words_ ||
+      unigram_logprobs_.size() != num_words_ ||
+      unigram_backoffs_.size() != num_words_ ||
+      unigram_child_ends_.size() != (num_levels > 0 ? num_words_ : 0)) {
+    KALDI_ERR << "CompactArpaLm: bad or inconsistent unigram section.";
+  }
+  levels_.resize(num_levels);
+  for (int32 i = 0; i < num_levels; i++) {
+    Level &level = levels_[i];
+    ExpectToken(is, binary, "<Level>");
+    ReadBasicType(is, binary, &level.num_entries);
+    ReadBasicType(is, binary, &level.word_bits);
+    ReadBasicType(is, binary, &level.logprob_bits);
+    ReadBasicType(is, binary, &level.backoff_bits);
+    ReadBasicType(is, binary, &level.child_bits);
+    ReadArray(is, &level.logprob_codebook);
+    ReadArray(is, &level.backoff_codebook);
+    ReadArray(is, &level.data);
+    bool highest = (i + 1 == num_levels);
+    if (level.num_entries < 0 || level.word_bits > 31 ||
+        level.logprob_bits > 16 || level.backoff_bits > 16 ||
+        level.child_bits > 57 || level.logprob_codebook.empty() ||
+        level.backoff_codebook.empty() != highest ||
+        level.data.size() != (level.num_entries * level.EntryBits() + 7) / 8 +
+        sizeof(uint64)) {
+      KALDI_ERR << "CompactArpaLm: bad or inconsistent section for order "
+                << (i + 2);
+    }
+  }
+  if (!is.good()) {
+    KALDI_ERR << "CompactArpaLm reading failed.";
+  }
+}
+
+
+// Computes the codebook for 'values' (which it sorts), with at most
+// 2^num_bits entries; see the comment for class CompactArpaLm.  If
+// 'exact_zero' is true and there are zeros in 'values', zero will be one of
+// the entries.  The codebook is sorted.
+static void ComputeCodebook(int32 num_bits, bool exact_zero,
+                            std::vector<float> *values,
+                            std::vector<float> *codebook) {
+  std::vector<float> &v = *values;
+  size_t max_size = static_cast<size_t>(1) << num_bits;
+  codebook->clear();
+  if (exact_zero) {
+    size_t size = v.size();
+    v.erase(std::remove(v.begin(), v.end(), 0.0f), v.end());
+    if (v.size() != size) {
+      codebook->push_back(0.0);
+      max_size--;
+    }
+  }
+  std::sort(v.begin(), v.end());
+  size_t num_distinct = (v.empty() ? 0 : 1);
+  for (size_t i = 1; i < v.size(); i++)
+    if (v[i] != v[i - 1])
+      num_distinct++;
+  if (num_distinct <= max_size) {
+    // The quantization is lossless.
+    for (size_t i = 0; i < v.size(); i++)
+      if (i == 0 || v[i] != v[i - 1])
+        codebook->push_back(v[i]);
+  } else {
+    // Bins with equal numbers of values, represented by their means.
+    for (size_t b = 0; b < max_size; b++) {
+      size_t begin = v.size() * b / max_size,
+          end = v.size() * (b + 1) / max_size;
+      double sum = 0.0;
+      for (size_t i = begin; i < end; i++)
+        sum += v[i];
+      codebook->push_back(sum / (end - begin));
+    }
+  }
+  if (codebook->empty())
+    codebook->push_back(0.0);
+  std::sort(codebook->begin(), codebook->end());
+  codebook->erase(std::unique(codebook->begin(), codebook->end()),
+                  codebook->end());
+}
+
+// Returns the index of the entry of 'codebook' (which is sorted) that is
+// closest to 'value'.
+static int32 EncodeValue(const std::vector<float> &codebook, float value) {
+  std::vector<float>::const_iterator iter =
+      std::lower_bound(codebook.begin(), codebook.end(), value);
+  if (iter == codebook.end())
+    return codebook.size() - 1;
+  int32 i = iter - codebook.begin();
+  if (i > 0 && value - codebook[i - 1] <= codebook[i] - value)
+    return i - 1;
+  return i;
+}
+
+struct NGramWordsLessThan {
+  bool operator()(const NGram &lhs, const NGram &rhs) const {
+    return lhs.words < rhs.words;
+  }
+};
+
+// Class to build CompactArpaLm from an Arpa format language model.  It keeps
+// all the n-grams in memory, sorts them by order and word sequence, and then
+// creates the levels of the trie.
+class CompactArpaLmBuilder : public ArpaFileParser {
+ public:
+  CompactArpaLmBuilder(const ArpaParseOptions &options, int32 quantize_bits,
+                       CompactArpaLm *lm)
+      : ArpaFileParser(options, NULL), quantize_bits_(quantize_bits),
+        lm_(lm) {
+    KALDI_ASSERT(quantize_bits_ > 0 && quantize_bits_ <= 16);
+  }
+
+ protected:
+  // ArpaFileParser overrides.
+  virtual void HeaderAvailable();
+  virtual void ConsumeNGram(const NGram &ngram);
+  virtual void ReadComplete();
+
+ private:
+  // Computes the ends of the child ranges of the n-grams of order 'order',
+  // for order < ngrams_.size(), i.e. for each n-gram the index of the first
+  // (order+1)-gram in ngrams_[order] that does not extend it or an earlier
+  // n-gram.  For order == 1 the n-grams are indexed by word id.
+  void ComputeChildEnds(int32 order, std::vector<int64> *child_ends) const;
+
+  int32 quantize_bits_;
+  CompactArpaLm *lm_;
+  // ngrams_[n] contains the n-grams of order n + 1.
+  std::vector<std::vector<NGram> > ngrams_;
+};
+
+void CompactArpaLmBuilder::HeaderAvailable() {
+  ngrams_.resize(NgramCounts().size());
+  for (size_t i = 0; i < ngrams_.size(); i++)
+    ngrams_[i].reserve(NgramCounts()[i]);
+}
+
+void CompactArpaLmBuilder::ConsumeNGram(const NGram &ngram) {
+  int32 order = ngram.words.size();
+  KALDI_ASSERT(order > 0 && order <= ngrams_.size());
+  ngrams_[order - 1].push_back(ngram);
+}
+
+void CompactArpaLmBuilder::ComputeChildEnds(
+    int32 order, std::vector<int64> *child_ends) const {
+  const std::vector<NGram> &children = ngrams_[order];
+  int64 num_children = children.size(), c = 0;
+  if (order == 1) {
+    child_ends->resize(lm_->num_words_);
+    for (int32 w = 0; w < lm_->num_words_; w++) {
+      if (lm_->unigram_exists_[w])
+        while (c < num_children && children[c].words[0] == w)
+          c++;
+      (*child_ends)[w] = c;
+    }
+  } else {
+    const std::vector<NGram> &parents = ngrams_[order - 1];
+    child_ends->resize(parents.size());
+    for (size_t p = 0; p < parents.size(); p++) {
+      while (c < num_children &&
+             std::equal(parents[p].words.begin(), parents[p].words.end(),
+                        children[c].words.begin()))
+        c++;
+      (*child_ends)[p] = c;
+    }
+  }
+  if (c != num_children) {
+    // Because both orders are sorted, we stop at the first (order+1)-gram
+    // whose history is not an n-gram.
+    std::ostringstream ss;
+    for (size_t i = 0; i < children[c].words.size(); i++)
+      ss << (i == 0 ? '[' : ' ') << children[c].words[i];
+    KALDI_ERR << (order + 1) << "-gram " << ss.str() << "] does not have "
+              << "a parent model " << order << "-gram.";
+  }
+}
+
+void CompactArpaLmBuilder::ReadComplete() {
+  int32 ngram_order = ngrams_.size();
+  KALDI_ASSERT(ngram_order > 0);
+  for (int32 n = 0; n < ngram_order; n++) {
+    std::vector<NGram> &ngrams = ngrams_[n];
+    std::sort(ngrams.begin(), ngrams.end(), NGramWordsLessThan());
+    for (size_t i = 1; i < ngrams.size(); i++) {
+      if (ngrams[i].words == ngrams[i - 1].words) {
+        std::ostringstream os;
+        os << "[ ";
+        for (size_t j = 0; j < ngrams[i].words.size(); j++)
+          os << ngrams[i].words[j] << " ";
+        os << "]";
+        KALDI_ERR << "N-gram " << os.str() << " appears twice in the arpa file";
+      }
+    }
+  }
+
+  // The unigrams.
+  const std::vector<NGram> &unigrams = ngrams_[0];
+  KALDI_ASSERT(!unigrams.empty());
+  int32 num_words = unigrams.back().words[0] + 1;
+  lm_->num_words_ = num_words;
+  lm_->unigram_exists_.assign(num_words, 0);
+  lm_->unigram_logprobs_.assign(num_words,
+                                -std::numeric_limits<float>::infinity());
+  lm_->unigram_backoffs_.assign(num_words, 0.0);
+  for (size_t i = 0; i < unigrams.size(); i++) {
+    int32 w = unigrams[i].words[0];
+    KALDI_ASSERT(w >= 0);
+    lm_->unigram_exists_[w] = 1;
+    lm_->unigram_logprobs_[w] = unigrams[i].logprob;
+    lm_->unigram_backoffs_[w] = unigrams[i].backoff;
+  }
+
+  // The higher orders.  child_ends is for the order below the current one.
+  lm_->levels_.resize(ngram_order - 1);
+  lm_->unigram_child_ends_.clear();
+  if (ngram_order > 1)
+    ComputeChildEnds(1, &(lm_->unigram_child_ends_));
+  for (int32 order = 2; order <= ngram_order; order++) {
+    const std::vector<NGram> &ngrams = ngrams_[order - 1];
+    CompactArpaLm::Level &level = lm_->levels_[order - 2];
+    bool highest = (order == ngram_order);
+    std::vector<int64> child_ends;
+    if (!highest)
+      ComputeChildEnds(order, &child_ends);
+
+    level.num_entries = ngrams.size();
+    level.word_bits = NumBitsFor(num_words - 1);
+    std::vector<float> values(ngrams.size());
+    for (size_t i = 0; i < ngrams.size(); i++)
+      values[i] = ngrams[i].logprob;
+    ComputeCodebook(quantize_bits_, false, &values, &level.logprob_codebook);
+    level.logprob_bits = NumBitsFor(level.logprob_codebook.size() - 1);
+    if (!highest) {
+      for (size_t i = 0; i < ngrams.size(); i++)
+        values[i] = ngrams[i].backoff;
+      ComputeCodebook(quantize_bits_, true, &values, &level.backoff_codebook);
+      level.backoff_bits = NumBitsFor(level.backoff_codebook.size() - 1);
+      level.child_bits = NumBitsFor(ngrams_[order].size());
+    }
+    level.Allocate();
+    for (size_t i = 0; i < ngrams.size(); i++) {
+      if (ngrams[i].words.back() >= num_words)
+        KALDI_ERR << "Word " << ngrams[i].words.back() << " appears in a "
+                  << order << "-gram but not as a unigram.";
+      level.SetEntry(i, ngrams[i].words.back(),
+                     EncodeValue(level.logprob_codebook, ngrams[i].logprob),
+                     (highest ? 0 : EncodeValue(level.backoff_codebook,
+                                                ngrams[i].backoff)),
+                     (highest ? 0 : child_ends[i]));
+    }
+    KALDI_VLOG(1) << "Order " << order << " has " << level.num_entries
+                  << " n-grams of " << level.EntryBits() << " bits each, "
+                  << "with " << level.logprob_codebook.size()
+                  << " distinct log-probs and "
+                  << level.backoff_codebook.size() << " distinct backoffs.";
+  }
+  ngrams_.clear();
+}
+
+bool BuildCompactArpaLm(const ArpaParseOptions &options,
+                        int32 quantize_bits,
+                        const std::string &arpa_rxfilename,
+                        const std::string &const_arpa_wxfilename) {
+  if (quantize_bits <= 0 || quantize_bits > 16)
+    KALDI_ERR << "Invalid number of quantization bits " << quantize_bits
+              << ", must be in the range [1, 16].";
+  CompactArpaLm *compact_lm = new CompactArpaLm();
+  {
+    CompactArpaLmBuilder lm_builder(options, quantize_bits, compact_lm);
+    KALDI_LOG << "Reading " << arpa_rxfilename;
+    Input ki(arpa_rxfilename);
+    lm_builder.Read(ki.Stream());
+  }
+  KALDI_LOG << "The compact language model uses "
+            << compact_lm->MemorySize() << " bytes.";
+  // const_arpa_lm takes ownership of compact_lm.
+  ConstArpaLm const_arpa_lm(options.bos_symbol, options.eos_symbol,
+                            options.unk_symbol, compact_lm);
+  WriteKaldiObject(const_arpa_lm, const_arpa_wxfilename, true);
+  return true;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,176 @@
+// lm/compact-arpa-lm.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_COMPACT_ARPA_LM_H_
+#define KALDI_LM_COMPACT_ARPA_LM_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "lm/arpa-file-parser.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+/**
+   CompactArpaLm is a compressed, read-only representation of a backoff n-gram
+   language model, which takes about a third to a quarter of the memory of the
+   normal ConstArpaLm representation.  It is not normally used directly: a
+   ConstArpaLm file written by "arpa-to-const-arpa --compact=true" contains a
+   CompactArpaLm, and ConstArpaLm then forwards its lookups to it, so programs
+   that use ConstArpaLm can use either format.
+
+   The layout is a trie stored level by level, as in KenLM and BerkeleyLM.
+   The n-grams of each order are stored in lexicographic order (of the word
+   sequence), so the children of an n-gram (i.e. the (n+1)-grams that extend
+   it) are a contiguous range of the next level, and the ranges of successive
+   n-grams are adjacent.  We therefore only store, for each n-gram that is not
+   of the highest order, the end of its child range; the beginning is the end
+   of the previous n-gram's range.  The unigrams are indexed directly by word
+   id and their log-probs and backoffs are stored as floats.  For the higher
+   orders, each n-gram is a fixed-size record of bit-packed fields:
+      word            (just enough bits for the largest word id)
+      logprob code    (an index into a codebook; see below)
+      backoff code    (not for the highest order)
+      child-range end (just enough bits for the size of the next level)
+   so the children of an n-gram can be found by a binary search on the words
+   in its child range.
+
+   The log-probs and backoffs of each order are quantized to at most
+   2^quantize_bits values (the codebook), chosen by dividing the sorted values
+   into bins with equal numbers of values and taking the mean of each bin.
+   Zero backoffs, which are very common, are always represented exactly.  If
+   there are no more distinct values than codebook entries, the quantization is
+   lossless.
+ */
+class CompactArpaLm {
+ public:
+  CompactArpaLm(): num_words_(0) { }
+
+  int32 NgramOrder() const { return levels_.size() + 1; }
+
+  // Returns true if 'word' is a unigram of the language model.
+  bool WordExists(int32 word) const {
+    return word >= 0 && word < num_words_ && unigram_exists_[word] != 0;
+  }
+
+  // Returns the log-prob of 'word' given the history 'hist' (oldest word
+  // first), with backoff.  'hist' must have at most NgramOrder() - 1 words,
+  // and it is not mapped to <unk>; see ConstArpaLm::GetNgramLogprob(), which
+  // does that and then calls this.  Returns -infinity if 'word' is not in the
+  // language model.
+  float GetNgramLogprob(int32 word, const std::vector<int32> &hist) const;
+
+  // Returns true if the word sequence 'hist' is an n-gram that has
+  // successors; see ConstArpaLm::HistoryStateExists().
+  bool HistoryStateExists(const std::vector<int32> &hist) const;
+
+  // Outputs all n-grams of the model, with their (quantized) log-probs and
+  // backoffs.  This will be useful in testing.
+  void GetNgrams(std::vector<NGram> *ngrams) const;
+
+  // Returns the approximate memory used, in bytes.
+  int64 MemorySize() const;
+
+  // Writes and reads the model.  The caller (ConstArpaLm) writes the
+  // enclosing tokens.  Only binary mode is supported.
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+
+ private:
+  friend class CompactArpaLmBuilder;
+
+  // The n-grams of one order greater than one, in lexicographic order.
+  struct Level {
+    int64 num_entries;
+    // The widths of the fields of each entry, in bits; backoff_bits and
+    // child_bits are zero for the highest order.
+    int32 word_bits;
+    int32 logprob_bits;
+    int32 backoff_bits;
+    int32 child_bits;
+    std::vector<float> logprob_codebook;
+    std::vector<float> backoff_codebook;
+    // The bit-packed entries (num_entries * EntryBits() bits), followed by
+    // some padding so that we can read any field with one 64-bit load.
+    std::vector<char> data;
+
+    Level(): num_entries(0), word_bits(0), logprob_bits(0), backoff_bits(0),
+             child_bits(0) { }
+    int32 EntryBits() const {
+      return word_bits + logprob_bits + backoff_bits + child_bits;
+    }
+    // Allocates 'data' (zeroed) once num_entries and the widths are set.
+    void Allocate();
+    inline int32 Word(int64 i) const;
+    inline float Logprob(int64 i) const;
+    inline float Backoff(int64 i) const;
+    inline int64 ChildEnd(int64 i) const;
+    void SetEntry(int64 i, int32 word, int32 logprob_code, int32 backoff_code,
+                  int64 child_end);
+  };
+
+  // Returns the range [*begin, *end) of the children of n-gram 'index' of
+  // order 'order' (which is the word id if order == 1), as indexes into
+  // levels_[order - 1].  Requires order < NgramOrder().
+  inline void GetChildRange(int32 order, int64 index,
+                            int64 *begin, int64 *end) const;
+
+  // Returns the backoff of n-gram 'index' of order 'order' (zero for the
+  // highest order).
+  inline float Backoff(int32 order, int64 index) const;
+
+  // Looks for 'word' among the children of n-gram 'index' of order 'order';
+  // if found, sets *child_index to its index in levels_[order - 1] and returns
+  // true.
+  bool FindChild(int32 order, int64 index, int32 word,
+                 int64 *child_index) const;
+
+  // Looks for the n-gram words[0 .. length-1]; if found, sets *index to its
+  // index (the word id if length == 1) and returns true.
+  bool FindNgram(const int32 *words, int32 length, int64 *index) const;
+
+  void GetNgramsRecurse(int32 order, int64 index, std::vector<int32> *words,
+                        std::vector<NGram> *ngrams) const;
+
+  // Index of the largest word-id plus one.
+  int32 num_words_;
+  // The following are indexed by word id.
+  std::vector<uint8> unigram_exists_;
+  std::vector<float> unigram_logprobs_;
+  std::vector<float> unigram_backoffs_;
+  // The end of the range of children of each unigram in levels_[0] (empty if
+  // this is a unigram model).
+  std::vector<int64> unigram_child_ends_;
+  // levels_[n] contains the n-grams of order n + 2.
+  std::vector<Level> levels_;
+};
+
+
+// Reads in an Arpa format language model whose words have been converted into
+// integers (as for BuildConstArpaLm()) and writes it as a ConstArpaLm that
+// uses the compact representation, with the log-probs and backoffs quantized
+// to 'quantize_bits' bits (at most 16).
+bool BuildCompactArpaLm(const ArpaParseOptions &options,
+                        int32 quantize_bits,
+                        const std::string &arpa_rxfilename,
+                        const std::string &const_arpa_wxfilename);
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_COMPACT_ARPA_LM_H_
@@ -0,0 +1,247 @@
+// lm/const-arpa-lm-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <set>
+
+#include "base/kaldi-common.h"
+#include "lm/compact-arpa-lm.h"
+#include "lm/const-arpa-lm.h"
+
+namespace kaldi {
+
+// Writes a random backoff language model of order 'ngram_order', whose words
+// are the integers 1 .. num_words (with 1 = <s>, 2 = </s>, 3 = <unk>), to
+// 'filename' in Arpa format.
+static void WriteRandomArpaLm(int32 ngram_order, int32 num_words,
+                              const std::string &filename) {
+  std::vector<std::set<std::vector<int32> > > ngrams(ngram_order);
+  for (int32 w = 1; w <= num_words; w++)
+    ngrams[0].insert(std::vector<int32>(1, w));
+  for (int32 n = 1; n < ngram_order; n++) {
+    // Extend some of the n-grams of the previous order, so that every n-gram
+    // has a parent.
+    std::set<std::vector<int32> >::const_iterator iter = ngrams[n - 1].begin();
+    for (; iter != ngrams[n - 1].end(); ++iter) {
+      if (RandInt(0, 2) == 0) continue;
+      int32 num_children = RandInt(1, 4);
+      for (int32 c = 0; c < num_children; c++) {
+        std::vector<int32> ngram(*iter);
+        ngram.push_back(RandInt(2, num_words));
+        ngrams[n].insert(ngram);
+      }
+    }
+    if (ngrams[n].empty()) {
+      std::vector<int32> ngram(*(ngrams[n - 1].begin()));
+      ngram.push_back(2);
+      ngrams[n].insert(ngram);
+    }
+  }
+  Output ko(filename, false);
+  std::ostream &os = ko.Stream();
+  os << "\\data\\\n";
+  for (int32 n = 0; n < ngram_order; n++)
+    os << "ngram " << (n + 1) << "=" << ngrams[n].size() << "\n";
+  for (int32 n = 0; n < ngram_order; n++) {
+    os << "\n\\" << (n + 1) << "-grams:\n";
+    std::set<std::vector<int32> >::const_iterator iter = ngrams[n].begin();
+    for (; iter != ngrams[n].end(); ++iter) {
+      // Random log-probs on a coarse grid, so that there are fewer distinct
+      // values than 2^16.
+      os << (n == 0 && (*iter)[0] == 1 ? -99.0 : -0.001 * RandInt(1, 5000));
+      for (size_t i = 0; i < iter->size(); i++)
+        os << ' ' << (*iter)[i];
+      if (n + 1 < ngram_order && RandInt(0, 1) == 0)
+        os << ' ' << (-0.001 * RandInt(1, 2000));
+      os << '\n';
+    }
+  }
+  os << "\n\\end\\\n";
+}
+
+// Returns a random history, which may contain words that are not in the
+// language model.
+static std::vector<int32> RandomHistory(int32 ngram_order, int32 num_words) {
+  std::vector<int32> hist(RandInt(0, ngram_order + 1));
+  for (size_t i = 0; i < hist.size(); i++)
+    hist[i] = RandInt(1, num_words + 1);
+  if (!hist.empty() && RandInt(0, 1) == 0)
+    hist[0] = 1;
+  return hist;
+}
+
+// Checks that the page-aligned format and the memory-mapped reading give the
+// same results as the normal ConstArpaLm, that the compact representation with
+// enough bits to be lossless gives the same results (up to the last bit of the
+// float, which the normal representation loses for some n-grams), and that the
+// quantized compact representation gives similar results.
+void UnitTestConstArpaLm() {
+  int32 ngram_order = RandInt(1, 4), num_words = RandInt(4, 100);
+  bool use_unk = (RandInt(0, 1) == 0);
+  std::string arpa_filename = "tmp.arpa", lm_filename = "tmp.carpa",
+      aligned_filename = "tmp.aligned.carpa",
+      compact_filename = "tmp.compact.carpa",
+      quantized_filename = "tmp.quantized.carpa";
+  WriteRandomArpaLm(ngram_order, num_words, arpa_filename);
+
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  options.unk_symbol = (use_unk ? 3 : -1);
+  BuildConstArpaLm(options, arpa_filename, lm_filename);
+  BuildConstArpaLm(options, arpa_filename, aligned_filename, true);
+  BuildCompactArpaLm(options, 16, arpa_filename, compact_filename);
+  BuildCompactArpaLm(options, 8, arpa_filename, quantized_filename);
+
+  ConstArpaLm lm, aligned_lm, mapped_lm, compact_lm, quantized_lm;
+  ReadKaldiObject(lm_filename, &lm);
+  ReadKaldiObject(aligned_filename, &aligned_lm);
+  mapped_lm.ReadMapped(aligned_filename);
+  ReadKaldiObject(compact_filename, &compact_lm);
+  ReadKaldiObject(quantized_filename, &quantized_lm);
+  KALDI_ASSERT(!lm.IsCompact() && compact_lm.IsCompact() &&
+               compact_lm.NgramOrder() == ngram_order);
+
+  // Compare the number of lines of the Arpa files; the log-probs are compared
+  // below.
+  std::ostringstream arpa, compact_arpa;
+  lm.WriteArpa(arpa);
+  compact_lm.WriteArpa(compact_arpa);
+  std::string arpa_str = arpa.str(), compact_arpa_str = compact_arpa.str();
+  KALDI_ASSERT(std::count(arpa_str.begin(), arpa_str.end(), '\n') ==
+               std::count(compact_arpa_str.begin(), compact_arpa_str.end(),
+                          '\n'));
+
+  for (int32 i = 0; i < 500; i++) {
+    std::vector<int32> hist = RandomHistory(ngram_order, num_words);
+    int32 word = RandInt(2, num_words + 1);
+    float logprob = lm.GetNgramLogprob(word, hist);
+    KALDI_ASSERT(aligned_lm.GetNgramLogprob(word, hist) == logprob);
+    KALDI_ASSERT(mapped_lm.GetNgramLogprob(word, hist) == logprob);
+    float compact_logprob = compact_lm.GetNgramLogprob(word, hist),
+        quantized_logprob = quantized_lm.GetNgramLogprob(word, hist);
+    if (logprob == -std::numeric_limits<float>::infinity()) {
+      KALDI_ASSERT(compact_logprob == logprob && quantized_logprob == logprob);
+    } else {
+      KALDI_ASSERT(std::abs(compact_logprob - logprob) < 1.0e-04);
+      KALDI_ASSERT(std::abs(quantized_logprob - logprob) < 0.5);
+    }
+    if (hist.size() < ngram_order) {
+      bool exists = lm.HistoryStateExists(hist);
+      KALDI_ASSERT(mapped_lm.HistoryStateExists(hist) == exists);
+      KALDI_ASSERT(compact_lm.HistoryStateExists(hist) == exists);
+      KALDI_ASSERT(quantized_lm.HistoryStateExists(hist) == exists);
+    }
+  }
+  std::remove(arpa_filename.c_str());
+  std::remove(lm_filename.c_str());
+  std::remove(aligned_filename.c_str());
+  std::remove(compact_filename.c_str());
+  std::remove(quantized_filename.c_str());
+}
+
+// Checks the least-recently-used replacement of ConstArpaLmCache, with a
+// single shard so that the order is exact.
+void UnitTestConstArpaLmCacheLru() {
+  int32 capacity = RandInt(1, 10);
+  ConstArpaLmCache cache(capacity, 1);
+  std::vector<std::vector<int32> > hists;
+  for (int32 i = 0; i <= capacity; i++) {
+    std::vector<int32> hist(RandInt(0, 3), 5);
+    hist.push_back(i);
+    hists.push_back(hist);
+  }
+  for (int32 i = 0; i < capacity; i++)
+    cache.Insert(hists[i], 7, -0.5 * i, i % 3);
+  KALDI_ASSERT(cache.Size() == static_cast<size_t>(capacity));
+  // Touch the oldest entry; then inserting one more should remove the second
+  // oldest one (unless the capacity is 1).
+  float logprob;
+  int32 next_hist_length;
+  KALDI_ASSERT(cache.Lookup(hists[0], 7, &logprob, &next_hist_length) &&
+               logprob == 0.0 && next_hist_length == 0);
+  KALDI_ASSERT(!cache.Lookup(hists[0], 8, &logprob, &next_hist_length));
+  cache.Insert(hists[capacity], 7, 1.0, 2);
+  KALDI_ASSERT(cache.Size() == static_cast<size_t>(capacity));
+  if (capacity == 1) {
+    KALDI_ASSERT(!cache.Lookup(hists[0], 7, &logprob, &next_hist_length));
+  } else {
+    KALDI_ASSERT(cache.Lookup(hists[0], 7, &logprob, &next_hist_length));
+    KALDI_ASSERT(!cache.Lookup(hists[1], 7, &logprob, &next_hist_length));
+  }
+  KALDI_ASSERT(cache.Lookup(hists[capacity], 7, &logprob,
+                            &next_hist_length) &&
+               logprob == 1.0 && next_hist_length == 2);
+}
+
+// Checks that ConstArpaLmDeterministicFst gives the same arcs and final-probs
+// with a small shared ConstArpaLmCache, in which entries are replaced all the
+// time, as without one.
+void UnitTestConstArpaLmCache() {
+  int32 ngram_order = RandInt(1, 4), num_words = RandInt(4, 100);
+  std::string arpa_filename = "tmp.arpa", lm_filename = "tmp.carpa";
+  WriteRandomArpaLm(ngram_order, num_words, arpa_filename);
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  options.unk_symbol = (RandInt(0, 1) == 0 ? 3 : -1);
+  BuildConstArpaLm(options, arpa_filename, lm_filename);
+  ConstArpaLm lm;
+  ReadKaldiObject(lm_filename, &lm);
+
+  int32 capacity = RandInt(1, 30);
+  ConstArpaLmCache cache(capacity, RandInt(1, 4));
+  for (int32 utt = 0; utt < 10; utt++) {
+    ConstArpaLmDeterministicFst lm_fst(lm), cached_lm_fst(lm, &cache);
+    KALDI_ASSERT(lm_fst.Start() == cached_lm_fst.Start());
+    for (int32 path = 0; path < 20; path++) {
+      fst::StdArc::StateId s = lm_fst.Start();
+      int32 length = RandInt(0, 10);
+      for (int32 i = 0; i < length; i++) {
+        KALDI_ASSERT(lm_fst.Final(s) == cached_lm_fst.Final(s));
+        int32 word = RandInt(2, num_words + 1);
+        fst::StdArc arc, cached_arc;
+        bool ok = lm_fst.GetArc(s, word, &arc);
+        KALDI_ASSERT(cached_lm_fst.GetArc(s, word, &cached_arc) == ok);
+        if (!ok)
+          break;
+        KALDI_ASSERT(arc.weight == cached_arc.weight &&
+                     arc.nextstate == cached_arc.nextstate);
+        s = arc.nextstate;
+      }
+    }
+    KALDI_ASSERT(cache.Size() <= static_cast<size_t>(capacity));
+  }
+  std::remove(arpa_filename.c_str());
+  std::remove(lm_filename.c_str());
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 20; i++)
+    kaldi::UnitTestConstArpaLm();
+  for (int32 i = 0; i < 20; i++) {
+    kaldi::UnitTestConstArpaLmCacheLru();
+    kaldi::UnitTestConstArpaLmCache();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -18,12 +18,20 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <limits>
 #include <sstream>
 #include <utility>
+#if !defined(_MSC_VER)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "base/kaldi-math.h"
 #include "lm/arpa-file-parser.h"
+#include "lm/compact-arpa-lm.h"
 #include "lm/const-arpa-lm.h"
 #include "util/stl-utils.h"
 #include "util/text-utils.h"
@@ -202,8 +210,8 @@ class ConstArpaLmBuilder : public ArpaFileParser {
     }
   }
 
-  // Writes ConstArpaLm.
-  void Write(std::ostream &os, bool binary) const;
+  // Writes ConstArpaLm.  See ConstArpaLm::Write() for 'page_align'.
+  void Write(std::ostream &os, bool binary, bool page_align = false) const;
 
   void SetMaxAddressOffset(const int32 max_address_offset) {
     KALDI_WARN << "You are changing <max_address_offset_>; the default should "
@@ -480,7 +488,8 @@ void ConstArpaLmBuilder::ReadComplete() {
   is_built_ = true;
 }
 
-void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
+void ConstArpaLmBuilder::Write(std::ostream &os, bool binary,
+                               bool page_align) const {
   if (!binary) {
     KALDI_ERR << "text-mode writing is not implemented for ConstArpaLmBuilder.";
   }
@@ -491,10 +500,48 @@ void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
       Options().bos_symbol, Options().eos_symbol, Options().unk_symbol,
       ngram_order_, num_words_, overflow_buffer_size_, lm_states_size_,
       unigram_states_, overflow_buffer_, lm_states_);
-  const_arpa_lm.Write(os, binary);
+  const_arpa_lm.Write(os, binary, page_align);
 }
 
-void ConstArpaLm::Write(std::ostream &os, bool binary) const {
+// The alignment, in bytes, of the <LmStates> data in files written with
+// page_align == true.  Mapping only requires the data to be aligned for int32
+// (we map from the preceding page boundary), but aligning it to a page means
+// that the mapping does not include any of the header.
+static const int32 kConstArpaLmPageSize = 4096;
+
+ConstArpaLm::ConstArpaLm(const int32 bos_symbol, const int32 eos_symbol,
+                         const int32 unk_symbol, CompactArpaLm *compact_lm) :
+    bos_symbol_(bos_symbol), eos_symbol_(eos_symbol),
+    unk_symbol_(unk_symbol), ngram_order_(compact_lm->NgramOrder()),
+    num_words_(0), overflow_buffer_size_(0), lm_states_size_(0),
+    lm_states_end_(NULL), unigram_states_(NULL), overflow_buffer_(NULL),
+    lm_states_(NULL) {
+  KALDI_ASSERT(compact_lm->WordExists(bos_symbol_));
+  KALDI_ASSERT(compact_lm->WordExists(eos_symbol_));
+  KALDI_ASSERT(unk_symbol_ == -1 || compact_lm->WordExists(unk_symbol_));
+  mapped_address_ = NULL;
+  mapped_size_ = 0;
+  compact_lm_ = compact_lm;
+  memory_assigned_ = false;
+  initialized_ = true;
+}
+
+ConstArpaLm::~ConstArpaLm() {
+  delete compact_lm_;
+  if (memory_assigned_) {
+    if (mapped_address_ != NULL) {
+#if !defined(_MSC_VER)
+      munmap(mapped_address_, mapped_size_);
+#endif
+    } else {
+      delete[] lm_states_;
+    }
+    delete[] unigram_states_;
+    delete[] overflow_buffer_;
+  }
+}
+
+void ConstArpaLm::Write(std::ostream &os, bool binary, bool page_align) const {
   KALDI_ASSERT(initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode writing is not implemented for ConstArpaLm.";
@@ -510,9 +557,41 @@ void ConstArpaLm::Write(std::ostream &os, bool binary) const {
   WriteBasicType(os, binary, ngram_order_);
   WriteToken(os, binary, "</LmInfo>");
 
-  // LmStates section.
-  WriteToken(os, binary, "<LmStates>");
-  WriteBasicType(os, binary, lm_states_size_);
+  if (compact_lm_ != NULL) {
+    if (page_align) {
+      KALDI_ERR << "ConstArpaLm in the compact representation cannot be "
+                << "written page-aligned.";
+    }
+    WriteToken(os, binary, "<CompactLm>");
+    compact_lm_->Write(os, binary);
+    WriteToken(os, binary, "</CompactLm>");
+    WriteToken(os, binary, "</ConstArpaLm>");
+    return;
+  }
+
+  // LmStates section.  If page_align is true we write the number of padding
+  // bytes and then that many zero bytes, so that the data starts at a multiple
+  // of kConstArpaLmPageSize.
+  if (page_align) {
+    WriteToken(os, binary, "<LmStatesAligned>");
+    WriteBasicType(os, binary, lm_states_size_);
+    int64 pos = os.tellp();
+    if (pos < 0) {
+      KALDI_ERR << "Cannot page-align ConstArpaLm: the output is not a file "
+                << "(or we cannot get its position).";
+    }
+    // WriteBasicType() writes a size byte followed by the int32.
+    int64 data_pos = pos + 1 + sizeof(int32);
+    int32 pad_size = (kConstArpaLmPageSize -
+                      data_pos % kConstArpaLmPageSize) % kConstArpaLmPageSize;
+    WriteBasicType(os, binary, pad_size);
+    std::vector<char> padding(pad_size, 0);
+    os.write(padding.data(), pad_size);
+    KALDI_ASSERT(!os.good() || os.tellp() == data_pos + pad_size);
+  } else {
+    WriteToken(os, binary, "<LmStates>");
+    WriteBasicType(os, binary, lm_states_size_);
+  }
   os.write(reinterpret_cast<char *>(lm_states_),
            sizeof(int32) * lm_states_size_);
   if (!os.good()) {
@@ -584,7 +663,62 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
   }
 }
 
-void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
+void ConstArpaLm::ReadMapped(const std::string &filename) {
+  KALDI_ASSERT(!initialized_);
+  if (ClassifyRxfilename(filename) != kFileInput) {
+    KALDI_ERR << "ConstArpaLm::ReadMapped() requires an ordinary file, got "
+              << PrintableRxfilename(filename);
+  }
+  bool binary;
+  Input ki(filename, &binary);
+  if (!binary) {
+    KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
+  }
+  std::istream &is = ki.Stream();
+  if (is.peek() == 4) {  // Old on-disk format; see Read().
+    KALDI_WARN << "ConstArpaLm in " << filename << " is in the old format, "
+               << "which cannot be mapped into memory; reading it instead.";
+    ReadInternalOldFormat(is, binary);
+  } else {
+    ReadInternal(is, binary, filename);
+  }
+}
+
+// Maps 'size' bytes of the file 'filename', starting at byte 'offset', into
+// memory (read-only and shared between processes).  Outputs the address and
+// size of the whole mapping, which starts at a page boundary, and returns the
+// address corresponding to 'offset'.
+static char* MapFileRegion(const std::string &filename, int64 offset,
+                           int64 size, void **mapped_address,
+                           size_t *mapped_size) {
+#if !defined(_MSC_VER)
+  int64 page_size = sysconf(_SC_PAGESIZE),
+      map_offset = offset - offset % page_size;
+  *mapped_size = static_cast<size_t>(offset - map_offset + size);
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    KALDI_ERR << "Could not open " << filename << " for mapping: "
+              << strerror(errno);
+  }
+  void *address = mmap(NULL, *mapped_size, PROT_READ, MAP_SHARED, fd,
+                       static_cast<off_t>(map_offset));
+  int saved_errno = errno;
+  close(fd);  // The mapping stays valid after the file is closed.
+  if (address == MAP_FAILED) {
+    KALDI_ERR << "Could not map " << *mapped_size << " bytes of " << filename
+              << " into memory: " << strerror(saved_errno);
+  }
+  *mapped_address = address;
+  return static_cast<char*>(address) + (offset - map_offset);
+#else
+  KALDI_ERR << "Mapping ConstArpaLm files into memory is not supported on "
+            << "this platform.";
+  return NULL;
+#endif
+}
+
+void ConstArpaLm::ReadInternal(std::istream &is, bool binary,
+                               const std::string &map_filename) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
@@ -600,12 +734,61 @@ void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   ReadBasicType(is, binary, &ngram_order_);
   ExpectToken(is, binary, "</LmInfo>");
 
-  // LmStates section.
-  ExpectToken(is, binary, "<LmStates>");
+  // LmStates section.  See Write() for the page-aligned version, and for the
+  // compact representation, which has a <CompactLm> section instead.
+  std::string token;
+  ReadToken(is, binary, &token);
+  if (token == "<CompactLm>") {
+    if (!map_filename.empty()) {
+      KALDI_WARN << "ConstArpaLm in " << map_filename << " is in the compact "
+                 << "representation, which cannot be mapped into memory; "
+                 << "reading it instead.";
+    }
+    compact_lm_ = new CompactArpaLm();
+    compact_lm_->Read(is, binary);
+    ExpectToken(is, binary, "</CompactLm>");
+    ExpectToken(is, binary, "</ConstArpaLm>");
+    if (compact_lm_->NgramOrder() != ngram_order_ ||
+        !compact_lm_->WordExists(bos_symbol_) ||
+        !compact_lm_->WordExists(eos_symbol_) ||
+        !(unk_symbol_ == -1 || compact_lm_->WordExists(unk_symbol_))) {
+      KALDI_ERR << "ConstArpaLm: the compact model does not match its header.";
+    }
+    initialized_ = true;
+    return;
+  }
+  bool aligned = (token == "<LmStatesAligned>");
+  if (!aligned && token != "<LmStates>") {
+    KALDI_ERR << "Expected token <LmStates>, <LmStatesAligned> or "
+              << "<CompactLm>, got " << token;
+  }
   ReadBasicType(is, binary, &lm_states_size_);
-  lm_states_ = new int32[lm_states_size_];
-  is.read(reinterpret_cast<char *>(lm_states_),
-          sizeof(int32) * lm_states_size_);
+  if (aligned) {
+    int32 pad_size;
+    ReadBasicType(is, binary, &pad_size);
+    is.ignore(pad_size);
+  }
+  if (aligned && !map_filename.empty()) {
+    int64 offset = is.tellg();
+    if (offset < 0 || offset % sizeof(int32) != 0) {
+      KALDI_ERR << "ConstArpaLm <LmStates> section in " << map_filename
+                << " is at an unexpected position " << offset;
+    }
+    char *data = MapFileRegion(map_filename, offset,
+                               sizeof(int32) * lm_states_size_,
+                               &mapped_address_, &mapped_size_);
+    lm_states_ = reinterpret_cast<int32*>(data);
+    is.seekg(sizeof(int32) * lm_states_size_, std::ios::cur);
+  } else {
+    if (!map_filename.empty()) {
+      KALDI_WARN << "ConstArpaLm in " << map_filename << " was not written "
+                 << "page-aligned (see arpa-to-const-arpa --page-align), so it "
+                 << "cannot be mapped into memory; reading it instead.";
+    }
+    lm_states_ = new int32[lm_states_size_];
+    is.read(reinterpret_cast<char *>(lm_states_),
+            sizeof(int32) * lm_states_size_);
+  }
   if (!is.good()) {
     KALDI_ERR << "ConstArpaLm <LmStates> section reading failed.";
   }
@@ -725,6 +908,9 @@ bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
     return true;
   }
 
+  if (compact_lm_ != NULL)
+    return compact_lm_->HistoryStateExists(hist);
+
   // Tries to locate the LmState of the given word sequence.
   int32* lm_state = GetLmState(hist);
   if (lm_state == NULL) {
@@ -764,22 +950,29 @@ float ConstArpaLm::GetNgramLogprob(const int32 word,
   int32 mapped_word = word;
   if (unk_symbol_ != -1) {
     KALDI_ASSERT(mapped_word >= 0);
-    if (mapped_word >= num_words_ || unigram_states_[mapped_word] == NULL) {
+    if (!WordExists(mapped_word)) {
       mapped_word = unk_symbol_;
     }
     for (int32 i = 0; i < mapped_hist.size(); ++i) {
       KALDI_ASSERT(mapped_hist[i] >= 0);
-      if (mapped_hist[i] >= num_words_ ||
-          unigram_states_[mapped_hist[i]] == NULL) {
+      if (!WordExists(mapped_hist[i])) {
         mapped_hist[i] = unk_symbol_;
       }
     }
   }
 
   // Loops up n-gram probability.
+  if (compact_lm_ != NULL)
+    return compact_lm_->GetNgramLogprob(mapped_word, mapped_hist);
   return GetNgramLogprobRecurse(mapped_word, mapped_hist);
 }
 
+bool ConstArpaLm::WordExists(int32 word) const {
+  if (compact_lm_ != NULL)
+    return compact_lm_->WordExists(word);
+  return word < num_words_ && unigram_states_[word] != NULL;
+}
+
 float ConstArpaLm::GetNgramLogprobRecurse(
     const int32 word, const std::vector<int32>& hist) const {
   KALDI_ASSERT(initialized_);
@@ -953,6 +1146,16 @@ void ConstArpaLm::WriteArpa(std::ostream &os) const {
   KALDI_ASSERT(initialized_);
 
   std::vector<ArpaLine> tmp_output;
+  if (compact_lm_ != NULL) {
+    std::vector<NGram> ngrams;
+    compact_lm_->GetNgrams(&ngrams);
+    tmp_output.resize(ngrams.size());
+    for (size_t i = 0; i < ngrams.size(); ++i) {
+      tmp_output[i].words.swap(ngrams[i].words);
+      tmp_output[i].logprob = ngrams[i].logprob;
+      tmp_output[i].backoff_logprob = ngrams[i].backoff;
+    }
+  }
   for (int32 i = 0; i < num_words_; ++i) {
     if (unigram_states_[i] != NULL) {
       std::vector<int32> seq(1, i);
@@ -1010,20 +1213,160 @@ void ConstArpaLm::WriteArpa(std::ostream &os) const {
   os << std::endl << "\\end\\" << std::endl;
 }
 
+ConstArpaLmCache::ConstArpaLmCache(int32 capacity, int32 num_shards):
+    capacity_(capacity) {
+  KALDI_ASSERT(capacity_ > 0 && num_shards > 0);
+  num_shards = std::min(num_shards, capacity_);
+  for (int32 i = 0; i < num_shards; i++) {
+    Shard *shard = new Shard();
+    // Share the capacity out as evenly as we can.
+    shard->capacity = capacity_ / num_shards + (i < capacity_ % num_shards);
+    shard->num_lookups = 0;
+    shard->num_hits = 0;
+    shards_.push_back(shard);
+  }
+}
+
+ConstArpaLmCache::~ConstArpaLmCache() {
+  for (size_t i = 0; i < shards_.size(); i++)
+    delete shards_[i];
+}
+
+// static
+uint64 ConstArpaLmCache::HashKey(const std::vector<int32> &hist,
+                                 int32 word) {
+  // FNV-1a over the words, then a final mix so that the low bits (which
+  // select the shard) depend on all the words.
+  uint64 hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < hist.size(); i++)
+    hash = (hash ^ static_cast<uint32>(hist[i])) * 1099511628211ULL;
+  hash = (hash ^ static_cast<uint32>(word)) * 1099511628211ULL;
+  return hash ^ (hash >> 29);
+}
+
+bool ConstArpaLmCache::Lookup(const std::vector<int32> &hist, int32 word,
+                              float *logprob, int32 *next_hist_length) {
+  uint64 hash = HashKey(hist, word);
+  Shard &shard = GetShard(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.num_lookups++;
+  unordered_map<uint64, Entry>::iterator iter = shard.map.find(hash);
+  if (iter == shard.map.end())
+    return false;
+  const Entry &entry = iter->second;
+  if (entry.word != word || entry.hist != hist)
+    return false;  // A different key with the same hash.
+  shard.num_hits++;
+  // Move it to the end of the access queue.
+  shard.access_queue.splice(shard.access_queue.end(), shard.access_queue,
+                            entry.position);
+  *logprob = entry.logprob;
+  *next_hist_length = entry.next_hist_length;
+  return true;
+}
+
+void ConstArpaLmCache::Insert(const std::vector<int32> &hist, int32 word,
+                              float logprob, int32 next_hist_length) {
+  uint64 hash = HashKey(hist, word);
+  Shard &shard = GetShard(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  std::pair<unordered_map<uint64, Entry>::iterator, bool> result =
+      shard.map.insert(std::make_pair(hash, Entry()));
+  Entry &entry = result.first->second;
+  if (result.second) {
+    entry.position = shard.access_queue.insert(shard.access_queue.end(),
+                                               hash);
+  } else {
+    // Another thread inserted it, or a different key with the same hash is
+    // there; in the latter case we replace it.
+    shard.access_queue.splice(shard.access_queue.end(), shard.access_queue,
+                              entry.position);
+  }
+  entry.hist = hist;
+  entry.word = word;
+  entry.logprob = logprob;
+  entry.next_hist_length = next_hist_length;
+  if (shard.map.size() > static_cast<size_t>(shard.capacity)) {
+    // Remove the least recently used entry.
+    shard.map.erase(shard.access_queue.front());
+    shard.access_queue.pop_front();
+  }
+}
+
+size_t ConstArpaLmCache::Size() const {
+  size_t ans = 0;
+  for (size_t i = 0; i < shards_.size(); i++) {
+    std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+    ans += shards_[i]->map.size();
+  }
+  return ans;
+}
+
+void ConstArpaLmCache::PrintStats() const {
+  int64 num_lookups = 0, num_hits = 0;
+  for (size_t i = 0; i < shards_.size(); i++) {
+    std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+    num_lookups += shards_[i]->num_lookups;
+    num_hits += shards_[i]->num_hits;
+  }
+  KALDI_LOG << "ConstArpaLm cache: " << num_lookups << " lookups, hit rate "
+            << (num_lookups == 0 ? 0.0 :
+                static_cast<double>(num_hits) / num_lookups)
+            << ", " << Size() << " entries (capacity " << capacity_
+            << ").";
+}
+
 ConstArpaLmDeterministicFst::ConstArpaLmDeterministicFst(
-    const ConstArpaLm& lm) : lm_(lm) {
+    const ConstArpaLm& lm, ConstArpaLmCache *cache) : lm_(lm), cache_(cache) {
   // Creates a history state for <s>.
   std::vector<Label> bos_state(1, lm_.BosSymbol());
-  state_to_wseq_.push_back(bos_state);
-  wseq_to_state_[bos_state] = 0;
+  std::pair<MapType::iterator, bool> result =
+      wseq_to_state_.insert(std::make_pair(bos_state, 0));
+  state_to_wseq_.push_back(&(result.first->first));
   start_state_ = 0;
 }
 
+float ConstArpaLmDeterministicFst::GetLogprobAndNextState(
+    const std::vector<Label> &wseq, Label word, int32 *next_hist_length) {
+  float logprob;
+  if (cache_ != NULL &&
+      cache_->Lookup(wseq, word, &logprob, next_hist_length))
+    return logprob;
+  logprob = lm_.GetNgramLogprob(word, wseq);
+  *next_hist_length = 0;
+  if (logprob != -std::numeric_limits<float>::infinity()) {
+    // Locates the next state in ConstArpaLm. Note that OOV and backoff have
+    // been taken care of in ConstArpaLm.
+    std::vector<Label> next_wseq(wseq);
+    next_wseq.push_back(word);
+    while (next_wseq.size() >= lm_.NgramOrder()) {
+      // History state has at most lm_.NgramOrder() -1 words in the state.
+      next_wseq.erase(next_wseq.begin(), next_wseq.begin() + 1);
+    }
+    while (!lm_.HistoryStateExists(next_wseq)) {
+      KALDI_ASSERT(next_wseq.size() > 0);
+      next_wseq.erase(next_wseq.begin(), next_wseq.begin() + 1);
+    }
+    *next_hist_length = next_wseq.size();
+  }
+  if (cache_ != NULL)
+    cache_->Insert(wseq, word, logprob, *next_hist_length);
+  return logprob;
+}
+
 fst::StdArc::Weight ConstArpaLmDeterministicFst::Final(StateId s) {
   // At this point, we should have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  const std::vector<Label>& wseq = state_to_wseq_[s];
-  float logprob = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq);
+  const std::vector<Label>& wseq = *(state_to_wseq_[s]);
+  float logprob;
+  if (cache_ != NULL) {
+    // This shares the cache entry with GetArc(s, </s>).
+    int32 next_hist_length;
+    logprob = GetLogprobAndNextState(wseq, lm_.EosSymbol(),
+                                     &next_hist_length);
+  } else {
+    logprob = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq);
+  }
   return Weight(-logprob);
 }
 
@@ -1031,24 +1374,18 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
                                          Label ilabel, fst::StdArc *oarc) {
   // At this point, we should have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  std::vector<Label> wseq = state_to_wseq_[s];
+  std::vector<Label> wseq = *(state_to_wseq_[s]);
 
-  float logprob = lm_.GetNgramLogprob(ilabel, wseq);
+  int32 next_hist_length;
+  float logprob = GetLogprobAndNextState(wseq, ilabel, &next_hist_length);
   if (logprob == -std::numeric_limits<float>::infinity()) {
     return false;
   }
 
-  // Locates the next state in ConstArpaLm. Note that OOV and backoff have been
-  // taken care of in ConstArpaLm.
+  // The next state is the last <next_hist_length> words of wseq + ilabel.
   wseq.push_back(ilabel);
-  while (wseq.size() >= lm_.NgramOrder()) {
-    // History state has at most lm_.NgramOrder() -1 words in the state.
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
-  }
-  while (!lm_.HistoryStateExists(wseq)) {
-    KALDI_ASSERT(wseq.size() > 0);
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
-  }
+  KALDI_ASSERT(next_hist_length <= wseq.size());
+  wseq.erase(wseq.begin(), wseq.end() - next_hist_length);
 
   std::pair<const std::vector<Label>, StateId> wseq_state_pair(
       wseq, static_cast<Label>(state_to_wseq_.size()));
@@ -1060,7 +1397,7 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
 
   // If the pair was just inserted, then also add it to <state_to_wseq_>.
   if (result.second == true)
-    state_to_wseq_.push_back(wseq);
+    state_to_wseq_.push_back(&(result.first->first));
 
   // Creates the arc.
   oarc->ilabel = ilabel;
@@ -1073,12 +1410,15 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
 
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename) {
+                      const std::string& const_arpa_wxfilename,
+                      bool page_align) {
   ConstArpaLmBuilder lm_builder(options);
   KALDI_LOG << "Reading " << arpa_rxfilename;
   Input ki(arpa_rxfilename);
   lm_builder.Read(ki.Stream());
-  WriteKaldiObject(lm_builder, const_arpa_wxfilename, true);
+  bool binary = true;
+  Output ko(const_arpa_wxfilename, binary);
+  lm_builder.Write(ko.Stream(), binary, page_align);
   return true;
 }
 
@@ -20,6 +20,8 @@
 #ifndef KALDI_LM_CONST_ARPA_LM_H_
 #define KALDI_LM_CONST_ARPA_LM_H_
 
+#include <list>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -199,6 +201,9 @@ namespace kaldi {
 // Forward declaration of Auxiliary struct ArpaLine.
 struct ArpaLine;
 
+// Forward declaration of the compact representation; see compact-arpa-lm.h.
+class CompactArpaLm;
+
 union Int32AndFloat {
   int32 i;
   float f;
@@ -217,6 +222,9 @@ class ConstArpaLm {
     lm_states_ = NULL;
     unigram_states_ = NULL;
     overflow_buffer_ = NULL;
+    mapped_address_ = NULL;
+    mapped_size_ = 0;
+    compact_lm_ = NULL;
     memory_assigned_ = false;
     initialized_ = false;
     ngram_order_ = 0;
@@ -243,24 +251,41 @@ class ConstArpaLm {
     KALDI_ASSERT(unk_symbol_ < num_words_ &&
                  (unk_symbol_ > 0 || unk_symbol_ == -1));
     lm_states_end_ = lm_states_ + lm_states_size_ - 1;
+    mapped_address_ = NULL;
+    mapped_size_ = 0;
+    compact_lm_ = NULL;
     memory_assigned_ = false;
     initialized_ = true;
   }
 
-  ~ConstArpaLm() {
-    if (memory_assigned_) {
-      delete[] lm_states_;
-      delete[] unigram_states_;
-      delete[] overflow_buffer_;
-    }
-  }
+  // Constructor for a language model in the compact representation (see
+  // compact-arpa-lm.h); this takes ownership of 'compact_lm'.
+  ConstArpaLm(const int32 bos_symbol, const int32 eos_symbol,
+              const int32 unk_symbol, CompactArpaLm *compact_lm);
+
+  ~ConstArpaLm();
 
   // Reads the ConstArpaLm format language model. It calls ReadInternal() or
   // ReadInternalOldFormat() to do the actual reading.
   void Read(std::istream &is, bool binary);
 
-  // Writes the language model in ConstArpaLm format.
-  void Write(std::ostream &os, bool binary) const;
+  // Reads the language model from the file 'filename', which must be an
+  // ordinary file (not a pipe or an archive).  If the file was written with
+  // page_align == true, the <LmStates> section, which is nearly all of the
+  // model, is not read but mapped into memory read-only with mmap(), so
+  // processes that use the same file share one copy of it in the page cache
+  // and loading is nearly instant.  Otherwise this is the same as Read(),
+  // apart from a warning.
+  void ReadMapped(const std::string &filename);
+
+  // Writes the language model in ConstArpaLm format.  If page_align is true,
+  // the <LmStates> section is padded so that it starts at a multiple of
+  // 4096 bytes in the file, which allows ReadMapped() to map it; files written
+  // this way can only be read by versions of the code that support this.
+  // 'os' must then be a file, because we need its position.  A model in the
+  // compact representation is written in that representation, and cannot be
+  // page-aligned.
+  void Write(std::ostream &os, bool binary, bool page_align = false) const;
 
   // Creates Arpa format language model from ConstArpaLm format, and writes it
   // to output stream. This will be useful in testing.
@@ -279,10 +304,15 @@ class ConstArpaLm {
   int32 UnkSymbol() const { return unk_symbol_; }
   int32 NgramOrder() const { return ngram_order_; }
   bool Initialized() const { return initialized_; }
+  // Returns true if the model uses the compact representation.
+  bool IsCompact() const { return compact_lm_ != NULL; }
 
  private:
-  // Function that loads data from stream to the class.
-  void ReadInternal(std::istream &is, bool binary);
+  // Function that loads data from stream to the class.  If map_filename is
+  // nonempty, 'is' must have been opened from that file, and if the
+  // <LmStates> section is page-aligned we map it instead of reading it.
+  void ReadInternal(std::istream &is, bool binary,
+                    const std::string &map_filename = "");
 
   // Function that loads data from stream to the class. This is a deprecated one
   // that handles the old on-disk format. We keep this for back-compatibility
@@ -290,6 +320,9 @@ class ConstArpaLm {
   // format, ReadInternal() will be called.
   void ReadInternalOldFormat(std::istream &is, bool binary);
 
+  // Returns true if 'word' is a unigram of the language model.
+  bool WordExists(int32 word) const;
+
   // Loops up n-gram probability for given word sequence. Backoff is handled by
   // recursively calling this function.
   float GetNgramLogprobRecurse(const int32 word,
@@ -327,6 +360,17 @@ class ConstArpaLm {
   // the destructor.
   bool memory_assigned_;
 
+  // If ReadMapped() mapped the <LmStates> section, the address and size of
+  // the mapping (which starts at a page boundary, so it may begin a little
+  // before <lm_states_>); otherwise NULL and 0.
+  void *mapped_address_;
+  size_t mapped_size_;
+
+  // If the model uses the compact representation, the model (which we own),
+  // and the members below that describe the normal representation are unused;
+  // otherwise NULL.
+  CompactArpaLm *compact_lm_;
+
   // Makes sure that the language model has been loaded before using it.
   bool initialized_;
 
@@ -386,6 +430,80 @@ class ConstArpaLm {
   int32* lm_states_;
 };
 
+/**
+ ConstArpaLmCache is a bounded cache, with least-recently-used replacement, of
+ the lookups that ConstArpaLmDeterministicFst does: for a history and a word,
+ the log-prob of the word and the number of words of the next history state.
+ These do not depend on the utterance, so one cache can be shared by the
+ ConstArpaLmDeterministicFst objects of all utterances, and of all threads (it
+ is thread-safe).
+
+ The entries are indexed by a 64-bit hash of the history and word, so a lookup
+ does not copy the history; the history is stored with the entry and compared
+ on a hit, so a hash collision cannot give a wrong result.  To reduce lock
+ contention between threads the cache is split by hash into 'num_shards'
+ parts, each with its own lock and its own share of the capacity; the
+ least-recently-used order is kept per shard.
+
+ Note: a lookup in an in-memory ConstArpaLm is only a few binary searches, and
+ in our measurements the cache was no faster than that (and slower when it
+ was large enough to fall out of the CPU cache).  It is only worth using when
+ the lookups are expensive, e.g. when the LM is memory-mapped and mostly not
+ resident in memory.
+ */
+class ConstArpaLmCache {
+ public:
+  // 'capacity' is the maximum number of entries; each takes about 100 bytes
+  // plus 4 bytes per word of the history.
+  explicit ConstArpaLmCache(int32 capacity, int32 num_shards = 16);
+
+  ~ConstArpaLmCache();
+
+  // If the result for history 'hist' and word 'word' is in the cache, outputs
+  // it and returns true.
+  bool Lookup(const std::vector<int32> &hist, int32 word, float *logprob,
+              int32 *next_hist_length);
+
+  // Adds the result for history 'hist' and word 'word' to the cache,
+  // removing the least recently used entry of its shard if that is full.
+  void Insert(const std::vector<int32> &hist, int32 word, float logprob,
+              int32 next_hist_length);
+
+  // Returns the number of entries.
+  size_t Size() const;
+
+  // Prints the number of lookups and the hit rate.
+  void PrintStats() const;
+
+ private:
+  static uint64 HashKey(const std::vector<int32> &hist, int32 word);
+
+  typedef std::list<uint64> AqType;
+  struct Entry {
+    std::vector<int32> hist;
+    int32 word;
+    float logprob;
+    int32 next_hist_length;
+    AqType::iterator position;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    int32 capacity;
+    // The hashes of the entries; the most recently used entry is at the end.
+    AqType access_queue;
+    unordered_map<uint64, Entry> map;
+    int64 num_lookups;
+    int64 num_hits;
+  };
+
+  Shard &GetShard(uint64 hash) { return *(shards_[hash % shards_.size()]); }
+
+  int32 capacity_;
+  std::vector<Shard*> shards_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ConstArpaLmCache);
+};
+
 /**
  This class wraps a ConstArpaLm format language model with the interface defined
  in DeterministicOnDemandFst.
@@ -397,7 +515,10 @@ class ConstArpaLmDeterministicFst
   typedef fst::StdArc::StateId StateId;
   typedef fst::StdArc::Label Label;
 
-  explicit ConstArpaLmDeterministicFst(const ConstArpaLm& lm);
+  // If 'cache' is not NULL, it is used to look up the log-probs and next
+  // states (see ConstArpaLmCache); it is not owned, and may be shared.
+  explicit ConstArpaLmDeterministicFst(const ConstArpaLm& lm,
+                                       ConstArpaLmCache *cache = NULL);
 
   // We cannot use "const" because the pure virtual function in the interface is
   // not const.
@@ -410,20 +531,30 @@ class ConstArpaLmDeterministicFst
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
  private:
+  // Returns the log-prob of 'word' after history 'wseq', and outputs the
+  // number of words of the next history state (which is a suffix of wseq +
+  // word); uses the cache if we have one.
+  float GetLogprobAndNextState(const std::vector<Label> &wseq, Label word,
+                               int32 *next_hist_length);
+
   typedef unordered_map<std::vector<Label>,
                         StateId, VectorHasher<Label> > MapType;
   StateId start_state_;
   MapType wseq_to_state_;
-  std::vector<std::vector<Label> > state_to_wseq_;
+  // Pointers to the keys of <wseq_to_state_>, indexed by state, so that we
+  // store each history only once.
+  std::vector<const std::vector<Label>*> state_to_wseq_;
   const ConstArpaLm& lm_;
+  ConstArpaLmCache *cache_;
 };
 
 // Reads in an Arpa format language model and converts it into ConstArpaLm
 // format. We assume that the words in the input Arpa format language model have
-// been converted into integers.
+// been converted into integers.  See ConstArpaLm::Write() for 'page_align'.
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename);
+                      const std::string& const_arpa_wxfilename,
+                      bool page_align = false);
 
 }  // namespace kaldi
 
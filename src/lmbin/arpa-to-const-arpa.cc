@@ -19,6 +19,7 @@
 
 #include <string>
 
+#include "lm/compact-arpa-lm.h"
 #include "lm/const-arpa-lm.h"
 #include "util/parse-options.h"
 
@@ -37,6 +38,10 @@ int main(int argc, char *argv[]) {
         "ConstArpaLm format language model. We first map the words in an Arpa\n"
         "format language model to integers using utils/map_arpa_m.pl, and\n"
         "then use this program to build a ConstArpaLm format language model.\n"
+        "With --compact=true, the output uses a compressed representation\n"
+        "with quantized probabilities (see compact-arpa-lm.h), which takes\n"
+        "about a third of the memory; programs that read ConstArpaLm\n"
+        "format can read either.\n"
         "\n"
         "Usage: arpa-to-const-arpa [opts] <input-arpa> <const-arpa>\n"
         " e.g.: arpa-to-const-arpa --bos-symbol=1 --eos-symbol=2 \\\n"
@@ -46,6 +51,21 @@ int main(int argc, char *argv[]) {
 
     ArpaParseOptions options;
     options.Register(&po);
+    bool page_align = false;
+    po.Register("page-align", &page_align, "If true, align the LM states in "
+                "the output file to a page boundary, so that programs can map "
+                "them into memory (e.g. lattice-lmrescore-const-arpa "
+                "--mmap-lm=true).  The output must be a file, and older "
+                "versions of Kaldi cannot read it.");
+    bool compact = false;
+    int32 quantize_bits = 8;
+    po.Register("compact", &compact, "If true, write the language model in "
+                "the compact representation (bit-packed, with quantized "
+                "log-probs and backoffs).  Older versions of Kaldi cannot "
+                "read it.");
+    po.Register("quantize-bits", &quantize_bits, "With --compact=true, the "
+                "number of bits (1 to 16) to which log-probs and backoffs of "
+                "each order are quantized.");
 
     // Ideally, these registrations would be in ArpaParseOptions, but some
     // programs want integers and other want symbols, so we register them
@@ -75,8 +95,16 @@ int main(int argc, char *argv[]) {
     std::string arpa_rxfilename = po.GetArg(1),
         const_arpa_wxfilename = po.GetOptArg(2);
 
-    bool ans = BuildConstArpaLm(options, arpa_rxfilename,
-                                const_arpa_wxfilename);
+    if (compact && page_align)
+      KALDI_ERR << "--compact and --page-align cannot be used together.";
+
+    bool ans;
+    if (compact)
+      ans = BuildCompactArpaLm(options, quantize_bits, arpa_rxfilename,
+                               const_arpa_wxfilename);
+    else
+      ans = BuildConstArpaLm(options, arpa_rxfilename,
+                             const_arpa_wxfilename, page_align);
     if (ans)
       return 0;
     else
@@ -23,6 +23,7 @@
 
 #include "matrix/matrix-functions.h"
 #include "matrix/sp-matrix.h"
+#include "matrix/kaldi-blas.h"
 
 namespace kaldi {
 
@@ -770,4 +771,18 @@ void AddOuterProductPlusMinus<double>(double alpha,
                                       MatrixBase<double> *minus);
 
 
+int32 SetBlasNumThreads(int32 num_threads) {
+  KALDI_ASSERT(num_threads >= 0);
+#if defined(HAVE_MKL)
+  return mkl_set_num_threads_local(num_threads);
+#elif defined(HAVE_OPENBLAS)
+  int32 prev = openblas_get_num_threads();
+  if (num_threads > 0)
+    openblas_set_num_threads(num_threads);
+  return prev;
+#else
+  return -1;
+#endif
+}
+
 } // end namespace kaldi
@@ -157,6 +157,14 @@ void AddOuterProductPlusMinus(Real alpha,
                               MatrixBase<Real> *plus,
                               MatrixBase<Real> *minus);
 
+/// Sets the number of threads that the BLAS library may use for calls made
+/// from the calling thread, and returns the previous setting, which may be
+/// passed back to this function to restore it.  Zero means "the library's
+/// default".  This only has a thread-local effect for MKL; for OpenBLAS the
+/// setting is process-wide, and for other libraries (ATLAS, CLAPACK,
+/// Accelerate) it does nothing and returns -1.
+int32 SetBlasNumThreads(int32 num_threads);
+
 template<typename Real1, typename Real2>
 inline void AssertSameDim(const MatrixBase<Real1> &mat1, const MatrixBase<Real2> &mat2) {
   KALDI_ASSERT(mat1.NumRows() == mat2.NumRows()
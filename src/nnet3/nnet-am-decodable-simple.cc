@@ -41,7 +41,10 @@ DecodableNnetSimple::DecodableNnetSimple(
     ivector_(ivector), online_ivector_feats_(online_ivectors),
     online_ivector_period_(online_ivector_period),
     compiler_(*compiler),
-    current_log_post_subsampled_offset_(0) {
+    current_log_post_subsampled_offset_(0),
+    use_looped_(false),
+    looped_computer_(NULL),
+    num_chunks_computed_(0) {
   num_subsampled_frames_ =
       (feats_.NumRows() + opts_.frame_subsampling_factor - 1) /
       opts_.frame_subsampling_factor;
@@ -52,6 +55,45 @@ DecodableNnetSimple::DecodableNnetSimple(
                  "You need to set the --online-ivector-period option!"));
   log_priors_.ApplyLog();
   CheckAndFixConfigs();
+  if (opts_.reuse_activations && num_subsampled_frames_ > 0) {
+    if (NnetIsRecurrent(nnet_)) {
+      static bool warned_recurrent = false;
+      if (!warned_recurrent) {
+        warned_recurrent = true;
+        KALDI_WARN << "Ignoring --reuse-activations=true because the nnet is "
+                   << "recurrent (see the looped decoders, e.g. "
+                   << "nnet3-latgen-faster-looped, for unidirectional "
+                   << "recurrent nnets).";
+      }
+    } else {
+      InitLoopedComputation();
+    }
+  }
+}
+
+void DecodableNnetSimple::InitLoopedComputation() {
+  // With a fixed chunk size, the only computation that is wasted in the
+  // looped case is on the padding after the end of the utterance, so we use as
+  // few chunks as --frames-per-chunk allows and make them as small as we can
+  // (each chunk has a fixed cost, and small chunks make for inefficient matrix
+  // multiplications).  The chunk size has to be a multiple of n.  Each chunk
+  // size needs its own compiled computation, so we round it up to a multiple
+  // of 'step', which allows at most kNumLoopedChunkSizes distinct sizes, at the
+  // cost of a little more padding.
+  int32 n = Lcm(opts_.frame_subsampling_factor, nnet_.Modulus()),
+      max_chunk_size = opts_.frames_per_chunk,  // a multiple of n.
+      step = n * std::max<int32>(1, max_chunk_size /
+                                    (n * kNumLoopedChunkSizes)),
+      num_frames = num_subsampled_frames_ * opts_.frame_subsampling_factor,
+      num_chunks = (num_frames + max_chunk_size - 1) / max_chunk_size,
+      chunk_size = (num_frames + num_chunks - 1) / num_chunks;
+  opts_.frames_per_chunk = std::min(max_chunk_size,
+                                    step * ((chunk_size + step - 1) / step));
+  looped_computation_ = compiler_.GetLoopedComputation(
+      opts_.frames_per_chunk, opts_.frame_subsampling_factor,
+      nnet_left_context_, nnet_right_context_,
+      &looped_request1_, &looped_request2_);
+  use_looped_ = true;
 }
 
 
@@ -104,6 +146,10 @@ void DecodableNnetSimple::EnsureFrameIsComputed(int32 subsampled_frame) {
   if (ivector_dim != std::max<int32>(0, nnet_.InputDim("ivector")))
     KALDI_ERR << "Neural net expects 'ivector' features with dimension "
               << nnet_ivector_dim << " but you provided " << ivector_dim;
+  if (use_looped_) {
+    EnsureFrameIsComputedLooped(subsampled_frame);
+    return;
+  }
 
   int32 current_subsampled_frames_computed = current_log_post_.NumRows(),
       current_subsampled_offset = current_log_post_subsampled_offset_;
@@ -166,6 +212,89 @@ void DecodableNnetSimple::EnsureFrameIsComputed(int32 subsampled_frame) {
   }
 }
 
+void DecodableNnetSimple::EnsureFrameIsComputedLooped(int32 subsampled_frame) {
+  int32 subsampled_frames_per_chunk =
+      opts_.frames_per_chunk / opts_.frame_subsampling_factor,
+      chunk_index = subsampled_frame / subsampled_frames_per_chunk;
+  if (chunk_index < num_chunks_computed_) {
+    // The frames are not being accessed in order; we have to start again.
+    delete looped_computer_;
+    looped_computer_ = NULL;
+    num_chunks_computed_ = 0;
+  }
+  if (looped_computer_ == NULL) {
+    Nnet *nnet_to_update = NULL;  // we're not doing any update.
+    looped_computer_ = new NnetComputer(opts_.compute_config,
+                                        *looped_computation_, nnet_,
+                                        nnet_to_update);
+  }
+  while (num_chunks_computed_ <= chunk_index)
+    AdvanceLoopedChunk();
+}
+
+void DecodableNnetSimple::AdvanceLoopedChunk() {
+  int32 chunk_size = opts_.frames_per_chunk,
+      num_features = feats_.NumRows(),
+      begin_input_frame, end_input_frame;  // end is last plus one.
+  if (num_chunks_computed_ == 0) {
+    begin_input_frame = -nnet_left_context_;
+    end_input_frame = chunk_size + nnet_right_context_;
+  } else {
+    begin_input_frame = num_chunks_computed_ * chunk_size +
+        nnet_right_context_;
+    end_input_frame = begin_input_frame + chunk_size;
+  }
+  // The last chunk may extend past the end of the utterance; like the start
+  // of the utterance, this is padded with copies of the first or last frame.
+  Matrix<BaseFloat> feats_chunk(end_input_frame - begin_input_frame,
+                                feats_.NumCols(), kUndefined);
+  for (int32 t = begin_input_frame; t < end_input_frame; t++) {
+    int32 input_frame = std::min(std::max(t, 0), num_features - 1);
+    feats_chunk.Row(t - begin_input_frame).CopyFromVec(
+        feats_.Row(input_frame));
+  }
+  CuMatrix<BaseFloat> cu_feats_chunk(feats_chunk);
+  looped_computer_->AcceptInput("input", &cu_feats_chunk);
+
+  if (GetIvectorDim() > 0) {
+    // Each iVector is for the chunk that starts at its time index; we choose
+    // it in the same way as in the non-looped computation.
+    const ComputationRequest &request = (num_chunks_computed_ == 0 ?
+                                         looped_request1_ : looped_request2_);
+    int32 t_shift = (num_chunks_computed_ == 0 ? 0 :
+                     (num_chunks_computed_ - 1) * chunk_size),
+        num_output_frames = num_subsampled_frames_ *
+                            opts_.frame_subsampling_factor,
+        i = request.IndexForInput("ivector");
+    KALDI_ASSERT(i >= 0);
+    const std::vector<Index> &indexes = request.inputs[i].indexes;
+    Matrix<BaseFloat> ivectors(indexes.size(), GetIvectorDim(), kUndefined);
+    for (size_t j = 0; j < indexes.size(); j++) {
+      int32 t = std::min(std::max(indexes[j].t + t_shift, 0),
+                         num_output_frames - 1);
+      Vector<BaseFloat> ivector;
+      GetCurrentIvector(t, std::min(chunk_size, num_output_frames - t),
+                        &ivector);
+      ivectors.Row(j).CopyFromVec(ivector);
+    }
+    CuMatrix<BaseFloat> cu_ivectors(ivectors);
+    looped_computer_->AcceptInput("ivector", &cu_ivectors);
+  }
+  looped_computer_->Run();
+
+  // GetOutputDestructive() is OK because the nnet is not recurrent.
+  CuMatrix<BaseFloat> cu_output;
+  looped_computer_->GetOutputDestructive("output", &cu_output);
+  if (log_priors_.Dim() != 0)
+    cu_output.AddVecToRows(-1.0, log_priors_);
+  cu_output.Scale(opts_.acoustic_scale);
+  current_log_post_.Resize(0, 0);
+  cu_output.Swap(&current_log_post_);
+  current_log_post_subsampled_offset_ = num_chunks_computed_ *
+      (chunk_size / opts_.frame_subsampling_factor);
+  num_chunks_computed_++;
+}
+
 // note: in the normal case (with no frame subsampling) you can ignore the
 // 'subsampled_' in the variable name.
 void DecodableNnetSimple::GetOutputForFrame(int32 subsampled_frame,
@@ -49,6 +49,7 @@ struct NnetSimpleComputationOptions {
   int32 frames_per_chunk;
   BaseFloat acoustic_scale;
   bool debug_computation;
+  bool reuse_activations;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
   CachingOptimizingCompilerOptions compiler_config;
@@ -61,7 +62,8 @@ struct NnetSimpleComputationOptions {
       frame_subsampling_factor(1),
       frames_per_chunk(50),
       acoustic_scale(0.1),
-      debug_computation(false) {
+      debug_computation(false),
+      reuse_activations(false) {
     compiler_config.cache_capacity += frames_per_chunk;
   }
 
@@ -94,6 +96,14 @@ struct NnetSimpleComputationOptions {
                    "input frames");
     opts->Register("debug-computation", &debug_computation, "If true, turn on "
                    "debug for the actual computation (very verbose!)");
+    opts->Register("reuse-activations", &reuse_activations, "If true, and the "
+                   "nnet is not recurrent, the utterance is computed with a "
+                   "'looped' computation that reuses the activations of the "
+                   "previous chunk instead of recomputing the context of each "
+                   "chunk.  In this case --frames-per-chunk is a maximum: the "
+                   "chunk size is chosen per utterance, from a few sizes, to "
+                   "minimize the computation, and --extra-left-context and related options "
+                   "are ignored.");
 
     // register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -187,6 +197,7 @@ class DecodableNnetSimple {
                       const MatrixBase<BaseFloat> *online_ivectors = NULL,
                       int32 online_ivector_period = 1);
 
+  ~DecodableNnetSimple() { delete looped_computer_; }
 
   // returns the number of frames of likelihoods.  The same as feats_.NumRows()
   // in the normal case (but may be less if opts_.frame_subsampling_factor !=
@@ -218,6 +229,27 @@ class DecodableNnetSimple {
   // cached in current_log_post_.
   void EnsureFrameIsComputed(int32 subsampled_frame);
 
+  // This is called from EnsureFrameIsComputed() if we are using a looped
+  // computation (opts_.reuse_activations == true); it computes chunks in
+  // order until the one containing 'subsampled_frame', starting again from
+  // the beginning of the utterance if the frame is before the current chunk.
+  void EnsureFrameIsComputedLooped(int32 subsampled_frame);
+
+  // Computes the next chunk of the looped computation; called from
+  // EnsureFrameIsComputedLooped().
+  void AdvanceLoopedChunk();
+
+  // Called from the constructor if opts_.reuse_activations is true and the
+  // nnet is not recurrent.  It chooses the chunk size for this utterance and
+  // gets the looped computation from the compiler.
+  void InitLoopedComputation();
+
+  // The maximum number of distinct chunk sizes that InitLoopedComputation()
+  // chooses between (plus one, if the step does not divide
+  // --frames-per-chunk), which limits the number of looped computations that
+  // have to be compiled.
+  static const int32 kNumLoopedChunkSizes = 8;
+
   // This function does the actual nnet computation; it is called from
   // EnsureFrameIsComputed.  Any padding at file start/end is done by
   // the caller of this function (so the input should exceed the output
@@ -277,6 +309,19 @@ class DecodableNnetSimple {
   // opts_.frame_subsampling_factor > 1, this will be measured in subsampled
   // frames.
   int32 current_log_post_subsampled_offset_;
+
+  // The following variables are only used if use_looped_ is true, i.e. if
+  // opts_.reuse_activations is true and the nnet is not recurrent.  In that
+  // case the chunk size opts_.frames_per_chunk is fixed for the utterance and
+  // each chunk continues the computation of the previous one, so the context
+  // is only computed once.  The requests are those for the first and second
+  // chunks; the later chunks are like the second, shifted in time.
+  bool use_looped_;
+  std::shared_ptr<const NnetComputation> looped_computation_;
+  ComputationRequest looped_request1_;
+  ComputationRequest looped_request2_;
+  NnetComputer *looped_computer_;
+  int32 num_chunks_computed_;
 };
 
 class DecodableAmNnetSimple: public DecodableInterface {
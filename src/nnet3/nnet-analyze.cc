@@ -1365,6 +1365,84 @@ void PrintMatrixAccesses(std::ostream &os,
   }
 }
 
+void ComputeCommandDependencies(
+    const NnetComputation &computation,
+    const ComputationVariables &variables,
+    const std::vector<CommandAttributes> &command_attributes,
+    std::vector<std::vector<int32> > *dependencies) {
+  int32 num_commands = computation.commands.size(),
+      num_variables = variables.NumVariables(),
+      num_components = 0;
+  KALDI_ASSERT(command_attributes.size() == static_cast<size_t>(num_commands));
+  for (int32 c = 0; c < num_commands; c++) {
+    const NnetComputation::Command &command = computation.commands[c];
+    if (command.command_type == kPropagate ||
+        command.command_type == kBackprop ||
+        command.command_type == kBackpropNoModelUpdate)
+      num_components = std::max(num_components, command.arg1 + 1);
+  }
+  // last_writer[v] is the most recent command that wrote to variable v (or -1);
+  // readers[v] is the list of commands that read v since it was last written.
+  std::vector<int32> last_writer(num_variables, -1),
+      last_component_user(num_components, -1);
+  std::vector<std::vector<int32> > readers(num_variables);
+
+  dependencies->clear();
+  dependencies->resize(num_commands);
+  std::vector<int32> read, written;
+  for (int32 c = 0; c < num_commands; c++) {
+    const NnetComputation::Command &command = computation.commands[c];
+    const CommandAttributes &attr = command_attributes[c];
+    std::vector<int32> &this_deps = (*dependencies)[c];
+    read = attr.variables_read;
+    written = attr.variables_written;
+    switch (command.command_type) {
+      case kAllocMatrix: case kDeallocMatrix: case kCompressMatrix:
+      case kDecompressMatrix:
+        variables.AppendVariablesForMatrix(
+            computation.submatrices[command.arg1].matrix_index, &written);
+        break;
+      case kSwapMatrix:
+        variables.AppendVariablesForMatrix(
+            computation.submatrices[command.arg1].matrix_index, &written);
+        variables.AppendVariablesForMatrix(
+            computation.submatrices[command.arg2].matrix_index, &written);
+        break;
+      case kPropagate: case kBackprop: case kBackpropNoModelUpdate: {
+        int32 &prev = last_component_user[command.arg1];
+        if (prev != -1)
+          this_deps.push_back(prev);
+        prev = c;
+        break;
+      }
+      default:
+        break;
+    }
+    SortAndUniq(&written);
+    for (std::vector<int32>::const_iterator iter = read.begin();
+         iter != read.end(); ++iter) {
+      if (last_writer[*iter] != -1)
+        this_deps.push_back(last_writer[*iter]);
+    }
+    for (std::vector<int32>::const_iterator iter = written.begin();
+         iter != written.end(); ++iter) {
+      int32 v = *iter;
+      if (last_writer[v] != -1)
+        this_deps.push_back(last_writer[v]);
+      this_deps.insert(this_deps.end(), readers[v].begin(), readers[v].end());
+      readers[v].clear();
+      last_writer[v] = c;
+    }
+    for (std::vector<int32>::const_iterator iter = read.begin();
+         iter != read.end(); ++iter) {
+      // if c also wrote v, it is already recorded as v's last writer.
+      if (last_writer[*iter] != c)
+        readers[*iter].push_back(c);
+    }
+    SortAndUniq(&this_deps);
+  }
+}
+
 void PrintCommandAttributes(std::ostream &os,
                             const std::vector<CommandAttributes> &attributes) {
   int32 num_commands = attributes.size();
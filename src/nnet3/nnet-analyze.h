@@ -289,6 +289,38 @@ void ComputeMatrixAccesses(
 void PrintMatrixAccesses(std::ostream &os,
                          const std::vector<MatrixAccesses> &matrix_accesses);
 
+
+/**
+   This function works out, for each command in the computation, which earlier
+   commands it has to wait for if commands are to be executed out of order
+   (e.g. concurrently on multiple threads, see NnetComputeOptions::num_threads).
+   A command depends on an earlier command if they access a common variable and
+   at least one of the two accesses is a write (i.e. we take account of
+   read-after-write, write-after-read and write-after-write hazards).  Commands
+   that allocate, deallocate or swap a matrix are treated as writing all of its
+   variables; and commands that invoke the same component (Propagate or
+   Backprop) are kept in their original order, because components may keep
+   state such as stats or random-number generators.
+
+   This analysis assumes that commands are executed in increasing order of
+   index, so it is not valid for computations containing kGotoLabel.
+
+     @param [in] computation  The computation to analyze.
+     @param [in] variables   The definition of variables for this computation
+     @param [in] command_attributes  A vector of attributes, one per command, as
+                      obtained from ComputeCommandAttributes().
+     @param [out] dependencies  The output will have a size equal to the
+                     number of commands; (*dependencies)[c] is a sorted, unique
+                     list of the commands c' < c that command c directly depends
+                     on.  Dependencies implied by other dependencies are not
+                     necessarily removed.
+*/
+void ComputeCommandDependencies(
+    const NnetComputation &computation,
+    const ComputationVariables &variables,
+    const std::vector<CommandAttributes> &command_attributes,
+    std::vector<std::vector<int32> > *dependencies);
+
 /// This struct exists to set up various pieces of analysis; it helps avoid the
 /// repetition of code where we compute all these things in sequence.
 struct Analyzer {
@@ -41,7 +41,8 @@ NnetBatchComputer::NnetBatchComputer(
   opts_.CheckAndFixConfigs(nnet_.Modulus());
   KALDI_ASSERT(opts_.minibatch_size >= 1 && opts_.edge_minibatch_size >= 1 &&
                opts_.partial_minibatch_factor < 1.0 &&
-               opts_.partial_minibatch_factor >= 0.0);
+               opts_.partial_minibatch_factor >= 0.0 &&
+               opts_.num_compute_threads >= 1);
 
   ComputeSimpleNnetContext(nnet, &nnet_left_context_, &nnet_right_context_);
   input_dim_ = nnet.InputDim("input");
@@ -141,11 +142,12 @@ NnetBatchComputer::GetHighestPriorityComputation(
   std::unique_lock<std::mutex> lock(mutex_);
   MapType::iterator iter = tasks_.begin(), end = tasks_.end(),
       best_iter = tasks_.end();
-  double highest_priority = -std::numeric_limits<double>::infinity();
+  double highest_priority = -std::numeric_limits<double>::infinity(),
+      now = timer_.Elapsed();
 
   for (; iter != end; ++iter) {
     ComputationGroupInfo &info = iter->second;
-    double this_priority = GetPriority(allow_partial_minibatch, info);
+    double this_priority = GetPriority(allow_partial_minibatch, now, info);
     if (this_priority > highest_priority) {
       highest_priority = this_priority;
       best_iter = iter;
@@ -265,14 +267,26 @@ std::shared_ptr<const NnetComputation> NnetBatchComputer::GetComputation(
 }
 
 
+// static
+double NnetBatchComputer::OldestQueueTime(const ComputationGroupInfo &info) {
+  KALDI_ASSERT(!info.tasks.empty());
+  double ans = info.tasks[0]->queue_time;
+  for (size_t i = 1; i < info.tasks.size(); i++)
+    ans = std::min(ans, info.tasks[i]->queue_time);
+  return ans;
+}
+
 double NnetBatchComputer::GetPriority(bool allow_partial_minibatch,
+                                      double now,
                                       const ComputationGroupInfo &info) const {
   if (info.tasks.empty())
     return -std::numeric_limits<double>::infinity();
   int32 this_minibatch_size = GetMinibatchSize(info);
   int32 num_tasks = info.tasks.size();
 
-  if (!allow_partial_minibatch && num_tasks < this_minibatch_size)
+  if (!allow_partial_minibatch && num_tasks < this_minibatch_size &&
+      !(opts_.max_batch_wait >= 0.0 &&
+        now - OldestQueueTime(info) >= opts_.max_batch_wait))
     return -std::numeric_limits<double>::infinity();
 
   // penalty_for_not_full will be negative if the minibatch is not full, up to a
@@ -582,6 +596,7 @@ void NnetBatchComputer::AcceptTask(NnetInferenceTask *task,
     while (num_full_minibatches_ > max_minibatches_full)
       cond->wait(lock);
   }
+  task->queue_time = timer_.Elapsed();
   ComputationGroupKey key(*task);
   ComputationGroupInfo &info = tasks_[key];
   info.tasks.push_back(task);
@@ -621,10 +636,14 @@ bool NnetBatchComputer::Compute(bool allow_partial_minibatch) {
   output.Scale(opts_.acoustic_scale);
   FormatOutputs(output, tasks);
 
-  // Update the stats, for diagnostics.
-  minfo->num_done++;
-  minfo->tot_num_tasks += static_cast<int64>(tasks.size());
-  minfo->seconds_taken += tim.Elapsed();
+  {
+    // Update the stats, for diagnostics.  We need the lock because other
+    // threads may be computing minibatches of the same type.
+    std::unique_lock<std::mutex> lock(mutex_);
+    minfo->num_done++;
+    minfo->tot_num_tasks += static_cast<int64>(tasks.size());
+    minfo->seconds_taken += tim.Elapsed();
+  }
 
   SynchronizeGpu();
 
@@ -635,6 +654,28 @@ bool NnetBatchComputer::Compute(bool allow_partial_minibatch) {
 }
 
 
+double NnetBatchComputer::TimeToNextDeadline() {
+  if (opts_.max_batch_wait < 0.0)
+    return -1.0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  double now = timer_.Elapsed(), ans = -1.0;
+  for (MapType::const_iterator iter = tasks_.begin();
+       iter != tasks_.end(); ++iter) {
+    const ComputationGroupInfo &info = iter->second;
+    // Groups with a full minibatch can be computed anyway; those tasks don't
+    // have a deadline.
+    if (info.tasks.empty() ||
+        static_cast<int32>(info.tasks.size()) >= GetMinibatchSize(info))
+      continue;
+    double remaining = std::max(
+        0.0, OldestQueueTime(info) + opts_.max_batch_wait - now);
+    if (ans < 0.0 || remaining < ans)
+      ans = remaining;
+  }
+  return ans;
+}
+
+
 /**
    This namespace contains things needed for the implementation of
    the function NnetBatchComputer::SplitUtteranceIntoTasks().
@@ -1087,8 +1128,9 @@ NnetBatchInference::NnetBatchInference(
     computer_(opts, nnet, priors),
     is_finished_(false),
     utterance_counter_(0) {
-  // 'thread_' will run the Compute() function in the background.
-  compute_thread_ = std::thread(ComputeFunc, this);
+  // These threads will run the Compute() function in the background.
+  for (int32 i = 0; i < opts.num_compute_threads; i++)
+    compute_threads_.push_back(new std::thread(ComputeFunc, this));
 }
 
 
@@ -1124,7 +1166,8 @@ void NnetBatchInference::AcceptInput(
     computer_.AcceptTask(&(info->tasks[i]), max_full_minibatches);
   }
   utts_.push_back(info);
-  tasks_ready_semaphore_.Signal();
+  for (size_t i = 0; i < compute_threads_.size(); i++)
+    tasks_ready_semaphore_.Signal();
 }
 
 bool NnetBatchInference::GetOutput(std::string *utterance_id,
@@ -1159,23 +1202,32 @@ NnetBatchInference::~NnetBatchInference() {
     KALDI_ERR << "Object destroyed before Finished() was called.";
   if (!utts_.empty())
     KALDI_ERR << "You should get all output before destroying this object.";
-  compute_thread_.join();
+  for (size_t i = 0; i < compute_threads_.size(); i++) {
+    compute_threads_[i]->join();
+    delete compute_threads_[i];
+  }
 }
 
 void NnetBatchInference::Finished() {
   is_finished_ = true;
-  tasks_ready_semaphore_.Signal();
+  for (size_t i = 0; i < compute_threads_.size(); i++)
+    tasks_ready_semaphore_.Signal();
 }
 
-// This is run as the thread of class NnetBatchInference.
+// This is run as the thread(s) of class NnetBatchInference.
 void NnetBatchInference::Compute() {
   bool allow_partial_minibatch = false;
   while (true) {
     // keep calling Compute() as long as it makes progress.
     while (computer_.Compute(allow_partial_minibatch));
 
-    // ... then wait on tasks_ready_semaphore_.
-    tasks_ready_semaphore_.Wait();
+    // ... then wait on tasks_ready_semaphore_, but not for longer than it
+    // takes for some partial minibatch to reach --max-batch-wait.
+    double timeout = computer_.TimeToNextDeadline();
+    if (timeout < 0.0)
+      tasks_ready_semaphore_.Wait();
+    else if (!tasks_ready_semaphore_.TimedWait(timeout))
+      continue;
     if (is_finished_) {
       allow_partial_minibatch = true;
       while (computer_.Compute(allow_partial_minibatch));
@@ -1202,7 +1254,8 @@ NnetBatchDecoder::NnetBatchDecoder(
   KALDI_ASSERT(num_threads > 0);
   for (int32 i = 0; i < num_threads; i++)
     decode_threads_.push_back(new std::thread(DecodeFunc, this));
-  compute_thread_ = std::thread(ComputeFunc, this);
+  for (int32 i = 0; i < computer_->GetOptions().num_compute_threads; i++)
+    compute_threads_.push_back(new std::thread(ComputeFunc, this));
 }
 
 void NnetBatchDecoder::SetPriorities(std::vector<NnetInferenceTask> *tasks) {
@@ -1257,8 +1310,13 @@ int32 NnetBatchDecoder::Finished() {
   // compute timing.
 
   tasks_finished_ = true;
-  tasks_ready_semaphore_.Signal();
-  compute_thread_.join();
+  for (size_t i = 0; i < compute_threads_.size(); i++)
+    tasks_ready_semaphore_.Signal();
+  for (size_t i = 0; i < compute_threads_.size(); i++) {
+    compute_threads_[i]->join();
+    delete compute_threads_[i];
+  }
+  compute_threads_.clear();
   return num_success_;
 }
 
@@ -1327,11 +1385,23 @@ bool NnetBatchDecoder::GetOutput(
 }
 
 void NnetBatchDecoder::Compute() {
+  // The decoder threads wait for their tasks, so we normally compute partial
+  // minibatches right away.  If --max-batch-wait is set, we instead give them
+  // up to that long to fill up, which gives larger (more efficient)
+  // minibatches at the cost of some latency.
+  bool allow_partial_minibatch =
+      (computer_->GetOptions().max_batch_wait < 0.0);
   while (!tasks_finished_) {
-    tasks_ready_semaphore_.Wait();
-    bool allow_partial_minibatch = true;
+    double timeout = computer_->TimeToNextDeadline();
+    if (timeout < 0.0)
+      tasks_ready_semaphore_.Wait();
+    else
+      tasks_ready_semaphore_.TimedWait(timeout);
     while (computer_->Compute(allow_partial_minibatch));
   }
+  // Make sure nothing is left over (all decoder threads have finished by now,
+  // so this would only matter in case of a coding error).
+  while (computer_->Compute(true));
 }
 
 void NnetBatchDecoder::Decode() {
@@ -1365,7 +1435,10 @@ void NnetBatchDecoder::Decode() {
     SetPriorities(&tasks);
     for (size_t i = 0; i < tasks.size(); i++)
       computer_->AcceptTask(&(tasks[i]));
-    tasks_ready_semaphore_.Signal();
+    // Wake all the compute threads, as in NnetBatchInference::AcceptInput();
+    // each Wait() in Compute() consumes only one signal.
+    for (size_t i = 0; i < compute_threads_.size(); i++)
+      tasks_ready_semaphore_.Signal();
 
     {
       int32 frame_offset = 0;
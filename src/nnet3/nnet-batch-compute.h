@@ -119,6 +119,11 @@ struct NnetInferenceTask {
   // after this object is provided to class NnetBatchComputer.
   double priority;
 
+  // The time at which this task was given to NnetBatchComputer::AcceptTask(),
+  // in seconds relative to when the NnetBatchComputer was created.  Set by
+  // class NnetBatchComputer; used to implement --max-batch-wait.
+  double queue_time;
+
   // This semaphore will be incremented by class NnetBatchComputer when this
   // chunk is done.  After this semaphore is incremented, class
   // NnetBatchComputer will no longer hold any pointers to this class.
@@ -146,11 +151,15 @@ struct NnetBatchComputerOptions: public NnetSimpleComputationOptions {
   int32 edge_minibatch_size;
   bool ensure_exact_final_context;
   BaseFloat partial_minibatch_factor;
+  int32 num_compute_threads;
+  BaseFloat max_batch_wait;
 
   NnetBatchComputerOptions(): minibatch_size(128),
                               edge_minibatch_size(32),
                               ensure_exact_final_context(false),
-                              partial_minibatch_factor(0.5) {
+                              partial_minibatch_factor(0.5),
+                              num_compute_threads(1),
+                              max_batch_wait(-1.0) {
   }
 
   void Register(OptionsItf *po) {
@@ -174,6 +183,17 @@ struct NnetBatchComputerOptions: public NnetSimpleComputationOptions {
                  "for sizes: int(partial_minibatch_factor^n * minibatch_size "
                  ", for n = 0, 1, 2....  Set it to 0.0 if you want to use "
                  "only the specified minibatch sizes.");
+    po->Register("num-compute-threads", &num_compute_threads, "Number of "
+                 "threads that take minibatches from the queue and compute "
+                 "them.  Values >1 are intended for CPU-only use, where "
+                 "they let the batch computation use many cores (consider "
+                 "using a single-threaded BLAS in that case).");
+    po->Register("max-batch-wait", &max_batch_wait, "If >= 0, the maximum "
+                 "time in seconds a chunk may wait for its minibatch to "
+                 "become full; after that, a partial minibatch is computed. "
+                 "This bounds the latency when minibatches would otherwise "
+                 "wait for more input.  If < 0, no limit (programs then "
+                 "flush partial minibatches only when they have to).");
   }
 };
 
@@ -203,6 +223,12 @@ void MergeTaskOutput(
    computation.  It does the computation in one background thread that accesses
    the GPU.  It is thread safe, i.e. you can call it from multiple threads
    without having to worry about data races and the like.
+
+   On CPU, batching also helps the efficiency of the matrix multiplications,
+   and several threads may call Compute() at the same time (see
+   --num-compute-threads in the users of this class), each taking its own
+   minibatch.  --max-batch-wait bounds how long a chunk waits for its minibatch
+   to become full; see TimeToNextDeadline().
 */
 class NnetBatchComputer {
  public:
@@ -244,6 +270,16 @@ class NnetBatchComputer {
    */
   bool Compute(bool allow_partial_minibatch);
 
+  /**
+     Returns the time in seconds until the oldest pending task that is not part
+     of a full minibatch will have waited for opts.max_batch_wait (after which
+     Compute(false) will compute a partial minibatch for it); zero if that
+     time has already passed, and -1 if there is no such task or
+     opts.max_batch_wait < 0.  Threads that call Compute() can use this to
+     decide how long they may sleep.
+  */
+  double TimeToNextDeadline();
+
 
   /**
      Split a single utterance into a list of separate tasks which can then
@@ -347,10 +383,17 @@ class NnetBatchComputer {
   // list of tasks that may be computed in the same minibatch).  What this
   // function does is a kind of heuristic.
   // If allow_partial_minibatch == false, it will set the priority for
-  // any minibatches that are not full to negative infinity.
+  // any minibatches that are not full to negative infinity, unless
+  // opts_.max_batch_wait >= 0 and one of its tasks has waited at least that
+  // long at time 'now' (as returned by timer_.Elapsed()).
   inline double GetPriority(bool allow_partial_minibatch,
+                            double now,
                             const ComputationGroupInfo &info) const;
 
+  // Returns the smallest queue_time of any task in 'info', which must be
+  // nonempty.
+  static double OldestQueueTime(const ComputationGroupInfo &info);
+
   // Returns the minibatch size for this group of tasks, i.e. the size of a full
   // minibatch for this type of task, which is what we'd ideally like to
   // compute.  Note: the is_edge and is_irregular options should be the same
@@ -484,6 +527,9 @@ class NnetBatchComputer {
   // below n, the corresponding condition variable is notified (if it exists).
   std::unordered_map<int32, std::condition_variable*> no_more_than_n_minibatches_full_;
 
+  // Used to set the queue_time of tasks, for --max-batch-wait.
+  Timer timer_;
+
   // some static information about the neural net, computed at the start.
   int32 nnet_left_context_;
   int32 nnet_right_context_;
@@ -558,8 +604,9 @@ class NnetBatchInference {
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchInference);
 
-  // This is the computation thread, which is run in the background.  It will
-  // exit once the user calls Finished() and all computation is completed.
+  // This is the computation thread, which is run in the background (in
+  // opts.num_compute_threads copies).  It will exit once the user calls
+  // Finished() and all computation is completed.
   void Compute();
   // static wrapper for Compute().
   static void ComputeFunc(NnetBatchInference *object) { object->Compute(); }
@@ -576,8 +623,9 @@ class NnetBatchInference {
   bool is_finished_;
 
   // This semaphore is signaled by the main thread (the thread in which
-  // AcceptInput() is called) every time a new utterance is added, and waited on
-  // in the background thread in which Compute() is called.
+  // AcceptInput() is called) every time a new utterance is added (once per
+  // compute thread), and waited on in the background threads in which
+  // Compute() is called.
   Semaphore tasks_ready_semaphore_;
 
   struct UtteranceInfo {
@@ -598,8 +646,8 @@ class NnetBatchInference {
 
   int32 utterance_counter_;  // counter that increases on every utterance.
 
-  // The thread running the Compute() process.
-  std::thread compute_thread_;
+  // The threads running the Compute() process.
+  std::vector<std::thread*> compute_threads_;
 };
 
 
@@ -780,7 +828,9 @@ class NnetBatchDecoder {
   bool allow_partial_;
   NnetBatchComputer *computer_;
   std::vector<std::thread*> decode_threads_;
-  std::thread compute_thread_;  // Thread that calls computer_->Compute().
+  // Threads that call computer_->Compute(); there are
+  // computer_->GetOptions().num_compute_threads of them.
+  std::vector<std::thread*> compute_threads_;
 
 
   // 'input_utterance', together with utterance_ready_semaphore_ and
@@ -801,7 +851,8 @@ class NnetBatchDecoder {
                                         // still needed).
 
   Semaphore tasks_ready_semaphore_; // Is signaled when new tasks are added to
-                                    // the computer_ object (or when we're finished).
+                                    // the computer_ object (or when we're
+                                    // finished), once per compute thread.
 
   bool is_finished_;  // True if the input is finished.  If this is true, a
                       // signal to input_ready_semaphore_ indicates to the
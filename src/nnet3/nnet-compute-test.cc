@@ -98,7 +98,8 @@ void TestNnetDecodable(Nnet *nnet) {
   }
 
   Matrix<BaseFloat> output1(num_frames, output_dim),
-      output2(num_frames, output_dim);
+      output2(num_frames, output_dim),
+      output3(num_frames, output_dim);
 
   {
     NnetSimpleComputationOptions opts;
@@ -112,6 +113,36 @@ void TestNnetDecodable(Nnet *nnet) {
     }
   }
 
+  {
+    // --reuse-activations=true; we access the frames in order and then go
+    // back to the start, which requires the computation to be restarted.
+    NnetSimpleComputationOptions opts;
+    opts.frames_per_chunk = RandInt(5, 25);
+    opts.reuse_activations = true;
+    // With a capacity of 1, the looped computation of the shorter utterance
+    // below is removed from the cache again.
+    CachingOptimizingCompilerOptions compiler_config;
+    compiler_config.cache_capacity = 1;
+    CachingOptimizingCompiler compiler(*nnet, compiler_config);
+    {
+      SubMatrix<BaseFloat> part(input, 0, RandInt(1, input.NumRows()),
+                                0, input.NumCols());
+      DecodableNnetSimple decodable(opts, *nnet, priors, part, &compiler,
+                                    (ivector_dim != 0 ? &ivector : NULL));
+      Vector<BaseFloat> row(output_dim);
+      decodable.GetOutputForFrame(0, &row);
+    }
+    DecodableNnetSimple decodable(opts, *nnet, priors, input, &compiler,
+                                  (ivector_dim != 0 ? &ivector : NULL));
+    for (int32 t = 0; t < num_frames; t++) {
+      SubVector<BaseFloat> row(output3, t);
+      decodable.GetOutputForFrame(t, &row);
+    }
+    Vector<BaseFloat> row(output_dim);
+    decodable.GetOutputForFrame(0, &row);
+    KALDI_ASSERT(row.ApproxEqual(output3.Row(0)));
+  }
+
   {
     NnetSimpleLoopedComputationOptions opts;
     // caution: this may modify nnet, by changing how it consumes iVectors.
@@ -138,8 +169,9 @@ void TestNnetDecodable(Nnet *nnet) {
     // might have 'optional' context if required-time-offsets != time-offsets.
     for (int32 t = 0; t < num_frames; t++) {
       SubVector<BaseFloat> row1(output1, t),
-          row2(output2, t);
+          row2(output2, t), row3(output3, t);
       KALDI_ASSERT(row1.ApproxEqual(row2));
+      KALDI_ASSERT(row1.ApproxEqual(row3));
     }
   }
 }
@@ -276,6 +308,77 @@ void UnitTestNnetCompute() {
   }
 }
 
+// This runs the same computation with serial and with concurrent execution of
+// commands (NnetComputeOptions::num_threads > 1) and checks that the outputs
+// and input-derivatives are the same.
+void UnitTestNnetComputeParallel() {
+  for (int32 n = 0; n < 10; n++) {
+    struct NnetGenerationOptions gen_config;
+    std::vector<std::string> configs;
+    GenerateConfigSequence(gen_config, &configs);
+    Nnet nnet;
+    for (size_t j = 0; j < configs.size(); j++) {
+      std::istringstream is(configs[j]);
+      nnet.ReadConfig(is);
+    }
+    // so that the two runs are deterministic and comparable.
+    SetBatchnormTestMode(true, &nnet);
+    SetDropoutTestMode(true, &nnet);
+
+    ComputationRequest request;
+    std::vector<Matrix<BaseFloat> > inputs;
+    ComputeExampleComputationRequestSimple(nnet, &request, &inputs);
+
+    NnetComputation computation;
+    Compiler compiler(request, nnet);
+    CompilerOptions opts;
+    compiler.CreateComputation(opts, &computation);
+    if (RandInt(0, 1) == 0) {
+      NnetOptimizeOptions opt_config;
+      Optimize(opt_config, nnet, MaxOutputTimeInRequest(request),
+               &computation);
+    }
+    computation.ComputeCudaIndexes();
+
+    CuMatrix<BaseFloat> output_deriv;
+    std::vector<CuMatrix<BaseFloat> > outputs(2);
+    std::vector<std::vector<CuMatrix<BaseFloat> > > input_derivs(2);
+    for (int32 i = 0; i < 2; i++) {
+      NnetComputeOptions compute_opts;
+      if (i == 1)
+        compute_opts.num_threads = RandInt(2, 4);
+      Nnet nnet_to_update(nnet);
+      NnetComputer computer(compute_opts, computation, nnet, &nnet_to_update);
+      {  // copying is allowed while no memos are held.
+        NnetComputer computer_copy(computer);
+      }
+      for (size_t j = 0; j < request.inputs.size(); j++) {
+        CuMatrix<BaseFloat> temp(inputs[j]);
+        computer.AcceptInput(request.inputs[j].name, &temp);
+      }
+      computer.Run();
+      outputs[i] = computer.GetOutput("output");
+      if (request.outputs[0].has_deriv) {
+        if (i == 0) {
+          output_deriv.Resize(outputs[i].NumRows(), outputs[i].NumCols());
+          output_deriv.SetRandn();
+        }
+        CuMatrix<BaseFloat> temp(output_deriv);
+        computer.AcceptInput("output", &temp);
+        computer.Run();
+        for (size_t j = 0; j < request.inputs.size(); j++)
+          if (request.inputs[j].has_deriv)
+            input_derivs[i].push_back(CuMatrix<BaseFloat>(
+                computer.GetOutput(request.inputs[j].name)));
+      }
+    }
+    KALDI_ASSERT(ApproxEqual(outputs[0], outputs[1]));
+    KALDI_ASSERT(input_derivs[0].size() == input_derivs[1].size());
+    for (size_t j = 0; j < input_derivs[0].size(); j++)
+      KALDI_ASSERT(ApproxEqual(input_derivs[0][j], input_derivs[1][j]));
+  }
+}
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -296,6 +399,7 @@ int main() {
       CuDevice::Instantiate().SelectGpuId("yes");
 #endif
     UnitTestNnetCompute();
+    UnitTestNnetComputeParallel();
   }
 
   KALDI_LOG << "Nnet tests succeeded.";
@@ -17,8 +17,13 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <condition_variable>
+#include <functional>
 #include <iterator>
+#include <mutex>
+#include <queue>
 #include <sstream>
+#include <thread>
 #include "nnet3/nnet-compute.h"
 
 namespace kaldi {
@@ -31,7 +36,7 @@ NnetComputer::NnetComputer(const NnetComputeOptions &options,
                            Nnet *nnet_to_update):
     options_(options), computation_(computation), nnet_(nnet),
     program_counter_(0), nnet_to_store_stats_(nnet_to_update),
-    nnet_to_update_(nnet_to_update) {
+    nnet_to_update_(nnet_to_update), worker_pool_(NULL) {
   Init();
 }
 
@@ -41,7 +46,7 @@ NnetComputer::NnetComputer(const NnetComputeOptions &options,
                            Nnet *nnet_to_update):
     options_(options), computation_(computation), nnet_(*nnet),
     program_counter_(0), nnet_to_store_stats_(nnet),
-    nnet_to_update_(nnet_to_update) {
+    nnet_to_update_(nnet_to_update), worker_pool_(NULL) {
   Init();
 }
 
@@ -52,11 +57,34 @@ void NnetComputer::Init() {
                "executing the computation.");
   matrices_.resize(computation_.matrices.size());
   debug_ = (options_.debug || GetVerboseLevel() >= 5);
-  if (debug_) {
+  parallel_ = (options_.num_threads > 1 && !debug_);
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    parallel_ = false;
+#endif
+  int32 max_memo_index = 0;
+  for (size_t i = 0; parallel_ && i < computation_.commands.size(); i++) {
+    const NnetComputation::Command &c = computation_.commands[i];
+    if (c.command_type == kGotoLabel)
+      parallel_ = false;  // e.g. looped computation; the analysis won't work.
+    else if (c.command_type == kPropagate)
+      max_memo_index = std::max(max_memo_index, c.arg5);
+  }
+  if (debug_ || parallel_) {
     ComputationVariables variables;
     variables.Init(computation_);
     ComputeCommandAttributes(nnet_, computation_, variables,
                              &command_attributes_);
+    if (parallel_) {
+      ComputeCommandDependencies(computation_, variables, command_attributes_,
+                                 &command_dependencies_);
+      command_attributes_.clear();
+      // SaveMemo() must not resize memos_ while other threads are running.
+      if (max_memo_index > 0)
+        memos_.resize(max_memo_index + 1, NULL);
+    }
+  }
+  if (debug_) {
     std::string preamble;
     computation_.GetCommandStrings(nnet_, &preamble, &command_strings_);
     KALDI_LOG << preamble;
@@ -199,16 +227,23 @@ NnetComputer::NnetComputer(const NnetComputer &other):
     submatrix_strings_(other.submatrix_strings_),
     command_strings_(other.command_strings_),
     matrices_(other.matrices_),
-    memos_(other.memos_) {
+    memos_(other.memos_),
+    worker_pool_(NULL),
+    parallel_(other.parallel_),
+    command_dependencies_(other.command_dependencies_) {
   // Note: this is the same as the default copy constructor, except for the check below.
-  if (!memos_.empty()) {
-    KALDI_ERR << "You cannot use the copy constructor of NnetComputer if "
-        "memos are used.";
+  // memos_ may have been sized in advance (see Init()), so we check for
+  // memos that are actually held.
+  for (size_t i = 0; i < memos_.size(); i++) {
+    if (memos_[i] != NULL) {
+      KALDI_ERR << "You cannot use the copy constructor of NnetComputer if "
+          "memos are used.";
+    }
   }
 }
 
-void NnetComputer::ExecuteCommand() {
-  const NnetComputation::Command &c = computation_.commands[program_counter_];
+void NnetComputer::ExecuteCommand(int32 command_index) {
+  const NnetComputation::Command &c = computation_.commands[command_index];
   int32 m1, m2;
   try {
     switch (c.command_type) {
@@ -432,17 +467,20 @@ void NnetComputer::ExecuteCommand() {
         KALDI_ERR << "Invalid command in computation";
     }
   } catch (...) {
+    // in case several threads fail at once in RunParallel().
+    static std::mutex error_mutex;
+    std::lock_guard<std::mutex> lock(error_mutex);
     if (!debug_) {
       std::string preamble;
       computation_.GetCommandStrings(nnet_, &preamble, &command_strings_);
       KALDI_WARN << "Printing some background info since error was detected";
       KALDI_LOG << preamble;
-      for (int32 prev_c = 0; prev_c < program_counter_; prev_c++)
+      for (int32 prev_c = 0; prev_c < command_index; prev_c++)
         KALDI_LOG << command_strings_[prev_c];
     }
     // the following will re-throw the error, but now we've printed more info
     // about what went wrong.
-    KALDI_ERR << "Error running command " << command_strings_[program_counter_];
+    KALDI_ERR << "Error running command " << command_strings_[command_index];
   }
 }
 
@@ -521,6 +559,16 @@ void NnetComputer::Run() {
   }
   CheckNoPendingIo();
 
+  if (parallel_) {
+    int32 end_command = program_counter_;
+    while (end_command < num_commands &&
+           c[end_command].command_type != kAcceptInput &&
+           c[end_command].command_type != kProvideOutput)
+      end_command++;
+    RunParallel(end_command);
+    return;
+  }
+
   CommandDebugInfo info;
   Timer timer;
   double total_elapsed_previous = 0.0;
@@ -534,7 +582,7 @@ void NnetComputer::Run() {
     }
     if (debug_)
       DebugBeforeExecute(program_counter_, &info);
-    ExecuteCommand();
+    ExecuteCommand(program_counter_);
     if (debug_) {
       double total_elapsed_now = timer.Elapsed();
       DebugAfterExecute(program_counter_, info,
@@ -544,6 +592,195 @@ void NnetComputer::Run() {
   }
 }
 
+struct NnetComputer::ParallelRunState {
+  std::mutex mutex;
+  std::condition_variable cond;
+  int32 begin_command;
+  // num_pending[c - begin_command] is the number of commands that command c is
+  // still waiting for.
+  std::vector<int32> num_pending;
+  // successors[c - begin_command] is the list of commands that depend on c.
+  std::vector<std::vector<int32> > successors;
+  // Commands that are ready to run.  We take the lowest-numbered one first,
+  // which keeps the order (and hence the memory use) close to that of serial
+  // execution.
+  std::priority_queue<int32, std::vector<int32>, std::greater<int32> > ready;
+  // The number of commands that have not yet finished.
+  int32 num_remaining;
+  bool failed;
+  std::string error;
+};
+
+void NnetComputer::RunParallelWorker(ParallelRunState *state) {
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (true) {
+    while (state->ready.empty() && state->num_remaining > 0 && !state->failed)
+      state->cond.wait(lock);
+    if (state->num_remaining == 0 || state->failed)
+      return;
+    int32 command = state->ready.top();
+    state->ready.pop();
+    lock.unlock();
+    try {
+      ExecuteCommand(command);
+    } catch (const std::exception &e) {
+      lock.lock();
+      state->failed = true;
+      state->error = e.what();
+      state->cond.notify_all();
+      return;
+    }
+    lock.lock();
+    state->num_remaining--;
+    const std::vector<int32> &successors =
+        state->successors[command - state->begin_command];
+    for (size_t i = 0; i < successors.size(); i++) {
+      int32 s = successors[i];
+      if (--(state->num_pending[s - state->begin_command]) == 0) {
+        state->ready.push(s);
+        state->cond.notify_one();
+      }
+    }
+    if (state->num_remaining == 0)
+      state->cond.notify_all();
+  }
+}
+
+class NnetComputer::WorkerPool {
+ public:
+  // Starts "num_threads" threads, which wait for calls to Run().
+  WorkerPool(NnetComputer *computer, int32 num_threads, int32 blas_threads):
+      computer_(computer), state_(NULL), generation_(0), num_busy_(0),
+      exit_(false) {
+    for (int32 t = 0; t < num_threads; t++)
+      threads_.push_back(std::thread(&WorkerPool::ThreadMain, this,
+                                     blas_threads));
+  }
+
+  // Calls computer_->RunParallelWorker(state) on each of the threads and on
+  // the calling thread, and returns when they have all returned.
+  void Run(ParallelRunState *state) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      state_ = state;
+      num_busy_ = threads_.size();
+      generation_++;
+      start_cond_.notify_all();
+    }
+    computer_->RunParallelWorker(state);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (num_busy_ > 0)
+      done_cond_.wait(lock);
+    state_ = NULL;
+  }
+
+  ~WorkerPool() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      exit_ = true;
+      start_cond_.notify_all();
+    }
+    for (size_t t = 0; t < threads_.size(); t++)
+      threads_[t].join();
+  }
+
+ private:
+  void ThreadMain(int32 blas_threads) {
+    // For MKL this setting is per thread, so it is done once here; see
+    // RunParallel() for the process-wide setting.
+    if (blas_threads > 0)
+      SetBlasNumThreads(blas_threads);
+    int64 last_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (!exit_ && generation_ == last_generation)
+        start_cond_.wait(lock);
+      if (exit_)
+        return;
+      last_generation = generation_;
+      ParallelRunState *state = state_;
+      lock.unlock();
+      computer_->RunParallelWorker(state);
+      lock.lock();
+      if (--num_busy_ == 0)
+        done_cond_.notify_all();
+    }
+  }
+
+  NnetComputer *computer_;
+  std::mutex mutex_;
+  std::condition_variable start_cond_;
+  std::condition_variable done_cond_;
+  ParallelRunState *state_;
+  int64 generation_;  // incremented by each call to Run().
+  int32 num_busy_;  // number of threads still working on state_.
+  bool exit_;
+  std::vector<std::thread> threads_;
+};
+
+void NnetComputer::RunParallel(int32 end_command) {
+  int32 begin_command = program_counter_,
+      num_commands = end_command - begin_command;
+  if (num_commands == 0)
+    return;
+  ParallelRunState state;
+  state.begin_command = begin_command;
+  state.num_pending.resize(num_commands, 0);
+  state.successors.resize(num_commands);
+  state.num_remaining = num_commands;
+  state.failed = false;
+
+  // We also work out the depth of each command in the dependency graph and the
+  // largest number of (non-trivial) commands at any one depth; if this is 1,
+  // nothing can run concurrently and we avoid the overhead of the threads.
+  std::vector<int32> depth(num_commands, 0), num_at_depth(num_commands, 0);
+  int32 max_width = 0;
+  for (int32 i = 0; i < num_commands; i++) {
+    int32 command = begin_command + i;
+    const std::vector<int32> &deps = command_dependencies_[command];
+    for (size_t j = 0; j < deps.size(); j++) {
+      // dependencies on commands before begin_command are already satisfied.
+      if (deps[j] >= begin_command) {
+        state.num_pending[i]++;
+        state.successors[deps[j] - begin_command].push_back(command);
+        depth[i] = std::max(depth[i], depth[deps[j] - begin_command] + 1);
+      }
+    }
+    if (state.num_pending[i] == 0)
+      state.ready.push(command);
+    CommandType type = computation_.commands[command].command_type;
+    if (type != kNoOperation && type != kNoOperationPermanent &&
+        type != kNoOperationMarker && type != kNoOperationLabel &&
+        type != kAllocMatrix && type != kDeallocMatrix)
+      max_width = std::max(max_width, ++num_at_depth[depth[i]]);
+  }
+  int32 num_threads = std::min(options_.num_threads, max_width);
+  if (num_threads <= 1) {
+    for (; program_counter_ < end_command; program_counter_++)
+      ExecuteCommand(program_counter_);
+    return;
+  }
+
+  int32 blas_threads = options_.blas_threads_per_command,
+      prev_blas_threads = 0;
+  // Note: for OpenBLAS this changes the setting for the whole process until
+  // we restore it below.
+  if (blas_threads > 0)
+    prev_blas_threads = SetBlasNumThreads(blas_threads);
+  if (worker_pool_ == NULL)
+    worker_pool_ = new WorkerPool(this, options_.num_threads - 1,
+                                  blas_threads);
+  // If the pool has more threads than this segment can use, the extra ones
+  // just wait in RunParallelWorker() until the segment is finished.
+  worker_pool_->Run(&state);
+  if (blas_threads > 0 && prev_blas_threads >= 0)
+    SetBlasNumThreads(prev_blas_threads);
+  if (state.failed)
+    KALDI_ERR << "Error in concurrent execution of computation: "
+              << state.error;
+  program_counter_ = end_command;
+}
+
 void NnetComputer::AcceptInput(const std::string &node_name,
                                CuMatrix<BaseFloat> *input) {
   bool is_output = false;
@@ -684,6 +921,7 @@ NnetComputer::~NnetComputer() {
   // the forward propagation but not the backprop.
   for (size_t i = 0; i < compressed_matrices_.size(); i++)
     delete compressed_matrices_[i];
+  delete worker_pool_;
 }
 
 } // namespace nnet3
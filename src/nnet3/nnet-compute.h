@@ -38,11 +38,28 @@ namespace nnet3 {
 
 struct NnetComputeOptions {
   bool debug;
-  NnetComputeOptions(): debug(false) { }
+  int32 num_threads;
+  int32 blas_threads_per_command;
+  NnetComputeOptions(): debug(false), num_threads(1),
+                        blas_threads_per_command(0) { }
   void Register(OptionsItf *opts) {
     opts->Register("debug", &debug, "If true, turn on "
                    "debug for the neural net computation (very verbose!) "
                    "Will be turned on regardless if --verbose >= 5");
+    opts->Register("num-threads", &num_threads, "If >1 and we are not "
+                   "using a GPU, the number of threads used to execute "
+                   "mutually independent commands of the neural net "
+                   "computation concurrently (e.g. parallel branches of the "
+                   "network, or separate outputs).  The sub-components of "
+                   "a CompositeComponent are still run one after another.");
+    opts->Register("blas-threads-per-command", &blas_threads_per_command,
+                   "If >0 and --num-threads > 1, the number of threads "
+                   "the BLAS library may use inside each command while "
+                   "commands are run concurrently.  Only MKL supports this "
+                   "per thread.  For OpenBLAS the setting is process-wide, "
+                   "so while the computation runs it also affects BLAS calls "
+                   "from other threads of the program.  If 0, the BLAS "
+                   "library's setting is not changed.");
   }
 
 };
@@ -110,6 +127,12 @@ class NnetComputer {
   /// and provide derivatives; and the second time you call it, it will do
   /// the backward computation.  There used to be two separate functions
   /// Forward() and Backward().
+  /// If options.num_threads > 1 and we are not using a GPU, mutually
+  /// independent commands will be executed concurrently (see
+  /// ComputeCommandDependencies()); the results are the same as for serial
+  /// execution.  The threads are started the first time they are needed and
+  /// are kept until this object is destroyed.  A CompositeComponent is one
+  /// command, so its sub-components are not run concurrently.
   void Run();
 
   // e.g. GetOutput("output").  This function can also be used to get
@@ -173,8 +196,39 @@ class NnetComputer {
   std::vector<CuCompressedMatrixBase*> compressed_matrices_;
 
 
-  // executes the command in computation_.commands[program_counter_].
-  void ExecuteCommand();
+  // executes the command in computation_.commands[command_index].  If it
+  // is a kGotoLabel command, this sets program_counter_.
+  void ExecuteCommand(int32 command_index);
+
+  // Called from Run() if parallel_ is true; executes the commands in the range
+  // [program_counter_, end_command) on up to options_.num_threads threads,
+  // respecting command_dependencies_, and sets program_counter_ to
+  // end_command.
+  void RunParallel(int32 end_command);
+
+  // Bookkeeping shared between the threads in RunParallel(); defined in the
+  // .cc file.
+  struct ParallelRunState;
+
+  // Used inside RunParallel(): the function executed by each thread.
+  void RunParallelWorker(ParallelRunState *state);
+
+  // The threads that RunParallel() uses in addition to the calling thread;
+  // defined in the .cc file.
+  class WorkerPool;
+  // Created by RunParallel() the first time it needs more than one thread,
+  // and reused for each later call; NULL until then.  Not copied by the
+  // copy constructor.
+  WorkerPool *worker_pool_;
+
+  // True if Run() should execute commands concurrently; this requires
+  // options_.num_threads > 1, no GPU, no debug mode and no kGotoLabel
+  // commands in the computation.
+  bool parallel_;
+  // command_dependencies_[c] is the list of earlier commands that command c
+  // must wait for; only set up if parallel_ is true (see
+  // ComputeCommandDependencies()).
+  std::vector<std::vector<int32> > command_dependencies_;
 
   // Returns the matrix index where the input (if is_output==false) or output
   // matrix index for "node_name" is stored.  This looks at the next command (at
@@ -405,6 +405,10 @@ class OptionalSumDescriptor: public SumDescriptor {
 
   OptionalSumDescriptor(SumDescriptor *src): src_(src) { }
   virtual ~OptionalSumDescriptor() { delete src_; }
+
+  // this function is not in the shared interface. it's used
+  // by ConvertNnetToFlat().
+  const SumDescriptor &Src() const { return *src_; }
  private:
   SumDescriptor *src_;
 };
@@ -474,6 +478,10 @@ class ConstantSumDescriptor: public SumDescriptor {
 
   ConstantSumDescriptor(BaseFloat value, int32 dim);
   virtual ~ConstantSumDescriptor() {}
+
+  // this function is not in the shared interface. it's used
+  // by ConvertNnetToFlat().
+  BaseFloat Value() const { return value_; }
  private:
   BaseFloat value_;
   int32 dim_;
@@ -511,6 +519,12 @@ class BinarySumDescriptor: public SumDescriptor {
   BinarySumDescriptor(Operation op, SumDescriptor *src1, SumDescriptor *src2):
       op_(op), src1_(src1), src2_(src2) {}
   virtual ~BinarySumDescriptor() { delete src1_; delete src2_; }
+
+  // these functions are not in the shared interface. they are used
+  // by ConvertNnetToFlat().
+  Operation Op() const { return op_; }
+  const SumDescriptor &Src1() const { return *src1_; }
+  const SumDescriptor &Src2() const { return *src2_; }
  private:
   Operation op_;
   SumDescriptor *src1_;
@@ -0,0 +1,316 @@
+// nnet3/nnet-flat-graph-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-flat-graph.h"
+#include "nnet3/nnet-nnet.h"
+#include "nnet3/nnet-utils.h"
+#include "nnet3/nnet-optimize.h"
+#include "nnet3/nnet-compute.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Returns the config of a TDNN-F-like network with an iVector input.
+std::string GetTdnnfConfig(int32 input_dim, int32 ivector_dim,
+                           int32 hidden_dim, int32 bottleneck_dim,
+                           int32 output_dim) {
+  std::ostringstream os;
+  os << "input-node name=input dim=" << input_dim << "\n"
+     << "input-node name=ivector dim=" << ivector_dim << "\n"
+     << "component name=lda type=FixedAffineComponent input-dim="
+     << (3 * input_dim + ivector_dim) << " output-dim=" << hidden_dim << "\n"
+     << "component-node name=lda component=lda input=Append(Offset(input, -1),"
+     << " input, Offset(input, 1), ReplaceIndex(ivector, t, 0))\n"
+     << "component name=tdnn1.affine type=NaturalGradientAffineComponent "
+     << "input-dim=" << hidden_dim << " output-dim=" << hidden_dim << "\n"
+     << "component-node name=tdnn1.affine component=tdnn1.affine input=lda\n"
+     << "component name=tdnn1.relu type=RectifiedLinearComponent dim="
+     << hidden_dim << "\n"
+     << "component-node name=tdnn1.relu component=tdnn1.relu "
+     << "input=tdnn1.affine\n"
+     << "component name=tdnn1.batchnorm type=BatchNormComponent dim="
+     << hidden_dim << "\n"
+     << "component-node name=tdnn1.batchnorm component=tdnn1.batchnorm "
+     << "input=tdnn1.relu\n"
+     << "component name=tdnn1.dropout type=GeneralDropoutComponent dim="
+     << hidden_dim << " dropout-proportion=0.5 continuous=true\n"
+     << "component-node name=tdnn1.dropout component=tdnn1.dropout "
+     << "input=tdnn1.batchnorm\n"
+     << "component name=tdnnf2.linear type=TdnnComponent input-dim="
+     << hidden_dim << " output-dim=" << bottleneck_dim
+     << " time-offsets=-1,0 use-bias=false\n"
+     << "component-node name=tdnnf2.linear component=tdnnf2.linear "
+     << "input=tdnn1.dropout\n"
+     << "component name=tdnnf2.affine type=TdnnComponent input-dim="
+     << bottleneck_dim << " output-dim=" << hidden_dim
+     << " time-offsets=0,2\n"
+     << "component-node name=tdnnf2.affine component=tdnnf2.affine "
+     << "input=tdnnf2.linear\n"
+     << "component name=tdnnf2.relu type=RectifiedLinearComponent dim="
+     << hidden_dim << "\n"
+     << "component-node name=tdnnf2.relu component=tdnnf2.relu "
+     << "input=tdnnf2.affine\n"
+     << "component name=tdnnf2.batchnorm type=BatchNormComponent dim="
+     << hidden_dim << "\n"
+     << "component-node name=tdnnf2.batchnorm component=tdnnf2.batchnorm "
+     << "input=tdnnf2.relu\n"
+     << "component name=tdnnf2.noop type=NoOpComponent dim=" << hidden_dim
+     << "\n"
+     << "component-node name=tdnnf2.noop component=tdnnf2.noop "
+     << "input=Sum(Scale(0.66, tdnn1.dropout), tdnnf2.batchnorm)\n"
+     << "component name=prefinal.linear type=LinearComponent input-dim="
+     << hidden_dim << " output-dim=" << bottleneck_dim << "\n"
+     << "component-node name=prefinal.linear component=prefinal.linear "
+     << "input=tdnnf2.noop\n"
+     << "component name=prefinal.scale type=ScaleAndOffsetComponent dim="
+     << bottleneck_dim << "\n"
+     << "component-node name=prefinal.scale component=prefinal.scale "
+     << "input=prefinal.linear\n"
+     << "component name=output.affine type=NaturalGradientAffineComponent "
+     << "input-dim=" << bottleneck_dim << " output-dim=" << output_dim << "\n"
+     << "component-node name=output.affine component=output.affine "
+     << "input=prefinal.scale\n"
+     << "component name=output.log-softmax type=LogSoftmaxComponent dim="
+     << output_dim << "\n"
+     << "component-node name=output.log-softmax component=output.log-softmax "
+     << "input=output.affine\n"
+     << "output-node name=output input=output.log-softmax\n"
+     << "output-node name=output-xent input=Sum(Offset(output.affine, 1), "
+     << "Const(0.5, " << output_dim << "))\n";
+  return os.str();
+}
+
+// Returns the config of an LSTM with a projection and a recurrence with delay
+// 'delay', preceded by an elementwise product of nonlinearities.
+std::string GetLstmConfig(int32 input_dim, int32 cell_dim,
+                          int32 projection_dim, int32 output_dim,
+                          int32 delay) {
+  std::ostringstream os;
+  os << "input-node name=input dim=" << input_dim << "\n"
+     << "component name=pre.tanh type=TanhComponent dim=" << input_dim << "\n"
+     << "component-node name=pre.tanh component=pre.tanh input=input\n"
+     << "component name=pre.sigmoid type=SigmoidComponent dim=" << input_dim
+     << "\n"
+     << "component-node name=pre.sigmoid component=pre.sigmoid input=input\n"
+     << "component name=pre.product type=ElementwiseProductComponent "
+     << "input-dim=" << (2 * input_dim) << " output-dim=" << input_dim << "\n"
+     << "component-node name=pre.product component=pre.product "
+     << "input=Append(pre.tanh, pre.sigmoid)\n"
+     << "component name=lstm.W_all type=NaturalGradientAffineComponent "
+     << "input-dim=" << (input_dim + projection_dim) << " output-dim="
+     << (4 * cell_dim) << "\n"
+     << "component-node name=lstm.W_all component=lstm.W_all "
+     << "input=Append(pre.product, IfDefined(Offset(lstm.r_trunc, -"
+     << delay << ")))\n"
+     << "component name=lstm.lstm_nonlin type=LstmNonlinearityComponent "
+     << "cell-dim=" << cell_dim << "\n"
+     << "component-node name=lstm.lstm_nonlin component=lstm.lstm_nonlin "
+     << "input=Append(lstm.W_all, IfDefined(Offset(lstm.c_trunc, -"
+     << delay << ")))\n"
+     << "dim-range-node name=lstm.c input-node=lstm.lstm_nonlin dim-offset=0 "
+     << "dim=" << cell_dim << "\n"
+     << "dim-range-node name=lstm.m input-node=lstm.lstm_nonlin dim-offset="
+     << cell_dim << " dim=" << cell_dim << "\n"
+     << "component name=lstm.W_rp type=NaturalGradientAffineComponent "
+     << "input-dim=" << cell_dim << " output-dim=" << projection_dim << "\n"
+     << "component-node name=lstm.rp component=lstm.W_rp input=lstm.m\n"
+     << "component name=lstm.cr_trunc type=BackpropTruncationComponent dim="
+     << (cell_dim + projection_dim) << " scale=0.9\n"
+     << "component-node name=lstm.cr_trunc component=lstm.cr_trunc "
+     << "input=Append(lstm.c, lstm.rp)\n"
+     << "dim-range-node name=lstm.c_trunc input-node=lstm.cr_trunc "
+     << "dim-offset=0 dim=" << cell_dim << "\n"
+     << "dim-range-node name=lstm.r_trunc input-node=lstm.cr_trunc "
+     << "dim-offset=" << cell_dim << " dim=" << projection_dim << "\n"
+     << "component name=output.affine type=NaturalGradientAffineComponent "
+     << "input-dim=" << projection_dim << " output-dim=" << output_dim << "\n"
+     << "component-node name=output.affine component=output.affine "
+     << "input=lstm.rp\n"
+     << "component name=output.softmax type=SoftmaxComponent dim="
+     << output_dim << "\n"
+     << "component-node name=output.softmax component=output.softmax "
+     << "input=output.affine\n"
+     << "output-node name=output input=output.softmax\n";
+  return os.str();
+}
+
+// Computes output 'output_name' of 'nnet' for times first_t ... first_t +
+// num_frames - 1 with the regular nnet3 computation, given the input
+// starting at time input_first_t and (if non-NULL) the iVector for time 0.
+// If nnet_to_store_stats is non-NULL, the component stats (e.g. for batch-norm)
+// are stored there.
+void ComputeReferenceOutput(const Nnet &nnet,
+                            int32 input_first_t,
+                            const Matrix<BaseFloat> &input,
+                            const Matrix<BaseFloat> *ivector,
+                            const std::string &output_name,
+                            int32 first_t, int32 num_frames,
+                            Nnet *nnet_to_store_stats,
+                            Matrix<BaseFloat> *output) {
+  ComputationRequest request;
+  request.inputs.resize(ivector != NULL ? 2 : 1);
+  request.inputs[0].name = "input";
+  for (int32 t = 0; t < input.NumRows(); t++)
+    request.inputs[0].indexes.push_back(Index(0, input_first_t + t));
+  if (ivector != NULL) {
+    request.inputs[1].name = "ivector";
+    request.inputs[1].indexes.push_back(Index(0, 0));
+  }
+  request.outputs.resize(1);
+  request.outputs[0].name = output_name;
+  for (int32 t = 0; t < num_frames; t++)
+    request.outputs[0].indexes.push_back(Index(0, first_t + t));
+  request.store_component_stats = (nnet_to_store_stats != NULL);
+
+  CachingOptimizingCompiler compiler(nnet);
+  std::shared_ptr<const NnetComputation> computation =
+      compiler.Compile(request);
+  NnetComputeOptions opts;
+  NnetComputer *computer = (nnet_to_store_stats != NULL ?
+      new NnetComputer(opts, *computation, nnet_to_store_stats, NULL) :
+      new NnetComputer(opts, *computation, nnet, NULL));
+  CuMatrix<BaseFloat> input_cu(input);
+  computer->AcceptInput("input", &input_cu);
+  if (ivector != NULL) {
+    CuMatrix<BaseFloat> ivector_cu(*ivector);
+    computer->AcceptInput("ivector", &ivector_cu);
+  }
+  computer->Run();
+  CuMatrix<BaseFloat> output_cu;
+  computer->GetOutputDestructive(output_name, &output_cu);
+  delete computer;
+  output->Resize(output_cu.NumRows(), output_cu.NumCols());
+  output->CopyFromMat(output_cu);
+}
+
+// Converts 'nnet' to the flat format and checks that the I/O works, that the
+// context is the same, and that FlatNnetComputer gives the same outputs as
+// the regular computation.
+void TestFlatNnetEquivalence(const Nnet &nnet,
+                             const std::vector<std::string> &output_names) {
+  FlatNnet flat_nnet;
+  ConvertNnetToFlat(nnet, &flat_nnet);
+  KALDI_LOG << "Flat nnet info is: " << flat_nnet.Info();
+
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  flat_nnet.Write(os, binary);
+  FlatNnet flat_nnet2;
+  {
+    std::istringstream is(os.str());
+    flat_nnet2.Read(is, binary);
+  }
+  std::ostringstream os2;
+  flat_nnet2.Write(os2, binary);
+  if (binary)
+    KALDI_ASSERT(os.str() == os2.str());
+
+  int32 left_context, right_context, flat_left_context, flat_right_context;
+  ComputeSimpleNnetContext(nnet, &left_context, &right_context);
+  flat_nnet2.ComputeContext("output", "input", &flat_left_context,
+                            &flat_right_context);
+  KALDI_ASSERT(flat_left_context == left_context &&
+               flat_right_context == right_context);
+
+  bool has_ivector = (nnet.InputDim("ivector") > 0);
+  int32 num_frames = RandInt(1, 30),
+      first_t = RandInt(-5, 5),
+      input_first_t = first_t - left_context - RandInt(0, 4),
+      input_frames = (first_t + num_frames + right_context + RandInt(0, 4)) -
+      input_first_t;
+  // This is the context required for the extra outputs, which may be larger.
+  input_first_t -= 2;
+  input_frames += 4;
+  Matrix<BaseFloat> input(input_frames, nnet.InputDim("input")), ivector;
+  input.SetRandn();
+  if (has_ivector) {
+    ivector.Resize(1, nnet.InputDim("ivector"));
+    ivector.SetRandn();
+  }
+
+  FlatNnetComputer computer(flat_nnet2);
+  computer.AcceptInput("input", input_first_t, input);
+  if (has_ivector)
+    computer.AcceptInput("ivector", 0, ivector);
+  for (size_t i = 0; i < output_names.size(); i++) {
+    Matrix<BaseFloat> ref_output, output;
+    ComputeReferenceOutput(nnet, input_first_t, input,
+                           (has_ivector ? &ivector : NULL), output_names[i],
+                           first_t, num_frames, NULL, &ref_output);
+    computer.Compute(output_names[i], first_t, num_frames, &output);
+    KALDI_LOG << "For output " << output_names[i] << ", reference output sum "
+              << "is " << ref_output.Sum() << " vs. " << output.Sum();
+    KALDI_ASSERT(output.ApproxEqual(ref_output, 0.001));
+  }
+}
+
+void UnitTestFlatNnetTdnnf() {
+  int32 input_dim = RandInt(2, 10), ivector_dim = RandInt(1, 5),
+      hidden_dim = RandInt(5, 20), bottleneck_dim = RandInt(3, 10),
+      output_dim = RandInt(2, 10);
+  Nnet nnet;
+  {
+    std::istringstream is(GetTdnnfConfig(input_dim, ivector_dim, hidden_dim,
+                                         bottleneck_dim, output_dim));
+    nnet.ReadConfig(is);
+  }
+  // Make the scale-and-offset component non-trivial.
+  PerturbParams(0.1, &nnet);
+
+  // Store some stats for the batch-norm components, so that test mode is
+  // meaningful.
+  Matrix<BaseFloat> input(40, input_dim), ivector(1, ivector_dim), output;
+  input.SetRandn();
+  ivector.SetRandn();
+  ComputeReferenceOutput(nnet, -5, input, &ivector, "output", 0, 30, &nnet,
+                         &output);
+  SetBatchnormTestMode(true, &nnet);
+  SetDropoutTestMode(true, &nnet);
+
+  std::vector<std::string> output_names;
+  output_names.push_back("output");
+  output_names.push_back("output-xent");
+  TestFlatNnetEquivalence(nnet, output_names);
+}
+
+void UnitTestFlatNnetLstm() {
+  int32 input_dim = RandInt(2, 10), cell_dim = RandInt(2, 10),
+      projection_dim = RandInt(2, 10), output_dim = RandInt(2, 10),
+      delay = RandInt(1, 3);
+  Nnet nnet;
+  {
+    std::istringstream is(GetLstmConfig(input_dim, cell_dim, projection_dim,
+                                        output_dim, delay));
+    nnet.ReadConfig(is);
+  }
+  std::vector<std::string> output_names(1, "output");
+  TestFlatNnetEquivalence(nnet, output_names);
+}
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestFlatNnetTdnnf();
+    UnitTestFlatNnetLstm();
+  }
+  KALDI_LOG << "Flat nnet tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,998 @@
+// nnet3/nnet-flat-graph.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <sstream>
+#include "nnet3/nnet-flat-graph.h"
+#include "nnet3/nnet-graph.h"
+#include "nnet3/nnet-utils.h"
+#include "nnet3/nnet-simple-component.h"
+#include "nnet3/nnet-combined-component.h"
+#include "nnet3/nnet-convolutional-component.h"
+#include "nnet3/nnet-sparse-component.h"
+#include "cudamatrix/cu-math.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Sentinels for the times on which a node is defined if it does not depend
+// on any input; they are far from any time that occurs in practice, but small
+// enough that adding time offsets to them cannot overflow.
+static const int32 kMinFlatTime = -100000000,
+    kMaxFlatTime = 100000000;
+
+static const char *kFlatNnetOpNames[] = { "Input", "Affine", "Relu",
+                                          "Sigmoid", "Tanh", "Softmax",
+                                          "LogSoftmax", "ScaleAndOffset",
+                                          "Product", "Lstm", "Copy" };
+static const int32 kNumFlatNnetOps = 11;
+
+const char *FlatNnetOpTypeToString(FlatNnetOpType op) {
+  KALDI_ASSERT(static_cast<int32>(op) >= 0 &&
+               static_cast<int32>(op) < kNumFlatNnetOps);
+  return kFlatNnetOpNames[static_cast<int32>(op)];
+}
+
+FlatNnetOpType StringToFlatNnetOpType(const std::string &str) {
+  for (int32 i = 0; i < kNumFlatNnetOps; i++)
+    if (str == kFlatNnetOpNames[i])
+      return static_cast<FlatNnetOpType>(i);
+  KALDI_ERR << "Unknown op type in flat nnet: " << str;
+  return kFlatInput;  // Suppress compiler warning.
+}
+
+
+void FlatNnetTerm::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<Term>");
+  WriteBasicType(os, binary, node);
+  WriteBasicType(os, binary, col_offset);
+  WriteBasicType(os, binary, t_offset);
+  WriteBasicType(os, binary, fixed_t);
+  WriteBasicType(os, binary, optional);
+  WriteBasicType(os, binary, scale);
+}
+
+void FlatNnetTerm::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<Term>");
+  ReadBasicType(is, binary, &node);
+  ReadBasicType(is, binary, &col_offset);
+  ReadBasicType(is, binary, &t_offset);
+  ReadBasicType(is, binary, &fixed_t);
+  ReadBasicType(is, binary, &optional);
+  ReadBasicType(is, binary, &scale);
+}
+
+void FlatNnetPart::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<Part>");
+  WriteBasicType(os, binary, dim);
+  WriteBasicType(os, binary, constant);
+  int32 num_terms = terms.size();
+  WriteBasicType(os, binary, num_terms);
+  for (int32 i = 0; i < num_terms; i++)
+    terms[i].Write(os, binary);
+}
+
+void FlatNnetPart::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<Part>");
+  ReadBasicType(is, binary, &dim);
+  ReadBasicType(is, binary, &constant);
+  int32 num_terms;
+  ReadBasicType(is, binary, &num_terms);
+  if (num_terms < 0)
+    KALDI_ERR << "Bad number of terms in flat nnet: " << num_terms;
+  terms.resize(num_terms);
+  for (int32 i = 0; i < num_terms; i++)
+    terms[i].Read(is, binary);
+}
+
+int32 FlatNnetNode::InputDim() const {
+  int32 ans = 0;
+  for (size_t p = 0; p < input.size(); p++)
+    ans += input[p].dim;
+  return ans;
+}
+
+void FlatNnetNode::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<Node>");
+  WriteToken(os, binary, name);
+  WriteToken(os, binary, FlatNnetOpTypeToString(op));
+  WriteToken(os, binary, "<Dim>");
+  WriteBasicType(os, binary, dim);
+  WriteToken(os, binary, "<IsOutput>");
+  WriteBasicType(os, binary, is_output);
+  WriteToken(os, binary, "<NumParts>");
+  int32 num_parts = input.size();
+  WriteBasicType(os, binary, num_parts);
+  for (int32 p = 0; p < num_parts; p++)
+    input[p].Write(os, binary);
+  WriteToken(os, binary, "<Params>");
+  params.Write(os, binary);
+  WriteToken(os, binary, "<Bias>");
+  bias.Write(os, binary);
+  WriteToken(os, binary, "</Node>");
+}
+
+void FlatNnetNode::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<Node>");
+  ReadToken(is, binary, &name);
+  std::string op_str;
+  ReadToken(is, binary, &op_str);
+  op = StringToFlatNnetOpType(op_str);
+  ExpectToken(is, binary, "<Dim>");
+  ReadBasicType(is, binary, &dim);
+  ExpectToken(is, binary, "<IsOutput>");
+  ReadBasicType(is, binary, &is_output);
+  ExpectToken(is, binary, "<NumParts>");
+  int32 num_parts;
+  ReadBasicType(is, binary, &num_parts);
+  if (num_parts < 0)
+    KALDI_ERR << "Bad number of parts in flat nnet: " << num_parts;
+  input.resize(num_parts);
+  for (int32 p = 0; p < num_parts; p++)
+    input[p].Read(is, binary);
+  ExpectToken(is, binary, "<Params>");
+  params.Read(is, binary);
+  ExpectToken(is, binary, "<Bias>");
+  bias.Read(is, binary);
+  ExpectToken(is, binary, "</Node>");
+}
+
+
+int32 FlatNnet::AddNode(const FlatNnetNode &node) {
+  nodes_.push_back(node);
+  return nodes_.size() - 1;
+}
+
+int32 FlatNnet::GetNodeIndex(const std::string &name) const {
+  for (size_t n = 0; n < nodes_.size(); n++)
+    if (nodes_[n].name == name)
+      return n;
+  return -1;
+}
+
+void FlatNnet::Check() const {
+  int32 num_nodes = NumNodes();
+  std::set<std::string> names;
+  for (int32 n = 0; n < num_nodes; n++) {
+    const FlatNnetNode &node = nodes_[n];
+    if (node.name.empty() || !names.insert(node.name).second)
+      KALDI_ERR << "Empty or duplicate node name '" << node.name << "'";
+    if (node.dim <= 0)
+      KALDI_ERR << "Invalid dimension for node " << node.name;
+    for (size_t p = 0; p < node.input.size(); p++) {
+      const FlatNnetPart &part = node.input[p];
+      if (part.dim <= 0)
+        KALDI_ERR << "Invalid part dimension for node " << node.name;
+      for (size_t i = 0; i < part.terms.size(); i++) {
+        const FlatNnetTerm &term = part.terms[i];
+        if (term.node < 0 || term.node >= num_nodes ||
+            term.col_offset < 0 ||
+            term.col_offset + part.dim > nodes_[term.node].dim)
+          KALDI_ERR << "Invalid term in input of node " << node.name;
+        bool delayed = term.optional && !term.fixed_t && term.t_offset < 0;
+        if (term.node >= n && !delayed)
+          KALDI_ERR << "Nodes are not in topological order: " << node.name
+                    << " depends on " << nodes_[term.node].name;
+      }
+    }
+    int32 input_dim = node.InputDim(), dim = node.dim;
+    bool params_ok = true, dims_ok = true;
+    switch (node.op) {
+      case kFlatInput:
+        dims_ok = node.input.empty();
+        params_ok = (node.params.NumRows() == 0);
+        break;
+      case kFlatAffine:
+        params_ok = (node.params.NumRows() == dim &&
+                     node.params.NumCols() == input_dim &&
+                     (node.bias.Dim() == 0 || node.bias.Dim() == dim));
+        break;
+      case kFlatRelu: case kFlatSigmoid: case kFlatTanh: case kFlatSoftmax:
+      case kFlatLogSoftmax: case kFlatCopy:
+        dims_ok = (input_dim == dim);
+        params_ok = (node.params.NumRows() == 0);
+        break;
+      case kFlatScaleAndOffset:
+        dims_ok = (input_dim == dim);
+        params_ok = (node.params.NumRows() == 2 && node.params.NumCols() == dim);
+        break;
+      case kFlatProduct:
+        dims_ok = (input_dim > 0 && input_dim % dim == 0);
+        params_ok = (node.params.NumRows() == 0);
+        break;
+      case kFlatLstm:
+        dims_ok = (dim % 2 == 0 && input_dim * 2 == dim * 5);
+        params_ok = (node.params.NumRows() == 3 &&
+                     node.params.NumCols() * 2 == dim);
+        break;
+      default:
+        KALDI_ERR << "Invalid op type " << static_cast<int32>(node.op);
+    }
+    if (node.op != kFlatAffine && node.bias.Dim() != 0)
+      params_ok = false;
+    if (!dims_ok)
+      KALDI_ERR << "Input and output dimensions " << input_dim << " and "
+                << dim << " do not match for node " << node.name << " of type "
+                << FlatNnetOpTypeToString(node.op);
+    if (!params_ok)
+      KALDI_ERR << "Parameters have the wrong dimension for node "
+                << node.name;
+  }
+}
+
+void FlatNnet::ComputeContext(const std::string &output_name,
+                              const std::string &input_name,
+                              int32 *left_context,
+                              int32 *right_context) const {
+  int32 output_node = GetNodeIndex(output_name),
+      input_node = GetNodeIndex(input_name);
+  if (output_node < 0 || input_node < 0)
+    KALDI_ERR << "No such node " << (output_node < 0 ? output_name :
+                                     input_name);
+  // [min_t[n], max_t[n]] is the range of times of the input that node n
+  // requires for time zero; 'depends[n]' is false if it does not depend on
+  // the input at all.  Only non-optional terms refer to earlier nodes, so a
+  // single pass suffices.
+  int32 num_nodes = NumNodes();
+  std::vector<int32> min_t(num_nodes, 0), max_t(num_nodes, 0);
+  std::vector<bool> depends(num_nodes, false);
+  depends[input_node] = true;
+  for (int32 n = 0; n <= output_node; n++) {
+    const FlatNnetNode &node = nodes_[n];
+    for (size_t p = 0; p < node.input.size(); p++) {
+      const FlatNnetPart &part = node.input[p];
+      for (size_t i = 0; i < part.terms.size(); i++) {
+        const FlatNnetTerm &term = part.terms[i];
+        if (term.optional || term.fixed_t || !depends[term.node])
+          continue;
+        int32 lo = min_t[term.node] + term.t_offset,
+            hi = max_t[term.node] + term.t_offset;
+        if (!depends[n]) {
+          depends[n] = true;
+          min_t[n] = lo;
+          max_t[n] = hi;
+        } else {
+          min_t[n] = std::min(min_t[n], lo);
+          max_t[n] = std::max(max_t[n], hi);
+        }
+      }
+    }
+  }
+  *left_context = std::max<int32>(0, -min_t[output_node]);
+  *right_context = std::max<int32>(0, max_t[output_node]);
+}
+
+std::string FlatNnet::Info() const {
+  std::ostringstream os;
+  int64 num_params = 0;
+  for (int32 n = 0; n < NumNodes(); n++)
+    num_params += nodes_[n].params.NumRows() * nodes_[n].params.NumCols() +
+        nodes_[n].bias.Dim();
+  os << "num-nodes=" << NumNodes() << "\n"
+     << "num-parameters=" << num_params << "\n";
+  for (int32 n = 0; n < NumNodes(); n++) {
+    const FlatNnetNode &node = nodes_[n];
+    os << "node " << n << ": name=" << node.name << ", op="
+       << FlatNnetOpTypeToString(node.op) << ", dim=" << node.dim;
+    if (node.op != kFlatInput)
+      os << ", input-dim=" << node.InputDim();
+    if (node.is_output)
+      os << ", is-output=true";
+    os << ", inputs=";
+    for (size_t p = 0; p < node.input.size(); p++) {
+      const FlatNnetPart &part = node.input[p];
+      os << (p == 0 ? "" : ",") << "[";
+      for (size_t i = 0; i < part.terms.size(); i++) {
+        const FlatNnetTerm &term = part.terms[i];
+        os << (i == 0 ? "" : "+") << nodes_[term.node].name
+           << (term.fixed_t ? "@" : "") << "(" << term.t_offset << ")";
+        if (term.optional)
+          os << "?";
+      }
+      if (part.constant != 0.0)
+        os << (part.terms.empty() ? "" : "+") << part.constant;
+      os << "]";
+    }
+    os << "\n";
+  }
+  return os.str();
+}
+
+void FlatNnet::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<FlatNnet>");
+  WriteToken(os, binary, "<NumNodes>");
+  int32 num_nodes = NumNodes();
+  WriteBasicType(os, binary, num_nodes);
+  if (!binary)
+    os << std::endl;
+  for (int32 n = 0; n < num_nodes; n++) {
+    nodes_[n].Write(os, binary);
+    if (!binary)
+      os << std::endl;
+  }
+  WriteToken(os, binary, "</FlatNnet>");
+}
+
+void FlatNnet::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<FlatNnet>");
+  ExpectToken(is, binary, "<NumNodes>");
+  int32 num_nodes;
+  ReadBasicType(is, binary, &num_nodes);
+  if (num_nodes < 0)
+    KALDI_ERR << "Bad number of nodes in flat nnet: " << num_nodes;
+  nodes_.resize(num_nodes);
+  for (int32 n = 0; n < num_nodes; n++)
+    nodes_[n].Read(is, binary);
+  ExpectToken(is, binary, "</FlatNnet>");
+  Check();
+}
+
+
+// Converts a ForwardingDescriptor to a term.  Only descriptors that map time t
+// of the output to time t + offset, or to a fixed time, of a single node are
+// supported (this covers Offset() and ReplaceIndex(.., t, ..) but not Round()
+// or Switch()).  'flat_index' and 'col_offset' map nnet node-indexes to the
+// (provisional) flat node-index and column offset.
+static FlatNnetTerm ConvertForwardingDescriptor(
+    const Nnet &nnet,
+    const std::vector<int32> &flat_index,
+    const std::vector<int32> &col_offset,
+    const ForwardingDescriptor &desc) {
+  std::vector<int32> node_indexes;
+  desc.GetNodeDependencies(&node_indexes);
+  SortAndUniq(&node_indexes);
+  if (node_indexes.size() != 1)
+    KALDI_ERR << "Descriptors that switch between nodes are not supported "
+              << "by the flat format.";
+  int32 node_index = node_indexes[0];
+  Index i0(0, 0, 0), i1(0, 1000, 0), i2(0, 1001, 0);
+  Cindex c0 = desc.MapToInput(i0), c1 = desc.MapToInput(i1),
+      c2 = desc.MapToInput(i2);
+  if (c0.second.n != 0 || c0.second.x != 0 ||
+      c1.second.n != 0 || c1.second.x != 0)
+    KALDI_ERR << "Descriptors that change the 'n' or 'x' index are not "
+              << "supported by the flat format.";
+  FlatNnetTerm term;
+  term.node = flat_index[node_index];
+  term.col_offset = col_offset[node_index];
+  KALDI_ASSERT(term.node >= 0);
+  int32 t_offset = c0.second.t;
+  if (c1.second.t == 1000 + t_offset && c2.second.t == 1001 + t_offset) {
+    term.t_offset = t_offset;
+  } else if (c1.second.t == t_offset && c2.second.t == t_offset) {
+    term.t_offset = t_offset;
+    term.fixed_t = true;
+  } else {
+    std::ostringstream os;
+    desc.WriteConfig(os, nnet.GetNodeNames());
+    KALDI_ERR << "Descriptor " << os.str() << " is not supported by the flat "
+              << "format (only time offsets and fixed times are).";
+  }
+  term.scale = desc.GetScaleForNode(node_index);
+  return term;
+}
+
+// Appends the terms of 'desc' to 'part'.
+static void ConvertSumDescriptor(const Nnet &nnet,
+                                 const std::vector<int32> &flat_index,
+                                 const std::vector<int32> &col_offset,
+                                 const SumDescriptor &desc,
+                                 bool optional,
+                                 FlatNnetPart *part) {
+  if (const SimpleSumDescriptor *simple =
+      dynamic_cast<const SimpleSumDescriptor*>(&desc)) {
+    FlatNnetTerm term = ConvertForwardingDescriptor(nnet, flat_index,
+                                                    col_offset, simple->Src());
+    term.optional = optional;
+    part->terms.push_back(term);
+  } else if (const OptionalSumDescriptor *opt =
+             dynamic_cast<const OptionalSumDescriptor*>(&desc)) {
+    ConvertSumDescriptor(nnet, flat_index, col_offset, opt->Src(), true, part);
+  } else if (const BinarySumDescriptor *binary =
+             dynamic_cast<const BinarySumDescriptor*>(&desc)) {
+    if (binary->Op() != BinarySumDescriptor::kSumOperation)
+      KALDI_ERR << "Failover() in Descriptors is not supported by the flat "
+                << "format.";
+    ConvertSumDescriptor(nnet, flat_index, col_offset, binary->Src1(),
+                         optional, part);
+    ConvertSumDescriptor(nnet, flat_index, col_offset, binary->Src2(),
+                         optional, part);
+  } else if (const ConstantSumDescriptor *constant =
+             dynamic_cast<const ConstantSumDescriptor*>(&desc)) {
+    part->constant += constant->Value();
+  } else {
+    KALDI_ERR << "Unknown type of SumDescriptor";
+  }
+}
+
+static void ConvertDescriptor(const Nnet &nnet,
+                              const std::vector<int32> &flat_index,
+                              const std::vector<int32> &col_offset,
+                              const Descriptor &desc,
+                              std::vector<FlatNnetPart> *parts) {
+  parts->clear();
+  parts->resize(desc.NumParts());
+  for (int32 p = 0; p < desc.NumParts(); p++) {
+    (*parts)[p].dim = desc.Part(p).Dim(nnet);
+    ConvertSumDescriptor(nnet, flat_index, col_offset, desc.Part(p), false,
+                         &((*parts)[p]));
+  }
+}
+
+// Works out the scale and offset of a component that computes an elementwise
+// affine function of its input (in test mode), such as BatchNormComponent, by
+// propagating some constant vectors through it.  'params' is set to a 2 by dim
+// matrix containing the scale and then the offset.  The component's
+// Propagate() function must not need precomputed indexes in test mode.
+static void GetElementwiseAffineParams(const Component &c,
+                                       Matrix<BaseFloat> *params) {
+  int32 dim = c.InputDim();
+  KALDI_ASSERT(c.OutputDim() == dim);
+  // Some components (e.g. BatchNormComponent) require the stride to equal the
+  // num-cols.
+  CuMatrix<BaseFloat> in(3, dim, kSetZero, kStrideEqualNumCols),
+      out(3, dim, kSetZero, kStrideEqualNumCols);
+  in.Row(1).Set(1.0);
+  in.Row(2).Set(2.0);
+  void *memo = c.Propagate(NULL, in, &out);
+  c.DeleteMemo(memo);
+  Matrix<BaseFloat> out_cpu(out);
+  params->Resize(2, dim);
+  params->Row(0).CopyFromVec(out_cpu.Row(1));
+  params->Row(0).AddVec(-1.0, out_cpu.Row(0));
+  params->Row(1).CopyFromVec(out_cpu.Row(0));
+  Vector<BaseFloat> predicted(out_cpu.Row(0));
+  predicted.AddVec(2.0, params->Row(0));
+  if (!predicted.ApproxEqual(out_cpu.Row(2), 0.001))
+    KALDI_ERR << "Component of type " << c.Type() << " does not appear to "
+              << "compute an elementwise affine function.";
+}
+
+// Returns true if 'type' is a component type that (in test mode) computes an
+// elementwise affine function of its input.
+static bool IsElementwiseAffineType(const std::string &type) {
+  return type == "ScaleAndOffsetComponent" ||
+      type == "PerElementScaleComponent" ||
+      type == "NaturalGradientPerElementScaleComponent" ||
+      type == "PerElementOffsetComponent" ||
+      type == "FixedScaleComponent" ||
+      type == "FixedBiasComponent" ||
+      type == "BatchNormComponent" ||
+      type == "DropoutComponent" ||
+      type == "GeneralDropoutComponent" ||
+      type == "BackpropTruncationComponent" ||
+      type == "ClipGradientComponent" ||
+      type == "NoOpComponent";
+}
+
+// Sets up the op and parameters of 'node' from the component 'c';
+// node->input must already be set (it is changed for TdnnComponent).
+static void ConvertComponent(const Component &c, FlatNnetNode *node) {
+  std::string type = c.Type();
+  node->dim = c.OutputDim();
+  if (const AffineComponent *affine =
+      dynamic_cast<const AffineComponent*>(&c)) {
+    node->op = kFlatAffine;
+    node->params = Matrix<BaseFloat>(affine->LinearParams());
+    node->bias = Vector<BaseFloat>(affine->BiasParams());
+  } else if (const FixedAffineComponent *fixed =
+             dynamic_cast<const FixedAffineComponent*>(&c)) {
+    node->op = kFlatAffine;
+    node->params = Matrix<BaseFloat>(fixed->LinearParams());
+    node->bias = Vector<BaseFloat>(fixed->BiasParams());
+  } else if (const LinearComponent *linear =
+             dynamic_cast<const LinearComponent*>(&c)) {
+    node->op = kFlatAffine;
+    node->params = Matrix<BaseFloat>(linear->Params());
+  } else if (const BlockSparseAffineComponent *sparse =
+             dynamic_cast<const BlockSparseAffineComponent*>(&c)) {
+    node->op = kFlatAffine;
+    CuMatrix<BaseFloat> linear_params;
+    sparse->GetLinearParams(&linear_params);
+    node->params = Matrix<BaseFloat>(linear_params);
+    node->bias = Vector<BaseFloat>(sparse->BiasParams());
+  } else if (const TdnnComponent *tdnn =
+             dynamic_cast<const TdnnComponent*>(&c)) {
+    // The input for time t is the input for times t + o for each time
+    // offset o, appended together.
+    const std::vector<int32> &time_offsets = tdnn->TimeOffsets();
+    std::vector<FlatNnetPart> input = node->input;
+    node->input.clear();
+    for (size_t i = 0; i < time_offsets.size(); i++) {
+      for (size_t p = 0; p < input.size(); p++) {
+        FlatNnetPart part = input[p];
+        for (size_t j = 0; j < part.terms.size(); j++)
+          if (!part.terms[j].fixed_t)
+            part.terms[j].t_offset += time_offsets[i];
+        node->input.push_back(part);
+      }
+    }
+    node->op = kFlatAffine;
+    node->params = Matrix<BaseFloat>(tdnn->LinearParams());
+    node->bias = Vector<BaseFloat>(tdnn->BiasParams());
+  } else if (type == "RectifiedLinearComponent") {
+    node->op = kFlatRelu;
+  } else if (type == "SigmoidComponent") {
+    node->op = kFlatSigmoid;
+  } else if (type == "TanhComponent") {
+    node->op = kFlatTanh;
+  } else if (type == "SoftmaxComponent") {
+    node->op = kFlatSoftmax;
+  } else if (type == "LogSoftmaxComponent") {
+    node->op = kFlatLogSoftmax;
+  } else if (type == "ElementwiseProductComponent") {
+    node->op = kFlatProduct;
+  } else if (const LstmNonlinearityComponent *lstm =
+             dynamic_cast<const LstmNonlinearityComponent*>(&c)) {
+    int32 cell_dim = lstm->OutputDim() / 2;
+    if (lstm->InputDim() != 5 * cell_dim)
+      KALDI_ERR << "LstmNonlinearityComponent with dropout is not supported "
+                << "by the flat format.";
+    Vector<BaseFloat> params(lstm->NumParameters());
+    lstm->Vectorize(&params);
+    node->op = kFlatLstm;
+    node->params.Resize(3, cell_dim);
+    node->params.CopyRowsFromVec(params);
+  } else if (IsElementwiseAffineType(type)) {
+    Matrix<BaseFloat> params;
+    GetElementwiseAffineParams(c, &params);
+    Vector<BaseFloat> ones(params.NumCols());
+    ones.Set(1.0);
+    if (params.Row(0).ApproxEqual(ones, 1.0e-06) &&
+        params.Row(1).IsZero(1.0e-06)) {
+      node->op = kFlatCopy;
+    } else {
+      node->op = kFlatScaleAndOffset;
+      node->params.Swap(&params);
+    }
+  } else {
+    KALDI_ERR << "Components of type " << type << " are not supported by "
+              << "the flat format.";
+  }
+}
+
+
+void ConvertNnetToFlat(const Nnet &nnet_in, FlatNnet *flat_nnet) {
+  Nnet nnet(nnet_in);
+  SetBatchnormTestMode(true, &nnet);
+  SetDropoutTestMode(true, &nnet);
+
+  int32 num_nodes = nnet.NumNodes();
+  // First give each input, component and output node a provisional
+  // flat node-index, and work out which flat node and column offset each
+  // dim-range node corresponds to.
+  std::vector<int32> flat_index(num_nodes, -1), col_offset(num_nodes, 0);
+  int32 num_flat_nodes = 0;
+  for (int32 n = 0; n < num_nodes; n++)
+    if (nnet.IsInputNode(n) || nnet.IsComponentNode(n) || nnet.IsOutputNode(n))
+      flat_index[n] = num_flat_nodes++;
+  for (int32 n = 0; n < num_nodes; n++) {
+    if (nnet.IsDimRangeNode(n)) {
+      const NetworkNode &node = nnet.GetNode(n);
+      int32 src = node.u.node_index;
+      if (flat_index[src] < 0 || nnet.IsOutputNode(src))
+        KALDI_ERR << "Unexpected source of dim-range node "
+                  << nnet.GetNodeName(n);
+      flat_index[n] = flat_index[src];
+      col_offset[n] = col_offset[src] + node.dim_offset;
+    }
+  }
+
+  std::vector<FlatNnetNode> nodes(num_flat_nodes);
+  for (int32 n = 0; n < num_nodes; n++) {
+    if (flat_index[n] < 0 || nnet.IsDimRangeNode(n))
+      continue;
+    FlatNnetNode &node = nodes[flat_index[n]];
+    node.name = nnet.GetNodeName(n);
+    if (nnet.IsInputNode(n)) {
+      node.op = kFlatInput;
+      node.dim = nnet.GetNode(n).dim;
+    } else if (nnet.IsOutputNode(n)) {
+      const Descriptor &desc = nnet.GetNode(n).descriptor;
+      ConvertDescriptor(nnet, flat_index, col_offset, desc, &node.input);
+      node.op = kFlatCopy;
+      node.dim = desc.Dim(nnet);
+      node.is_output = true;
+    } else {
+      KALDI_ASSERT(nnet.IsComponentNode(n));
+      ConvertDescriptor(nnet, flat_index, col_offset,
+                        nnet.GetNode(n - 1).descriptor, &node.input);
+      const Component *c =
+          nnet.GetComponent(nnet.GetNode(n).u.component_index);
+      if (c->InputDim() != node.InputDim())
+        KALDI_ERR << "Dimension mismatch for component node " << node.name;
+      ConvertComponent(*c, &node);
+    }
+  }
+
+  // Put the nodes in topological order, ignoring the 'delayed' dependencies
+  // that are allowed to refer to later nodes, and preferring the original
+  // order where there is a choice.
+  std::vector<std::vector<int32> > dependents(num_flat_nodes);
+  std::vector<int32> num_deps(num_flat_nodes, 0);
+  for (int32 n = 0; n < num_flat_nodes; n++) {
+    for (size_t p = 0; p < nodes[n].input.size(); p++) {
+      const FlatNnetPart &part = nodes[n].input[p];
+      for (size_t i = 0; i < part.terms.size(); i++) {
+        const FlatNnetTerm &term = part.terms[i];
+        if (!(term.optional && !term.fixed_t && term.t_offset < 0)) {
+          dependents[term.node].push_back(n);
+          num_deps[n]++;
+        }
+      }
+    }
+  }
+  std::set<int32> ready;
+  for (int32 n = 0; n < num_flat_nodes; n++)
+    if (num_deps[n] == 0)
+      ready.insert(n);
+  std::vector<int32> new_index(num_flat_nodes, -1);
+  std::vector<int32> order;
+  while (!ready.empty()) {
+    int32 n = *ready.begin();
+    ready.erase(ready.begin());
+    new_index[n] = order.size();
+    order.push_back(n);
+    for (size_t i = 0; i < dependents[n].size(); i++)
+      if (--num_deps[dependents[n][i]] == 0)
+        ready.insert(dependents[n][i]);
+  }
+  if (static_cast<int32>(order.size()) != num_flat_nodes)
+    KALDI_ERR << "The nnet contains a recurrence without a time delay "
+              << "inside IfDefined(), which the flat format cannot express.";
+
+  *flat_nnet = FlatNnet();
+  for (int32 i = 0; i < num_flat_nodes; i++) {
+    FlatNnetNode &node = nodes[order[i]];
+    for (size_t p = 0; p < node.input.size(); p++)
+      for (size_t j = 0; j < node.input[p].terms.size(); j++)
+        node.input[p].terms[j].node = new_index[node.input[p].terms[j].node];
+    flat_nnet->AddNode(node);
+  }
+  flat_nnet->Check();
+}
+
+
+FlatNnetComputer::FlatNnetComputer(const FlatNnet &nnet):
+    nnet_(nnet),
+    defined_(nnet.NumNodes(), TimeRange(0, 0)),
+    computed_(nnet.NumNodes(), TimeRange(0, 0)),
+    values_(nnet.NumNodes()),
+    input_ranges_(nnet.NumNodes(), TimeRange(0, 0)) {
+  nnet_.Check();
+  ComputeSchedule();
+}
+
+void FlatNnetComputer::ComputeSchedule() {
+  int32 num_nodes = nnet_.NumNodes();
+  std::vector<std::vector<int32> > graph(num_nodes);
+  for (int32 n = 0; n < num_nodes; n++) {
+    const FlatNnetNode &node = nnet_.GetNode(n);
+    for (size_t p = 0; p < node.input.size(); p++)
+      for (size_t i = 0; i < node.input[p].terms.size(); i++)
+        graph[node.input[p].terms[i].node].push_back(n);
+  }
+  for (int32 n = 0; n < num_nodes; n++)
+    SortAndUniq(&(graph[n]));
+  std::vector<std::vector<int32> > sccs, scc_graph;
+  FindSccs(graph, &sccs);
+  MakeSccGraph(graph, sccs, &scc_graph);
+  std::vector<int32> scc_to_order;
+  ComputeTopSortOrder(scc_graph, &scc_to_order);
+  int32 num_sccs = sccs.size();
+  std::vector<int32> order_to_scc(num_sccs);
+  for (int32 s = 0; s < num_sccs; s++)
+    order_to_scc[scc_to_order[s]] = s;
+
+  std::vector<int32> node_to_scc(num_nodes);
+  for (int32 s = 0; s < num_sccs; s++)
+    for (size_t i = 0; i < sccs[s].size(); i++)
+      node_to_scc[sccs[s][i]] = s;
+
+  schedule_.resize(num_sccs);
+  for (int32 i = 0; i < num_sccs; i++) {
+    int32 s = order_to_scc[i];
+    Group &group = schedule_[i];
+    group.nodes = sccs[s];
+    // Within a block of time, the nodes of a recurrence are evaluated in the
+    // flat order, which respects the dependencies without a delay.
+    std::sort(group.nodes.begin(), group.nodes.end());
+    group.delay = 0;
+    bool recurrent = (group.nodes.size() > 1);
+    int32 delay = std::numeric_limits<int32>::max();
+    for (size_t j = 0; j < group.nodes.size(); j++) {
+      int32 n = group.nodes[j];
+      const FlatNnetNode &node = nnet_.GetNode(n);
+      for (size_t p = 0; p < node.input.size(); p++) {
+        for (size_t k = 0; k < node.input[p].terms.size(); k++) {
+          const FlatNnetTerm &term = node.input[p].terms[k];
+          if (node_to_scc[term.node] != s)
+            continue;
+          if (term.node == n)
+            recurrent = true;
+          if (term.fixed_t || term.t_offset > 0)
+            KALDI_ERR << "Recurrence involving node " << node.name
+                      << " has a fixed time or a positive time offset.";
+          if (term.t_offset < 0)
+            delay = std::min(delay, -term.t_offset);
+        }
+      }
+    }
+    if (recurrent) {
+      KALDI_ASSERT(delay != std::numeric_limits<int32>::max());
+      group.delay = delay;
+    }
+  }
+}
+
+void FlatNnetComputer::AcceptInput(const std::string &name, int32 first_t,
+                                   const MatrixBase<BaseFloat> &value) {
+  int32 n = nnet_.GetNodeIndex(name);
+  if (n < 0 || nnet_.GetNode(n).op != kFlatInput)
+    KALDI_ERR << "No input node named " << name;
+  if (value.NumCols() != nnet_.GetNode(n).dim)
+    KALDI_ERR << "Dimension mismatch for input " << name << ": "
+              << value.NumCols() << " vs. " << nnet_.GetNode(n).dim;
+  values_[n] = value;
+  input_ranges_[n] = TimeRange(first_t, first_t + value.NumRows());
+}
+
+void FlatNnetComputer::ComputeDefinedRanges() {
+  int32 num_nodes = nnet_.NumNodes();
+  for (int32 n = 0; n < num_nodes; n++) {
+    const FlatNnetNode &node = nnet_.GetNode(n);
+    if (node.op == kFlatInput) {
+      defined_[n] = input_ranges_[n];
+      continue;
+    }
+    TimeRange range(kMinFlatTime, kMaxFlatTime);
+    for (size_t p = 0; p < node.input.size(); p++) {
+      for (size_t i = 0; i < node.input[p].terms.size(); i++) {
+        const FlatNnetTerm &term = node.input[p].terms[i];
+        if (term.optional)
+          continue;
+        const TimeRange &src = defined_[term.node];
+        if (term.fixed_t) {
+          if (!src.Contains(term.t_offset))
+            range.end = range.begin;
+        } else {
+          if (src.begin != kMinFlatTime)
+            range.begin = std::max(range.begin, src.begin - term.t_offset);
+          if (src.end != kMaxFlatTime)
+            range.end = std::min(range.end, src.end - term.t_offset);
+        }
+      }
+    }
+    if (range.Empty())
+      range = TimeRange(0, 0);
+    defined_[n] = range;
+  }
+}
+
+void FlatNnetComputer::ComputeRequiredRanges(int32 output_node,
+                                             const TimeRange &range) {
+  int32 num_nodes = nnet_.NumNodes();
+  const TimeRange &defined = defined_[output_node];
+  if (range.begin < defined.begin || range.end > defined.end)
+    KALDI_ERR << "Output " << nnet_.GetNode(output_node).name
+              << " cannot be computed for times " << range.begin << " to "
+              << (range.end - 1) << " given the inputs supplied (it is "
+              << "defined for times " << defined.begin << " to "
+              << (defined.end - 1) << ").";
+  // computed_[n] is the range that node n is needed on (always a subset of
+  // defined_[n]); this is a fixed-point iteration because of the
+  // recurrences.
+  for (int32 n = 0; n < num_nodes; n++)
+    computed_[n] = TimeRange(0, 0);
+  computed_[output_node] = range;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int32 n = num_nodes - 1; n >= 0; n--) {
+      const TimeRange cur = computed_[n];
+      if (cur.Empty())
+        continue;
+      const FlatNnetNode &node = nnet_.GetNode(n);
+      for (size_t p = 0; p < node.input.size(); p++) {
+        for (size_t i = 0; i < node.input[p].terms.size(); i++) {
+          const FlatNnetTerm &term = node.input[p].terms[i];
+          TimeRange want = (term.fixed_t ?
+                            TimeRange(term.t_offset, term.t_offset + 1) :
+                            TimeRange(cur.begin + term.t_offset,
+                                      cur.end + term.t_offset));
+          const TimeRange &src_defined = defined_[term.node];
+          want.begin = std::max(want.begin, src_defined.begin);
+          want.end = std::min(want.end, src_defined.end);
+          if (want.Empty())
+            continue;
+          TimeRange &src = computed_[term.node];
+          if (src.Empty()) {
+            src = want;
+            changed = true;
+          } else if (want.begin < src.begin || want.end > src.end) {
+            src.begin = std::min(src.begin, want.begin);
+            src.end = std::max(src.end, want.end);
+            changed = true;
+          }
+          if (src.begin <= kMinFlatTime || src.end >= kMaxFlatTime)
+            KALDI_ERR << "Node " << nnet_.GetNode(term.node).name
+                      << " would have to be computed for unbounded times.";
+        }
+      }
+    }
+  }
+  for (int32 n = 0; n < num_nodes; n++)
+    if (nnet_.GetNode(n).op == kFlatInput)
+      computed_[n] = input_ranges_[n];
+}
+
+void FlatNnetComputer::GetNodeInput(int32 n, int32 begin, int32 end,
+                                    Matrix<BaseFloat> *in) {
+  const FlatNnetNode &node = nnet_.GetNode(n);
+  int32 num_rows = end - begin;
+  in->Resize(num_rows, node.InputDim());
+  int32 col = 0;
+  for (size_t p = 0; p < node.input.size(); p++) {
+    const FlatNnetPart &part = node.input[p];
+    SubMatrix<BaseFloat> in_part(*in, 0, num_rows, col, part.dim);
+    if (part.constant != 0.0)
+      in_part.Add(part.constant);
+    for (size_t i = 0; i < part.terms.size(); i++) {
+      const FlatNnetTerm &term = part.terms[i];
+      const TimeRange &src = computed_[term.node];
+      const Matrix<BaseFloat> &src_value = values_[term.node];
+      if (term.fixed_t) {
+        if (src.Contains(term.t_offset)) {
+          SubVector<BaseFloat> row(src_value, term.t_offset - src.begin);
+          in_part.AddVecToRows(term.scale, row.Range(term.col_offset,
+                                                     part.dim));
+        } else {
+          KALDI_ASSERT(term.optional);
+        }
+      } else {
+        int32 src_begin = std::max(begin + term.t_offset, src.begin),
+            src_end = std::min(end + term.t_offset, src.end);
+        KALDI_ASSERT(term.optional || (src_begin == begin + term.t_offset &&
+                                       src_end == end + term.t_offset));
+        if (src_begin < src_end) {
+          SubMatrix<BaseFloat> src_part(src_value, src_begin - src.begin,
+                                        src_end - src_begin, term.col_offset,
+                                        part.dim);
+          in_part.RowRange(src_begin - term.t_offset - begin,
+                           src_end - src_begin).AddMat(term.scale, src_part);
+        }
+      }
+    }
+    col += part.dim;
+  }
+}
+
+void FlatNnetComputer::EvaluateNode(int32 n, int32 begin, int32 end) {
+  const FlatNnetNode &node = nnet_.GetNode(n);
+  KALDI_ASSERT(begin >= computed_[n].begin && end <= computed_[n].end);
+  Matrix<BaseFloat> in;
+  GetNodeInput(n, begin, end, &in);
+  SubMatrix<BaseFloat> out(values_[n], begin - computed_[n].begin,
+                           end - begin, 0, node.dim);
+  switch (node.op) {
+    case kFlatAffine:
+      if (node.bias.Dim() != 0)
+        out.CopyRowsFromVec(node.bias);
+      else
+        out.SetZero();
+      out.AddMatMat(1.0, in, kNoTrans, node.params, kTrans, 1.0);
+      break;
+    case kFlatRelu:
+      out.CopyFromMat(in);
+      out.ApplyFloor(0.0);
+      break;
+    case kFlatSigmoid:
+      out.Sigmoid(in);
+      break;
+    case kFlatTanh:
+      out.Tanh(in);
+      break;
+    case kFlatSoftmax:
+      out.CopyFromMat(in);
+      out.ApplySoftMaxPerRow();
+      out.ApplyFloor(1.0e-20);
+      break;
+    case kFlatLogSoftmax:
+      out.CopyFromMat(in);
+      for (int32 r = 0; r < out.NumRows(); r++)
+        out.Row(r).ApplyLogSoftMax();
+      break;
+    case kFlatScaleAndOffset:
+      out.CopyFromMat(in);
+      out.MulColsVec(node.params.Row(0));
+      out.AddVecToRows(1.0, node.params.Row(1));
+      break;
+    case kFlatProduct: {
+      int32 num_pieces = in.NumCols() / node.dim;
+      out.CopyFromMat(in.ColRange(0, node.dim));
+      for (int32 i = 1; i < num_pieces; i++)
+        out.MulElements(in.ColRange(i * node.dim, node.dim));
+      break;
+    }
+    case kFlatLstm:
+      cu::CpuComputeLstmNonlinearity(in, node.params, &out);
+      break;
+    case kFlatCopy:
+      out.CopyFromMat(in);
+      break;
+    default:
+      KALDI_ERR << "Unexpected op " << FlatNnetOpTypeToString(node.op);
+  }
+}
+
+void FlatNnetComputer::Compute(const std::string &name, int32 first_t,
+                               int32 num_frames, Matrix<BaseFloat> *output) {
+  int32 output_node = nnet_.GetNodeIndex(name);
+  if (output_node < 0 || nnet_.GetNode(output_node).op == kFlatInput)
+    KALDI_ERR << "No non-input node named " << name;
+  KALDI_ASSERT(num_frames > 0);
+  ComputeDefinedRanges();
+  ComputeRequiredRanges(output_node, TimeRange(first_t,
+                                               first_t + num_frames));
+  int32 num_nodes = nnet_.NumNodes();
+  for (int32 n = 0; n < num_nodes; n++) {
+    if (nnet_.GetNode(n).op != kFlatInput) {
+      const TimeRange &range = computed_[n];
+      if (range.Empty())
+        values_[n].Resize(0, 0);
+      else
+        values_[n].Resize(range.end - range.begin, nnet_.GetNode(n).dim,
+                          kUndefined);
+    }
+  }
+  for (size_t g = 0; g < schedule_.size(); g++) {
+    const Group &group = schedule_[g];
+    if (group.delay == 0) {
+      int32 n = group.nodes[0];
+      const TimeRange &range = computed_[n];
+      if (nnet_.GetNode(n).op != kFlatInput && !range.Empty())
+        EvaluateNode(n, range.begin, range.end);
+    } else {
+      int32 begin = kMaxFlatTime, end = kMinFlatTime;
+      for (size_t i = 0; i < group.nodes.size(); i++) {
+        const TimeRange &range = computed_[group.nodes[i]];
+        if (!range.Empty()) {
+          begin = std::min(begin, range.begin);
+          end = std::max(end, range.end);
+        }
+      }
+      for (int32 t = begin; t < end; t += group.delay) {
+        for (size_t i = 0; i < group.nodes.size(); i++) {
+          int32 n = group.nodes[i];
+          int32 block_begin = std::max(t, computed_[n].begin),
+              block_end = std::min(t + group.delay, computed_[n].end);
+          if (block_begin < block_end)
+            EvaluateNode(n, block_begin, block_end);
+        }
+      }
+    }
+  }
+  output->Resize(num_frames, nnet_.GetNode(output_node).dim, kUndefined);
+  output->CopyFromMat(values_[output_node].RowRange(
+      first_t - computed_[output_node].begin, num_frames));
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
@@ -0,0 +1,281 @@
+// nnet3/nnet-flat-graph.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_FLAT_GRAPH_H_
+#define KALDI_NNET3_NNET_FLAT_GRAPH_H_
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "nnet3/nnet-nnet.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace kaldi {
+namespace nnet3 {
+
+/// @file  nnet-flat-graph.h
+///
+/// This file contains class FlatNnet, a flat, self-contained representation of
+/// a 'simple' neural network (a TDNN, TDNN-F, LSTM and so on, with one
+/// sequence and a time index), intended to be consumed by inference runtimes
+/// other than Kaldi's.  There is no compilation step: the network is a list of
+/// operations in topological order, each of which reads from earlier operations
+/// at explicit time offsets.  ConvertNnetToFlat() creates it from an Nnet, and
+/// class FlatNnetComputer is a reference implementation of its semantics.
+///
+/// The semantics are as follows.  Each node of the graph produces, for each
+/// time index t (an integer frame index), a vector of dimension
+/// FlatNnetNode::dim.  Input nodes (op == kFlatInput) get their values from
+/// the user.  For other nodes, the value at time t is op(x(t)), where the
+/// input vector x(t) is the concatenation ("Append") of the node's parts, and
+/// each part (of dimension FlatNnetPart::dim) is
+///
+///    x_part(t) = constant + sum over terms:  scale * y_term(t)
+///
+/// where y_term(t) is the sub-vector [col_offset, col_offset + part dim) of
+/// the output of the term's source node at time t + t_offset (or, if
+/// 'fixed_t' is true, at time t_offset regardless of t; this is how iVectors
+/// are normally read).  If a term is 'optional' and the source node's value
+/// is not defined at that time, the term contributes zero; otherwise the value
+/// of this node at time t is defined only if the values of all its
+/// non-optional terms are defined.  Input nodes are defined for the times the
+/// user supplies.
+///
+/// The nodes are in topological order, i.e. every term refers to an earlier
+/// node, except for optional terms with negative time offsets, which may refer
+/// to the same or a later node; these express recurrences (as in LSTMs) and
+/// mean that, within a recurrence, values must be computed in order of
+/// increasing t.
+///
+/// The operations are (with 'in' being x(t) and 'out' the node's value):
+///  - Input:  no input; the value is supplied by the user.
+///  - Affine:  out = params * in + bias, where params is dim by input-dim and
+///             bias has dimension dim, or is empty meaning zero.
+///  - Relu, Sigmoid, Tanh:  elementwise functions; dim == input-dim.
+///  - Softmax:  softmax(in), floored at 1.0e-20;  LogSoftmax:  log-softmax(in).
+///  - ScaleAndOffset:  out = params(0) .* in + params(1), params is 2 by dim.
+///  - Product:  the input is divided into input-dim / dim pieces of dimension
+///             dim which are multiplied elementwise.
+///  - Lstm:  the LSTM nonlinearity (see ComputeLstmNonlinearity() in
+///           cu-math.h): in = [ i_part f_part c_part o_part c_prev ] each of
+///           dimension C, params is 3 by C containing the diagonal 'peephole'
+///           weights w_ic, w_fc, w_oc, and out = [ c m ] where
+///              i = sigmoid(i_part + w_ic .* c_prev),
+///              f = sigmoid(f_part + w_fc .* c_prev),
+///              c = f .* c_prev + i .* tanh(c_part),
+///              o = sigmoid(o_part + w_oc .* c),  m = o .* tanh(c).
+///  - Copy:  out = in.  Output nodes are normally of this type.
+///
+/// The file format is Kaldi's usual binary or text format; see
+/// FlatNnet::Write().
+
+enum FlatNnetOpType {
+  kFlatInput,
+  kFlatAffine,
+  kFlatRelu,
+  kFlatSigmoid,
+  kFlatTanh,
+  kFlatSoftmax,
+  kFlatLogSoftmax,
+  kFlatScaleAndOffset,
+  kFlatProduct,
+  kFlatLstm,
+  kFlatCopy
+};
+
+/// Returns the name of the op as written in the file, e.g. "Affine".
+const char *FlatNnetOpTypeToString(FlatNnetOpType op);
+
+/// Returns the op corresponding to a name like "Affine"; dies on error.
+FlatNnetOpType StringToFlatNnetOpType(const std::string &str);
+
+
+struct FlatNnetTerm {
+  // The index of the source node.
+  int32 node;
+  // The first column of the source node's output that we use.
+  int32 col_offset;
+  // The time offset (or, if fixed_t is true, the absolute time).
+  int32 t_offset;
+  bool fixed_t;
+  // True if this term is treated as zero when the source is not defined
+  // (corresponds to IfDefined() in nnet3 Descriptors).
+  bool optional;
+  BaseFloat scale;
+
+  FlatNnetTerm(): node(-1), col_offset(0), t_offset(0), fixed_t(false),
+                  optional(false), scale(1.0) { }
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+};
+
+struct FlatNnetPart {
+  int32 dim;
+  BaseFloat constant;
+  std::vector<FlatNnetTerm> terms;
+
+  FlatNnetPart(): dim(0), constant(0.0) { }
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+};
+
+struct FlatNnetNode {
+  std::string name;
+  FlatNnetOpType op;
+  // The output dimension.
+  int32 dim;
+  // True if this is an output of the network (e.g. "output").
+  bool is_output;
+  // The parts whose values are appended to form the input of 'op'; empty for
+  // input nodes.
+  std::vector<FlatNnetPart> input;
+  // Parameters; their interpretation depends on 'op' (see above).
+  Matrix<BaseFloat> params;
+  Vector<BaseFloat> bias;
+
+  FlatNnetNode(): op(kFlatInput), dim(0), is_output(false) { }
+  // Returns the dimension of the input, i.e. the sum of the parts' dims.
+  int32 InputDim() const;
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+};
+
+
+class FlatNnet {
+ public:
+  FlatNnet() { }
+
+  int32 NumNodes() const { return nodes_.size(); }
+  const FlatNnetNode &GetNode(int32 n) const { return nodes_[n]; }
+  FlatNnetNode &GetNode(int32 n) { return nodes_[n]; }
+  /// Appends a node and returns its index.
+  int32 AddNode(const FlatNnetNode &node);
+  /// Returns the index of the node with this name, or -1.
+  int32 GetNodeIndex(const std::string &name) const;
+
+  /// Checks that the dimensions, the parameters and the node order are
+  /// consistent; dies if not.
+  void Check() const;
+
+  /// Returns the left and right context that an output node requires from
+  /// the input node 'input_name' (not counting optional terms, which is the
+  /// same convention as ComputeSimpleNnetContext()).
+  void ComputeContext(const std::string &output_name,
+                      const std::string &input_name,
+                      int32 *left_context, int32 *right_context) const;
+
+  std::string Info() const;
+
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+
+ private:
+  std::vector<FlatNnetNode> nodes_;
+};
+
+
+/// Converts 'nnet' into the flat format.  The nnet should be a 'simple' nnet
+/// (see IsSimpleNnet()) in which all components are of the types supported
+/// by FlatNnet, or can be rewritten as such (e.g. TdnnComponent becomes an
+/// Affine op whose input has the time offsets spliced in, and BatchNorm
+/// becomes ScaleAndOffset); dropout and batch-norm components are converted as
+/// in test mode.  Dies with an informative error if the nnet cannot be
+/// converted.
+void ConvertNnetToFlat(const Nnet &nnet, FlatNnet *flat_nnet);
+
+
+/**
+   FlatNnetComputer is a simple reference executor for FlatNnet, which
+   evaluates the network for a single sequence on CPU.  Usage is:
+     FlatNnetComputer computer(flat_nnet);
+     computer.AcceptInput("input", first_input_t, input_feats);
+     computer.AcceptInput("ivector", 0, ivector_as_matrix);  // if present
+     computer.Compute("output", 0, num_frames, &output);
+
+   Each node is evaluated only on the range of times that is needed for the
+   requested output and on which it is defined.  Non-recurrent nodes are
+   evaluated for all those times in one go; nodes that are part of a
+   recurrence are evaluated in blocks of t whose size is the smallest
+   time delay in the recurrence.
+ */
+class FlatNnetComputer {
+ public:
+  explicit FlatNnetComputer(const FlatNnet &nnet);
+
+  /// Supplies the value of input node 'name' for times first_t,
+  /// first_t + 1, ..., first_t + value.NumRows() - 1.
+  void AcceptInput(const std::string &name, int32 first_t,
+                   const MatrixBase<BaseFloat> &value);
+
+  /// Computes the output node 'name' for times first_t ... first_t +
+  /// num_frames - 1, and puts it in *output.  Dies if the inputs supplied are
+  /// not sufficient.  It may be called more than once, for different outputs
+  /// or times.
+  void Compute(const std::string &name, int32 first_t, int32 num_frames,
+               Matrix<BaseFloat> *output);
+
+ private:
+  // A half-open range of times [begin, end); empty if begin >= end.
+  struct TimeRange {
+    int32 begin;
+    int32 end;
+    TimeRange(int32 b, int32 e): begin(b), end(e) { }
+    bool Empty() const { return begin >= end; }
+    bool Contains(int32 t) const { return t >= begin && t < end; }
+  };
+
+  // Computes defined_, the range of times on which each node is defined
+  // given the inputs.
+  void ComputeDefinedRanges();
+  // Computes computed_, the range of times on which each node will be
+  // computed in order to produce output node 'output_node' on 'range'.
+  void ComputeRequiredRanges(int32 output_node, const TimeRange &range);
+  // Computes schedule_; called from the constructor.
+  void ComputeSchedule();
+  // Evaluates node n for times [begin, end), which must be within
+  // computed_[n].
+  void EvaluateNode(int32 n, int32 begin, int32 end);
+  // Gets the input of node n for times [begin, end).
+  void GetNodeInput(int32 n, int32 begin, int32 end, Matrix<BaseFloat> *in);
+
+  const FlatNnet &nnet_;
+  std::vector<TimeRange> defined_;
+  std::vector<TimeRange> computed_;
+  // values_[n] contains the value of node n for times computed_[n].begin
+  // onward (or the supplied range, for input nodes).
+  std::vector<Matrix<BaseFloat> > values_;
+  // input_ranges_[n] is the range of times supplied for input node n (empty
+  // for other nodes).
+  std::vector<TimeRange> input_ranges_;
+
+  // The evaluation schedule: a list of groups of nodes, in order.  A group
+  // with one node and delay 0 is evaluated all at once; otherwise the nodes
+  // form a recurrence and are evaluated in blocks of 'delay' time steps.
+  struct Group {
+    std::vector<int32> nodes;
+    int32 delay;
+  };
+  std::vector<Group> schedule_;
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif
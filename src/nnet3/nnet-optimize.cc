@@ -18,8 +18,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <iomanip>
 #include "nnet3/nnet-optimize.h"
+#include "nnet3/nnet-compile-looped.h"
 #include "nnet3/nnet-optimize-utils.h"
 #include "nnet3/nnet-utils.h"
 #include "base/timer.h"
@@ -640,7 +642,8 @@ CachingOptimizingCompiler::CachingOptimizingCompiler(
     seconds_taken_optimize_(0.0), seconds_taken_expand_(0.0),
     seconds_taken_check_(0.0), seconds_taken_indexes_(0.0),
     seconds_taken_io_(0.0), cache_(config.cache_capacity),
-    nnet_left_context_(-1), nnet_right_context_(-1) { }
+    nnet_left_context_(-1), nnet_right_context_(-1),
+    looped_access_count_(0) { }
 
 CachingOptimizingCompiler::CachingOptimizingCompiler(
     const Nnet &nnet,
@@ -651,7 +654,8 @@ CachingOptimizingCompiler::CachingOptimizingCompiler(
     seconds_taken_optimize_(0.0), seconds_taken_expand_(0.0),
     seconds_taken_check_(0.0), seconds_taken_indexes_(0.0),
     seconds_taken_io_(0.0), cache_(config.cache_capacity),
-    nnet_left_context_(-1), nnet_right_context_(-1) { }
+    nnet_left_context_(-1), nnet_right_context_(-1),
+    looped_access_count_(0) { }
 
 void CachingOptimizingCompiler::GetSimpleNnetContext(
     int32 *nnet_left_context, int32 *nnet_right_context) {
@@ -663,6 +667,72 @@ void CachingOptimizingCompiler::GetSimpleNnetContext(
   *nnet_right_context = nnet_right_context_;
 }
 
+std::shared_ptr<const NnetComputation>
+CachingOptimizingCompiler::GetLoopedComputation(
+    int32 chunk_size, int32 frame_subsampling_factor,
+    int32 left_context, int32 right_context,
+    ComputationRequest *request1, ComputationRequest *request2) {
+  std::lock_guard<std::mutex> lock(looped_mutex_);
+  looped_access_count_++;
+  // The cache is small (at most config_.cache_capacity entries), so a linear
+  // search is fine.
+  for (size_t i = 0; i < looped_computations_.size(); i++) {
+    LoopedComputationInfo &info = looped_computations_[i];
+    if (info.chunk_size == chunk_size &&
+        info.frame_subsampling_factor == frame_subsampling_factor &&
+        info.left_context == left_context &&
+        info.right_context == right_context) {
+      info.last_used = looped_access_count_;
+      *request1 = info.request1;
+      *request2 = info.request2;
+      return info.computation;
+    }
+  }
+  if (!looped_computations_.empty() &&
+      static_cast<int32>(looped_computations_.size()) >=
+      std::max<int32>(1, config_.cache_capacity)) {
+    // Remove the least recently used computation.  Decodables that are using
+    // it hold their own reference to it.
+    size_t lru = 0;
+    for (size_t i = 1; i < looped_computations_.size(); i++)
+      if (looped_computations_[i].last_used <
+          looped_computations_[lru].last_used)
+        lru = i;
+    looped_computations_.erase(looped_computations_.begin() + lru);
+  }
+  LoopedComputationInfo info;
+  info.last_used = looped_access_count_;
+  info.chunk_size = chunk_size;
+  info.frame_subsampling_factor = frame_subsampling_factor;
+  info.left_context = left_context;
+  info.right_context = right_context;
+
+  // The iVector is read with period chunk_size, as in
+  // DecodableNnetSimpleLoopedInfo.
+  int32 ivector_period = chunk_size, num_sequences = 1;
+  const Nnet *nnet = &nnet_;
+  Nnet ivector_nnet;
+  if (nnet_.InputDim("ivector") > 0) {
+    ivector_nnet = nnet_;
+    ModifyNnetIvectorPeriod(ivector_period, &ivector_nnet);
+    nnet = &ivector_nnet;
+  }
+  ComputationRequest request3;
+  CreateLoopedComputationRequest(*nnet, chunk_size, frame_subsampling_factor,
+                                 ivector_period, left_context, right_context,
+                                 num_sequences, &(info.request1),
+                                 &(info.request2), &request3);
+  NnetComputation *computation = new NnetComputation();
+  CompileLooped(*nnet, opt_config_, info.request1, info.request2, request3,
+                computation);
+  computation->ComputeCudaIndexes();
+  info.computation.reset(computation);
+  looped_computations_.push_back(info);
+  *request1 = info.request1;
+  *request2 = info.request2;
+  return info.computation;
+}
+
 void CachingOptimizingCompiler::ReadCache(std::istream &is, bool binary) {
   {
     Timer timer;
@@ -252,6 +252,27 @@ class CachingOptimizingCompiler {
   void GetSimpleNnetContext(int32 *nnet_left_context,
                             int32 *nnet_right_context);
 
+  /// GetLoopedComputation() returns a 'looped' computation (see
+  /// nnet-compile-looped.h) for processing a single sequence with a simple
+  /// nnet in chunks of 'chunk_size' frames, with 'left_context' and
+  /// 'right_context' frames of input context for the first chunk.  It is used
+  /// by DecodableNnetSimple when --reuse-activations=true.  The computation is
+  /// cached inside this class, keyed by the arguments.  It outputs to
+  /// 'request1' and 'request2' the computation requests for the first and
+  /// second chunks; subsequent chunks are like the second one, shifted in time
+  /// by multiples of 'chunk_size'.  If the nnet has an input called "ivector",
+  /// the computation is compiled for a copy of the nnet in which the iVector
+  /// is read with period 'chunk_size' (see ModifyNnetIvectorPeriod()); since
+  /// that only changes Descriptors, the computation can be run with the
+  /// original nnet.  At most config.cache_capacity of these computations are
+  /// cached (the least recently used ones are removed), so callers should only
+  /// use a small number of distinct chunk sizes.  Like GetSimpleNnetContext(),
+  /// this is independent of the rest of the functionality of this class.
+  std::shared_ptr<const NnetComputation> GetLoopedComputation(
+      int32 chunk_size, int32 frame_subsampling_factor,
+      int32 left_context, int32 right_context,
+      ComputationRequest *request1, ComputationRequest *request2);
+
  private:
 
   // This function just implements the work of Compile(); it's made a separate
@@ -304,6 +325,21 @@ class CachingOptimizingCompiler {
   // These following two variables are only used by the function GetSimpleNnetContext().
   int32 nnet_left_context_;
   int32 nnet_right_context_;
+
+  // This is only used by the function GetLoopedComputation().
+  struct LoopedComputationInfo {
+    int32 chunk_size;
+    int32 frame_subsampling_factor;
+    int32 left_context;
+    int32 right_context;
+    ComputationRequest request1;
+    ComputationRequest request2;
+    std::shared_ptr<const NnetComputation> computation;
+    int64 last_used;  // value of looped_access_count_ when last used.
+  };
+  std::vector<LoopedComputationInfo> looped_computations_;
+  int64 looped_access_count_;
+  std::mutex looped_mutex_;
 };
 
 
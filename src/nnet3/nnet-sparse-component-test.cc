@@ -0,0 +1,258 @@
+// nnet3/nnet-sparse-component-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-sparse-component.h"
+#include "nnet3/nnet-nnet.h"
+#include "nnet3/nnet-utils.h"
+#include "nnet3/nnet-optimize.h"
+#include "nnet3/nnet-am-decodable-simple.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Checks that Propagate() and Backprop() give the same results as the
+// equivalent dense affine transform, and that the I/O works.
+void UnitTestBlockSparseAffineComponent() {
+  int32 input_dim = RandInt(1, 60), output_dim = RandInt(1, 60),
+      block_rows = RandInt(1, 12), block_cols = RandInt(1, 12),
+      num_rows = RandInt(1, 20);
+  BaseFloat sparsity = 0.1 * RandInt(0, 9);
+  bool use_bias = (RandInt(0, 1) == 0);
+
+  CuMatrix<BaseFloat> linear_params(output_dim, input_dim);
+  linear_params.SetRandn();
+  CuVector<BaseFloat> bias_params(use_bias ? output_dim : 0);
+  bias_params.SetRandn();
+
+  BlockSparseAffineComponent component;
+  component.Init(linear_params, bias_params, block_rows, block_cols,
+                 sparsity);
+  KALDI_ASSERT(component.InputDim() == input_dim &&
+               component.OutputDim() == output_dim);
+  KALDI_LOG << component.Info();
+
+  CuMatrix<BaseFloat> pruned_params;
+  component.GetLinearParams(&pruned_params);
+  if (sparsity == 0.0)
+    KALDI_ASSERT(pruned_params.ApproxEqual(linear_params));
+  // Each element of the pruned matrix is either zero or the original value.
+  {
+    Matrix<BaseFloat> orig(linear_params), pruned(pruned_params);
+    int32 num_zero = 0;
+    for (int32 i = 0; i < output_dim; i++)
+      for (int32 j = 0; j < input_dim; j++) {
+        if (pruned(i, j) == 0.0) num_zero++;
+        else KALDI_ASSERT(pruned(i, j) == orig(i, j));
+      }
+    KALDI_ASSERT(component.NumStoredParams() ==
+                 input_dim * output_dim - num_zero);
+  }
+
+  CuMatrix<BaseFloat> input(num_rows, input_dim),
+      output(num_rows, output_dim),
+      ref_output(num_rows, output_dim);
+  input.SetRandn();
+  output.SetRandn();  // check that Propagate() does not add to the output.
+  component.Propagate(NULL, input, &output);
+  if (use_bias)
+    ref_output.CopyRowsFromVec(bias_params);
+  ref_output.AddMatMat(1.0, input, kNoTrans, pruned_params, kTrans, 1.0);
+  KALDI_ASSERT(output.ApproxEqual(ref_output));
+
+  CuMatrix<BaseFloat> out_deriv(num_rows, output_dim),
+      in_deriv(num_rows, input_dim),
+      ref_in_deriv(num_rows, input_dim);
+  out_deriv.SetRandn();
+  in_deriv.SetRandn();
+  ref_in_deriv.CopyFromMat(in_deriv);  // check that Backprop() adds.
+  component.Backprop("", NULL, input, output, out_deriv, NULL, NULL,
+                     &in_deriv);
+  ref_in_deriv.AddMatMat(1.0, out_deriv, kNoTrans, pruned_params, kNoTrans,
+                         1.0);
+  KALDI_ASSERT(in_deriv.ApproxEqual(ref_in_deriv));
+
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  component.Write(os, binary);
+  std::istringstream is(os.str());
+  Component *component2 = Component::ReadNew(is, binary);
+  std::ostringstream os2;
+  component2->Write(os2, binary);
+  if (binary)
+    KALDI_ASSERT(os.str() == os2.str());
+  Component *component3 = component2->Copy();
+  CuMatrix<BaseFloat> output2(num_rows, output_dim);
+  component3->Propagate(NULL, input, &output2);
+  KALDI_ASSERT(output2.ApproxEqual(ref_output));
+  delete component2;
+  delete component3;
+}
+
+
+// Checks that SparsifyNnet() with sparsity 0 does not change the output of a
+// network that contains TdnnComponents with time offsets (which requires
+// rewriting the input descriptors), and that the pruned network can be
+// evaluated.
+void UnitTestSparsifyNnet() {
+  int32 input_dim = RandInt(5, 20), hidden_dim = RandInt(10, 40),
+      bottleneck_dim = RandInt(5, 20), output_dim = RandInt(5, 30);
+  std::ostringstream config_os;
+  config_os << "input-node name=input dim=" << input_dim << "\n"
+            << "component name=tdnn1.affine type=TdnnComponent input-dim="
+            << input_dim << " output-dim=" << hidden_dim
+            << " time-offsets=-2,0,2\n"
+            << "component-node name=tdnn1.affine component=tdnn1.affine "
+            << "input=input\n"
+            << "component name=tdnn1.relu type=RectifiedLinearComponent dim="
+            << hidden_dim << "\n"
+            << "component-node name=tdnn1.relu component=tdnn1.relu "
+            << "input=tdnn1.affine\n"
+            << "component name=tdnnf2.linear type=TdnnComponent input-dim="
+            << hidden_dim << " output-dim=" << bottleneck_dim
+            << " time-offsets=-1,0 use-bias=false\n"
+            << "component-node name=tdnnf2.linear component=tdnnf2.linear "
+            << "input=tdnn1.relu\n"
+            << "component name=tdnnf2.affine type=TdnnComponent input-dim="
+            << bottleneck_dim << " output-dim=" << hidden_dim
+            << " time-offsets=0,1\n"
+            << "component-node name=tdnnf2.affine component=tdnnf2.affine "
+            << "input=tdnnf2.linear\n"
+            << "component name=prefinal type=LinearComponent input-dim="
+            << hidden_dim << " output-dim=" << bottleneck_dim << "\n"
+            << "component-node name=prefinal component=prefinal "
+            << "input=Sum(tdnnf2.affine, tdnn1.relu)\n"
+            << "component name=output.affine type=NaturalGradientAffineComponent"
+            << " input-dim=" << bottleneck_dim << " output-dim=" << output_dim
+            << "\n"
+            << "component-node name=output.affine component=output.affine "
+            << "input=prefinal\n"
+            << "output-node name=output input=output.affine\n";
+  Nnet nnet;
+  {
+    std::istringstream is(config_os.str());
+    nnet.ReadConfig(is);
+  }
+  int32 left_context, right_context;
+  ComputeSimpleNnetContext(nnet, &left_context, &right_context);
+
+  Nnet nnet_pruned(nnet), nnet_sparse(nnet);
+  SparsifyNnetConfig config;
+  config.block_rows = RandInt(1, 8);
+  config.block_cols = RandInt(1, 8);
+  config.min_params = 0;
+  config.sparsity = 0.0;
+  SparsifyNnet(config, &nnet_pruned);
+  config.sparsity = 0.1 * RandInt(1, 9);
+  SparsifyNnet(config, &nnet_sparse);
+  KALDI_LOG << "Pruned nnet info is: " << nnet_sparse.Info();
+
+  for (int32 c = 0; c < nnet_pruned.NumComponents(); c++) {
+    const Component *comp = nnet_pruned.GetComponent(c);
+    KALDI_ASSERT(comp->Type() == "BlockSparseAffineComponent" ||
+                 comp->Type() == "RectifiedLinearComponent");
+  }
+  int32 left_context2, right_context2;
+  ComputeSimpleNnetContext(nnet_pruned, &left_context2, &right_context2);
+  KALDI_ASSERT(left_context2 == left_context &&
+               right_context2 == right_context);
+
+  int32 num_frames = RandInt(1, 50);
+  Matrix<BaseFloat> input(num_frames, input_dim);
+  input.SetRandn();
+  Vector<BaseFloat> priors;
+  std::vector<Matrix<BaseFloat> > outputs(3);
+  const Nnet *nnets[3] = { &nnet, &nnet_pruned, &nnet_sparse };
+  for (int32 i = 0; i < 3; i++) {
+    NnetSimpleComputationOptions opts;
+    CachingOptimizingCompiler compiler(*(nnets[i]));
+    DecodableNnetSimple decodable(opts, *(nnets[i]), priors, input,
+                                  &compiler);
+    outputs[i].Resize(num_frames, output_dim);
+    for (int32 t = 0; t < num_frames; t++) {
+      SubVector<BaseFloat> row(outputs[i], t);
+      decodable.GetOutputForFrame(t, &row);
+    }
+  }
+  KALDI_ASSERT(outputs[0].ApproxEqual(outputs[1]));
+  KALDI_ASSERT(outputs[2].NumRows() == num_frames);
+}
+
+
+// Prints the speed of BlockSparseAffineComponent relative to the dense matrix
+// multiplication, for some dimensions typical of TDNN-F models.
+void BenchmarkBlockSparseAffineComponent() {
+  int32 num_rows = 512, block_size = 32;
+  int32 dims[2][2] = { { 1536, 320 }, { 3072, 160 } };
+  for (int32 d = 0; d < 2; d++) {
+    int32 output_dim = dims[d][0], input_dim = dims[d][1];
+    for (int32 i = 0; i < 2; i++) {
+      // the second time, swap the input and output dims.
+      if (i == 1)
+        std::swap(input_dim, output_dim);
+      CuMatrix<BaseFloat> linear_params(output_dim, input_dim),
+          input(num_rows, input_dim), output(num_rows, output_dim);
+      linear_params.SetRandn();
+      input.SetRandn();
+      CuVector<BaseFloat> bias_params(output_dim);
+      int32 num_iters = 10;
+      Timer timer;
+      for (int32 iter = 0; iter < num_iters; iter++) {
+        output.CopyRowsFromVec(bias_params);
+        output.AddMatMat(1.0, input, kNoTrans, linear_params, kTrans, 1.0);
+      }
+      double dense_time = timer.Elapsed();
+      for (BaseFloat sparsity = 0.5; sparsity < 0.8; sparsity += 0.25) {
+        BlockSparseAffineComponent component;
+        component.Init(linear_params, bias_params, block_size, block_size,
+                       sparsity);
+        timer.Reset();
+        for (int32 iter = 0; iter < num_iters; iter++)
+          component.Propagate(NULL, input, &output);
+        double sparse_time = timer.Elapsed();
+        KALDI_LOG << "For input-dim=" << input_dim << ", output-dim="
+                  << output_dim << ", sparsity=" << sparsity
+                  << ", speedup versus dense is "
+                  << (dense_time / sparse_time);
+      }
+    }
+  }
+}
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  for (kaldi::int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+    CuDevice::Instantiate().SetDebugStrideMode(true);
+    if (loop == 0)
+      CuDevice::Instantiate().SelectGpuId("no");
+    else
+      CuDevice::Instantiate().SelectGpuId("yes");
+#endif
+    for (int32 i = 0; i < 20; i++)
+      UnitTestBlockSparseAffineComponent();
+    for (int32 i = 0; i < 5; i++)
+      UnitTestSparsifyNnet();
+    BenchmarkBlockSparseAffineComponent();
+  }
+  KALDI_LOG << "Sparse component tests succeeded.";
+  return 0;
+}
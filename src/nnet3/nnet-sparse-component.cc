@@ -0,0 +1,399 @@
+// nnet3/nnet-sparse-component.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+#include "nnet3/nnet-sparse-component.h"
+#include "nnet3/nnet-parse.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+void BlockSparseAffineComponent::Init(
+    const CuMatrixBase<BaseFloat> &linear_params,
+    const CuVectorBase<BaseFloat> &bias_params,
+    int32 block_rows, int32 block_cols,
+    BaseFloat sparsity) {
+  KALDI_ASSERT(linear_params.NumRows() > 0 && linear_params.NumCols() > 0 &&
+               block_rows > 0 && block_cols > 0 &&
+               sparsity >= 0.0 && sparsity < 1.0 &&
+               (bias_params.Dim() == 0 ||
+                bias_params.Dim() == linear_params.NumRows()));
+  input_dim_ = linear_params.NumCols();
+  output_dim_ = linear_params.NumRows();
+  block_rows_ = block_rows;
+  block_cols_ = block_cols;
+  bias_params_ = bias_params;
+
+  Matrix<BaseFloat> params(linear_params);
+  int32 num_block_rows = (output_dim_ + block_rows_ - 1) / block_rows_,
+      num_block_cols = NumBlockCols(),
+      num_blocks = num_block_rows * num_block_cols;
+
+  // Rank the blocks by their root-mean-square value; we use this rather than
+  // the Frobenius norm so that the (possibly smaller) blocks at the edges of
+  // the matrix are not unfairly penalized.
+  std::vector<std::pair<BaseFloat, int32> > block_scores(num_blocks);
+  for (int32 r = 0; r < num_block_rows; r++) {
+    for (int32 c = 0; c < num_block_cols; c++) {
+      int32 row_offset = r * block_rows_, col_offset = c * block_cols_,
+          num_rows = std::min(block_rows_, output_dim_ - row_offset),
+          num_cols = std::min(block_cols_, input_dim_ - col_offset);
+      SubMatrix<BaseFloat> block(params, row_offset, num_rows,
+                                 col_offset, num_cols);
+      BaseFloat score = std::sqrt(TraceMatMat(block, block, kTrans) /
+                                  (num_rows * num_cols));
+      int32 b = r * num_block_cols + c;
+      block_scores[b] = std::pair<BaseFloat, int32>(score, b);
+    }
+  }
+  int32 num_pruned = static_cast<int32>(sparsity * num_blocks + 0.5);
+  std::vector<bool> retained(num_blocks, true);
+  if (num_pruned > 0) {
+    std::nth_element(block_scores.begin(), block_scores.begin() + num_pruned,
+                     block_scores.end());
+    for (int32 i = 0; i < num_pruned; i++)
+      retained[block_scores[i].second] = false;
+  }
+
+  block_indexes_.clear();
+  block_indexes_.resize(num_block_rows);
+  params_.clear();
+  params_.resize(num_block_rows);
+  for (int32 r = 0; r < num_block_rows; r++) {
+    for (int32 c = 0; c < num_block_cols; c++)
+      if (retained[r * num_block_cols + c])
+        block_indexes_[r].push_back(c);
+    int32 row_offset = r * block_rows_,
+        num_rows = std::min(block_rows_, output_dim_ - row_offset),
+        num_cols = 0;
+    for (size_t i = 0; i < block_indexes_[r].size(); i++)
+      num_cols += std::min(block_cols_,
+                           input_dim_ - block_indexes_[r][i] * block_cols_);
+    if (num_cols == 0)
+      continue;
+    Matrix<BaseFloat> packed(num_rows, num_cols, kUndefined);
+    int32 packed_offset = 0;
+    for (size_t i = 0; i < block_indexes_[r].size(); i++) {
+      int32 col_offset = block_indexes_[r][i] * block_cols_,
+          width = std::min(block_cols_, input_dim_ - col_offset);
+      packed.ColRange(packed_offset, width).CopyFromMat(
+          params.Range(row_offset, num_rows, col_offset, width));
+      packed_offset += width;
+    }
+    params_[r].Swap(&packed);
+  }
+  ComputeDerived();
+  Check();
+}
+
+void BlockSparseAffineComponent::ComputeDerived() {
+  int32 num_block_rows = NumBlockRows();
+  column_indexes_.clear();
+  column_indexes_.resize(num_block_rows);
+  contiguous_offset_.clear();
+  contiguous_offset_.resize(num_block_rows, -1);
+  max_stored_cols_ = 0;
+  for (int32 r = 0; r < num_block_rows; r++) {
+    std::vector<int32> columns;
+    for (size_t i = 0; i < block_indexes_[r].size(); i++) {
+      int32 col_offset = block_indexes_[r][i] * block_cols_,
+          col_end = std::min(col_offset + block_cols_, input_dim_);
+      for (int32 col = col_offset; col < col_end; col++)
+        columns.push_back(col);
+    }
+    if (columns.empty())
+      continue;
+    if (columns.back() - columns.front() + 1 ==
+        static_cast<int32>(columns.size())) {
+      contiguous_offset_[r] = columns.front();
+    } else {
+      column_indexes_[r].CopyFromVec(columns);
+      max_stored_cols_ = std::max<int32>(max_stored_cols_, columns.size());
+    }
+  }
+}
+
+void BlockSparseAffineComponent::Check() const {
+  KALDI_ASSERT(input_dim_ > 0 && output_dim_ > 0 &&
+               block_rows_ > 0 && block_cols_ > 0);
+  int32 num_block_rows = (output_dim_ + block_rows_ - 1) / block_rows_,
+      num_block_cols = NumBlockCols();
+  KALDI_ASSERT(NumBlockRows() == num_block_rows &&
+               static_cast<int32>(params_.size()) == num_block_rows);
+  KALDI_ASSERT(bias_params_.Dim() == 0 || bias_params_.Dim() == output_dim_);
+  for (int32 r = 0; r < num_block_rows; r++) {
+    const std::vector<int32> &indexes = block_indexes_[r];
+    int32 num_cols = 0;
+    for (size_t i = 0; i < indexes.size(); i++) {
+      KALDI_ASSERT(indexes[i] >= 0 && indexes[i] < num_block_cols &&
+                   (i == 0 || indexes[i] > indexes[i-1]));
+      num_cols += std::min(block_cols_, input_dim_ - indexes[i] * block_cols_);
+    }
+    if (num_cols == 0) {
+      KALDI_ASSERT(params_[r].NumRows() == 0);
+    } else {
+      KALDI_ASSERT(params_[r].NumCols() == num_cols &&
+                   params_[r].NumRows() ==
+                   std::min(block_rows_, output_dim_ - r * block_rows_));
+    }
+  }
+}
+
+void BlockSparseAffineComponent::InitFromConfig(ConfigLine *cfl) {
+  int32 block_rows = 16, block_cols = 16;
+  BaseFloat sparsity = 0.5;
+  bool use_bias = true;
+  cfl->GetValue("block-rows", &block_rows);
+  cfl->GetValue("block-cols", &block_cols);
+  cfl->GetValue("sparsity", &sparsity);
+  cfl->GetValue("use-bias", &use_bias);
+
+  CuMatrix<BaseFloat> linear_params;
+  CuVector<BaseFloat> bias_params;
+  std::string filename;
+  // Two forms allowed: "matrix=<rxfilename>", or "input-dim=x output-dim=y"
+  // (for testing purposes only).
+  if (cfl->GetValue("matrix", &filename)) {
+    bool binary;
+    Input ki(filename, &binary);
+    CuMatrix<BaseFloat> mat;
+    mat.Read(ki.Stream(), binary);
+    KALDI_ASSERT(mat.NumRows() != 0 && mat.NumCols() > 1);
+    linear_params = mat.ColRange(0, mat.NumCols() - 1);
+    bias_params.Resize(mat.NumRows());
+    bias_params.CopyColFromMat(mat, mat.NumCols() - 1);
+  } else {
+    int32 input_dim = -1, output_dim = -1;
+    if (!cfl->GetValue("input-dim", &input_dim) ||
+        !cfl->GetValue("output-dim", &output_dim) ||
+        input_dim <= 0 || output_dim <= 0) {
+      KALDI_ERR << "Invalid initializer for layer of type "
+                << Type() << ": \"" << cfl->WholeLine() << "\"";
+    }
+    linear_params.Resize(output_dim, input_dim);
+    linear_params.SetRandn();
+    linear_params.Scale(1.0 / std::sqrt(static_cast<BaseFloat>(input_dim)));
+    if (use_bias) {
+      bias_params.Resize(output_dim);
+      bias_params.SetRandn();
+    }
+  }
+  if (cfl->HasUnusedValues())
+    KALDI_ERR << "Could not process these elements in initializer: "
+              << cfl->UnusedValues();
+  if (block_rows <= 0 || block_cols <= 0 || sparsity < 0.0 || sparsity >= 1.0)
+    KALDI_ERR << "Invalid block-rows, block-cols or sparsity in config line: "
+              << cfl->WholeLine();
+  Init(linear_params, bias_params, block_rows, block_cols, sparsity);
+}
+
+std::string BlockSparseAffineComponent::Info() const {
+  std::ostringstream stream;
+  stream << Component::Info()
+         << ", block-rows=" << block_rows_
+         << ", block-cols=" << block_cols_
+         << ", sparsity=" << Sparsity();
+  CuMatrix<BaseFloat> linear_params;
+  GetLinearParams(&linear_params);
+  PrintParameterStats(stream, "linear-params", linear_params);
+  if (bias_params_.Dim() != 0)
+    PrintParameterStats(stream, "bias", bias_params_, true);
+  return stream.str();
+}
+
+void* BlockSparseAffineComponent::Propagate(
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &in,
+    CuMatrixBase<BaseFloat> *out) const {
+  if (bias_params_.Dim() != 0)
+    out->CopyRowsFromVec(bias_params_);
+  else
+    out->SetZero();
+  int32 num_rows = in.NumRows(), num_block_rows = NumBlockRows();
+  // 'gathered' is a temporary for the input columns of block-rows whose
+  // retained blocks are not contiguous.
+  CuMatrix<BaseFloat> gathered;
+  if (max_stored_cols_ > 0)
+    gathered.Resize(num_rows, max_stored_cols_, kUndefined);
+  for (int32 r = 0; r < num_block_rows; r++) {
+    const CuMatrix<BaseFloat> &params = params_[r];
+    if (params.NumCols() == 0)
+      continue;
+    CuSubMatrix<BaseFloat> out_part(out->ColRange(r * block_rows_,
+                                                  params.NumRows()));
+    if (contiguous_offset_[r] >= 0) {
+      out_part.AddMatMat(1.0, in.ColRange(contiguous_offset_[r],
+                                          params.NumCols()), kNoTrans,
+                         params, kTrans, 1.0);
+    } else {
+      CuSubMatrix<BaseFloat> in_part(gathered.ColRange(0, params.NumCols()));
+      in_part.CopyCols(in, column_indexes_[r]);
+      out_part.AddMatMat(1.0, in_part, kNoTrans, params, kTrans, 1.0);
+    }
+  }
+  return NULL;
+}
+
+void BlockSparseAffineComponent::Backprop(
+    const std::string &debug_info,
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &, // in_value
+    const CuMatrixBase<BaseFloat> &, // out_value
+    const CuMatrixBase<BaseFloat> &out_deriv,
+    void *memo,
+    Component *, // to_update
+    CuMatrixBase<BaseFloat> *in_deriv) const {
+  NVTX_RANGE("BlockSparseAffineComponent::Backprop");
+  // kBackpropAdds is true. It's the user's responsibility to zero out
+  // <in_deriv> if they need it to be so.
+  if (in_deriv == NULL)
+    return;
+  int32 num_rows = out_deriv.NumRows(), num_block_rows = NumBlockRows();
+  CuMatrix<BaseFloat> scattered;
+  if (max_stored_cols_ > 0)
+    scattered.Resize(num_rows, max_stored_cols_, kUndefined);
+  for (int32 r = 0; r < num_block_rows; r++) {
+    const CuMatrix<BaseFloat> &params = params_[r];
+    if (params.NumCols() == 0)
+      continue;
+    CuSubMatrix<BaseFloat> out_deriv_part(out_deriv.ColRange(
+        r * block_rows_, params.NumRows()));
+    if (contiguous_offset_[r] >= 0) {
+      in_deriv->ColRange(contiguous_offset_[r], params.NumCols()).AddMatMat(
+          1.0, out_deriv_part, kNoTrans, params, kNoTrans, 1.0);
+    } else {
+      CuSubMatrix<BaseFloat> in_deriv_part(
+          scattered.ColRange(0, params.NumCols()));
+      in_deriv_part.AddMatMat(1.0, out_deriv_part, kNoTrans,
+                              params, kNoTrans, 0.0);
+      const std::vector<int32> &indexes = block_indexes_[r];
+      int32 offset = 0;
+      for (size_t i = 0; i < indexes.size(); i++) {
+        int32 col_offset = indexes[i] * block_cols_,
+            width = std::min(block_cols_, input_dim_ - col_offset);
+        in_deriv->ColRange(col_offset, width).AddMat(
+            1.0, in_deriv_part.ColRange(offset, width));
+        offset += width;
+      }
+    }
+  }
+}
+
+Component* BlockSparseAffineComponent::Copy() const {
+  BlockSparseAffineComponent *ans = new BlockSparseAffineComponent();
+  ans->input_dim_ = input_dim_;
+  ans->output_dim_ = output_dim_;
+  ans->block_rows_ = block_rows_;
+  ans->block_cols_ = block_cols_;
+  ans->block_indexes_ = block_indexes_;
+  ans->params_ = params_;
+  ans->bias_params_ = bias_params_;
+  ans->column_indexes_ = column_indexes_;
+  ans->contiguous_offset_ = contiguous_offset_;
+  ans->max_stored_cols_ = max_stored_cols_;
+  return ans;
+}
+
+void BlockSparseAffineComponent::GetLinearParams(
+    CuMatrix<BaseFloat> *linear_params) const {
+  Matrix<BaseFloat> ans(output_dim_, input_dim_);
+  for (int32 r = 0; r < NumBlockRows(); r++) {
+    if (params_[r].NumCols() == 0)
+      continue;
+    Matrix<BaseFloat> packed(params_[r]);
+    const std::vector<int32> &indexes = block_indexes_[r];
+    int32 offset = 0;
+    for (size_t i = 0; i < indexes.size(); i++) {
+      int32 col_offset = indexes[i] * block_cols_,
+          width = std::min(block_cols_, input_dim_ - col_offset);
+      ans.Range(r * block_rows_, packed.NumRows(),
+                col_offset, width).CopyFromMat(packed.ColRange(offset, width));
+      offset += width;
+    }
+  }
+  linear_params->Swap(&ans);
+}
+
+int32 BlockSparseAffineComponent::NumStoredParams() const {
+  int32 ans = 0;
+  for (size_t r = 0; r < params_.size(); r++)
+    ans += params_[r].NumRows() * params_[r].NumCols();
+  return ans;
+}
+
+BaseFloat BlockSparseAffineComponent::Sparsity() const {
+  if (input_dim_ == 0 || output_dim_ == 0)
+    return 0.0;
+  return 1.0 - NumStoredParams() /
+      (static_cast<BaseFloat>(input_dim_) * output_dim_);
+}
+
+void BlockSparseAffineComponent::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<BlockSparseAffineComponent>");
+  WriteToken(os, binary, "<InputDim>");
+  WriteBasicType(os, binary, input_dim_);
+  WriteToken(os, binary, "<OutputDim>");
+  WriteBasicType(os, binary, output_dim_);
+  WriteToken(os, binary, "<BlockRows>");
+  WriteBasicType(os, binary, block_rows_);
+  WriteToken(os, binary, "<BlockCols>");
+  WriteBasicType(os, binary, block_cols_);
+  WriteToken(os, binary, "<Blocks>");
+  for (size_t r = 0; r < params_.size(); r++) {
+    WriteIntegerVector(os, binary, block_indexes_[r]);
+    params_[r].Write(os, binary);
+  }
+  WriteToken(os, binary, "<BiasParams>");
+  bias_params_.Write(os, binary);
+  WriteToken(os, binary, "</BlockSparseAffineComponent>");
+}
+
+void BlockSparseAffineComponent::Read(std::istream &is, bool binary) {
+  ExpectOneOrTwoTokens(is, binary, "<BlockSparseAffineComponent>",
+                       "<InputDim>");
+  ReadBasicType(is, binary, &input_dim_);
+  ExpectToken(is, binary, "<OutputDim>");
+  ReadBasicType(is, binary, &output_dim_);
+  ExpectToken(is, binary, "<BlockRows>");
+  ReadBasicType(is, binary, &block_rows_);
+  ExpectToken(is, binary, "<BlockCols>");
+  ReadBasicType(is, binary, &block_cols_);
+  if (input_dim_ <= 0 || output_dim_ <= 0 ||
+      block_rows_ <= 0 || block_cols_ <= 0)
+    KALDI_ERR << "Bad dimensions reading BlockSparseAffineComponent";
+  int32 num_block_rows = (output_dim_ + block_rows_ - 1) / block_rows_;
+  ExpectToken(is, binary, "<Blocks>");
+  block_indexes_.resize(num_block_rows);
+  params_.resize(num_block_rows);
+  for (int32 r = 0; r < num_block_rows; r++) {
+    ReadIntegerVector(is, binary, &(block_indexes_[r]));
+    params_[r].Read(is, binary);
+  }
+  ExpectToken(is, binary, "<BiasParams>");
+  bias_params_.Read(is, binary);
+  ExpectToken(is, binary, "</BlockSparseAffineComponent>");
+  ComputeDerived();
+  Check();
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
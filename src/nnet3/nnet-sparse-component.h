@@ -0,0 +1,180 @@
+// nnet3/nnet-sparse-component.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_SPARSE_COMPONENT_H_
+#define KALDI_NNET3_NNET_SPARSE_COMPONENT_H_
+
+#include "nnet3/nnet-common.h"
+#include "nnet3/nnet-component-itf.h"
+#include <iostream>
+
+namespace kaldi {
+namespace nnet3 {
+
+/// @file  nnet-sparse-component.h
+///
+/// Contains component(s) whose parameter matrices are stored in a sparse
+/// (pruned) form, for faster test-time computation.
+
+
+/**
+   BlockSparseAffineComponent is a non-trainable affine (or linear) transform
+   whose linear parameters are block-sparse: the (output-dim by input-dim)
+   parameter matrix is divided into blocks of size block-rows by block-cols
+   (the last block-row and block-column may be smaller if the dimensions are
+   not multiples of the block size), and only a subset of the blocks are
+   stored; the rest are implicitly zero.  It is intended to be created by
+   magnitude-pruning the parameters of an already-trained model (see
+   SparsifyNnet() in nnet-utils.h and the program nnet3-prune-sparse), and
+   then used for decoding; think of it as a sparse version of
+   FixedAffineComponent.
+
+   The computation is done per block-row: the input columns corresponding to
+   the retained blocks of that block-row are gathered into a temporary matrix
+   and a single matrix multiplication is done against the packed parameters
+   of that block-row.  The number of floating point operations is thus
+   proportional to the number of retained blocks; e.g. with 75% of blocks
+   pruned away it is about 4 times smaller than for the dense matrix.  The
+   block structure means the work is still done by the BLAS (or CUBLAS) matrix
+   multiplication routines, which is much faster than element-wise sparse
+   kernels at the sparsity levels that are attainable without loss of
+   accuracy.
+
+   Configuration values accepted by InitFromConfig() (they are mostly for
+   testing; normally this component is created by SparsifyNnet()):
+
+     matrix         Filename of a matrix of dimension output-dim by
+                    (input-dim + 1), whose last column is the bias.  If this
+                    is not set, then input-dim and output-dim must be set and
+                    the parameters are initialized randomly.
+     input-dim      Input dimension (if matrix is not set).
+     output-dim     Output dimension (if matrix is not set).
+     use-bias       If false, there is no bias term.  Default: true.  Only
+                    relevant if matrix is not set.
+     block-rows     Number of rows in each block of the parameter matrix.
+                    Default: 16.
+     block-cols     Number of columns in each block.  Default: 16.
+     sparsity       The proportion of blocks that are pruned away (the ones
+                    with the smallest root-mean-square value), in [0, 1).
+                    Default: 0.5.
+ */
+class BlockSparseAffineComponent: public Component {
+ public:
+  virtual int32 InputDim() const { return input_dim_; }
+  virtual int32 OutputDim() const { return output_dim_; }
+
+  virtual std::string Type() const { return "BlockSparseAffineComponent"; }
+  virtual int32 Properties() const {
+    return kSimpleComponent|kBackpropAdds;
+  }
+  virtual std::string Info() const;
+
+  virtual void* Propagate(const ComponentPrecomputedIndexes *indexes,
+                         const CuMatrixBase<BaseFloat> &in,
+                         CuMatrixBase<BaseFloat> *out) const;
+  virtual void Backprop(const std::string &debug_info,
+                        const ComponentPrecomputedIndexes *indexes,
+                        const CuMatrixBase<BaseFloat> &, // in_value
+                        const CuMatrixBase<BaseFloat> &, // out_value
+                        const CuMatrixBase<BaseFloat> &out_deriv,
+                        void *memo,
+                        Component *, // to_update
+                        CuMatrixBase<BaseFloat> *in_deriv) const;
+
+  virtual Component* Copy() const;
+  virtual void Read(std::istream &is, bool binary);
+  virtual void Write(std::ostream &os, bool binary) const;
+  virtual void InitFromConfig(ConfigLine *cfl);
+
+  // this constructor does not really initialize, use Init(),
+  // InitFromConfig() or Read().
+  BlockSparseAffineComponent(): input_dim_(0), output_dim_(0),
+                                block_rows_(0), block_cols_(0) { }
+
+  /// Initializes from a dense parameter matrix, pruning away the
+  /// proportion 'sparsity' of (block_rows by block_cols) blocks of
+  /// 'linear_params' that have the smallest root-mean-square value (so that
+  /// the smaller blocks at the edges are not penalized).  'bias_params' may be
+  /// empty, meaning there is no bias term.
+  void Init(const CuMatrixBase<BaseFloat> &linear_params,
+            const CuVectorBase<BaseFloat> &bias_params,
+            int32 block_rows, int32 block_cols,
+            BaseFloat sparsity);
+
+  /// Outputs the linear parameters as a dense matrix (with zeros for the pruned
+  /// blocks); 'linear_params' will be resized to OutputDim() by InputDim().
+  void GetLinearParams(CuMatrix<BaseFloat> *linear_params) const;
+
+  const CuVector<BaseFloat> &BiasParams() const { return bias_params_; }
+
+  /// Returns the number of stored (non-pruned) parameters of the linear part.
+  int32 NumStoredParams() const;
+
+  /// Returns the proportion of the dense parameter matrix that was pruned
+  /// away, between 0 and 1.
+  BaseFloat Sparsity() const;
+
+ private:
+  int32 NumBlockRows() const { return block_indexes_.size(); }
+  int32 NumBlockCols() const {
+    return (input_dim_ + block_cols_ - 1) / block_cols_;
+  }
+  // Sets up column_indexes_, contiguous_offset_ and max_stored_cols_
+  // from block_indexes_; called from Init() and Read().
+  void ComputeDerived();
+  void Check() const;
+
+  int32 input_dim_;
+  int32 output_dim_;
+  int32 block_rows_;
+  int32 block_cols_;
+
+  // block_indexes_[r] is the sorted list of the block-column indexes that are
+  // retained for block-row r (i.e. for output dimensions
+  // r * block_rows_ ... min((r+1) * block_rows_, output_dim_) - 1).
+  std::vector<std::vector<int32> > block_indexes_;
+
+  // params_[r] contains the retained blocks of block-row r, concatenated
+  // horizontally in the order given by block_indexes_[r].  Its num-rows is the
+  // number of rows in block-row r and its num-cols is the total width of the
+  // retained blocks (it is empty if no blocks were retained).
+  std::vector<CuMatrix<BaseFloat> > params_;
+
+  // bias_params_ is of dimension output_dim_, or empty if there is no bias.
+  CuVector<BaseFloat> bias_params_;
+
+  // Derived variables:
+
+  // column_indexes_[r] contains the input columns that correspond to the
+  // columns of params_[r].
+  std::vector<CuArray<int32> > column_indexes_;
+  // If the input columns of block-row r are a contiguous range (e.g. all
+  // blocks were retained), contiguous_offset_[r] is the first of them, and we
+  // don't need to gather the input; otherwise it's -1.
+  std::vector<int32> contiguous_offset_;
+  // The largest NumCols() of any of params_.
+  int32 max_stored_cols_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BlockSparseAffineComponent);
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+#endif
@@ -25,6 +25,7 @@
 #include "nnet3/nnet-normalize-component.h"
 #include "nnet3/nnet-general-component.h"
 #include "nnet3/nnet-convolutional-component.h"
+#include "nnet3/nnet-sparse-component.h"
 #include "nnet3/nnet-parse.h"
 #include "nnet3/nnet-computation-graph.h"
 #include "nnet3/nnet-diagnostics.h"
@@ -2119,6 +2120,114 @@ void CollapseModel(const CollapseModelConfig &config,
   c.Collapse();
 }
 
+// Writes to 'config_os' config lines that redefine each component-node that
+// uses component 'c' of 'nnet' so that its input is spliced with the
+// time offsets 'time_offsets'.  This is used when converting a TdnnComponent
+// into a simple component.
+static void WriteSplicedComponentNodeConfigs(
+    const Nnet &nnet, int32 c,
+    const std::vector<int32> &time_offsets,
+    std::ostream &config_os) {
+  KALDI_ASSERT(!time_offsets.empty());
+  for (int32 n = 0; n < nnet.NumNodes(); n++) {
+    if (!nnet.IsComponentNode(n) || nnet.GetNode(n).u.component_index != c)
+      continue;
+    // the component-node's input descriptor is in the preceding node.
+    std::ostringstream descriptor_os;
+    nnet.GetNode(n - 1).descriptor.WriteConfig(descriptor_os,
+                                               nnet.GetNodeNames());
+    const std::string descriptor = descriptor_os.str();
+    config_os << "component-node name=" << nnet.GetNodeName(n)
+              << " component=" << nnet.GetComponentName(c) << " input=";
+    if (time_offsets.size() > 1)
+      config_os << "Append(";
+    for (size_t i = 0; i < time_offsets.size(); i++) {
+      if (i > 0)
+        config_os << ", ";
+      if (time_offsets[i] == 0)
+        config_os << descriptor;
+      else
+        config_os << "Offset(" << descriptor << ", " << time_offsets[i] << ")";
+    }
+    if (time_offsets.size() > 1)
+      config_os << ")";
+    config_os << "\n";
+  }
+}
+
+void SparsifyNnet(const SparsifyNnetConfig &config,
+                  Nnet *nnet) {
+  KALDI_ASSERT(config.sparsity >= 0.0 && config.sparsity < 1.0 &&
+               config.block_rows > 0 && config.block_cols > 0);
+  std::ostringstream node_config_os;
+  int64 num_params_dense = 0, num_params_sparse = 0;
+  int32 num_sparsified = 0;
+  for (int32 c = 0; c < nnet->NumComponents(); c++) {
+    const std::string &name = nnet->GetComponentName(c);
+    if (!NameMatchesPattern(name.c_str(), config.components.c_str()))
+      continue;
+    const Component *comp = nnet->GetComponent(c);
+    CuMatrix<BaseFloat> linear_params;
+    CuVector<BaseFloat> bias_params;
+    std::vector<int32> time_offsets;
+    const AffineComponent *affine =
+        dynamic_cast<const AffineComponent*>(comp);
+    const FixedAffineComponent *fixed_affine =
+        dynamic_cast<const FixedAffineComponent*>(comp);
+    const LinearComponent *linear =
+        dynamic_cast<const LinearComponent*>(comp);
+    const TdnnComponent *tdnn = dynamic_cast<const TdnnComponent*>(comp);
+    if (affine != NULL) {
+      linear_params = affine->LinearParams();
+      bias_params = affine->BiasParams();
+    } else if (fixed_affine != NULL) {
+      linear_params = fixed_affine->LinearParams();
+      bias_params = fixed_affine->BiasParams();
+    } else if (linear != NULL) {
+      linear_params = linear->Params();
+    } else if (tdnn != NULL) {
+      linear_params = tdnn->LinearParams();
+      bias_params = tdnn->BiasParams();
+      time_offsets = tdnn->TimeOffsets();
+    } else {
+      continue;
+    }
+    int32 num_params = linear_params.NumRows() * linear_params.NumCols();
+    if (num_params < config.min_params)
+      continue;
+
+    BlockSparseAffineComponent *sparse = new BlockSparseAffineComponent();
+    sparse->Init(linear_params, bias_params, config.block_rows,
+                 config.block_cols, config.sparsity);
+    CuMatrix<BaseFloat> pruned_params;
+    sparse->GetLinearParams(&pruned_params);
+    BaseFloat orig_norm = linear_params.FrobeniusNorm();
+    pruned_params.AddMat(-1.0, linear_params);
+    BaseFloat relative_error = (orig_norm == 0.0 ? 0.0 :
+                                pruned_params.FrobeniusNorm() / orig_norm);
+    KALDI_LOG << "Pruned component " << name << " of type " << comp->Type()
+              << " to sparsity " << sparse->Sparsity()
+              << ", relative change in parameters is " << relative_error;
+    num_params_dense += num_params;
+    num_params_sparse += sparse->NumStoredParams();
+    num_sparsified++;
+
+    if (!time_offsets.empty() &&
+        !(time_offsets.size() == 1 && time_offsets[0] == 0))
+      WriteSplicedComponentNodeConfigs(*nnet, c, time_offsets,
+                                       node_config_os);
+    // the following call deletes 'comp'.
+    nnet->SetComponent(c, sparse);
+  }
+  if (!node_config_os.str().empty()) {
+    std::istringstream node_config_is(node_config_os.str());
+    nnet->ReadConfig(node_config_is);
+  }
+  KALDI_LOG << "Pruned " << num_sparsified << " components; the number of "
+            << "parameters in them was reduced from " << num_params_dense
+            << " to " << num_params_sparse;
+}
+
 bool UpdateNnetWithMaxChange(const Nnet &delta_nnet,
                              BaseFloat max_param_change,
                              BaseFloat max_change_scale,
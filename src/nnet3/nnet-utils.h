@@ -22,6 +22,7 @@
 
 #include "base/kaldi-common.h"
 #include "util/kaldi-io.h"
+#include "itf/options-itf.h"
 #include "matrix/matrix-lib.h"
 #include "nnet3/nnet-common.h"
 #include "nnet3/nnet-component-itf.h"
@@ -258,6 +259,50 @@ struct CollapseModelConfig {
 void CollapseModel(const CollapseModelConfig &config,
                    Nnet *nnet);
 
+/**
+   Configuration class for SparsifyNnet().
+ */
+struct SparsifyNnetConfig {
+  int32 block_rows;
+  int32 block_cols;
+  BaseFloat sparsity;
+  std::string components;
+  int32 min_params;
+  SparsifyNnetConfig(): block_rows(16), block_cols(16), sparsity(0.5),
+                        components("*"), min_params(10000) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("block-rows", &block_rows, "Number of rows in each block "
+                   "of the pruned parameter matrices (the output dimension).");
+    opts->Register("block-cols", &block_cols, "Number of columns in each "
+                   "block of the pruned parameter matrices (the input "
+                   "dimension).");
+    opts->Register("sparsity", &sparsity, "Proportion of blocks of each "
+                   "parameter matrix that are pruned away (those with the "
+                   "smallest root-mean-square value); must be in [0, 1).");
+    opts->Register("components", &components, "Only components whose names "
+                   "match this pattern (where '*' matches any sequence of "
+                   "characters) are pruned, e.g. 'tdnnf*'.");
+    opts->Register("min-params", &min_params, "Parameter matrices with fewer "
+                   "than this many elements are not pruned.");
+  }
+};
+
+/**
+   This function, intended to be used at test time, replaces the
+   components of type AffineComponent, NaturalGradientAffineComponent,
+   FixedAffineComponent, LinearComponent and TdnnComponent whose names match
+   config.components with components of type BlockSparseAffineComponent,
+   obtained by magnitude-pruning their parameter matrices (see the comment
+   for that class in nnet-sparse-component.h).  For TdnnComponents with
+   time-offsets other than just 0, the input descriptors of the component-nodes
+   are rewritten to do the splicing, e.g. input=x becomes
+   input=Append(Offset(x, -1), x) for time-offsets=-1,0.  The model will no
+   longer be trainable in the pruned components.
+ */
+void SparsifyNnet(const SparsifyNnetConfig &config,
+                  Nnet *nnet);
+
 /**
    ReadEditConfig() reads a file with a similar-looking format to the config file
    read by Nnet::ReadConfig(), but this consists of a sequence of operations to
@@ -35,7 +35,8 @@ int main(int argc, char *argv[]) {
 
     const char *usage =
         "Propagate the features through raw neural network model "
-        "and write the output.  This version is optimized for GPU use. "
+        "and write the output.  This version is optimized for GPU use "
+        "(for CPU-only use, see --num-compute-threads and --max-batch-wait). "
         "If --apply-exp=true, apply the Exp() function to the output "
         "before writing it out.\n"
         "\n"
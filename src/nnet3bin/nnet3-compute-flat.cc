@@ -0,0 +1,163 @@
+// nnet3bin/nnet3-compute-flat.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "nnet3/nnet-flat-graph.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Propagate features through a neural network in the 'flat' format\n"
+        "(see nnet3-export-flat) using the reference executor, and write the\n"
+        "output.  The features are padded at the edges by repeating the first\n"
+        "and last frames, as in nnet3-compute, so the output should be the\n"
+        "same as that of nnet3-compute on the original model (for models\n"
+        "without frame subsampling, or with --frame-subsampling-factor set\n"
+        "to the same value).\n"
+        "\n"
+        "Usage: nnet3-compute-flat [options] <flat-nnet-in> "
+        "<features-rspecifier> <matrix-wspecifier>\n"
+        " e.g.: nnet3-compute-flat final.flat scp:feats.scp ark:out.ark\n"
+        "See also: nnet3-export-flat, nnet3-compute\n";
+
+    ParseOptions po(usage);
+    Timer timer;
+
+    bool apply_exp = false;
+    int32 frame_subsampling_factor = 1,
+        extra_left_context = 0,
+        extra_right_context = 0;
+    std::string ivector_rspecifier, utt2spk_rspecifier;
+
+    po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
+                "iVectors as vectors (i.e. not estimated online); per "
+                "utterance by default, or per speaker if you provide the "
+                "--utt2spk option.");
+    po.Register("utt2spk", &utt2spk_rspecifier, "Rspecifier for "
+                "utt2spk option used to get ivectors per speaker");
+    po.Register("apply-exp", &apply_exp, "If true, apply exp function to "
+                "output");
+    po.Register("frame-subsampling-factor", &frame_subsampling_factor,
+                "Required if the model was trained with frame subsampling: "
+                "only every n'th output frame is written.");
+    po.Register("extra-left-context", &extra_left_context, "Number of "
+                "frames of additional left context (relevant for recurrent "
+                "models).");
+    po.Register("extra-right-context", &extra_right_context, "Number of "
+                "frames of additional right context.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3 || frame_subsampling_factor < 1) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string flat_rxfilename = po.GetArg(1),
+        feature_rspecifier = po.GetArg(2),
+        matrix_wspecifier = po.GetArg(3);
+
+    FlatNnet flat_nnet;
+    ReadKaldiObject(flat_rxfilename, &flat_nnet);
+    bool has_ivector = (flat_nnet.GetNodeIndex("ivector") >= 0);
+    if (has_ivector && ivector_rspecifier.empty())
+      KALDI_ERR << "The nnet has an iVector input; you must supply the "
+                << "--ivectors option.";
+    int32 left_context, right_context;
+    flat_nnet.ComputeContext("output", "input", &left_context,
+                             &right_context);
+    left_context += extra_left_context;
+    right_context += extra_right_context;
+
+    RandomAccessBaseFloatVectorReaderMapped ivector_reader(
+        ivector_rspecifier, utt2spk_rspecifier);
+    BaseFloatMatrixWriter matrix_writer(matrix_wspecifier);
+    FlatNnetComputer computer(flat_nnet);
+
+    int32 num_success = 0, num_fail = 0;
+    int64 frame_count = 0;
+
+    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+    for (; !feature_reader.Done(); feature_reader.Next()) {
+      std::string utt = feature_reader.Key();
+      const Matrix<BaseFloat> &features (feature_reader.Value());
+      int32 num_frames = features.NumRows();
+      if (num_frames == 0) {
+        KALDI_WARN << "Zero-length utterance: " << utt;
+        num_fail++;
+        continue;
+      }
+      if (has_ivector) {
+        if (!ivector_reader.HasKey(utt)) {
+          KALDI_WARN << "No iVector available for utterance " << utt;
+          num_fail++;
+          continue;
+        }
+        const Vector<BaseFloat> &ivector = ivector_reader.Value(utt);
+        Matrix<BaseFloat> ivector_mat(1, ivector.Dim());
+        ivector_mat.Row(0).CopyFromVec(ivector);
+        computer.AcceptInput("ivector", 0, ivector_mat);
+      }
+      Matrix<BaseFloat> padded_features(left_context + num_frames +
+                                        right_context, features.NumCols(),
+                                        kUndefined);
+      for (int32 i = 0; i < padded_features.NumRows(); i++) {
+        int32 t = std::min(std::max(i - left_context, 0), num_frames - 1);
+        padded_features.Row(i).CopyFromVec(features.Row(t));
+      }
+      computer.AcceptInput("input", -left_context, padded_features);
+
+      Matrix<BaseFloat> output;
+      computer.Compute("output", 0, num_frames, &output);
+      if (frame_subsampling_factor != 1) {
+        int32 num_subsampled_frames = (num_frames + frame_subsampling_factor
+                                       - 1) / frame_subsampling_factor;
+        Matrix<BaseFloat> subsampled_output(num_subsampled_frames,
+                                            output.NumCols(), kUndefined);
+        for (int32 i = 0; i < num_subsampled_frames; i++)
+          subsampled_output.Row(i).CopyFromVec(
+              output.Row(i * frame_subsampling_factor));
+        output.Swap(&subsampled_output);
+      }
+      if (apply_exp)
+        output.ApplyExp();
+
+      matrix_writer.Write(utt, output);
+      frame_count += num_frames;
+      num_success++;
+    }
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed * 100.0 / frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    return (num_success != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,103 @@
+// nnet3bin/nnet3-export-flat.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "nnet3/am-nnet-simple.h"
+#include "nnet3/nnet-flat-graph.h"
+#include "nnet3/nnet-utils.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Export an nnet3 model to the 'flat' graph format (see\n"
+        "nnet3/nnet-flat-graph.h), a list of operations in topological order\n"
+        "with explicit time offsets that is intended to be run by inference\n"
+        "runtimes other than Kaldi's.  Batch-norm and dropout components are\n"
+        "exported as in test mode.  The model must be a 'simple' nnet with\n"
+        "supported component types (affine, TDNN, ReLU, sigmoid, tanh, softmax,\n"
+        "batch-norm, LSTM nonlinearity and so on); the program dies with an\n"
+        "error otherwise.  Use nnet3-compute-flat to check the result.\n"
+        "\n"
+        "Usage:  nnet3-export-flat [options] <nnet-in> <flat-nnet-out>\n"
+        "e.g.:\n"
+        " nnet3-export-flat final.mdl final.flat\n"
+        "See also: nnet3-compute-flat\n";
+
+    bool binary_write = true,
+        raw = false,
+        collapse = true;
+
+    ParseOptions po(usage);
+    po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("raw", &raw, "If true, read a 'raw' neural net rather than "
+                "an acoustic model with transition model.");
+    po.Register("collapse", &collapse, "If true, collapse the model first "
+                "(e.g. batch-norm is combined with the preceding affine "
+                "component where possible); see CollapseModel().");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string nnet_rxfilename = po.GetArg(1),
+        flat_wxfilename = po.GetArg(2);
+
+    AmNnetSimple am_nnet;
+    if (raw) {
+      ReadKaldiObject(nnet_rxfilename, &(am_nnet.GetNnet()));
+    } else {
+      bool binary;
+      TransitionModel trans_model;
+      Input ki(nnet_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+    }
+    Nnet &nnet = am_nnet.GetNnet();
+    SetBatchnormTestMode(true, &nnet);
+    SetDropoutTestMode(true, &nnet);
+    if (collapse)
+      CollapseModel(CollapseModelConfig(), &nnet);
+
+    FlatNnet flat_nnet;
+    ConvertNnetToFlat(nnet, &flat_nnet);
+    KALDI_VLOG(1) << "Flat nnet info is: " << flat_nnet.Info();
+
+    int32 left_context, right_context;
+    flat_nnet.ComputeContext("output", "input", &left_context,
+                             &right_context);
+    KALDI_LOG << "Exported " << flat_nnet.NumNodes() << " nodes; "
+              << "left-context=" << left_context << ", right-context="
+              << right_context;
+
+    WriteKaldiObject(flat_nnet, flat_wxfilename, binary_write);
+    KALDI_LOG << "Wrote flat neural net to " << flat_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -72,7 +72,8 @@ int main(int argc, char *argv[]) {
 
     const char *usage =
         "Generate lattices using nnet3 neural net model.  This version is optimized\n"
-        "for GPU-based inference.\n"
+        "for GPU-based inference.  For CPU-only use, see --num-compute-threads\n"
+        "and --max-batch-wait.\n"
         "Usage: nnet3-latgen-faster-batch [options] <nnet-in> <fst-in> <features-rspecifier>"
         " <lattice-wspecifier>\n";
     ParseOptions po(usage);
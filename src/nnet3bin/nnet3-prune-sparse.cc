@@ -0,0 +1,203 @@
+// nnet3bin/nnet3-prune-sparse.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "nnet3/am-nnet-simple.h"
+#include "nnet3/nnet-am-decodable-simple.h"
+#include "nnet3/nnet-utils.h"
+
+
+namespace kaldi {
+namespace nnet3 {
+
+// Computes the output of 'nnet' for the features 'feats' and returns the time
+// taken, in seconds.
+double ComputeNnetOutput(const NnetSimpleComputationOptions &opts,
+                         const Nnet &nnet,
+                         CachingOptimizingCompiler *compiler,
+                         const Matrix<BaseFloat> &feats,
+                         const Vector<BaseFloat> *ivector,
+                         Matrix<BaseFloat> *output) {
+  Timer timer;
+  Vector<BaseFloat> priors;
+  DecodableNnetSimple decodable(opts, nnet, priors, feats, compiler, ivector);
+  output->Resize(decodable.NumFrames(), decodable.OutputDim(), kUndefined);
+  for (int32 t = 0; t < decodable.NumFrames(); t++) {
+    SubVector<BaseFloat> row(*output, t);
+    decodable.GetOutputForFrame(t, &row);
+  }
+  return timer.Elapsed();
+}
+
+// Compares the speed and the outputs of 'nnet' and 'pruned_nnet' on the
+// features in 'feature_rspecifier'.
+void BenchmarkPrunedNnet(const NnetSimpleComputationOptions &opts,
+                         const Nnet &nnet,
+                         const Nnet &pruned_nnet,
+                         const std::string &feature_rspecifier) {
+  CachingOptimizingCompiler compiler(nnet, opts.optimize_config),
+      pruned_compiler(pruned_nnet, opts.optimize_config);
+  int32 ivector_dim = nnet.InputDim("ivector");  // -1 if no such input.
+  Vector<BaseFloat> ivector(std::max<int32>(ivector_dim, 0));
+  if (ivector_dim > 0)
+    KALDI_WARN << "The nnet has an iVector input; using zero iVectors.";
+
+  double tot_time = 0.0, tot_pruned_time = 0.0,
+      tot_sumsq = 0.0, tot_diff_sumsq = 0.0;
+  int64 num_frames = 0, num_frames_same_best = 0;
+  int32 num_done = 0;
+  SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+  for (; !feature_reader.Done(); feature_reader.Next()) {
+    const Matrix<BaseFloat> &feats = feature_reader.Value();
+    if (feats.NumRows() == 0) {
+      KALDI_WARN << "Zero-length utterance: " << feature_reader.Key();
+      continue;
+    }
+    Matrix<BaseFloat> output, pruned_output;
+    tot_time += ComputeNnetOutput(opts, nnet, &compiler, feats,
+                                  (ivector_dim > 0 ? &ivector : NULL),
+                                  &output);
+    tot_pruned_time += ComputeNnetOutput(opts, pruned_nnet, &pruned_compiler,
+                                         feats,
+                                         (ivector_dim > 0 ? &ivector : NULL),
+                                         &pruned_output);
+    for (int32 t = 0; t < output.NumRows(); t++) {
+      SubVector<BaseFloat> row(output, t), pruned_row(pruned_output, t);
+      int32 best, pruned_best;
+      row.Max(&best);
+      pruned_row.Max(&pruned_best);
+      if (best == pruned_best)
+        num_frames_same_best++;
+    }
+    tot_sumsq += TraceMatMat(output, output, kTrans);
+    pruned_output.AddMat(-1.0, output);
+    tot_diff_sumsq += TraceMatMat(pruned_output, pruned_output, kTrans);
+    num_frames += output.NumRows();
+    num_done++;
+  }
+  if (num_frames == 0) {
+    KALDI_WARN << "No features were processed, not printing benchmark.";
+    return;
+  }
+  KALDI_LOG << "Benchmarked " << num_done << " utterances (" << num_frames
+            << " output frames).";
+  KALDI_LOG << "Time taken was " << tot_time << " seconds for the original "
+            << "model and " << tot_pruned_time << " for the pruned model, "
+            << "a speedup of " << (tot_time / tot_pruned_time);
+  KALDI_LOG << "Relative difference in the output was "
+            << std::sqrt(tot_diff_sumsq / tot_sumsq) << "; the best-scoring "
+            << "output index was the same on "
+            << (100.0 * num_frames_same_best / num_frames) << "% of frames.";
+}
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Convert the affine, linear and TDNN components of an nnet3 model into\n"
+        "block-sparse components by magnitude pruning, for faster decoding on\n"
+        "CPU.  The pruned components are no longer trainable.  If\n"
+        "--benchmark-feats is given, the speed and outputs of the original\n"
+        "and pruned models are compared on those features (the accuracy\n"
+        "should be measured in the normal way, by decoding with the pruned\n"
+        "model).\n"
+        "See also SparsifyNnet() in nnet3/nnet-utils.h.\n"
+        "\n"
+        "Usage:  nnet3-prune-sparse [options] <nnet-in> <nnet-out>\n"
+        "e.g.:\n"
+        " nnet3-prune-sparse --sparsity=0.6 --components='tdnnf*' \\\n"
+        "   --benchmark-feats=scp:data/test/feats.scp final.mdl pruned.mdl\n";
+
+    bool binary_write = true,
+        raw = false;
+    std::string benchmark_feats;
+    SparsifyNnetConfig sparsify_config;
+    NnetSimpleComputationOptions compute_opts;
+
+    ParseOptions po(usage);
+    po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("raw", &raw, "If true, read and write 'raw' neural nets "
+                "rather than acoustic models with transition model.");
+    po.Register("benchmark-feats", &benchmark_feats, "If set, rspecifier "
+                "for features on which to compare the speed and output of the "
+                "original and pruned models.");
+    sparsify_config.Register(&po);
+    compute_opts.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string nnet_rxfilename = po.GetArg(1),
+        nnet_wxfilename = po.GetArg(2);
+
+    TransitionModel trans_model;
+    AmNnetSimple am_nnet;
+    if (raw) {
+      ReadKaldiObject(nnet_rxfilename, &(am_nnet.GetNnet()));
+    } else {
+      bool binary;
+      Input ki(nnet_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+    }
+    Nnet &nnet = am_nnet.GetNnet();
+
+    Nnet original_nnet;
+    if (!benchmark_feats.empty())
+      original_nnet = nnet;
+
+    SparsifyNnet(sparsify_config, &nnet);
+
+    if (!benchmark_feats.empty()) {
+      SetBatchnormTestMode(true, &original_nnet);
+      SetDropoutTestMode(true, &original_nnet);
+      Nnet pruned_nnet(nnet);
+      SetBatchnormTestMode(true, &pruned_nnet);
+      SetDropoutTestMode(true, &pruned_nnet);
+      BenchmarkPrunedNnet(compute_opts, original_nnet, pruned_nnet,
+                          benchmark_feats);
+    }
+
+    if (raw) {
+      WriteKaldiObject(nnet, nnet_wxfilename, binary_write);
+    } else {
+      am_nnet.SetContext();
+      Output ko(nnet_wxfilename, binary_write);
+      trans_model.Write(ko.Stream(), binary_write);
+      am_nnet.Write(ko.Stream(), binary_write);
+    }
+    KALDI_LOG << "Wrote pruned neural net to " << nnet_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
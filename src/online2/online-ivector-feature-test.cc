@@ -0,0 +1,167 @@
+// online2/online-ivector-feature-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmm/model-test-common.h"
+#include "online2/online-ivector-feature.h"
+
+namespace kaldi {
+
+// Features from a matrix, of which only the first NumFramesReady() rows are
+// available; this simulates features that arrive in chunks.
+class GrowingMatrixFeature: public OnlineFeatureInterface {
+ public:
+  explicit GrowingMatrixFeature(const MatrixBase<BaseFloat> &mat):
+      mat_(mat), num_frames_ready_(0) { }
+
+  virtual int32 Dim() const { return mat_.NumCols(); }
+  virtual BaseFloat FrameShiftInSeconds() const { return 0.01; }
+  virtual int32 NumFramesReady() const { return num_frames_ready_; }
+  virtual bool IsLastFrame(int32 frame) const {
+    return frame + 1 == mat_.NumRows() && num_frames_ready_ == mat_.NumRows();
+  }
+  virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
+    KALDI_ASSERT(frame < num_frames_ready_);
+    feat->CopyFromVec(mat_.Row(frame));
+  }
+
+  void AddFrames(int32 num_frames) {
+    num_frames_ready_ = std::min(num_frames_ready_ + num_frames,
+                                 mat_.NumRows());
+  }
+ private:
+  const MatrixBase<BaseFloat> &mat_;
+  int32 num_frames_ready_;
+};
+
+// Sets up "info" with a random UBM and iVector extractor, and no splicing or
+// LDA.
+void InitRandIvectorExtractionInfo(int32 dim,
+                                   OnlineIvectorExtractionInfo *info) {
+  FullGmm fgmm;
+  unittest::InitRandFullGmm(dim, RandInt(5, 10), &fgmm);
+  info->diag_ubm.CopyFromFullGmm(fgmm);
+  IvectorExtractorOptions ivector_opts;
+  ivector_opts.ivector_dim = RandInt(2, 10);
+  ivector_opts.use_weights = false;  // not supported in online extraction.
+  info->extractor = IvectorExtractor(ivector_opts, fgmm);
+
+  info->lda_mat.Resize(dim, dim);
+  info->lda_mat.AddToDiag(1.0);
+  info->global_cmvn_stats.Resize(2, dim + 1);
+  BaseFloat count = 100.0;
+  info->global_cmvn_stats(0, dim) = count;
+  for (int32 d = 0; d < dim; d++)
+    info->global_cmvn_stats(1, d) = count;  // unit variance, zero mean.
+  info->splice_opts.left_context = 0;
+  info->splice_opts.right_context = 0;
+
+  info->ivector_period = RandInt(1, 10);
+  info->num_gselect = 5;
+  info->min_post = 0.025;
+  info->posterior_scale = 0.1;
+  info->max_count = 0.0;
+  info->num_cg_iters = 15;
+  info->use_most_recent_ivector = false;
+  info->greedy_ivector_extractor = (RandInt(0, 1) == 0);
+  info->max_remembered_frames = 1000;
+  info->Check();
+}
+
+// Extracts iVectors from several streams in chunks, with and without calling
+// OnlineIvectorFeature::ComputeUbmLogLikesBatch() before each chunk, and checks
+// that the iVectors are the same.
+void TestComputeUbmLogLikesBatch() {
+  int32 dim = RandInt(2, 8);
+  OnlineIvectorExtractionInfo info;
+  InitRandIvectorExtractionInfo(dim, &info);
+
+  // An adaptation state as if from a previous utterance of the same speaker.
+  OnlineIvectorExtractorAdaptationState adaptation_state(info);
+  {
+    Matrix<BaseFloat> feats(RandInt(10, 50), dim);
+    feats.SetRandn();
+    OnlineMatrixFeature base_feature(feats);
+    OnlineIvectorFeature ivector_feature(info, &base_feature);
+    Vector<BaseFloat> ivector(ivector_feature.Dim());
+    ivector_feature.GetFrame(feats.NumRows() - 1, &ivector);
+    ivector_feature.GetAdaptationState(&adaptation_state);
+  }
+
+  int32 num_streams = RandInt(1, 5);
+  std::vector<Matrix<BaseFloat> > feats(num_streams);
+  std::vector<GrowingMatrixFeature*> base_features, batch_base_features;
+  std::vector<OnlineIvectorFeature*> ivector_features, batch_ivector_features;
+  for (int32 i = 0; i < num_streams; i++) {
+    feats[i].Resize(RandInt(1, 100), dim);
+    feats[i].SetRandn();
+    base_features.push_back(new GrowingMatrixFeature(feats[i]));
+    batch_base_features.push_back(new GrowingMatrixFeature(feats[i]));
+    ivector_features.push_back(
+        new OnlineIvectorFeature(info, base_features[i]));
+    batch_ivector_features.push_back(
+        new OnlineIvectorFeature(info, batch_base_features[i]));
+    if (RandInt(0, 1) == 0) {
+      ivector_features[i]->SetAdaptationState(adaptation_state);
+      batch_ivector_features[i]->SetAdaptationState(adaptation_state);
+    }
+  }
+
+  std::vector<int32> num_frames_done(num_streams, 0);
+  bool done = false;
+  while (!done) {
+    for (int32 i = 0; i < num_streams; i++) {
+      int32 num_frames = RandInt(0, 20);
+      base_features[i]->AddFrames(num_frames);
+      batch_base_features[i]->AddFrames(num_frames);
+    }
+    OnlineIvectorFeature::ComputeUbmLogLikesBatch(batch_ivector_features);
+    done = true;
+    for (int32 i = 0; i < num_streams; i++) {
+      // Sometimes don't get all the frames that are ready, so that some of the
+      // cached log-likelihoods are left for the next chunk.
+      int32 num_frames_ready = ivector_features[i]->NumFramesReady(),
+          end_frame = (RandInt(0, 1) == 0 ? num_frames_ready :
+                       RandInt(num_frames_done[i], num_frames_ready));
+      for (int32 t = num_frames_done[i]; t < end_frame; t++) {
+        Vector<BaseFloat> ivector(ivector_features[i]->Dim()),
+            batch_ivector(ivector_features[i]->Dim());
+        ivector_features[i]->GetFrame(t, &ivector);
+        batch_ivector_features[i]->GetFrame(t, &batch_ivector);
+        KALDI_ASSERT(ivector.ApproxEqual(batch_ivector, 0.001));
+      }
+      num_frames_done[i] = end_frame;
+      if (num_frames_done[i] < feats[i].NumRows())
+        done = false;
+    }
+  }
+  for (int32 i = 0; i < num_streams; i++) {
+    KALDI_ASSERT(ApproxEqual(ivector_features[i]->UbmLogLikePerFrame(),
+                             batch_ivector_features[i]->UbmLogLikePerFrame()));
+    delete ivector_features[i];
+    delete batch_ivector_features[i];
+    delete base_features[i];
+    delete batch_base_features[i];
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 10; i++)
+    kaldi::TestComputeUbmLogLikesBatch();
+  KALDI_LOG << "Success.";
+}
@@ -217,9 +217,24 @@ void OnlineIvectorFeature::UpdateStatsForFrames(
   frames.reserve(frame_weights.size());
   for (int32 i = 0; i < num_frames; i++)
     frames.push_back(frame_weights[i].first);
-  lda_normalized_->GetFrames(frames, &feats);
-
-  info_.diag_ubm.LogLikelihoods(feats, &log_likes);
+  if (ubm_loglikes_.NumRows() != 0 &&
+      frames.front() >= ubm_loglikes_begin_ + ubm_loglikes_num_used_ &&
+      frames.back() < ubm_loglikes_begin_ + ubm_loglikes_.NumRows()) {
+    // We have these from ComputeUbmLogLikesBatch().  ("frames" is sorted.)
+    log_likes.Resize(num_frames, ubm_loglikes_.NumCols(), kUndefined);
+    for (int32 i = 0; i < num_frames; i++)
+      log_likes.Row(i).CopyFromVec(
+          ubm_loglikes_.Row(frames[i] - ubm_loglikes_begin_));
+    // Don't use these rows, or any before them, again.
+    ubm_loglikes_num_used_ = frames.back() + 1 - ubm_loglikes_begin_;
+    if (ubm_loglikes_num_used_ == ubm_loglikes_.NumRows()) {
+      ubm_loglikes_.Resize(0, 0);
+      ubm_loglikes_num_used_ = 0;
+    }
+  } else {
+    lda_normalized_->GetFrames(frames, &feats);
+    info_.diag_ubm.LogLikelihoods(feats, &log_likes);
+  }
 
   // "posteriors" stores, for each frame index in the range of frames, the
   // pruned posteriors for the Gaussians in the UBM.
@@ -354,6 +369,58 @@ void OnlineIvectorFeature::GetFrame(int32 frame,
   }
 }
 
+// static
+void OnlineIvectorFeature::ComputeUbmLogLikesBatch(
+    const std::vector<OnlineIvectorFeature*> &features) {
+  if (features.empty())
+    return;
+  const OnlineIvectorExtractionInfo &info = features[0]->info_;
+  int32 num_features = features.size(), tot_frames = 0;
+  // the frames of features[i] will be begin_frame[i] .. begin_frame[i] +
+  // num_frames[i] - 1.
+  std::vector<int32> begin_frame(num_features), num_frames(num_features);
+  for (int32 i = 0; i < num_features; i++) {
+    OnlineIvectorFeature *feature = features[i];
+    KALDI_ASSERT(&(feature->info_) == &info);
+    begin_frame[i] = feature->num_frames_stats_;
+    num_frames[i] = std::max<int32>(
+        0, feature->lda_normalized_->NumFramesReady() - begin_frame[i]);
+    tot_frames += num_frames[i];
+  }
+  if (tot_frames == 0)
+    return;
+
+  Matrix<BaseFloat> feats(tot_frames, features[0]->lda_normalized_->Dim(),
+                          kUndefined);
+  for (int32 i = 0, offset = 0; i < num_features; i++) {
+    if (num_frames[i] == 0)
+      continue;
+    std::vector<int32> frames(num_frames[i]);
+    for (int32 j = 0; j < num_frames[i]; j++)
+      frames[j] = begin_frame[i] + j;
+    SubMatrix<BaseFloat> this_feats(feats, offset, num_frames[i],
+                                    0, feats.NumCols());
+    features[i]->lda_normalized_->GetFrames(frames, &this_feats);
+    offset += num_frames[i];
+  }
+
+  Matrix<BaseFloat> log_likes;
+  info.diag_ubm.LogLikelihoods(feats, &log_likes);
+
+  for (int32 i = 0, offset = 0; i < num_features; i++) {
+    OnlineIvectorFeature *feature = features[i];
+    if (num_frames[i] == 0) {
+      feature->ubm_loglikes_.Resize(0, 0);
+      feature->ubm_loglikes_num_used_ = 0;
+      continue;
+    }
+    feature->ubm_loglikes_ = log_likes.RowRange(offset, num_frames[i]);
+    feature->ubm_loglikes_begin_ = begin_frame[i];
+    feature->ubm_loglikes_num_used_ = 0;
+    offset += num_frames[i];
+  }
+}
+
 void OnlineIvectorFeature::PrintDiagnostics() const {
   if (num_frames_stats_ == 0) {
     KALDI_VLOG(3) << "Processed no data.";
@@ -406,7 +473,8 @@ OnlineIvectorFeature::OnlineIvectorFeature(
                    info_.max_count),
     num_frames_stats_(0), delta_weights_provided_(false),
     updated_with_no_delta_weights_(false),
-    most_recent_frame_with_weight_(-1), tot_ubm_loglike_(0.0) {
+    most_recent_frame_with_weight_(-1), tot_ubm_loglike_(0.0),
+    ubm_loglikes_begin_(0), ubm_loglikes_num_used_(0) {
   info.Check();
   KALDI_ASSERT(base_feature != NULL);
   OnlineFeatureInterface *splice_feature = new OnlineSpliceFrames(info_.splice_opts, base_feature);
@@ -450,6 +518,10 @@ void OnlineIvectorFeature::SetAdaptationState(
                adaptation_state.ivector_stats.IvectorDim());
   ivector_stats_ = adaptation_state.ivector_stats;
   cmvn_->SetState(adaptation_state.cmvn_state);
+  // Any UBM log-likelihoods from ComputeUbmLogLikesBatch() were computed with
+  // the old CMVN state.
+  ubm_loglikes_.Resize(0, 0);
+  ubm_loglikes_num_used_ = 0;
 }
 
 BaseFloat OnlineIvectorFeature::UbmLogLikePerFrame() const {
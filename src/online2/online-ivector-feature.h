@@ -80,8 +80,13 @@ struct OnlineIvectorExtractionConfig {
                         // Interpret this as a number of frames times
                         // posterior_scale, typically 1/10 of a frame count.
 
-  int32 num_cg_iters;  // set to 15.  I don't believe this is very important, so it's
-                       // not configurable from the command line for now.
+  int32 num_cg_iters;  // The maximum number of conjugate gradient iterations
+                       // each time we re-estimate the iVector.  Since we start
+                       // from the previous iVector, a few are normally enough.
+                       // k iterations change the iVector only within a
+                       // k-dimensional (Krylov) subspace, so this is also the
+                       // only limit on the rank of each update; there is no
+                       // separate low-rank update of the stats or the solve.
 
 
   // If use_most_recent_ivector is true, we always return the most recent
@@ -148,6 +153,10 @@ struct OnlineIvectorExtractionConfig {
                    "iVectors from long utterances look more typical.  Interpret "
                    "as a frame-count times --posterior-scale, typically 1/10 of "
                    "a number of frames.  Suggest 100.");
+    opts->Register("num-cg-iters", &num_cg_iters, "Maximum number of "
+                   "conjugate gradient iterations each time the iVector is "
+                   "re-estimated (it starts from the previous iVector, so "
+                   "smaller values will normally be OK, and are faster).");
     opts->Register("use-most-recent-ivector", &use_most_recent_ivector, "If true, "
                    "always use most recent available iVector, rather than the "
                    "one for the designated frame.");
@@ -322,6 +331,28 @@ class OnlineIvectorFeature: public OnlineFeatureInterface {
   void UpdateFrameWeights(
       const std::vector<std::pair<int32, BaseFloat> > &delta_weights);
 
+  /// This is for applications that process many streams at once, each with its
+  /// own OnlineIvectorFeature (all using the same OnlineIvectorExtractionInfo).
+  /// It computes the UBM log-likelihoods of the frames that are ready but not
+  /// yet in the iVector stats, for all of "features" together, so the
+  /// Gaussian computation is one large matrix multiply rather than a small one
+  /// per stream and per iVector period.  The log-likelihoods are cached in
+  /// each object and used when it next updates its stats (as part of
+  /// GetFrame()), and each row is used only once.  Calling this is optional;
+  /// it doesn't affect the output except for roundoff.  If you call
+  /// SetAdaptationState(), call it before this.
+  ///
+  /// There is no option to re-estimate the iVector asynchronously, off the
+  /// decoding thread.  GetFrame(t) returns the iVector estimated from the
+  /// frames up to t (or the most recent one, with --use-most-recent-ivector),
+  /// and it reads the features through the non-thread-safe online feature
+  /// pipeline; a background estimate would make the output depend on timing
+  /// and would need locking around that pipeline.  Applications that want
+  /// this work off the per-stream path should call this function from their
+  /// own batching thread, between the calls to GetFrame().
+  static void ComputeUbmLogLikesBatch(
+      const std::vector<OnlineIvectorFeature*> &features);
+
  private:
 
   // This accumulates i-vector stats for a set of frames, specified as pairs
@@ -398,6 +429,14 @@ class OnlineIvectorFeature: public OnlineFeatureInterface {
   /// The following is only needed for diagnostics.
   double tot_ubm_loglike_;
 
+  /// The UBM log-likelihoods computed by ComputeUbmLogLikesBatch():
+  /// row i is for frame ubm_loglikes_begin_ + i.  The first
+  /// ubm_loglikes_num_used_ rows have already been used by
+  /// UpdateStatsForFrames() and are not used again.
+  Matrix<BaseFloat> ubm_loglikes_;
+  int32 ubm_loglikes_begin_;
+  int32 ubm_loglikes_num_used_;
+
   /// Most recently estimated iVector, will have been
   /// estimated at the greatest time t where t <= num_frames_stats_ and
   /// t % info_.ivector_period == 0.
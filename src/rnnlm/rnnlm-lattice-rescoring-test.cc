@@ -0,0 +1,104 @@
+// rnnlm/rnnlm-lattice-rescoring-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//  http://www.apache.org/licenses/LICENSE-2.0
+
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "rnnlm/rnnlm-lattice-rescoring.h"
+
+namespace kaldi {
+namespace rnnlm {
+
+// Creates a small recurrent RNNLM with random parameters.
+void GenerateRandomRnnlm(int32 embedding_dim, nnet3::Nnet *nnet) {
+  int32 hidden_dim = RandInt(2, 8);
+  std::ostringstream os;
+  os << "input-node name=input dim=" << embedding_dim << "\n"
+     << "component name=affine1 type=AffineComponent input-dim="
+     << (embedding_dim + hidden_dim) << " output-dim=" << hidden_dim << "\n"
+     << "component-node name=affine1 component=affine1 "
+     << "input=Append(input, IfDefined(Offset(tanh1, -1)))\n"
+     << "component name=tanh1 type=TanhComponent dim=" << hidden_dim << "\n"
+     << "component-node name=tanh1 component=tanh1 input=affine1\n"
+     << "component name=output.affine type=AffineComponent input-dim="
+     << hidden_dim << " output-dim=" << embedding_dim << "\n"
+     << "component-node name=output.affine component=output.affine "
+     << "input=tanh1\n"
+     << "output-node name=output input=output.affine\n";
+  std::istringstream is(os.str());
+  nnet->ReadConfig(is);
+}
+
+// Walks randomly through a KaldiRnnlmDeterministicFst that keeps all the RNNLM
+// states and one that keeps very few of them (so that states are deleted and
+// recomputed all the time), and checks that they give the same arcs and final
+// weights.
+void UnitTestKaldiRnnlmDeterministicFstEviction() {
+  int32 num_words = RandInt(5, 20), embedding_dim = RandInt(2, 8);
+  nnet3::Nnet nnet;
+  GenerateRandomRnnlm(embedding_dim, &nnet);
+  CuMatrix<BaseFloat> word_embedding_mat(num_words, embedding_dim);
+  word_embedding_mat.SetRandn();
+
+  RnnlmComputeStateComputationOptions opts;
+  opts.bos_index = 1;
+  opts.eos_index = 2;
+  opts.normalize_probs = (RandInt(0, 1) == 0);
+  RnnlmComputeStateInfo info(opts, nnet, word_embedding_mat);
+
+  int32 max_ngram_order = (RandInt(0, 1) == 0 ? 0 : RandInt(2, 4)),
+      max_cached_states = RandInt(1, 3);
+  KaldiRnnlmDeterministicFst fst(max_ngram_order, info),
+      cached_fst(max_ngram_order, info, max_cached_states);
+
+  // The states are numbered in the order in which they are first reached, so
+  // the state-ids of the two FSTs are the same.
+  std::vector<fst::StdArc::StateId> states;
+  states.push_back(fst.Start());
+  KALDI_ASSERT(cached_fst.Start() == fst.Start());
+  for (int32 i = 0; i < 200; i++) {
+    fst::StdArc::StateId s = states[RandInt(0, states.size() - 1)];
+    if (RandInt(0, 3) == 0) {
+      KALDI_ASSERT(ApproxEqual(fst.Final(s).Value(),
+                               cached_fst.Final(s).Value()));
+      continue;
+    }
+    fst::StdArc::Label word = RandInt(3, num_words - 1);
+    fst::StdArc arc, cached_arc;
+    KALDI_ASSERT(fst.GetArc(s, word, &arc) &&
+                 cached_fst.GetArc(s, word, &cached_arc));
+    KALDI_ASSERT(arc.nextstate == cached_arc.nextstate &&
+                 ApproxEqual(arc.weight.Value(), cached_arc.weight.Value()));
+    if (static_cast<size_t>(arc.nextstate) == states.size())
+      states.push_back(arc.nextstate);
+  }
+  // Visit every state, so that the ones that were deleted are recomputed.
+  for (size_t i = 0; i < states.size(); i++)
+    KALDI_ASSERT(ApproxEqual(fst.Final(states[i]).Value(),
+                             cached_fst.Final(states[i]).Value()));
+  KALDI_ASSERT(fst.NumStatesRecomputed() == 0);
+  if (states.size() > static_cast<size_t>(max_cached_states) + 1)
+    KALDI_ASSERT(cached_fst.NumStatesRecomputed() > 0);
+}
+
+}  // namespace rnnlm
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi::rnnlm;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestKaldiRnnlmDeterministicFstEviction();
+  KALDI_LOG << "Success.";
+}
@@ -47,12 +47,17 @@ void KaldiRnnlmDeterministicFst::Clear() {
   
   state_to_rnnlm_state_.resize(1);
   state_to_wseq_.resize(1);
+  state_to_prev_.resize(1);
   wseq_to_state_.clear();
   wseq_to_state_[state_to_wseq_[0]] = 0;
+  access_queue_.clear();
+  state_to_queue_position_.resize(1);
 }
 
 KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
-    const RnnlmComputeStateInfo &info) {
+    const RnnlmComputeStateInfo &info, int32 max_cached_states):
+    max_cached_states_(max_cached_states), num_computed_(0),
+    num_recomputed_(0) {
   max_ngram_order_ = max_ngram_order;
   bos_index_ = info.opts.bos_index;
   eos_index_ = info.opts.eos_index;
@@ -65,13 +70,15 @@ KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
   start_state_ = 0;
 
   state_to_rnnlm_state_.push_back(decodable_rnnlm);
+  state_to_prev_.push_back(std::make_pair(-1, bos_index_));
+  // The start state is never deleted, so it is not in the access queue.
+  state_to_queue_position_.push_back(access_queue_.end());
 }
 
 fst::StdArc::Weight KaldiRnnlmDeterministicFst::Final(StateId s) {
   /// At this point, we have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-
-  RnnlmComputeState* rnn = state_to_rnnlm_state_[s];
+  const RnnlmComputeState* rnn = GetRnnlmState(s);
   return Weight(-rnn->LogProbOfWord(eos_index_));
 }
 
@@ -79,9 +86,9 @@ bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
                                         fst::StdArc *oarc) {
   /// At this point, we have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+  const RnnlmComputeState* rnnlm = GetRnnlmState(s);
 
   std::vector<Label> word_seq = state_to_wseq_[s];
-  const RnnlmComputeState* rnnlm = state_to_rnnlm_state_[s];
 
   BaseFloat logprob = rnnlm->LogProbOfWord(ilabel);
 
@@ -104,8 +111,13 @@ bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
   // If the pair was just inserted, then also add it to state_to_* structures.
   if (result.second == true) {
     RnnlmComputeState *rnnlm2 = rnnlm->GetSuccessorState(ilabel);
+    num_computed_++;
     state_to_wseq_.push_back(word_seq);
     state_to_rnnlm_state_.push_back(rnnlm2);
+    state_to_prev_.push_back(std::make_pair(s, ilabel));
+    state_to_queue_position_.push_back(access_queue_.end());
+    Touch(result.first->second);
+    DeleteOldStates();
   }
 
   // Creates the arc.
@@ -116,5 +128,54 @@ bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
   return true;
 }
 
+const RnnlmComputeState *KaldiRnnlmDeterministicFst::GetRnnlmState(
+    StateId s) {
+  if (state_to_rnnlm_state_[s] == NULL)
+    RecomputeState(s);
+  Touch(s);
+  DeleteOldStates();
+  return state_to_rnnlm_state_[s];
+}
+
+void KaldiRnnlmDeterministicFst::RecomputeState(StateId s) {
+  // Find the deleted predecessors; the start state is never deleted.
+  std::vector<StateId> chain;
+  while (state_to_rnnlm_state_[s] == NULL) {
+    chain.push_back(s);
+    s = state_to_prev_[s].first;
+    KALDI_ASSERT(s >= 0);
+  }
+  for (size_t i = chain.size(); i > 0; i--) {
+    StateId t = chain[i - 1];
+    RnnlmComputeState *rnnlm_state =
+        new RnnlmComputeState(*(state_to_rnnlm_state_[state_to_prev_[t].first]));
+    rnnlm_state->AddWord(state_to_prev_[t].second);
+    state_to_rnnlm_state_[t] = rnnlm_state;
+    Touch(t);
+  }
+  num_recomputed_ += chain.size();
+}
+
+void KaldiRnnlmDeterministicFst::Touch(StateId s) {
+  if (s == start_state_ || max_cached_states_ <= 0)
+    return;
+  if (state_to_queue_position_[s] != access_queue_.end())
+    access_queue_.erase(state_to_queue_position_[s]);
+  state_to_queue_position_[s] =
+      access_queue_.insert(access_queue_.end(), s);
+}
+
+void KaldiRnnlmDeterministicFst::DeleteOldStates() {
+  if (max_cached_states_ <= 0)
+    return;
+  while (access_queue_.size() > static_cast<size_t>(max_cached_states_)) {
+    StateId s = access_queue_.front();
+    access_queue_.pop_front();
+    state_to_queue_position_[s] = access_queue_.end();
+    delete state_to_rnnlm_state_[s];
+    state_to_rnnlm_state_[s] = NULL;
+  }
+}
+
 }  // namespace rnnlm
 }  // namespace kaldi
@@ -22,6 +22,7 @@
 #ifndef KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 #define KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 
+#include <list>
 #include <string>
 #include <vector>
 
@@ -33,6 +34,17 @@
 namespace kaldi {
 namespace rnnlm {
 
+/*
+  This class wraps an RNNLM as a DeterministicOnDemandFst, for lattice
+  rescoring; a state corresponds to a word history, truncated to
+  max_ngram_order - 1 words if max_ngram_order > 0.
+
+  Because the RNNLM states are large, the number that we keep may be limited
+  (max_cached_states); the least recently used ones are then deleted, and are
+  recomputed from their predecessors if they are needed again.  This does not
+  change the results, since we remember which state and word each state was
+  created from.
+*/
 class KaldiRnnlmDeterministicFst
     : public fst::DeterministicOnDemandFst<fst::StdArc> {
  public:
@@ -40,9 +52,10 @@ class KaldiRnnlmDeterministicFst
   typedef fst::StdArc::StateId StateId;
   typedef fst::StdArc::Label Label;
 
-  // Does not take ownership.
+  // Does not take ownership.  If max_cached_states > 0, it is the maximum
+  // number of RNNLM states (not counting the start state) that we keep.
   KaldiRnnlmDeterministicFst(int32 max_ngram_order,
-      const RnnlmComputeStateInfo &info);
+      const RnnlmComputeStateInfo &info, int32 max_cached_states = 0);
   ~KaldiRnnlmDeterministicFst();
 
   void Clear();
@@ -57,7 +70,27 @@ class KaldiRnnlmDeterministicFst
 
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
+  // The number of RNNLM states that were computed, and of those that were
+  // recomputed after having been deleted.
+  int64 NumStatesComputed() const { return num_computed_; }
+  int64 NumStatesRecomputed() const { return num_recomputed_; }
+
  private:
+  // Returns the RNNLM state of state s, recomputing it if it was deleted,
+  // and marks it as recently used.
+  const RnnlmComputeState *GetRnnlmState(StateId s);
+
+  // Recomputes the RNNLM state of state s, which was deleted, and those of
+  // any deleted predecessors.
+  void RecomputeState(StateId s);
+
+  // Marks the RNNLM state of s, which must exist, as the most recently used.
+  void Touch(StateId s);
+
+  // Deletes the least recently used RNNLM states until there are at most
+  // max_cached_states_.
+  void DeleteOldStates();
+
   typedef unordered_map
       <std::vector<Label>, StateId, VectorHasher<Label> > MapType;
   StateId start_state_;
@@ -71,9 +104,24 @@ class KaldiRnnlmDeterministicFst
   std::vector<std::vector<Label> > state_to_wseq_;
 
   // Mapping from state-id to RNNLM states.
-  // The pointers are owned in this class
+  // The pointers are owned in this class; they are NULL for the states that
+  // we deleted.
   std::vector<RnnlmComputeState*> state_to_rnnlm_state_;
 
+  // Mapping from state-id to the state and word that it was created from
+  // (-1 and <s> for the start state).
+  std::vector<std::pair<StateId, Label> > state_to_prev_;
+
+  int32 max_cached_states_;
+  // The states other than the start state whose RNNLM states exist, the most
+  // recently used at the end.
+  std::list<StateId> access_queue_;
+  // Mapping from state-id to its position in access_queue_ (or
+  // access_queue_.end()).
+  std::vector<std::list<StateId>::iterator> state_to_queue_position_;
+
+  int64 num_computed_;
+  int64 num_recomputed_;
 };
 
 }  // namespace rnnlm
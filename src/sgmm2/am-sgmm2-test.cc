@@ -237,6 +237,59 @@ void TestSgmm2IncreaseDim(const AmSgmm2 &sgmm) {
   delete sgmm1;
 }
 
+// Tests that the version of ComputePerFrameVars() for a sequence of frames
+// gives the same results as the one for a single frame, with and without
+// speaker adaptation.
+void TestSgmm2PerFrameVarsBatch(const AmSgmm2 &sgmm) {
+  using namespace kaldi;
+  AmSgmm2 sgmm1;
+  sgmm1.CopyFromSgmm2(sgmm, false, false);
+  Sgmm2PerSpkDerivedVars spk_vars;
+  if (RandInt(0, 1) == 0) {
+    Matrix<BaseFloat> norm_xform;
+    ComputeFeatureNormalizingTransform(sgmm.full_ubm(), &norm_xform);
+    sgmm1.IncreaseSpkSpaceDim(sgmm.FeatureDim() - 1 + RandInt(0, 1),
+                              norm_xform, true);
+    Vector<BaseFloat> v_s(sgmm1.SpkSpaceDim());
+    v_s.SetRandn();
+    spk_vars.SetSpeakerVector(v_s);
+    sgmm1.ComputeDerivedVars();
+    sgmm1.ComputePerSpkDerivedVars(&spk_vars);
+  } else {
+    sgmm1.ComputeNormalizers();
+  }
+
+  int32 num_frames = RandInt(1, 50), dim = sgmm.FeatureDim();
+  Sgmm2GselectConfig config;
+  config.full_gmm_nbest = std::min(config.full_gmm_nbest, sgmm.NumGauss());
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+  std::vector<std::vector<int32> > gselect(num_frames);
+  for (int32 t = 0; t < num_frames; t++)
+    sgmm1.GaussianSelection(config, feats.Row(t), &(gselect[t]));
+
+  std::vector<Sgmm2PerFrameDerivedVars> per_frame_batch;
+  sgmm1.ComputePerFrameVars(feats, gselect, spk_vars, &per_frame_batch);
+  KALDI_ASSERT(per_frame_batch.size() == static_cast<size_t>(num_frames));
+  Sgmm2PerFrameDerivedVars per_frame;
+  Sgmm2LikelihoodCache cache(sgmm1.NumGroups(), sgmm1.NumPdfs());
+  for (int32 t = 0; t < num_frames; t++) {
+    sgmm1.ComputePerFrameVars(feats.Row(t), gselect[t], spk_vars, &per_frame);
+    const Sgmm2PerFrameDerivedVars &batch = per_frame_batch[t];
+    KALDI_ASSERT(batch.gselect == per_frame.gselect);
+    KALDI_ASSERT(batch.xt.ApproxEqual(per_frame.xt, 1.0e-06));
+    KALDI_ASSERT(batch.xti.ApproxEqual(per_frame.xti, 1.0e-05));
+    KALDI_ASSERT(batch.zti.ApproxEqual(per_frame.zti, 1.0e-04));
+    KALDI_ASSERT(batch.nti.ApproxEqual(per_frame.nti, 1.0e-04));
+    cache.NextFrame();
+    BaseFloat loglike = sgmm1.LogLikelihood(per_frame, 0, &cache, &spk_vars);
+    cache.NextFrame();
+    BaseFloat loglike_batch = sgmm1.LogLikelihood(batch, 0, &cache,
+                                                  &spk_vars);
+    AssertEqual(loglike, loglike_batch, 1.0e-04);
+  }
+}
+
 void TestSgmm2PreXform(const AmSgmm2 &sgmm) {
   kaldi::Matrix<BaseFloat> xform, inv_xform;
   kaldi::Vector<BaseFloat> diag_scatter;
@@ -275,6 +328,7 @@ void UnitTestSgmm2() {
   TestSgmm2Substates(sgmm);
   TestSgmm2IncreaseDim(sgmm);
   TestSgmm2PreXform(sgmm);
+  TestSgmm2PerFrameVarsBatch(sgmm);
 }
 
 int main() {
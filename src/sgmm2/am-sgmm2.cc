@@ -21,7 +21,9 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <functional>
+#include <utility>
 
 #include "sgmm2/am-sgmm2.h"
 #include "util/kaldi-thread.h"
@@ -472,6 +474,70 @@ void AmSgmm2::ComputePerFrameVars(const VectorBase<BaseFloat> &data,
   }
 }
 
+void AmSgmm2::ComputePerFrameVars(
+    const MatrixBase<BaseFloat> &data,
+    const std::vector<std::vector<int32> > &gselect,
+    const Sgmm2PerSpkDerivedVars &spk_vars,
+    std::vector<Sgmm2PerFrameDerivedVars> *per_frame_vars) const {
+  KALDI_ASSERT(!n_.empty() && "ComputeNormalizers() must be called.");
+  int32 num_frames = data.NumRows(), num_gauss = NumGauss(),
+      feat_dim = FeatureDim(), phn_dim = PhoneSpaceDim();
+  KALDI_ASSERT(static_cast<int32>(gselect.size()) == num_frames &&
+               data.NumCols() == feat_dim);
+  per_frame_vars->resize(num_frames);
+
+  // frames[i] is the list of (t, ki) such that gselect[t][ki] == i.
+  std::vector<std::vector<std::pair<int32, int32> > > frames(num_gauss);
+  size_t max_frames = 0;
+  for (int32 t = 0; t < num_frames; t++) {
+    Sgmm2PerFrameDerivedVars &vars = (*per_frame_vars)[t];
+    vars.Resize(gselect[t].size(), feat_dim, phn_dim);
+    vars.gselect = gselect[t];
+    vars.xt.CopyFromVec(data.Row(t));
+    for (int32 ki = 0, last = gselect[t].size(); ki < last; ki++) {
+      std::vector<std::pair<int32, int32> > &this_frames =
+          frames[gselect[t][ki]];
+      this_frames.push_back(std::make_pair(t, ki));
+      max_frames = std::max(max_frames, this_frames.size());
+    }
+  }
+  if (max_frames == 0) return;
+
+  bool speaker_dep_weights =
+      (spk_vars.v_s.Dim() != 0 && HasSpeakerDependentWeights());
+  Matrix<BaseFloat> SigmaInv(feat_dim, feat_dim),
+      x_buf(max_frames, feat_dim, kUndefined),
+      SigmaInv_x_buf(max_frames, feat_dim, kUndefined),
+      z_buf(max_frames, phn_dim, kUndefined);
+  for (int32 i = 0; i < num_gauss; i++) {
+    const std::vector<std::pair<int32, int32> > &this_frames = frames[i];
+    int32 n = this_frames.size();
+    if (n == 0) continue;
+    SubMatrix<BaseFloat> x(x_buf, 0, n, 0, feat_dim),
+        SigmaInv_x(SigmaInv_x_buf, 0, n, 0, feat_dim),
+        z(z_buf, 0, n, 0, phn_dim);
+    // Rows of x are x_{i}(t) = x(t) - o_i(s), eq.(34).
+    for (int32 r = 0; r < n; r++)
+      x.Row(r).CopyFromVec(data.Row(this_frames[r].first));
+    if (spk_vars.v_s.Dim() != 0)
+      x.AddVecToRows(-1.0, spk_vars.o_s.Row(i));
+    // Sigma_i^{-1} is symmetric, so row r of SigmaInv_x is
+    // (\Sigma_{i}^{-1} x_{i}(t))^T, and row r of z is z_{i}(t)^T, eq.(35).
+    SigmaInv.CopyFromSp(SigmaInv_[i]);
+    SigmaInv_x.AddMatMat(1.0, x, kNoTrans, SigmaInv, kNoTrans, 0.0);
+    z.AddMatMat(1.0, SigmaInv_x, kNoTrans, M_[i], kNoTrans, 0.0);
+    BaseFloat ssgmm_term = (speaker_dep_weights ? spk_vars.log_b_is(i) : 0.0);
+    for (int32 r = 0; r < n; r++) {
+      Sgmm2PerFrameDerivedVars &vars = (*per_frame_vars)[this_frames[r].first];
+      int32 ki = this_frames[r].second;
+      vars.xti.Row(ki).CopyFromVec(x.Row(r));
+      vars.zti.Row(ki).CopyFromVec(z.Row(r));
+      // Eq.(36): n_{i}(t) = -0.5 x_{i}^{T} \Sigma_{i}^{-1} x_{i}(t)
+      vars.nti(ki) = -0.5 * VecVec(x.Row(r), SigmaInv_x.Row(r)) + ssgmm_term;
+    }
+  }
+}
+
 // inline
 void AmSgmm2::ComponentLogLikes(const Sgmm2PerFrameDerivedVars &per_frame_vars,
                                int32 j1,
@@ -484,7 +550,7 @@ void AmSgmm2::ComponentLogLikes(const Sgmm2PerFrameDerivedVars &per_frame_vars,
   // Although the extra memory allocation of storing this as a
   // matrix might seem unnecessary, we save time in the LogSumExp()
   // via more effective pruning.
-  loglikes->Resize(num_gselect, num_substates);
+  loglikes->Resize(num_gselect, num_substates, kUndefined);
   bool speaker_dep_weights =
       (spk_vars->v_s.Dim() != 0 && HasSpeakerDependentWeights());
   if (speaker_dep_weights) {
@@ -492,11 +558,12 @@ void AmSgmm2::ComponentLogLikes(const Sgmm2PerFrameDerivedVars &per_frame_vars,
     KALDI_ASSERT(static_cast<int32>(w_jmi_.size()) == NumGroups() ||
                  "You need to call ComputeWeights().");
   }
+  // for all Gaussians and substates, compute z_{i}^T v_{jm}, as one matrix
+  // multiplication.
+  loglikes->AddMatMat(1.0, per_frame_vars.zti, kNoTrans, v_[j1], kTrans, 0.0);
   for (int32 ki = 0;  ki < num_gselect; ki++) {
     SubVector<BaseFloat> logp_xi(*loglikes, ki);
     int32 i = gselect[ki];
-    // for all substates, compute z_{i}^T v_{jm}
-    logp_xi.AddMatVec(1.0, v_[j1], kNoTrans, per_frame_vars.zti.Row(ki), 0.0);
     logp_xi.AddVec(1.0, n_[j1].Row(i));  // for all substates, add n_{jim}
     logp_xi.Add(per_frame_vars.nti(ki));  // for all substates, add n_{i}(t)
   }
@@ -280,6 +280,18 @@ class AmSgmm2 {
                            const Sgmm2PerSpkDerivedVars &spk_vars,
                            Sgmm2PerFrameDerivedVars *per_frame_vars) const;
 
+  /// This version of ComputePerFrameVars() does a sequence of frames (e.g. an
+  /// utterance, or a block of one), with gselect[t] the Gaussian selection for
+  /// frame t.  It is faster than calling the one-frame version for each frame,
+  /// because for each Gaussian the quantities for all the frames that selected
+  /// it are computed with matrix multiplications.  per_frame_vars is resized
+  /// to data.NumRows(); its elements are reused, so it is best to keep it
+  /// between calls.
+  void ComputePerFrameVars(
+      const MatrixBase<BaseFloat> &data,
+      const std::vector<std::vector<int32> > &gselect,
+      const Sgmm2PerSpkDerivedVars &spk_vars,
+      std::vector<Sgmm2PerFrameDerivedVars> *per_frame_vars) const;
 
   /// Computes the per-speaker derived vars; assumes vars->v_s is already
   /// set up.
@@ -505,6 +517,8 @@ class AmSgmm2 {
   friend class MleSgmm2SpeakerAccs;
   friend class AmSgmm2Functions;  // misc functions that need access.
   friend class Sgmm2Feature;
+  friend void TestSgmm2AccsAdd(const AmSgmm2 &sgmm,
+                               const Matrix<BaseFloat> &feats);  // for testing.
 };
 
 template<typename Real>
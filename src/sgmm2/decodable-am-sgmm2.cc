@@ -18,6 +18,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 using std::vector;
 
@@ -25,6 +26,7 @@ using std::vector;
 
 namespace kaldi {
 
+const int32 DecodableAmSgmm2::kFrameBlockSize;
 
 DecodableAmSgmm2::~DecodableAmSgmm2() {
   if (delete_vars_) {
@@ -39,15 +41,24 @@ BaseFloat DecodableAmSgmm2::LogLikelihoodForPdf(int32 frame, int32 pdf_id) {
     cur_frame_ = frame;
     sgmm_cache_.NextFrame(); // it has a frame-index internally but it doesn't
     // have to match up with our index here, it just needs to be unique.
-
-
-    SubVector<BaseFloat> data(*feature_matrix_, frame);
-    
-    sgmm_.ComputePerFrameVars(data, (*gselect_)[frame], *spk_,
-                              &per_frame_vars_);
+    if (frame < block_start_ ||
+        frame >= block_start_ + static_cast<int32>(per_frame_vars_.size()))
+      ComputeFrameBlock(frame);
   }
-  return sgmm_.LogLikelihood(per_frame_vars_, pdf_id, &sgmm_cache_, spk_,
-                             log_prune_);  
+  return sgmm_.LogLikelihood(per_frame_vars_[frame - block_start_], pdf_id,
+                             &sgmm_cache_, spk_, log_prune_);
+}
+
+void DecodableAmSgmm2::ComputeFrameBlock(int32 frame) {
+  int32 num_frames = std::min(kFrameBlockSize, NumFramesReady() - frame);
+  KALDI_ASSERT(frame >= 0 && num_frames > 0);
+  SubMatrix<BaseFloat> data(*feature_matrix_, frame, num_frames,
+                            0, feature_matrix_->NumCols());
+  std::vector<std::vector<int32> > gselect(gselect_->begin() + frame,
+                                           gselect_->begin() + frame +
+                                           num_frames);
+  sgmm_.ComputePerFrameVars(data, gselect, *spk_, &per_frame_vars_);
+  block_start_ = frame;
 }
 
 
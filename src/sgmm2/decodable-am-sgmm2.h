@@ -41,7 +41,8 @@ class DecodableAmSgmm2 : public DecodableInterface {
       sgmm_(sgmm), spk_(spk),
       trans_model_(tm), feature_matrix_(&feats),
       gselect_(&gselect), log_prune_(log_prune), cur_frame_(-1),
-      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(false) {
+      block_start_(0), sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()),
+      delete_vars_(false) {
     KALDI_ASSERT(gselect.size() == static_cast<size_t>(feats.NumRows()));
   }
 
@@ -56,7 +57,8 @@ class DecodableAmSgmm2 : public DecodableInterface {
       sgmm_(sgmm), spk_(spk),
       trans_model_(tm), feature_matrix_(feats),
       gselect_(gselect), log_prune_(log_prune), cur_frame_(-1),
-      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(true) {
+      block_start_(0), sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()),
+      delete_vars_(true) {
     KALDI_ASSERT(gselect->size() == static_cast<size_t>(feats->NumRows()));
   }
 
@@ -77,6 +79,13 @@ class DecodableAmSgmm2 : public DecodableInterface {
  protected:
   virtual BaseFloat LogLikelihoodForPdf(int32 frame, int32 pdf_id);
 
+  /// The per-frame vars are computed for blocks of this many frames at a
+  /// time, which is faster than computing them frame by frame.
+  static const int32 kFrameBlockSize = 256;
+
+  /// Computes per_frame_vars_ for the block of frames starting at "frame".
+  void ComputeFrameBlock(int32 frame);
+
   const AmSgmm2 &sgmm_;
   Sgmm2PerSpkDerivedVars *spk_;
   const TransitionModel &trans_model_;  ///< for tid to pdf mapping
@@ -86,7 +95,8 @@ class DecodableAmSgmm2 : public DecodableInterface {
   BaseFloat log_prune_;
 
   int32 cur_frame_;
-  Sgmm2PerFrameDerivedVars per_frame_vars_;
+  int32 block_start_;  ///< The frame that per_frame_vars_[0] is for.
+  std::vector<Sgmm2PerFrameDerivedVars> per_frame_vars_;
   Sgmm2LikelihoodCache sgmm_cache_;
 
   bool delete_vars_; // If true, we will delete feature_matrix_, gselect_, and
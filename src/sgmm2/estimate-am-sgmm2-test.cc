@@ -123,6 +123,120 @@ void TestSgmm2AccsIO(const AmSgmm2 &sgmm,
   unlink("tmpfb");
 }
 
+namespace kaldi {
+
+// Tests that stats accumulated in two parts and merged with Add() give the same
+// update as stats accumulated in one go, with a speaker vector so that the
+// speaker-projection stats are tested too.  The substates are split first, and
+// the stats Y_, Z_ and y_, which are accumulated with the sums over substates
+// done first, are checked against eqs. (41), (42) and (44) evaluated for each
+// substate and Gaussian separately.
+void TestSgmm2AccsAdd(const AmSgmm2 &sgmm_in,
+                      const kaldi::Matrix<BaseFloat> &feats) {
+  AmSgmm2 sgmm;
+  sgmm.CopyFromSgmm2(sgmm_in, false, false);
+  {
+    Vector<BaseFloat> occs(sgmm.NumPdfs());
+    occs.Set(1000.0);
+    Sgmm2SplitSubstatesConfig split_config;
+    split_config.split_substates = RandInt(2, 4) * sgmm.NumPdfs();
+    sgmm.SplitSubstates(occs, split_config);
+    sgmm.ComputeDerivedVars();
+  }
+  KALDI_ASSERT(sgmm.NumSubstatesForGroup(0) > 1);
+
+  SgmmUpdateFlagsType flags = kSgmmAll & ~kSgmmSpeakerWeightProjections;
+  Sgmm2PerSpkDerivedVars spk_vars;
+  Vector<BaseFloat> v_s(sgmm.SpkSpaceDim());
+  v_s.SetRandn();
+  spk_vars.SetSpeakerVector(v_s);
+  sgmm.ComputePerSpkDerivedVars(&spk_vars);
+  Sgmm2GselectConfig sgmm_config;
+  sgmm_config.full_gmm_nbest = std::min(sgmm_config.full_gmm_nbest,
+                                        sgmm.NumGauss());
+  int32 num_frames = feats.NumRows();
+  std::vector<std::vector<int32> > gselect(num_frames);
+  for (int32 t = 0; t < num_frames; t++)
+    sgmm.GaussianSelection(sgmm_config, feats.Row(t), &(gselect[t]));
+  std::vector<Sgmm2PerFrameDerivedVars> per_frame_vars;
+  sgmm.ComputePerFrameVars(feats, gselect, spk_vars, &per_frame_vars);
+
+  // The reference stats, accumulated as in eqs. (41), (42) and (44).
+  int32 num_gauss = sgmm.NumGauss(),
+      num_substates = sgmm.NumSubstatesForGroup(0),
+      feature_dim = sgmm.FeatureDim(), phn_space_dim = sgmm.PhoneSpaceDim(),
+      spk_space_dim = sgmm.SpkSpaceDim();
+  std::vector<Matrix<double> > Y_ref(num_gauss), Z_ref(num_gauss);
+  for (int32 i = 0; i < num_gauss; i++) {
+    Y_ref[i].Resize(feature_dim, phn_space_dim);
+    Z_ref[i].Resize(feature_dim, spk_space_dim);
+  }
+  Matrix<double> y_ref(num_substates, phn_space_dim);
+  Vector<BaseFloat> mu_jmi(feature_dim), xt_jmi(feature_dim);
+
+  MleAmSgmm2Accs accs(sgmm, flags, true, 0.0), accs1(sgmm, flags, true, 0.0),
+      accs2(sgmm, flags, true, 0.0);
+  int32 split = RandInt(0, num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    const Sgmm2PerFrameDerivedVars &frame_vars = per_frame_vars[t];
+    Matrix<BaseFloat> posteriors;
+    sgmm.ComponentPosteriors(frame_vars, 0, &spk_vars, &posteriors);
+    accs.AccumulateFromPosteriors(sgmm, frame_vars, posteriors, 0, &spk_vars);
+    (t < split ? accs1 : accs2).Accumulate(sgmm, frame_vars, 0, 1.0,
+                                           &spk_vars);
+    for (int32 m = 0; m < num_substates; m++) {
+      for (size_t ki = 0; ki < frame_vars.gselect.size(); ki++) {
+        int32 i = frame_vars.gselect[ki];
+        BaseFloat gammat_jmi = posteriors(ki, m);
+        if (gammat_jmi == 0.0) continue;
+        y_ref.Row(m).AddVec(gammat_jmi, frame_vars.zti.Row(ki));
+        Y_ref[i].AddVecVec(gammat_jmi, frame_vars.xti.Row(ki),
+                           sgmm.v_[0].Row(m));
+        sgmm.GetSubstateMean(0, m, i, &mu_jmi);
+        xt_jmi.CopyFromVec(frame_vars.xt);
+        xt_jmi.AddVec(-1.0, mu_jmi);
+        Z_ref[i].AddVecVec(gammat_jmi, xt_jmi, v_s);
+      }
+    }
+  }
+  for (int32 i = 0; i < num_gauss; i++) {
+    AssertEqual(accs.Y_[i], Y_ref[i], 1.0e-03);
+    AssertEqual(accs.Z_[i], Z_ref[i], 1.0e-03);
+  }
+  AssertEqual(accs.y_[0], y_ref, 1.0e-03);
+
+  accs.CommitStatsForSpk(sgmm, spk_vars);
+  accs1.CommitStatsForSpk(sgmm, spk_vars);
+  accs2.CommitStatsForSpk(sgmm, spk_vars);
+  accs1.Add(1.0, accs2);
+
+  Vector<BaseFloat> occs, occs1;
+  accs.GetStateOccupancies(&occs);
+  accs1.GetStateOccupancies(&occs1);
+  AssertEqual(occs, occs1, 1.0e-05);
+
+  MleAmSgmm2Options update_opts;
+  MleAmSgmm2Updater updater(update_opts);
+  AmSgmm2 sgmm_a, sgmm_b;
+  sgmm_a.CopyFromSgmm2(sgmm, false, false);
+  sgmm_b.CopyFromSgmm2(sgmm, false, false);
+  updater.Update(accs, &sgmm_a, flags);
+  updater.Update(accs1, &sgmm_b, flags);
+  sgmm_a.ComputeDerivedVars();
+  sgmm_b.ComputeDerivedVars();
+  Sgmm2PerFrameDerivedVars frame_vars;
+  Sgmm2PerSpkDerivedVars empty;
+  Sgmm2LikelihoodCache cache_a(sgmm.NumGroups(), sgmm.NumPdfs()),
+      cache_b(sgmm.NumGroups(), sgmm.NumPdfs());
+  sgmm_a.ComputePerFrameVars(feats.Row(0), gselect[0], empty, &frame_vars);
+  BaseFloat loglike_a = sgmm_a.LogLikelihood(frame_vars, 0, &cache_a, &empty);
+  sgmm_b.ComputePerFrameVars(feats.Row(0), gselect[0], empty, &frame_vars);
+  BaseFloat loglike_b = sgmm_b.LogLikelihood(frame_vars, 0, &cache_b, &empty);
+  AssertEqual(loglike_a, loglike_b, 1.0e-03);
+}
+
+}  // namespace kaldi
+
 void UnitTestEstimateSgmm2() {
   int32 dim = 1 + kaldi::RandInt(0, 9);  // random dimension of the gmm
   int32 num_comp = 2 + kaldi::RandInt(0, 9);  // random mixture size
@@ -157,6 +271,7 @@ void UnitTestEstimateSgmm2() {
   }
   sgmm.ComputeDerivedVars();
   TestSgmm2AccsIO(sgmm, feats);
+  kaldi::TestSgmm2AccsAdd(sgmm, feats);
 }
 
 int main() {
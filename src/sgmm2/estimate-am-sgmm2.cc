@@ -492,24 +492,26 @@ BaseFloat MleAmSgmm2Accs::AccumulateFromPosteriors(
     Sgmm2PerSpkDerivedVars *spk_vars) {
   double tot_count = 0.0;
   const vector<int32> &gselect = frame_vars.gselect;
-  // Intermediate variables
-  Vector<BaseFloat> gammat(gselect.size()), // sum of gammas over mix-weight.
-      a_is_part(gselect.size()); //
-  Vector<BaseFloat> xt_jmi(feature_dim_), mu_jmi(feature_dim_),
-      zt_jmi(spk_space_dim_);
-
+  int32 num_gselect = gselect.size();
   int32 j1 = model.Pdf2Group(j2);
   int32 num_substates = model.NumSubstatesForGroup(j1);
 
+  // Intermediate variables
+  Vector<BaseFloat> gammat(num_gselect), // sum of gammas over mix-weight.
+      gammat_m(num_substates); // sum of gammas over Gaussians.
+  // The pruned posteriors gamma_{jmi}(t), indexed [ki][m].
+  Matrix<BaseFloat> gammat_mi(num_gselect, num_substates);
+
   for (int32 m = 0; m < num_substates; m++) {
     BaseFloat d_jms = model.GetDjms(j1, m, spk_vars);
     BaseFloat gammat_jm = 0.0;
-    for (int32 ki = 0; ki < static_cast<int32>(gselect.size()); ki++) {
+    for (int32 ki = 0; ki < num_gselect; ki++) {
       int32 i = gselect[ki];
 
       // Eq. (39): gamma_{jmi}(t) = p (j, m, i|t)
       BaseFloat gammat_jmi = RandPrune(posteriors(ki, m), rand_prune_);
       if (gammat_jmi == 0.0) continue;
+      gammat_mi(ki, m) = gammat_jmi;
       gammat(ki) += gammat_jmi;
       if (gamma_s_.Dim() != 0)
         gamma_s_(i) += gammat_jmi;
@@ -521,30 +523,8 @@ BaseFloat MleAmSgmm2Accs::AccumulateFromPosteriors(
         // Eq. (40): gamma_{jmi} = \sum_t gamma_{jmi}(t)
         gamma_[j1](m, i) += gammat_jmi;
       }
-      if (!y_.empty()) {
-        // Eq. (41): y_{jm} = \sum_{t, i} \gamma_{jmi}(t) z_{i}(t)
-        // Suggestion:  move this out of the loop over m
-        y_[j1].Row(m).AddVec(gammat_jmi, frame_vars.zti.Row(ki));
-      }
-      if (!Y_.empty()) {
-        // Eq. (42): Y_{i} = \sum_{t, j, m} \gamma_{jmi}(t) x_{i}(t) v_{jm}^T
-        Y_[i].AddVecVec(gammat_jmi, frame_vars.xti.Row(ki),
-                        model.v_[j1].Row(m));
-      }
-      // Accumulate for speaker projections
-      if (!Z_.empty()) {
-        KALDI_ASSERT(spk_space_dim_ > 0);
-        // Eq. (43): x_{jmi}(t) = x_k(t) - M{i} v_{jm}
-        model.GetSubstateMean(j1, m, i, &mu_jmi);
-        xt_jmi.CopyFromVec(frame_vars.xt);
-        xt_jmi.AddVec(-1.0, mu_jmi);
-        // Eq. (44): Z_{i} = \sum_{t, j, m} \gamma_{jmi}(t) x_{jmi}(t) v^{s}'
-        if (spk_vars->v_s.Dim() != 0)  // interpret empty v_s as zero.
-          Z_[i].AddVecVec(gammat_jmi, xt_jmi, spk_vars->v_s);
-        // Eq. (49): \gamma_{i}^{(s)} = \sum_{t\in\Tau(s), j, m} gamma_{jmi}
-        // Will be used when you call CommitStatsForSpk(), to update R_.
-      }
     } // loop over selected Gaussians
+    gammat_m(m) = gammat_jm;
     if (gammat_jm != 0.0) {
       if (!a_.empty()) { // SSGMM code.
         KALDI_ASSERT(d_jms > 0);
@@ -564,8 +544,48 @@ BaseFloat MleAmSgmm2Accs::AccumulateFromPosteriors(
     }
   } // loop over substates
 
+  if (!y_.empty()) {
+    // Eq. (41): y_{jm} = \sum_{t, i} \gamma_{jmi}(t) z_{i}(t); we do the sum
+    // over i for all the substates at once.
+    Matrix<BaseFloat> y_jm(num_substates, phn_space_dim_);
+    y_jm.AddMatMat(1.0, gammat_mi, kTrans, frame_vars.zti, kNoTrans, 0.0);
+    for (int32 m = 0; m < num_substates; m++)
+      if (gammat_m(m) != 0.0)
+        y_[j1].Row(m).AddVec(1.0, y_jm.Row(m));
+  }
+  if (!Y_.empty() || !Z_.empty()) {
+    // Row ki of v_bar is \sum_m \gamma_{jmi}(t) v_{jm}, for i = gselect[ki]; it
+    // lets us do the sums over m in eqs. (42) and (44) before the outer
+    // products.
+    Matrix<BaseFloat> v_bar(num_gselect, phn_space_dim_);
+    v_bar.AddMatMat(1.0, gammat_mi, kNoTrans, model.v_[j1], kNoTrans, 0.0);
+    Vector<BaseFloat> xt_ji(feature_dim_);
+    for (int32 ki = 0; ki < num_gselect; ki++) {
+      if (gammat(ki) == 0.0) continue;
+      int32 i = gselect[ki];
+      if (!Y_.empty()) {
+        // Eq. (42): Y_{i} = \sum_{t, j, m} \gamma_{jmi}(t) x_{i}(t) v_{jm}^T
+        Y_[i].AddVecVec(1.0, frame_vars.xti.Row(ki), v_bar.Row(ki));
+      }
+      // Accumulate for speaker projections
+      if (!Z_.empty() && spk_vars->v_s.Dim() != 0) {  // interpret empty v_s
+                                                       // as zero.
+        KALDI_ASSERT(spk_space_dim_ > 0);
+        // Eq. (43): x_{jmi}(t) = x_k(t) - M{i} v_{jm}; summed over m with
+        // weights \gamma_{jmi}(t), this is
+        // \gamma_{ji}(t) x_k(t) - M_{i} \sum_m \gamma_{jmi}(t) v_{jm}.
+        xt_ji.CopyFromVec(frame_vars.xt);
+        xt_ji.AddMatVec(-1.0, model.M_[i], kNoTrans, v_bar.Row(ki), gammat(ki));
+        // Eq. (44): Z_{i} = \sum_{t, j, m} \gamma_{jmi}(t) x_{jmi}(t) v^{s}'
+        Z_[i].AddVecVec(1.0, xt_ji, spk_vars->v_s);
+        // Eq. (49): \gamma_{i}^{(s)} = \sum_{t\in\Tau(s), j, m} gamma_{jmi}
+        // Will be used when you call CommitStatsForSpk(), to update R_.
+      }
+    }
+  }
+
   if (!S_.empty()) {
-    for (int32 ki = 0; ki < static_cast<int32>(gselect.size()); ki++) {
+    for (int32 ki = 0; ki < num_gselect; ki++) {
       // Eq. (47): S_{i} = \sum_{t, j, m} \gamma_{jmi}(t) x_{i}(t) x_{i}(t)^T
       if (gammat(ki) != 0.0) {
         int32 i = gselect[ki];
@@ -601,6 +621,48 @@ void MleAmSgmm2Accs::CommitStatsForSpk(const AmSgmm2 &model,
   a_s_.SetZero();
 }
 
+void MleAmSgmm2Accs::Add(double scale, const MleAmSgmm2Accs &other) {
+  KALDI_ASSERT(num_pdfs_ == other.num_pdfs_ &&
+               num_groups_ == other.num_groups_ &&
+               num_gaussians_ == other.num_gaussians_ &&
+               feature_dim_ == other.feature_dim_ &&
+               phn_space_dim_ == other.phn_space_dim_ &&
+               spk_space_dim_ == other.spk_space_dim_);
+  KALDI_ASSERT(Y_.size() == other.Y_.size() && Z_.size() == other.Z_.size() &&
+               R_.size() == other.R_.size() && S_.size() == other.S_.size() &&
+               y_.size() == other.y_.size() &&
+               gamma_.size() == other.gamma_.size() &&
+               a_.size() == other.a_.size() && U_.size() == other.U_.size() &&
+               gamma_c_.size() == other.gamma_c_.size() &&
+               "Adding accumulators that were set up with different flags.");
+  for (size_t i = 0; i < Y_.size(); i++)
+    Y_[i].AddMat(scale, other.Y_[i]);
+  for (size_t i = 0; i < Z_.size(); i++)
+    Z_[i].AddMat(scale, other.Z_[i]);
+  for (size_t i = 0; i < R_.size(); i++)
+    R_[i].AddSp(scale, other.R_[i]);
+  for (size_t i = 0; i < S_.size(); i++)
+    S_[i].AddSp(scale, other.S_[i]);
+  for (size_t j1 = 0; j1 < y_.size(); j1++)
+    y_[j1].AddMat(scale, other.y_[j1]);
+  for (size_t j1 = 0; j1 < gamma_.size(); j1++)
+    gamma_[j1].AddMat(scale, other.gamma_[j1]);
+  for (size_t j1 = 0; j1 < a_.size(); j1++)
+    a_[j1].AddMat(scale, other.a_[j1]);
+  if (t_.NumRows() != 0)
+    t_.AddMat(scale, other.t_);
+  for (size_t i = 0; i < U_.size(); i++)
+    U_[i].AddSp(scale, other.U_[i]);
+  for (size_t j2 = 0; j2 < gamma_c_.size(); j2++)
+    gamma_c_[j2].AddVec(scale, other.gamma_c_[j2]);
+  if (gamma_s_.Dim() != 0)
+    gamma_s_.AddVec(scale, other.gamma_s_);
+  if (a_s_.Dim() != 0)
+    a_s_.AddVec(scale, other.a_s_);
+  total_frames_ += scale * other.total_frames_;
+  total_like_ += scale * other.total_like_;
+}
+
 void MleAmSgmm2Accs::GetStateOccupancies(Vector<BaseFloat> *occs) const {
   int32 J2 = gamma_c_.size();
   occs->Resize(J2);
@@ -168,6 +168,16 @@ class MleAmSgmm2Accs {
   void CommitStatsForSpk(const AmSgmm2 &model,
                          const Sgmm2PerSpkDerivedVars &spk_vars);
 
+  /// Adds the stats in "other", times "scale", to these stats; they must have
+  /// been set up for the same model and flags.  This is for merging the stats
+  /// accumulated by different threads.  Because the stats that
+  /// CommitStatsForSpk() adds are linear in the per-speaker stats, the
+  /// threads may accumulate parts of a speaker's data, as long as each one
+  /// calls CommitStatsForSpk() for its part.
+  void Add(double scale, const MleAmSgmm2Accs &other);
+
+  void SetRandPrune(BaseFloat rand_prune) { rand_prune_ = rand_prune; }
+
   /// Accessors
   void GetStateOccupancies(Vector<BaseFloat> *occs) const;
   int32 FeatureDim() const { return feature_dim_; }
@@ -238,6 +248,8 @@ class MleAmSgmm2Accs {
   KALDI_DISALLOW_COPY_AND_ASSIGN(MleAmSgmm2Accs);
   friend class MleAmSgmm2Updater;
   friend class EbwAmSgmm2Updater;
+  friend void TestSgmm2AccsAdd(const AmSgmm2 &sgmm,
+                               const Matrix<BaseFloat> &feats);  // for testing.
 };
 
 /** \class MleAmSgmmUpdater
@@ -22,11 +22,107 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "sgmm2/am-sgmm2.h"
 #include "hmm/transition-model.h"
 #include "sgmm2/estimate-am-sgmm2.h"
 #include "hmm/posterior.h"
 
+namespace kaldi {
+
+// The stats accumulated by one thread.
+struct Sgmm2AccStatsAccs {
+  Vector<double> transition_accs;
+  MleAmSgmm2Accs sgmm_accs;
+  double tot_like;
+  double tot_t;
+  // Kept here so that its storage is reused from one utterance to the next.
+  std::vector<Sgmm2PerFrameDerivedVars> per_frame_vars;
+  Sgmm2AccStatsAccs(): tot_like(0.0), tot_t(0.0) { }
+};
+
+// Accumulates the stats for one utterance, into whichever accumulator of
+// the pool is free.
+class Sgmm2AccStatsTask {
+ public:
+  Sgmm2AccStatsTask(const TransitionModel &trans_model,
+                    const AmSgmm2 &am_sgmm,
+                    const std::string &utt,
+                    const Matrix<BaseFloat> &features,
+                    const Posterior &posterior,
+                    const std::vector<std::vector<int32> > &gselect,
+                    const Sgmm2PerSpkDerivedVars &spk_vars,
+                    AccumulatorPool<Sgmm2AccStatsAccs> *pool,
+                    int32 *num_done):
+      trans_model_(trans_model), am_sgmm_(am_sgmm), utt_(utt),
+      features_(features), posterior_(posterior), gselect_(gselect),
+      spk_vars_(spk_vars), pool_(pool), num_done_(num_done),
+      tot_like_this_file_(0.0), tot_weight_(0.0) { }
+
+  void operator () () {
+    Sgmm2AccStatsAccs *accs = pool_->Acquire();
+    std::vector<Sgmm2PerFrameDerivedVars> &per_frame_vars =
+        accs->per_frame_vars;
+    am_sgmm_.ComputePerFrameVars(features_, gselect_, spk_vars_,
+                                 &per_frame_vars);
+    Posterior pdf_posterior;
+    ConvertPosteriorToPdfs(trans_model_, posterior_, &pdf_posterior);
+    for (size_t i = 0; i < posterior_.size(); i++) {
+      // Accumulates for SGMM.
+      for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
+        int32 pdf_id = pdf_posterior[i][j].first;
+        BaseFloat weight = pdf_posterior[i][j].second;
+        tot_like_this_file_ += accs->sgmm_accs.Accumulate(
+            am_sgmm_, per_frame_vars[i], pdf_id, weight, &spk_vars_) * weight;
+        tot_weight_ += weight;
+      }
+
+      // Accumulates for transitions.
+      for (size_t j = 0; j < posterior_[i].size(); j++) {
+        int32 tid = posterior_[i][j].first;
+        BaseFloat weight = posterior_[i][j].second;
+        trans_model_.Accumulate(weight, tid, &(accs->transition_accs));
+      }
+    }
+    // The stats that CommitStatsForSpk() adds are linear in the per-speaker
+    // stats, so committing them after each utterance is the same as doing so
+    // after each speaker, and lets the threads share a speaker's utterances.
+    accs->sgmm_accs.CommitStatsForSpk(am_sgmm_, spk_vars_);
+    accs->tot_like += tot_like_this_file_;
+    accs->tot_t += tot_weight_;
+    pool_->Release(accs);
+  }
+
+  ~Sgmm2AccStatsTask() {
+    (*num_done_)++;
+    KALDI_VLOG(2) << "Average like for this file is "
+                  << (tot_like_this_file_/tot_weight_) << " over "
+                  << tot_weight_ <<" frames.";
+    if (*num_done_ % 50 == 0) {
+      KALDI_LOG << "Processed " << *num_done_ << " utterances; for utterance "
+                << utt_ << " avg. like is "
+                << (tot_like_this_file_/tot_weight_)
+                << " over " << tot_weight_ <<" frames.";
+    }
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+  const AmSgmm2 &am_sgmm_;
+  std::string utt_;
+  Matrix<BaseFloat> features_;
+  Posterior posterior_;
+  std::vector<std::vector<int32> > gselect_;
+  // A copy, because the likelihood computation caches quantities in it.
+  Sgmm2PerSpkDerivedVars spk_vars_;
+  AccumulatorPool<Sgmm2AccStatsAccs> *pool_;
+  int32 *num_done_;
+  double tot_like_this_file_;
+  double tot_weight_;
+};
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   try {
@@ -35,13 +131,16 @@ int main(int argc, char *argv[]) {
         "Usage: sgmm2-acc-stats [options] <model-in> <feature-rspecifier> "
         "<posteriors-rspecifier> <stats-out>\n"
         "e.g.: sgmm2-acc-stats --gselect=ark:gselect.ark 1.mdl 1.ali scp:train.scp 'ark:ali-to-post 1.ali ark:-|' 1.acc\n"
-        "(note: gselect option is mandatory)\n";
-        
+        "(note: gselect option is mandatory)\n"
+        "With --num-threads=N, the utterances are processed by N threads,\n"
+        "each with its own accumulators, which are summed at the end.\n";
+
     ParseOptions po(usage);
     bool binary = true;
     std::string gselect_rspecifier, spkvecs_rspecifier, utt2spk_rspecifier;
     std::string update_flags_str = "vMNwcSt";
     BaseFloat rand_prune = 1.0e-05;
+    TaskSequencerConfig sequencer_config;
 
     po.Register("binary", &binary, "Write output in binary mode");
     po.Register("gselect", &gselect_rspecifier, "Precomputed Gaussian indices (rspecifier)");
@@ -51,6 +150,7 @@ int main(int argc, char *argv[]) {
     po.Register("rand-prune", &rand_prune, "Pruning threshold for posteriors");
     po.Register("update-flags", &update_flags_str, "Which SGMM parameters to accumulate "
                 "stats for: subset of vMNwcS.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -72,8 +172,7 @@ int main(int argc, char *argv[]) {
     typedef kaldi::int32 int32;
 
     int32 num_done = 0, num_err = 0;
-    Vector<double> transition_accs;
-    MleAmSgmm2Accs sgmm_accs(rand_prune);
+    AccumulatorPool<Sgmm2AccStatsAccs> pool(sequencer_config);
 
     { // this anonymous scope is to ensure deallocation of unnecessary stuff
       // while we're writing out the accs, which could be a long time for large
@@ -98,17 +197,18 @@ int main(int argc, char *argv[]) {
         am_sgmm.Read(ki.Stream(), binary);
       }
 
+      for (int32 i = 0; i < pool.NumAccums(); i++) {
+        Sgmm2AccStatsAccs &accs = pool.Accum(i);
+        trans_model.InitStats(&(accs.transition_accs));
+        accs.sgmm_accs.SetRandPrune(rand_prune);
+        accs.sgmm_accs.ResizeAccumulators(am_sgmm, acc_flags,
+                                          (spkvecs_rspecifier!=""));
+      }
 
-      trans_model.InitStats(&transition_accs);
-      sgmm_accs.ResizeAccumulators(am_sgmm, acc_flags, (spkvecs_rspecifier!=""));
-
-      double tot_like = 0.0;
-      double tot_t = 0;
-
-      kaldi::Sgmm2PerFrameDerivedVars per_frame_vars;
       std::string cur_spk;
       Sgmm2PerSpkDerivedVars spk_vars;
-              
+
+      TaskSequencer<Sgmm2AccStatsTask> sequencer(sequencer_config);
       for (; !feature_reader.Done(); feature_reader.Next()) {
         std::string utt = feature_reader.Key();
         std::string spk = utt;
@@ -120,9 +220,6 @@ int main(int argc, char *argv[]) {
           } else { spk = utt2spk_map.Value(utt); }
         }
 
-        if (spk != cur_spk && cur_spk != "")
-          sgmm_accs.CommitStatsForSpk(am_sgmm, spk_vars);        
-        
         if (spk != cur_spk || spk_vars.Empty()) {
           spk_vars.Clear();
           if (spkvecs_reader.IsOpen()) {
@@ -149,68 +246,43 @@ int main(int argc, char *argv[]) {
         }
         const Posterior &posterior = posteriors_reader.Value(utt);
       
-        if (!gselect_reader.HasKey(utt)
-            && gselect_reader.Value(utt).size() != features.NumRows()) {
+        if (!gselect_reader.HasKey(utt) ||
+            gselect_reader.Value(utt).size() != features.NumRows()) {
           KALDI_WARN << "No Gaussian-selection info available for utterance "
                      << utt << " (or wrong size)";
           num_err++;
+          continue;
         }
         const std::vector<std::vector<int32> > &gselect =
             gselect_reader.Value(utt);
 
-        num_done++;
-      
-        BaseFloat tot_like_this_file = 0.0, tot_weight = 0.0;
-
-        Posterior pdf_posterior;
-        ConvertPosteriorToPdfs(trans_model, posterior, &pdf_posterior);
-        for (size_t i = 0; i < posterior.size(); i++) {
-          am_sgmm.ComputePerFrameVars(features.Row(i), gselect[i], spk_vars,
-                                      &per_frame_vars);
-          // Accumulates for SGMM.
-          for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
-            int32 pdf_id = pdf_posterior[i][j].first;
-            BaseFloat weight = pdf_posterior[i][j].second;
-            tot_like_this_file += sgmm_accs.Accumulate(am_sgmm, per_frame_vars,
-                                                       pdf_id, weight, &spk_vars)
-                * weight;
-            tot_weight += weight;
-          }
-
-          // Accumulates for transitions.
-          for (size_t j = 0; j < posterior[i].size(); j++) {
-            int32 tid = posterior[i][j].first;
-            BaseFloat weight = posterior[i][j].second;
-            trans_model.Accumulate(weight, tid, &transition_accs);
-          }
-        }
-        
-        KALDI_VLOG(2) << "Average like for this file is "
-                      << (tot_like_this_file/tot_weight) << " over "
-                      << tot_weight <<" frames.";
-        tot_like += tot_like_this_file;
-        tot_t += tot_weight;
-        if (num_done % 50 == 0) {
-          KALDI_LOG << "Processed " << num_done << " utterances; for utterance "
-                    << utt << " avg. like is "
-                    << (tot_like_this_file/tot_weight)
-                    << " over " << tot_weight <<" frames.";
-        }
+        sequencer.Run(new Sgmm2AccStatsTask(trans_model, am_sgmm, utt,
+                                            features, posterior, gselect,
+                                            spk_vars, &pool, &num_done));
       }
-      sgmm_accs.CommitStatsForSpk(am_sgmm, spk_vars); // commit stats for
-      // last speaker.
-      
-      KALDI_LOG << "Overall like per frame (Gaussian only) = "
-                << (tot_like/tot_t) << " over " << tot_t << " frames.";
+      sequencer.Wait();
+    }
+
+    // Sum the accumulators of the different threads into the first one.
+    Sgmm2AccStatsAccs &accs = pool.Accum(0);
+    for (int32 i = 1; i < pool.NumAccums(); i++) {
+      accs.transition_accs.AddVec(1.0, pool.Accum(i).transition_accs);
+      accs.sgmm_accs.Add(1.0, pool.Accum(i).sgmm_accs);
+      accs.tot_like += pool.Accum(i).tot_like;
+      accs.tot_t += pool.Accum(i).tot_t;
+    }
+
+    KALDI_LOG << "Overall like per frame (Gaussian only) = "
+              << (accs.tot_like/accs.tot_t) << " over " << accs.tot_t
+              << " frames.";
 
-      KALDI_LOG << "Done " << num_done << " files, " << num_err
-                << " with errors.";
-    } 
+    KALDI_LOG << "Done " << num_done << " files, " << num_err
+              << " with errors.";
 
     {
       Output ko(accs_wxfilename, binary);
-      transition_accs.Write(ko.Stream(), binary);
-      sgmm_accs.Write(ko.Stream(), binary);
+      accs.transition_accs.Write(ko.Stream(), binary);
+      accs.sgmm_accs.Write(ko.Stream(), binary);
     }
     KALDI_LOG << "Written accs.";
     return (num_done != 0 ? 0 : 1);
@@ -219,5 +291,3 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 }
-
-
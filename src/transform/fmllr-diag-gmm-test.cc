@@ -222,6 +222,73 @@ void UnitTestFmllrDiagGmmOffset() {
   // mean that something is wrong.
 }
 
+// Checks that the stats accumulated for sequences of frames are the same as
+// those accumulated one frame at a time.
+void UnitTestFmllrDiagGmmBatch() {
+  using namespace kaldi;
+  DiagGmm gmm;
+  InitRandomGmm(&gmm);
+  int32 dim = gmm.Dim(), num_gauss = gmm.NumGauss(),
+      num_pdfs = 1 + Rand() % 4, num_frames = 1 + Rand() % 600;
+  AmDiagGmm am_gmm;
+  for (int32 p = 0; p < num_pdfs; p++) {
+    DiagGmm this_gmm(gmm);
+    Matrix<BaseFloat> means(num_gauss, dim);
+    this_gmm.GetMeans(&means);
+    means.Add(0.5 * p);
+    this_gmm.SetMeans(means);
+    this_gmm.ComputeGconsts();
+    am_gmm.AddPdf(this_gmm);
+  }
+  Matrix<BaseFloat> feats(num_frames, dim);
+  std::vector<std::vector<std::pair<int32, BaseFloat> > > pdf_post(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> row(feats, t);
+    if (t > 0 && Rand() % 5 == 0)
+      row.CopyFromVec(feats.Row(t - 1));  // repeated frames are merged.
+    else
+      gmm.Generate(&row);
+    int32 num_post = Rand() % 3;  // some frames have no posteriors.
+    for (int32 j = 0; j < num_post; j++)
+      pdf_post[t].push_back(std::make_pair(Rand() % num_pdfs,
+                                           RandUniform()));
+  }
+
+  FmllrOptions opts;
+  if (Rand() % 2 == 0)
+    opts.update_type = "diag";
+  FmllrDiagGmmAccs stats_ref(dim, opts), stats(dim, opts);
+  double like_ref = 0.0;
+  for (int32 t = 0; t < num_frames; t++)
+    for (size_t j = 0; j < pdf_post[t].size(); j++)
+      like_ref += pdf_post[t][j].second *
+          stats_ref.AccumulateForGmm(am_gmm.GetPdf(pdf_post[t][j].first),
+                                     feats.Row(t), pdf_post[t][j].second);
+  double like = stats.AccumulateForFrames(am_gmm, feats, pdf_post);
+  KALDI_ASSERT(ApproxEqual(like, like_ref, 1.0e-04));
+
+  // The same with posteriors supplied for a single GMM; negative posteriors
+  // exercise the general case of the "full" update.
+  Matrix<BaseFloat> post(num_frames, num_gauss);
+  post.SetRandn();
+  stats.AccumulateFromPosteriors(gmm, feats, post);
+  for (int32 t = 0; t < num_frames; t++)
+    stats_ref.AccumulateFromPosteriors(gmm, feats.Row(t), post.Row(t));
+
+  // Update() commits any pending stats.
+  Matrix<BaseFloat> xform_ref(dim, dim + 1), xform(dim, dim + 1);
+  xform_ref.SetUnit();
+  xform.SetUnit();
+  BaseFloat objf_impr_ref, count_ref, objf_impr, count;
+  stats_ref.Update(opts, &xform_ref, &objf_impr_ref, &count_ref);
+  stats.Update(opts, &xform, &objf_impr, &count);
+  KALDI_ASSERT(ApproxEqual(stats.beta_, stats_ref.beta_) &&
+               stats.K_.ApproxEqual(stats_ref.K_, 1.0e-04));
+  for (int32 i = 0; i < dim; i++)
+    KALDI_ASSERT(stats.G_[i].ApproxEqual(stats_ref.G_[i], 1.0e-04));
+  KALDI_ASSERT(ApproxEqual(count, count_ref));
+}
+
 }  // namespace kaldi ends here
 
 int main() {
@@ -229,6 +296,7 @@ int main() {
     kaldi::UnitTestFmllrDiagGmmOffset();
     kaldi::UnitTestFmllrDiagGmmDiagonal();
     kaldi::UnitTestFmllrDiagGmm();
+    kaldi::UnitTestFmllrDiagGmmBatch();
   }
   std::cout << "Test OK.\n";
 }
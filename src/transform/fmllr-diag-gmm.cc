@@ -19,6 +19,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 using std::vector;
@@ -126,6 +127,81 @@ BaseFloat FmllrDiagGmmAccs::AccumulateForGmmPreselect(
   return loglike;
 }
 
+const int32 FmllrDiagGmmAccs::kFrameBlockSize;
+
+void FmllrDiagGmmAccs::AccumulateFromPosteriors(
+    const DiagGmm &pdf,
+    const MatrixBase<BaseFloat> &data,
+    const MatrixBase<BaseFloat> &posteriors) {
+  int32 num_frames = data.NumRows(), dim = Dim(),
+      num_gauss = pdf.NumGauss();
+  KALDI_ASSERT(posteriors.NumRows() == num_frames);
+  CommitSingleFrameStats();
+  if (num_frames == 0) return;
+  KALDI_ASSERT(data.NumCols() == dim && posteriors.NumCols() == num_gauss);
+  for (int32 start = 0; start < num_frames; start += kFrameBlockSize) {
+    int32 this_num_frames = std::min(kFrameBlockSize, num_frames - start);
+    SubMatrix<BaseFloat> this_data(data, start, this_num_frames, 0, dim),
+        this_post(posteriors, start, this_num_frames, 0, num_gauss);
+    Matrix<BaseFloat> a(this_num_frames, dim, kUndefined),
+        b(this_num_frames, dim, kUndefined);
+    a.AddMatMat(1.0, this_post, kNoTrans, pdf.means_invvars(), kNoTrans, 0.0);
+    b.AddMatMat(1.0, this_post, kNoTrans, pdf.inv_vars(), kNoTrans, 0.0);
+    Vector<BaseFloat> counts(this_num_frames);
+    counts.AddColSumMat(1.0, this_post, 0.0);
+    CommitFrameBlock(this_data, a, b, counts);
+  }
+}
+
+BaseFloat FmllrDiagGmmAccs::AccumulateForFrames(
+    const AmDiagGmm &am_gmm,
+    const MatrixBase<BaseFloat> &data,
+    const std::vector<std::vector<std::pair<int32, BaseFloat> > > &pdf_post) {
+  int32 num_frames = data.NumRows(), dim = Dim();
+  KALDI_ASSERT(static_cast<int32>(pdf_post.size()) == num_frames);
+  CommitSingleFrameStats();
+  if (num_frames == 0) return 0.0;
+  KALDI_ASSERT(data.NumCols() == dim);
+
+  // The per-frame terms a and b are accumulated as in
+  // AccumulateFromPosteriors(), but into rows of a matrix; frames with zero
+  // count are skipped, as in CommitSingleFrameStats().
+  int32 block_size = std::min(num_frames, kFrameBlockSize), n = 0;
+  Matrix<BaseFloat> x(block_size, dim), a(block_size, dim), b(block_size, dim);
+  Vector<BaseFloat> counts(block_size), posterior;
+  double tot_like = 0.0;
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> this_a(a, n), this_b(b, n);
+    double count = 0.0;
+    for (size_t j = 0; j < pdf_post[t].size(); j++) {
+      const DiagGmm &pdf = am_gmm.GetPdf(pdf_post[t][j].first);
+      BaseFloat weight = pdf_post[t][j].second;
+      tot_like += weight * pdf.ComponentPosteriors(data.Row(t), &posterior);
+      posterior.Scale(weight);
+      count += posterior.Sum();
+      this_a.AddMatVec(1.0, pdf.means_invvars(), kTrans, posterior, 1.0);
+      this_b.AddMatVec(1.0, pdf.inv_vars(), kTrans, posterior, 1.0);
+    }
+    if (count == 0.0) {
+      this_a.SetZero();
+      this_b.SetZero();
+      continue;
+    }
+    x.Row(n).CopyFromVec(data.Row(t));
+    counts(n) = count;
+    if (++n == block_size) {
+      CommitFrameBlock(x, a, b, counts);
+      a.SetZero();
+      b.SetZero();
+      n = 0;
+    }
+  }
+  if (n > 0)
+    CommitFrameBlock(x.RowRange(0, n), a.RowRange(0, n), b.RowRange(0, n),
+                     counts.Range(0, n));
+  return tot_like;
+}
+
 
 
 void FmllrDiagGmmAccs::Update(const FmllrOptions &opts,
@@ -594,6 +670,58 @@ void FmllrDiagGmmAccs::CommitSingleFrameStats() {
   stats.a.SetZero();
   stats.b.SetZero();
 }
+
+void FmllrDiagGmmAccs::CommitFrameBlock(const MatrixBase<BaseFloat> &data,
+                                        const MatrixBase<BaseFloat> &a,
+                                        const MatrixBase<BaseFloat> &b,
+                                        const VectorBase<BaseFloat> &counts) {
+  int32 dim = Dim(), num_frames = data.NumRows();
+  KALDI_ASSERT(data.NumCols() == dim && a.NumRows() == num_frames &&
+               a.NumCols() == dim && b.NumRows() == num_frames &&
+               b.NumCols() == dim && counts.Dim() == num_frames);
+  KALDI_ASSERT(static_cast<size_t>(dim) == this->G_.size());
+
+  Matrix<double> xplus(num_frames, dim + 1, kUndefined);
+  xplus.Range(0, num_frames, 0, dim).CopyFromMat(data);
+  xplus.Range(0, num_frames, dim, 1).Set(1.0);
+
+  this->beta_ += counts.Sum();
+  this->K_.AddMatMat(1.0, Matrix<double>(a), kTrans, xplus, kNoTrans, 1.0);
+
+  Matrix<double> b_dbl(b);
+  if (opts_.update_type == "full") {
+    // G_i += \sum_t b_t(i) x_t^+ x_t^+^T is done for all i as one
+    // matrix-matrix product, of b^T with the matrix whose row t is
+    // x_t^+ x_t^+^T in packed format.
+    int32 packed_dim = ((dim + 1) * (dim + 2)) / 2;
+    Matrix<double> scatter(num_frames, packed_dim, kUndefined);
+    for (int32 t = 0; t < num_frames; t++) {
+      const double *x = xplus.RowData(t);
+      double *s = scatter.RowData(t);
+      for (int32 r = 0; r <= dim; r++)
+        for (int32 c = 0; c <= r; c++)
+          *(s++) = x[r] * x[c];
+    }
+    Matrix<double> G_packed(dim, packed_dim, kUndefined);
+    G_packed.AddMatMat(1.0, b_dbl, kTrans, scatter, kNoTrans, 0.0);
+    for (int32 i = 0; i < dim; i++) {
+      SubVector<double> this_G(this->G_[i].Data(), packed_dim);
+      this_G.AddVec(1.0, G_packed.Row(i));
+    }
+  } else {
+    // We only need some elements of these stats, so just update those elements.
+    Vector<double> b_col(num_frames), x_col(num_frames), bx_col(num_frames);
+    for (int32 i = 0; i < dim; i++) {
+      b_col.CopyColFromMat(b_dbl, i);
+      x_col.CopyColFromMat(xplus, i);
+      bx_col.CopyFromVec(b_col);
+      bx_col.MulElements(x_col);
+      this->G_[i](i, i) += VecVec(bx_col, x_col);
+      this->G_[i](dim, i) += bx_col.Sum();
+      this->G_[i](dim, dim) += b_col.Sum();
+    }
+  }
+}
     
 
 
@@ -22,6 +22,7 @@
 #ifndef KALDI_TRANSFORM_FMLLR_DIAG_GMM_H_
 #define KALDI_TRANSFORM_FMLLR_DIAG_GMM_H_
 
+#include <utility>
 #include <vector>
 
 #include "base/kaldi-common.h"
@@ -110,7 +111,25 @@ class FmllrDiagGmmAccs: public AffineXformStats {
       const VectorBase<BaseFloat> &data,
       const VectorBase<BaseFloat> &posteriors);
 
-  
+  /// Accumulate stats for a GMM for a sequence of frames, given supplied
+  /// posteriors: row t of "posteriors" is for row t of "data".  This is
+  /// equivalent to calling the one-frame version for each row, but is faster
+  /// because the stats are computed with matrix-matrix operations.
+  void AccumulateFromPosteriors(const DiagGmm &gmm,
+                                const MatrixBase<BaseFloat> &data,
+                                const MatrixBase<BaseFloat> &posteriors);
+
+  /// Accumulate stats for a sequence of frames (e.g. an utterance) given the
+  /// model and a list of (pdf-id, weight) pairs for each frame (e.g. from
+  /// ConvertPosteriorToPdfs()).  This gives the same stats as calling
+  /// AccumulateForGmm() for each frame and pdf, but the stats are committed
+  /// for blocks of frames at a time with matrix-matrix operations.  Returns
+  /// the total log-likelihood, weighted by the pdf weights.
+  BaseFloat AccumulateForFrames(
+      const AmDiagGmm &am_gmm,
+      const MatrixBase<BaseFloat> &data,
+      const std::vector<std::vector<std::pair<int32, BaseFloat> > > &pdf_post);
+
   /// Update
   void Update(const FmllrOptions &opts,
               MatrixBase<BaseFloat> *fmllr_mat,
@@ -148,6 +167,18 @@ class FmllrDiagGmmAccs: public AffineXformStats {
   bool DataHasChanged(const VectorBase<BaseFloat> &data) const; // compares it to the
   // data in single_frame_stats_, returns true if it's different.
 
+  // Commits the stats for a block of frames: row t of "a" and "b" are the
+  // linear and quadratic terms of the auxf for row t of "data" (as in
+  // SingleFrameStats), and counts(t) is its total posterior.  This is the
+  // batched equivalent of CommitSingleFrameStats().
+  void CommitFrameBlock(const MatrixBase<BaseFloat> &data,
+                        const MatrixBase<BaseFloat> &a,
+                        const MatrixBase<BaseFloat> &b,
+                        const VectorBase<BaseFloat> &counts);
+
+  // The number of frames committed at a time by AccumulateForFrames().
+  static const int32 kFrameBlockSize = 256;
+
   SingleFrameStats single_frame_stats_;
   
   // We only use the opts_ variable for its "update_type" data member,
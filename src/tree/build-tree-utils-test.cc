@@ -835,6 +835,53 @@ void TestSplitDecisionTree() {
     }
   }
 }
+// Checks that SplitDecisionTree() gives the same tree for any number of
+// threads.  There are enough stats that the first splits are evaluated in
+// several threads.
+void TestSplitDecisionTreeThreaded() {
+  int32 num_keys = RandInt(1, 4), num_values = RandInt(2, 10);
+  BuildTreeStatsType stats;
+  size_t n_stats = RandInt(100, 500);
+  for (size_t i = 0; i < n_stats; i++) {
+    EventType evec;
+    for (int32 k = 0; k < num_keys; k++)
+      evec.push_back(std::make_pair(static_cast<EventKeyType>(k),
+                                    static_cast<EventValueType>(
+                                        RandInt(0, num_values - 1))));
+    stats.push_back(std::make_pair(evec,
+                                   (Clusterable*) new ScalarClusterable(
+                                       RandGauss())));
+  }
+  Questions qo;
+  qo.InitRand(stats, RandInt(1, 10), RandInt(0, 4), kAllKeysIntersection);
+  int32 max_leaves = RandInt(2, 100);
+
+  std::string tree_str;
+  int32 ref_num_leaves = 0;
+  BaseFloat ref_impr = 0.0;
+  for (int32 num_threads = 1; num_threads <= 4; num_threads++) {
+    int32 num_leaves = 0;
+    EventMap *trivial_tree = TrivialTree(&num_leaves);
+    BaseFloat impr;
+    EventMap *split_tree = SplitDecisionTree(*trivial_tree, stats, qo, 0.0,
+                                             max_leaves, &num_leaves, &impr,
+                                             NULL, num_threads);
+    std::ostringstream os;
+    split_tree->Write(os, false);
+    if (num_threads == 1) {
+      tree_str = os.str();
+      ref_num_leaves = num_leaves;
+      ref_impr = impr;
+    } else {
+      KALDI_ASSERT(os.str() == tree_str && num_leaves == ref_num_leaves &&
+                   impr == ref_impr);
+    }
+    delete trivial_tree;
+    delete split_tree;
+  }
+  DeleteBuildTreeStats(&stats);
+}
+
 void TestBuildTreeStatsIo(bool binary) {
   for (int32 p = 0; p < 10; p++) {
     size_t num_stats = Rand() % 20;
@@ -882,6 +929,7 @@ int main() {
     TestShareEventMapLeaves();
     TestQuestionsInitRand();
     TestSplitDecisionTree();
+    TestSplitDecisionTreeThreaded();
     TestBuildTreeStatsIo(false);
     TestBuildTreeStatsIo(true);
     TestConvertStats();
@@ -20,6 +20,7 @@
 #include <set>
 #include <queue>
 #include "util/stl-utils.h"
+#include "util/kaldi-thread.h"
 #include "tree/build-tree-utils.h"
 
 
@@ -169,13 +170,15 @@ EventMap *DoTableSplitMultiple(const EventMap &orig, const std::vector<EventKeyT
 
 
 
-void SplitStatsByMap(const BuildTreeStatsType &stats, const EventMap &e, std::vector<BuildTreeStatsType> *stats_out) {
-  BuildTreeStatsType::const_iterator iter, end = stats.end();
-  KALDI_ASSERT(stats_out != NULL);
-  stats_out->clear();
-  size_t size = 0;
-  for (iter = stats.begin(); iter != end; ++iter) {
-    const EventType &evec = iter->first;
+// Works out, for each answer of the map "e", the indexes of the stats whose
+// events map to that answer (in order).
+static void SplitStatIndexesByMap(const BuildTreeStatsType &stats,
+                                  const EventMap &e,
+                                  std::vector<std::vector<int32> > *indexes_out) {
+  KALDI_ASSERT(indexes_out != NULL);
+  indexes_out->clear();
+  for (size_t i = 0; i < stats.size(); i++) {
+    const EventType &evec = stats[i].first;
     EventAnswerType ans;
     if (!e.Map(evec, &ans)) // this is an error--could not map it.
       KALDI_ERR << "SplitStatsByMap: could not map event vector " << EventTypeToString(evec)
@@ -183,15 +186,22 @@ void SplitStatsByMap(const BuildTreeStatsType &stats, const EventMap &e, std::ve
                 << "--context-width and --central-position match stats, "
                 << "and that phones that are context-independent (CI) during "
                 << "stats accumulation do not share roots with non-CI phones.";
-    size = std::max(size, (size_t)(ans+1));
+    if (static_cast<size_t>(ans) >= indexes_out->size())
+      indexes_out->resize(ans + 1);
+    (*indexes_out)[ans].push_back(i);
   }
-  stats_out->resize(size);
-  for (iter = stats.begin(); iter != end; ++iter) {
-    const EventType &evec = iter->first;
-    EventAnswerType ans;
-    bool b = e.Map(evec, &ans);
-    KALDI_ASSERT(b);
-    (*stats_out)[ans].push_back(*iter);
+}
+
+void SplitStatsByMap(const BuildTreeStatsType &stats, const EventMap &e, std::vector<BuildTreeStatsType> *stats_out) {
+  KALDI_ASSERT(stats_out != NULL);
+  std::vector<std::vector<int32> > indexes;
+  SplitStatIndexesByMap(stats, e, &indexes);
+  stats_out->clear();
+  stats_out->resize(indexes.size());
+  for (size_t ans = 0; ans < indexes.size(); ans++) {
+    (*stats_out)[ans].reserve(indexes[ans].size());
+    for (size_t j = 0; j < indexes[ans].size(); j++)
+      (*stats_out)[ans].push_back(stats[indexes[ans][j]]);
   }
 }
 
@@ -343,24 +353,16 @@ BaseFloat ComputeInitialSplit(const std::vector<Clusterable*> &summed_stats,
 }
 
 
-// returns best delta-objf.
-// If key does not exist, returns 0 and sets yes_set_out to empty.
-BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
-                              const Questions &q_opts,
-                              EventKeyType key,
-                              std::vector<EventValueType> *yes_set_out) {
-  if (stats.size()<=1) return 0.0;  // cannot split if only zero or one instance of stats.
-  if (!PossibleValues(key, stats, NULL)) {
-    yes_set_out->clear();
-    return 0.0;  // Can't split as key not always defined.
-  }
-  std::vector<Clusterable*> summed_stats;  // indexed by value corresponding to key. owned here.
-  {  // compute summed_stats
-    std::vector<BuildTreeStatsType> split_stats;
-    SplitStatsByKey(stats, key, &split_stats);
-    SumStatsVec(split_stats, &summed_stats);
-  }
-
+// This is the part of FindBestSplitForKey() that comes after the stats have
+// been summed for each value of the key: "summed_stats" is indexed by value
+// (entries may be NULL).  It finds the best initial question and, if
+// configured, refines it.  It deletes the pointers in summed_stats.
+static BaseFloat FindBestSplitGivenSummedStats(
+    const Questions &q_opts,
+    EventKeyType key,
+    std::vector<Clusterable*> *summed_stats_in,
+    std::vector<EventValueType> *yes_set_out) {
+  std::vector<Clusterable*> &summed_stats = *summed_stats_in;
   std::vector<EventValueType> yes_set;
   BaseFloat improvement = ComputeInitialSplit(summed_stats,
                                                q_opts, key, &yes_set);
@@ -421,6 +423,63 @@ BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
 }
 
 
+// returns best delta-objf.
+// If key does not exist, returns 0 and sets yes_set_out to empty.
+BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
+                              const Questions &q_opts,
+                              EventKeyType key,
+                              std::vector<EventValueType> *yes_set_out) {
+  if (stats.size()<=1) return 0.0;  // cannot split if only zero or one instance of stats.
+  if (!PossibleValues(key, stats, NULL)) {
+    yes_set_out->clear();
+    return 0.0;  // Can't split as key not always defined.
+  }
+  std::vector<Clusterable*> summed_stats;  // indexed by value corresponding to key.
+  {  // compute summed_stats
+    std::vector<BuildTreeStatsType> split_stats;
+    SplitStatsByKey(stats, key, &split_stats);
+    SumStatsVec(split_stats, &summed_stats);
+  }
+  return FindBestSplitGivenSummedStats(q_opts, key, &summed_stats,
+                                       yes_set_out);
+}
+
+
+/*
+  TreeStatsColumns is a columnar copy of the stats given to
+  SplitDecisionTree(): for each key that has questions, the values of that key
+  in the events of all the stats are packed into one array.  The
+  DecisionTreeSplitter objects refer to their stats by index, so that summing
+  the stats of a leaf for a key, or splitting a leaf, needs no search in (or
+  copy of) the event vectors.
+*/
+struct TreeStatsColumns {
+  // The value stored if the key is not present in the event.
+  static const EventValueType kNoValue = -1;
+  std::vector<EventKeyType> keys;
+  // values[k][s] is the value of keys[k] in the event of stats s.
+  std::vector<std::vector<EventValueType> > values;
+  std::vector<Clusterable*> stats;  // pointers not owned here.
+
+  TreeStatsColumns(const BuildTreeStatsType &stats_in,
+                   const Questions &q_opts) {
+    q_opts.GetKeysWithQuestions(&keys);
+    values.resize(keys.size(),
+                  std::vector<EventValueType>(stats_in.size(), kNoValue));
+    stats.resize(stats_in.size());
+    for (size_t s = 0; s < stats_in.size(); s++) {
+      stats[s] = stats_in[s].second;
+      for (size_t k = 0; k < keys.size(); k++) {
+        EventValueType val;
+        if (EventMap::Lookup(stats_in[s].first, keys[k], &val))
+          values[k][s] = val;
+      }
+    }
+  }
+};
+
+const EventValueType TreeStatsColumns::kNoValue;
+
 
 /*
   DecisionTreeBuilder is a class used in SplitDecisionTree
@@ -432,46 +491,105 @@ class DecisionTreeSplitter {
     if (!yes_) {  // leaf.
       return new ConstantEventMap(leaf_);
     } else {
-      return new SplitEventMap(key_, yes_set_, yes_->GetMap(), no_->GetMap());
+      return new SplitEventMap(columns_.keys[key_index_], yes_set_,
+                               yes_->GetMap(), no_->GetMap());
     }
   }
   BaseFloat BestSplit() { return best_split_impr_; } // returns objf improvement (>=0) of best possible split.
-  void DoSplit(int32 *next_leaf) {
+  void DoSplit(int32 *next_leaf, int32 num_threads) {
     if (!yes_) {  // not already split; we are a leaf, so split.
-      DoSplitInternal(next_leaf);
+      DoSplitInternal(next_leaf, num_threads);
     } else {  // find which of our children is best to split, and split that.
-      (yes_->BestSplit() >= no_->BestSplit() ? yes_ : no_)->DoSplit(next_leaf);
+      (yes_->BestSplit() >= no_->BestSplit() ? yes_ : no_)->DoSplit(next_leaf,
+                                                                   num_threads);
       best_split_impr_ = std::max(yes_->BestSplit(), no_->BestSplit());  // may have changed.
     }
   }
-  DecisionTreeSplitter(EventAnswerType leaf, const BuildTreeStatsType &stats,
-                      const Questions &q_opts): q_opts_(q_opts), yes_(NULL), no_(NULL), leaf_(leaf), stats_(stats) {
-    // not, this must work when stats is empty too. [just gives zero improvement, non-splittable].
-    FindBestSplit();
+  // Takes the stat indexes from "stat_indexes".  FindBestSplits() must be
+  // called before BestSplit() or DoSplit().
+  DecisionTreeSplitter(EventAnswerType leaf, const TreeStatsColumns &columns,
+                       std::vector<int32> *stat_indexes,
+                       const Questions &q_opts):
+      q_opts_(q_opts), columns_(columns), best_split_impr_(0.0), yes_(NULL),
+      no_(NULL), leaf_(leaf), key_index_(-1) {
+    // note, this must work when there are no stats too. [just gives zero
+    // improvement, non-splittable].
+    stat_indexes_.swap(*stat_indexes);
   }
   ~DecisionTreeSplitter() {
     delete yes_;
     delete no_;
   }
+
+  // This is as FindBestSplitForKey(), for the stats of this leaf and the key
+  // columns_.keys[key_index].  It only reads member variables, so it may be
+  // called from several threads at once.
+  BaseFloat FindBestSplitForKey(int32 key_index,
+                                std::vector<EventValueType> *yes_set) const {
+    if (stat_indexes_.size() <= 1) return 0.0;  // cannot split.
+    const std::vector<EventValueType> &values = columns_.values[key_index];
+    EventValueType max_value = -1;
+    for (size_t i = 0; i < stat_indexes_.size(); i++) {
+      EventValueType val = values[stat_indexes_[i]];
+      if (val == TreeStatsColumns::kNoValue) {
+        yes_set->clear();
+        return 0.0;  // Can't split as key not always defined.
+      }
+      max_value = std::max(max_value, val);
+    }
+    std::vector<Clusterable*> summed_stats(max_value + 1, NULL);
+    for (size_t i = 0; i < stat_indexes_.size(); i++) {
+      Clusterable *cl = columns_.stats[stat_indexes_[i]];
+      if (cl != NULL) {
+        Clusterable *&sum = summed_stats[values[stat_indexes_[i]]];
+        if (sum == NULL) sum = cl->Copy();
+        else sum->Add(*cl);
+      }
+    }
+    return FindBestSplitGivenSummedStats(q_opts_, columns_.keys[key_index],
+                                         &summed_stats, yes_set);
+  }
+
+  // This sets best_split_impr_, key_index_ and yes_set_ for each of
+  // "splitters", which must be leaves.  May just pick best question, or may
+  // iterate a bit (depends on q_opts; see FindBestSplitForKey for details).
+  // The pairs of splitter and key are evaluated by up to num_threads threads.
+  // When called from DoSplitInternal() there are two splitters, so at most
+  // 2 * (number of keys) threads do any work, and they are started and joined
+  // for each split of a leaf with at least 100 stats.
+  static void FindBestSplits(const std::vector<DecisionTreeSplitter*> &splitters,
+                             int32 num_threads);
+
  private:
-  void DoSplitInternal(int32 *next_leaf) {
+  void DoSplitInternal(int32 *next_leaf, int32 num_threads) {
     // Does the split; applicable only to leaf nodes.
     KALDI_ASSERT(!yes_);  // make sure children not already set up.
     KALDI_ASSERT(best_split_impr_ > 0);
     EventAnswerType yes_leaf = leaf_, no_leaf = (*next_leaf)++;
     leaf_ = -1;  // we now have no leaf.
     // Now split the stats.
-    BuildTreeStatsType yes_stats, no_stats;
-    yes_stats.reserve(stats_.size()); no_stats.reserve(stats_.size());  //  probably better than multiple resizings.
-    for (BuildTreeStatsType::const_iterator iter = stats_.begin(); iter != stats_.end(); ++iter) {
-      const EventType &vec = iter->first;
-      EventValueType val;
-      if (!EventMap::Lookup(vec, key_, &val)) KALDI_ERR << "DoSplitInternal: key has no value.";
-      if (std::binary_search(yes_set_.begin(), yes_set_.end(), val)) yes_stats.push_back(*iter);
-      else no_stats.push_back(*iter);
+    const std::vector<EventValueType> &values = columns_.values[key_index_];
+    std::vector<int32> yes_indexes, no_indexes;
+    yes_indexes.reserve(stat_indexes_.size());
+    no_indexes.reserve(stat_indexes_.size());
+    for (size_t i = 0; i < stat_indexes_.size(); i++) {
+      EventValueType val = values[stat_indexes_[i]];
+      if (val == TreeStatsColumns::kNoValue)
+        KALDI_ERR << "DoSplitInternal: key has no value.";
+      if (std::binary_search(yes_set_.begin(), yes_set_.end(), val))
+        yes_indexes.push_back(stat_indexes_[i]);
+      else
+        no_indexes.push_back(stat_indexes_[i]);
     }
 #ifdef KALDI_PARANOID
     {  // Check objf improvement.
+      BuildTreeStatsType yes_stats, no_stats;
+      for (size_t i = 0; i < yes_indexes.size(); i++)
+        yes_stats.push_back(std::make_pair(EventType(),
+                                           columns_.stats[yes_indexes[i]]));
+      for (size_t i = 0; i < no_indexes.size(); i++)
+        no_stats.push_back(std::make_pair(EventType(),
+                                          columns_.stats[no_indexes[i]]));
       Clusterable *yes_clust = SumStats(yes_stats), *no_clust = SumStats(no_stats);
       BaseFloat impr_check = yes_clust->Distance(*no_clust);
       // this is a negated objf improvement from merging (== objf improvement from splitting).
@@ -481,38 +599,19 @@ class DecisionTreeSplitter {
       delete yes_clust; delete no_clust;
     }
 #endif
-    yes_ = new DecisionTreeSplitter(yes_leaf, yes_stats, q_opts_);
-    no_ = new DecisionTreeSplitter(no_leaf, no_stats, q_opts_);
+    yes_ = new DecisionTreeSplitter(yes_leaf, columns_, &yes_indexes, q_opts_);
+    no_ = new DecisionTreeSplitter(no_leaf, columns_, &no_indexes, q_opts_);
+    std::vector<DecisionTreeSplitter*> children;
+    children.push_back(yes_);
+    children.push_back(no_);
+    FindBestSplits(children, num_threads);
     best_split_impr_ = std::max(yes_->BestSplit(), no_->BestSplit());
-    stats_.clear();  // note: pointers in stats_ were not owned here.
+    std::vector<int32>().swap(stat_indexes_);  // free the memory.
   }
-  void FindBestSplit() {
-    // This sets best_split_impr_, key_ and yes_set_.
-    // May just pick best question, or may iterate a bit (depends on
-    // q_opts; see FindBestSplitForKey for details)
-    std::vector<EventKeyType> all_keys;
-    q_opts_.GetKeysWithQuestions(&all_keys);
-    if (all_keys.size() == 0) {
-      KALDI_WARN << "DecisionTreeSplitter::FindBestSplit(), no keys available to split on (maybe no key covered all of your events, or there was a problem with your questions configuration?)";
-    }
-    best_split_impr_ = 0;
-    for (size_t i = 0; i < all_keys.size(); i++) {
-      if (q_opts_.HasQuestionsForKey(all_keys[i])) {
-        std::vector<EventValueType> temp_yes_set;
-        BaseFloat split_improvement = FindBestSplitForKey(stats_, q_opts_, all_keys[i], &temp_yes_set);
-        if (split_improvement > best_split_impr_) {
-          best_split_impr_ = split_improvement;
-          yes_set_ = temp_yes_set;
-          key_ = all_keys[i];
-        }
-      }
-    }
-  }
-
-
 
   // Data members... Always used:
   const Questions &q_opts_;
+  const TreeStatsColumns &columns_;
   BaseFloat best_split_impr_;
 
   // If already split:
@@ -521,14 +620,73 @@ class DecisionTreeSplitter {
 
   // Otherwise:
   EventAnswerType leaf_;
-  BuildTreeStatsType stats_;  // vector of stats.  pointers inside there not owned here.
+  std::vector<int32> stat_indexes_;  // indexes into columns_.
 
-  // key and "yes set" of best split:
-  EventKeyType key_;
+  // key (as index into columns_.keys) and "yes set" of best split:
+  int32 key_index_;
   std::vector<EventValueType> yes_set_;
 
 };
 
+// This class is used in DecisionTreeSplitter::FindBestSplits(); it evaluates
+// the pairs (splitter, key) with indexes thread_id_, thread_id_ + num_threads_,
+// and so on, where pair j is splitter j / num_keys and key j % num_keys.
+class FindBestSplitsClass: public MultiThreadable {
+ public:
+  FindBestSplitsClass(const std::vector<DecisionTreeSplitter*> &splitters,
+                      int32 num_keys,
+                      std::vector<BaseFloat> *improvements,
+                      std::vector<std::vector<EventValueType> > *yes_sets):
+      splitters_(splitters), num_keys_(num_keys), improvements_(improvements),
+      yes_sets_(yes_sets) { }
+  void operator () () {
+    for (size_t j = thread_id_; j < improvements_->size(); j += num_threads_)
+      (*improvements_)[j] = splitters_[j / num_keys_]->FindBestSplitForKey(
+          j % num_keys_, &((*yes_sets_)[j]));
+  }
+ private:
+  const std::vector<DecisionTreeSplitter*> &splitters_;
+  int32 num_keys_;
+  std::vector<BaseFloat> *improvements_;
+  std::vector<std::vector<EventValueType> > *yes_sets_;
+};
+
+void DecisionTreeSplitter::FindBestSplits(
+    const std::vector<DecisionTreeSplitter*> &splitters, int32 num_threads) {
+  if (splitters.empty()) return;
+  const TreeStatsColumns &columns = splitters[0]->columns_;
+  int32 num_keys = columns.keys.size();
+  if (num_keys == 0) {
+    KALDI_WARN << "DecisionTreeSplitter::FindBestSplit(), no keys available to split on (maybe no key covered all of your events, or there was a problem with your questions configuration?)";
+  }
+  std::vector<BaseFloat> improvements(splitters.size() * num_keys, 0.0);
+  std::vector<std::vector<EventValueType> > yes_sets(improvements.size());
+  // Starting threads is not worthwhile for small numbers of stats, which is
+  // the case for most of the splits near the leaves of the tree.
+  size_t num_stats = 0;
+  for (size_t i = 0; i < splitters.size(); i++)
+    num_stats += splitters[i]->stat_indexes_.size();
+  FindBestSplitsClass c(splitters, num_keys, &improvements, &yes_sets);
+  if (num_threads > 1 && improvements.size() > 1 && num_stats >= 100) {
+    MultiThreader<FindBestSplitsClass> m(
+        std::min<int32>(num_threads, improvements.size()), c);
+  } else {
+    MultiThreader<FindBestSplitsClass> m(0, c);  // runs in this thread.
+  }
+  for (size_t i = 0; i < splitters.size(); i++) {
+    DecisionTreeSplitter *splitter = splitters[i];
+    splitter->best_split_impr_ = 0;
+    for (int32 k = 0; k < num_keys; k++) {
+      size_t j = i * num_keys + k;
+      if (improvements[j] > splitter->best_split_impr_) {
+        splitter->best_split_impr_ = improvements[j];
+        splitter->yes_set_ = yes_sets[j];
+        splitter->key_index_ = k;
+      }
+    }
+  }
+}
+
 EventMap *SplitDecisionTree(const EventMap &input_map,
                             const BuildTreeStatsType &stats,
                             Questions &q_opts,
@@ -536,23 +694,27 @@ EventMap *SplitDecisionTree(const EventMap &input_map,
                             int32 max_leaves,  // max_leaves<=0 -> no maximum.
                             int32 *num_leaves,
                             BaseFloat *obj_impr_out,
-                            BaseFloat *smallest_split_change_out) {
+                            BaseFloat *smallest_split_change_out,
+                            int32 num_threads) {
   KALDI_ASSERT(num_leaves != NULL && *num_leaves > 0);  // can't be 0 or input_map would be empty.
   int32 num_empty_leaves = 0;
   BaseFloat like_impr = 0.0;
   BaseFloat smallest_split_change = 1.0e+20;
+  TreeStatsColumns columns(stats, q_opts);
   std::vector<DecisionTreeSplitter*> builders;
   {  // set up "builders" [one for each current leaf].  This array is never extended.
     // the structures generated during splitting remain as trees at each array location.
-    std::vector<BuildTreeStatsType> split_stats;
-    SplitStatsByMap(stats, input_map, &split_stats);
-    KALDI_ASSERT(split_stats.size() != 0);
-    builders.resize(split_stats.size());  // size == #leaves.
-    for (size_t i = 0;i < split_stats.size();i++) {
+    std::vector<std::vector<int32> > split_indexes;
+    SplitStatIndexesByMap(stats, input_map, &split_indexes);
+    KALDI_ASSERT(split_indexes.size() != 0);
+    builders.resize(split_indexes.size());  // size == #leaves.
+    for (size_t i = 0;i < split_indexes.size();i++) {
       EventAnswerType leaf = static_cast<EventAnswerType>(i);
-      if (split_stats[i].size() == 0) num_empty_leaves++;
-      builders[i] = new DecisionTreeSplitter(leaf, split_stats[i], q_opts);
+      if (split_indexes[i].size() == 0) num_empty_leaves++;
+      builders[i] = new DecisionTreeSplitter(leaf, columns, &(split_indexes[i]),
+                                             q_opts);
     }
+    DecisionTreeSplitter::FindBestSplits(builders, num_threads);
   }
 
   {  // Do the splitting.
@@ -569,7 +731,7 @@ EventMap *SplitDecisionTree(const EventMap &input_map,
       smallest_split_change = std::min(smallest_split_change, queue.top().first);
       size_t i = queue.top().second;
       like_impr += queue.top().first;
-      builders[i]->DoSplit(num_leaves);
+      builders[i]->DoSplit(num_leaves, num_threads);
       queue.pop();
       queue.push(std::make_pair(builders[i]->BestSplit(), i));
       count++;
@@ -20,6 +20,7 @@
 
 
 
+#include <chrono>
 #include "base/kaldi-error.h"
 #include "util/kaldi-semaphore.h"
 
@@ -48,6 +49,20 @@ void Semaphore::Wait() {
   count_--;
 }
 
+bool Semaphore::TimedWait(double seconds) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::microseconds(static_cast<int64>(seconds * 1.0e+06));
+  while (!count_) {
+    if (condition_variable_.wait_until(lock, deadline) ==
+        std::cv_status::timeout && !count_)
+      return false;
+  }
+  count_--;
+  return true;
+}
+
 void Semaphore::Signal() {
   std::unique_lock<std::mutex> lock(mutex_);
   count_++;
@@ -35,6 +35,9 @@ class Semaphore {
 
   bool TryWait();  ///< Returns true if Wait() goes through
   void Wait();     ///< decrease the counter
+  /// Like Wait(), but gives up after 'seconds'; returns true if the counter
+  /// was decreased.
+  bool TimedWait(double seconds);
   void Signal();   ///< increase the counter
 
  private:
@@ -123,6 +123,40 @@ void TestTaskSequencer() {
 }
 
 
+// Sums up a pre-given integer into an accumulator obtained from an
+// AccumulatorPool.
+class MyAccumTaskClass {
+ public:
+  MyAccumTaskClass(int32 i, AccumulatorPool<int64> *pool):
+      i_(i), pool_(pool) { }
+  void operator() () {
+    int64 *accum = pool_->Acquire();
+    *accum += i_;
+    pool_->Release(accum);
+  }
+ private:
+  int32 i_;
+  AccumulatorPool<int64> *pool_;
+};
+
+void TestAccumulatorPool() {
+  TaskSequencerConfig config;
+  config.num_threads = Rand() % 10;
+  AccumulatorPool<int64> pool(config);
+  for (int32 i = 0; i < pool.NumAccums(); i++)
+    pool.Accum(i) = 0;
+  int32 num_tasks = Rand() % 100;
+  {
+    TaskSequencer<MyAccumTaskClass> sequencer(config);
+    for (int32 i = 0; i < num_tasks; i++)
+      sequencer.Run(new MyAccumTaskClass(i, &pool));
+  }
+  int64 tot = 0;
+  for (int32 i = 0; i < pool.NumAccums(); i++)
+    tot += pool.Accum(i);
+  KALDI_ASSERT(tot == (num_tasks * (num_tasks - 1)) / 2);
+}
+
 }  // end namespace kaldi.
 
 int main() {
@@ -130,4 +164,6 @@ int main() {
   TestThreads();
   for (int32 i = 0; i < 10; i++)
     TestTaskSequencer();
+  for (int32 i = 0; i < 10; i++)
+    TestAccumulatorPool();
 }
@@ -23,6 +23,8 @@
 #define KALDI_THREAD_KALDI_THREAD_H_ 1
 
 #include <thread>
+#include <mutex>
+#include <vector>
 #include <algorithm>
 #include "itf/options-itf.h"
 #include "util/kaldi-semaphore.h"
@@ -280,6 +282,52 @@ class TaskSequencer {
 
 };
 
+/// AccumulatorPool is for programs that use TaskSequencer to accumulate
+/// statistics (e.g. GMM or tree stats) from a sequence of utterances.  It holds
+/// one accumulator of type A per thread: each task calls Acquire() at the start
+/// of its operator () and Release() at the end, so it has an accumulator to
+/// itself without any locking while it accumulates.  Because TaskSequencer
+/// runs no more than config.num_threads operator () calls at a time, an
+/// accumulator is always free.  At the end the program merges the
+/// accumulators, e.g. by adding Accum(1) ... Accum(NumAccums() - 1) to
+/// Accum(0); with one thread the result is the same as accumulating in a
+/// single loop.  A must have a default constructor.
+template<class A>
+class AccumulatorPool {
+ public:
+  explicit AccumulatorPool(const TaskSequencerConfig &config):
+      accums_(std::max<int32>(1, config.num_threads)) {
+    for (size_t i = 0; i < accums_.size(); i++)
+      free_accums_.push_back(&(accums_[i]));
+  }
+
+  /// Returns an accumulator that no other task is using.
+  A *Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    KALDI_ASSERT(!free_accums_.empty() &&
+                 "More tasks running than --num-threads");
+    A *accum = free_accums_.back();
+    free_accums_.pop_back();
+    return accum;
+  }
+
+  /// Gives back an accumulator obtained from Acquire().
+  void Release(A *accum) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_accums_.push_back(accum);
+  }
+
+  int32 NumAccums() const { return accums_.size(); }
+  /// Gives access to the accumulators, e.g. to initialize them before the
+  /// tasks are run or to merge them afterwards.
+  A &Accum(int32 i) { return accums_[i]; }
+
+ private:
+  std::vector<A> accums_;
+  std::vector<A*> free_accums_;
+  std::mutex mutex_;
+};
+
 } // namespace kaldi
 
 #endif  // KALDI_THREAD_KALDI_THREAD_H_